@@ -108,6 +108,7 @@ class AliasSet : public ilist_node<AliasSet> {
   };
 
   PointerRec *PtrList, **PtrListEnd;  // Doubly linked list of nodes.
+  unsigned SetSize;              // Number of nodes in PtrList.
   AliasSet *Forward;             // Forwarding pointer.
   AliasSet *Next, *Prev;         // Doubly linked list of AliasSets.
 
@@ -178,6 +179,9 @@ public:
   iterator end()   const { return iterator(); }
   bool empty() const { return PtrList == 0; }
 
+  /// size - Return the number of pointers in this alias set.
+  unsigned size() const { return SetSize; }
+
   void print(raw_ostream &OS) const;
   void dump() const;
 
@@ -222,8 +226,9 @@ private:
   // Can only be created by AliasSetTracker. Also, ilist creates one
   // to serve as a sentinel.
   friend struct ilist_sentinel_traits<AliasSet>;
-  AliasSet() : PtrList(0), PtrListEnd(&PtrList), Forward(0), RefCount(0),
-               AccessTy(NoModRef), AliasTy(MustAlias), Volatile(false) {
+  AliasSet() : PtrList(0), PtrListEnd(&PtrList), SetSize(0), Forward(0),
+               RefCount(0), AccessTy(NoModRef), AliasTy(MustAlias),
+               Volatile(false) {
   }
 
   AliasSet(const AliasSet &AS);        // do not implement
@@ -253,7 +258,8 @@ private:
   void addPointer(AliasSetTracker &AST, PointerRec &Entry, uint64_t Size,
                   const MDNode *TBAAInfo,
                   bool KnownMustAlias = false);
-  void addCallSite(CallSite CS, AliasAnalysis &AA);
+  void addCallSite(CallSite CS, AliasSetTracker &AST);
+  void setMayAlias(AliasSetTracker &AST);
   void removeCallSite(CallSite CS) {
     for (size_t i = 0, e = CallSites.size(); i != e; ++i)
       if (CallSites[i] == CS.getInstruction()) {
@@ -301,11 +307,25 @@ class AliasSetTracker {
   // Map from pointers to their node
   PointerMapType PointerMap;
 
+  /// AliasAnyAS - Once the tracker is saturated, this is the single live
+  /// alias set that every pointer and call site is put into.
+  AliasSet *AliasAnyAS;
+
+  /// TotalMayAliasSetSize - The number of pointers in live may-alias sets.
+  /// Each query against a may-alias set is linear in its size, so once this
+  /// exceeds the saturation threshold all sets are collapsed into AliasAnyAS.
+  unsigned TotalMayAliasSetSize;
+
+  /// NumLiveSets - The number of alias sets that are not forwarding.  Adding a
+  /// pointer queries each of them, so this is bounded the same way.
+  unsigned NumLiveSets;
+
 public:
   /// AliasSetTracker ctor - Create an empty collection of AliasSets, and use
   /// the specified alias analysis object to disambiguate load and store
   /// addresses.
-  explicit AliasSetTracker(AliasAnalysis &aa) : AA(aa) {}
+  explicit AliasSetTracker(AliasAnalysis &aa)
+    : AA(aa), AliasAnyAS(0), TotalMayAliasSetSize(0), NumLiveSets(0) {}
   ~AliasSetTracker() { clear(); }
 
   /// add methods - These methods are used to add different types of
@@ -371,6 +391,10 @@ public:
   /// alias sets.
   bool containsPointer(Value *P, uint64_t Size, const MDNode *TBAAInfo) const;
 
+  /// isSaturated - Return true if this tracker has given up on disambiguating
+  /// pointers and keeps all of them in one may-alias, mod/ref set.
+  bool isSaturated() const { return AliasAnyAS != 0; }
+
   /// getAliasAnalysis - Return the underlying alias analysis object used by
   /// this tracker.
   AliasAnalysis &getAliasAnalysis() const { return AA; }
@@ -422,8 +446,10 @@ private:
     NewSet = false;
     AliasSet &AS = getAliasSetForPointer(P, Size, TBAAInfo, &NewSet);
     AS.AccessTy |= E;
-    return AS;
+    return checkSaturation(AS);
   }
+  AliasSet &checkSaturation(AliasSet &AS);
+  AliasSet &mergeAllAliasSets();
   AliasSet *findAliasSetForPointer(const Value *Ptr, uint64_t Size,
                                    const MDNode *TBAAInfo);
 
@@ -30,14 +30,29 @@ namespace llvm {
 
 class AliasAnalysis;
 class AnalysisUsage;
+class LoopInfo;
 class ScalarEvolution;
 class SCEV;
 class Value;
 class raw_ostream;
 
 class LoopDependenceAnalysis : public LoopPass {
+public:
+  /// Distance - The dependence distance of a pair of memory accesses in one
+  /// of the loops containing both: if the first access touches a location in
+  /// some iteration of the loop, the second one touches it Value iterations
+  /// later.  Known is false if the distance could not be computed, in which
+  /// case any distance is possible.
+  struct Distance {
+    const Loop *L;
+    bool Known;
+    int64_t Value;
+  };
+
+private:
   AliasAnalysis *AA;
   ScalarEvolution *SE;
+  LoopInfo *LI;
 
   /// L - The loop we are currently analysing.
   Loop *L;
@@ -45,9 +60,10 @@ class LoopDependenceAnalysis : public LoopPass {
   /// TODO: doc
   enum DependenceResult { Independent = 0, Dependent = 1, Unknown = 2 };
 
-  /// TODO: doc
+  /// Subscript - The result of testing a pair of subscripts: the dependence
+  /// distances it determines in the loops of the nest.
   struct Subscript {
-    /// TODO: Add distance, direction, breaking conditions, ...
+    SmallVector<std::pair<const Loop*, int64_t>, 2> Distances;
   };
 
   /// DependencePair - Represents a data dependence relation between to memory
@@ -57,11 +73,18 @@ class LoopDependenceAnalysis : public LoopPass {
     Value *B;
     DependenceResult Result;
     SmallVector<Subscript, 4> Subscripts;
+    /// Distances - The distance vector of the pair, one entry for each loop
+    /// containing both accesses, outermost first.
+    SmallVector<Distance, 4> Distances;
 
     DependencePair(const FoldingSetNodeID &ID, Value *a, Value *b) :
         FastFoldingSetNode(ID), A(a), B(b), Result(Unknown), Subscripts() {}
   };
 
+  /// Nest - The loops containing both accesses of the pair being analysed,
+  /// outermost first.
+  SmallVector<const Loop*, 4> Nest;
+
   /// findOrInsertDependencePair - Return true if a DependencePair for the
   /// given Values already exists, false if a new DependencePair had to be
   /// created. The third argument is set to the pair found or created.
@@ -86,8 +109,14 @@ class LoopDependenceAnalysis : public LoopPass {
   DependenceResult analyseZIV(const SCEV*, const SCEV*, Subscript*) const;
   DependenceResult analyseSIV(const SCEV*, const SCEV*, Subscript*) const;
   DependenceResult analyseMIV(const SCEV*, const SCEV*, Subscript*) const;
+
+  /// analyseLinear - Test a pair of subscripts that are linear functions of
+  /// the induction variables of Nest with the same constant coefficients, by
+  /// solving for the distance in each loop.
+  DependenceResult analyseLinear(const SCEV*, const SCEV*, Subscript*) const;
   DependenceResult analyseSubscript(const SCEV*, const SCEV*, Subscript*) const;
-  DependenceResult analysePair(DependencePair*) const;
+  DependenceResult analysePair(DependencePair*);
+  DependencePair *getAnalysedPair(Value*, Value*);
 
 public:
   static char ID; // Class identification, replacement for typeinfo
@@ -104,6 +133,11 @@ public:
   /// between two instructions.
   bool depends(Value*, Value*);
 
+  /// getDistanceVector - Return false if the two instructions are independent.
+  /// Otherwise fill in the distance of the dependence in each loop containing
+  /// both instructions, outermost first.
+  bool getDistanceVector(Value*, Value*, SmallVectorImpl<Distance>&);
+
   bool runOnLoop(Loop*, LPPassManager&);
   virtual void releaseMemory();
   virtual void getAnalysisUsage(AnalysisUsage&) const;
@@ -31,6 +31,13 @@ namespace llvm {
   //
   Pass *createGlobalsModRefPass();
 
+  //===--------------------------------------------------------------------===//
+  //
+  // createAndersensPass - This pass implements Andersen's interprocedural
+  // inclusion-based points-to analysis.
+  //
+  ModulePass *createAndersensPass();
+
   //===--------------------------------------------------------------------===//
   //
   // createAliasDebugger - This pass helps debug clients of AA
@@ -632,6 +632,11 @@ namespace llvm {
     /// actual backedge taken count.
     const SCEV *getMaxBackedgeTakenCount(const Loop *L);
 
+    /// getExitCount - Return the number of times the backedge of the specified
+    /// loop is taken before it exits via ExitingBlock, ignoring its other
+    /// exits, or a SCEVCouldNotCompute object if this isn't predictable.
+    const SCEV *getExitCount(const Loop *L, BasicBlock *ExitingBlock);
+
     /// hasLoopInvariantBackedgeTakenCount - Return true if the specified loop
     /// has an analyzable loop-invariant backedge-taken count.
     bool hasLoopInvariantBackedgeTakenCount(const Loop *L);
@@ -610,6 +610,12 @@ namespace ISD {
     ATOMIC_LOAD_UMIN,
     ATOMIC_LOAD_UMAX,
 
+    // LIFETIME_START/LIFETIME_END - These nodes take a chain and the
+    // TargetFrameIndex of a static alloca, and return a chain. They carry the
+    // llvm.lifetime.start/end markers to the stack coloring pass.
+    LIFETIME_START,
+    LIFETIME_END,
+
     /// BUILTIN_OP_END - This must be the last enum value in this list.
     /// The target-specific pre-isel opcode values start here.
     BUILTIN_OP_END
@@ -35,6 +35,8 @@
 namespace llvm {
 
   class AliasAnalysis;
+  class BasicBlock;
+  class Function;
   class LiveVariables;
   class MachineLoopInfo;
   class TargetRegisterInfo;
@@ -42,6 +44,8 @@ namespace llvm {
   class TargetInstrInfo;
   class TargetRegisterClass;
   class VirtRegMap;
+  template<class FType, class BType> class ProfileInfoT;
+  typedef ProfileInfoT<Function, BasicBlock> ProfileInfo;
 
   class LiveIntervals : public MachineFunctionPass {
     MachineFunction* mf_;
@@ -52,6 +56,8 @@ namespace llvm {
     AliasAnalysis *aa_;
     LiveVariables* lv_;
     SlotIndexes* indexes_;
+    const MachineLoopInfo* loops_;
+    ProfileInfo* profile_;
 
     /// Special pool allocator for VNInfo's (LiveInterval val#).
     ///
@@ -75,6 +81,20 @@ namespace llvm {
     // Calculate the spill weight to assign to a single instruction.
     static float getSpillWeight(bool isDef, bool isUse, unsigned loopDepth);
 
+    // Return the expected number of executions of mbb per function invocation,
+    // the unit spill weights and spill placement measure costs in. Measured
+    // counts are used when the profile covers the function, otherwise the
+    // frequency is estimated from the loop depth like getSpillWeight does.
+    static float getBlockFrequency(const MachineBasicBlock *mbb,
+                                   const MachineLoopInfo &loops,
+                                   ProfileInfo *profile);
+
+    // Return the block frequency of mbb using the profile, if any, that was
+    // available when the intervals were computed.
+    float getBlockFrequency(const MachineBasicBlock *mbb) const {
+      return getBlockFrequency(mbb, *loops_, profile_);
+    }
+
     // After summing the spill weights of all defs and uses, the final weight
     // should be normalized, dividing the weight of the interval by its size.
     // This encourages spilling of intervals that are large and have few uses,
@@ -167,7 +187,9 @@ namespace llvm {
     /// range to just the remaining uses. This method does not compute reaching
     /// defs for new uses, and it doesn't remove dead defs.
     /// Dead PHIDef values are marked as unused.
-    void shrinkToUses(LiveInterval *li);
+    /// New dead machine instructions are added to the dead vector.
+    void shrinkToUses(LiveInterval *li,
+                      SmallVectorImpl<MachineInstr*> *dead = 0);
 
     // Interval removal
 
@@ -22,6 +22,7 @@
 
 namespace llvm {
 class raw_ostream;
+class AllocaInst;
 class TargetData;
 class TargetRegisterClass;
 class Type;
@@ -108,10 +109,15 @@ class MachineFrameInfo {
     // block and doesn't need additional handling for allocation beyond that.
     bool PreAllocated;
 
+    // Alloca - If this stack object was created for a static alloca, this is
+    // the alloca. Stack coloring uses it to rewrite memory operands.
+    const AllocaInst *Alloca;
+
     StackObject(uint64_t Sz, unsigned Al, int64_t SP, bool IM,
-                bool isSS, bool NSP)
+                bool isSS, bool NSP, const AllocaInst *Val = 0)
       : SPOffset(SP), Size(Sz), Alignment(Al), isImmutable(IM),
-        isSpillSlot(isSS), MayNeedSP(NSP), PreAllocated(false) {}
+        isSpillSlot(isSS), MayNeedSP(NSP), PreAllocated(false),
+        Alloca(Val) {}
   };
 
   /// Objects - The list of stack objects allocated...
@@ -192,6 +198,11 @@ class MachineFrameInfo {
   /// CSIValid - Has CSInfo been set yet?
   bool CSIValid;
 
+  /// SavePoint - The block where the prolog and the callee saved register
+  /// spills are inserted. Null means the entry block. Shrink wrapping may pick
+  /// a later block that dominates every use of the frame.
+  MachineBasicBlock *SavePoint;
+
   /// TargetFrameLowering - Target information about frame layout.
   ///
   const TargetFrameLowering &TFI;
@@ -223,6 +234,7 @@ public:
     StackProtectorIdx = -1;
     MaxCallFrameSize = 0;
     CSIValid = false;
+    SavePoint = 0;
     LocalFrameSize = 0;
     LocalFrameMaxAlign = 0;
     UseLocalStackAllocationBlock = false;
@@ -353,6 +365,14 @@ public:
     MaxAlignment = std::max(MaxAlignment, Align);
   }
 
+  /// getObjectAllocation - Return the underlying Alloca of the specified
+  /// stack object if it exists, or null.
+  const AllocaInst *getObjectAllocation(int ObjectIdx) const {
+    assert(unsigned(ObjectIdx+NumFixedObjects) < Objects.size() &&
+           "Invalid Object Idx!");
+    return Objects[ObjectIdx+NumFixedObjects].Alloca;
+  }
+
   /// NeedsStackProtector - Returns true if the object may need stack
   /// protectors.
   bool MayNeedStackProtector(int ObjectIdx) const {
@@ -471,9 +491,10 @@ public:
   /// a nonnegative identifier to represent it.
   ///
   int CreateStackObject(uint64_t Size, unsigned Alignment, bool isSS,
-                        bool MayNeedSP = false) {
+                        bool MayNeedSP = false, const AllocaInst *Alloca = 0) {
     assert(Size != 0 && "Cannot allocate zero size stack objects!");
-    Objects.push_back(StackObject(Size, Alignment, 0, false, isSS, MayNeedSP));
+    Objects.push_back(StackObject(Size, Alignment, 0, false, isSS, MayNeedSP,
+                                  Alloca));
     int Index = (int)Objects.size() - NumFixedObjects - 1;
     assert(Index >= 0 && "Bad frame index!");
     MaxAlignment = std::max(MaxAlignment, Alignment);
@@ -527,6 +548,11 @@ public:
 
   void setCalleeSavedInfoValid(bool v) { CSIValid = v; }
 
+  /// getSavePoint - Return the block that receives the prolog, or null if it
+  /// is the entry block.
+  MachineBasicBlock *getSavePoint() const { return SavePoint; }
+  void setSavePoint(MachineBasicBlock *MBB) { SavePoint = MBB; }
+
   /// getPristineRegs - Return a set of physical registers that are pristine on
   /// entry to the MBB.
   ///
@@ -535,7 +561,9 @@ public:
   /// been saved yet.
   ///
   /// Before the PrologueEpilogueInserter has placed the CSR spill code, this
-  /// method always returns an empty set.
+  /// method always returns an empty set. When the spills have been shrink
+  /// wrapped, the blocks that run before the save point get the saved CSRs as
+  /// live-ins instead.
   BitVector getPristineRegs(const MachineBasicBlock *MBB) const;
 
   /// print - Used by the MachineFunction printer to print information about
@@ -24,6 +24,7 @@ namespace llvm {
   class MachineFunctionPass;
   class PassInfo;
   class TargetLowering;
+  class TargetFrameLowering;
   class RegisterCoalescer;
   class raw_ostream;
 
@@ -138,9 +139,11 @@ namespace llvm {
   RegisterCoalescer *createSimpleRegisterCoalescer();
 
   /// PrologEpilogCodeInserter Pass - This pass inserts prolog and epilog code,
-  /// and eliminates abstract frame references.
+  /// and eliminates abstract frame references. When optimizing, it shrink
+  /// wraps the prolog if TFI supports that.
   ///
-  FunctionPass *createPrologEpilogCodeInserter();
+  FunctionPass *createPrologEpilogCodeInserter(CodeGenOpt::Level OptLevel,
+                                               const TargetFrameLowering *TFI);
 
   /// LowerSubregs Pass - This pass lowers subregs to register-register copies
   /// which yields suboptimal, but correct code if the register allocator
@@ -203,10 +206,18 @@ namespace llvm {
   /// like extension and comparison eliminations.
   FunctionPass *createPeepholeOptimizerPass();
 
+  /// createMachineSchedulerPass - This pass schedules machine instructions
+  /// before register allocation, tracking register pressure.
+  FunctionPass *createMachineSchedulerPass(CodeGenOpt::Level OptLevel);
+
   /// createOptimizePHIsPass - This pass optimizes machine instruction PHIs
   /// to take advantage of opportunities created during DAG legalization.
   FunctionPass *createOptimizePHIsPass();
 
+  /// createStackColoringPass - This pass merges the stack objects of allocas
+  /// whose lifetime markers show that they are never live at the same time.
+  FunctionPass *createStackColoringPass();
+
   /// createStackSlotColoringPass - This pass performs stack slot coloring.
   FunctionPass *createStackSlotColoringPass(bool);
 
@@ -56,6 +56,11 @@ namespace llvm {
     /// symbol.
     unsigned NextUniqueID;
 
+    /// TempSymbolTag - Text inserted after the private prefix of every
+    /// assembler temporary symbol, to keep them apart from the temporaries of
+    /// other output that this is assembled together with.
+    std::string TempSymbolTag;
+
     /// Instances of directional local labels.
     DenseMap<unsigned, MCLabel *> Instances;
     /// NextInstance() creates the next instance of the directional local label
@@ -109,6 +114,10 @@ namespace llvm {
 
     const TargetAsmInfo &getTargetAsmInfo() const { return *TAI; }
 
+    /// setTempSymbolTag - Set the text that distinguishes the assembler
+    /// temporaries of this context.  This must be done before any are made.
+    void setTempSymbolTag(StringRef Tag) { TempSymbolTag = Tag; }
+
     /// @name Symbol Management
     /// @{
 
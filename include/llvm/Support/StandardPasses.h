@@ -46,6 +46,8 @@ namespace llvm {
   /// \arg HaveExceptions - Whether the module may have code using exceptions.
   /// \arg InliningPass - The inlining pass to use, if any, or null. This will
   /// always be added, even at -O0.a
+  /// \arg TLI - The target lowering information that loop and vectorization
+  /// passes consult, or null if the target is not known.
   static inline void createStandardModulePasses(PassManagerBase *PM,
                                                 unsigned OptimizationLevel,
                                                 bool OptimizeSize,
@@ -53,7 +55,8 @@ namespace llvm {
                                                 bool UnrollLoops,
                                                 bool SimplifyLibCalls,
                                                 bool HaveExceptions,
-                                                Pass *InliningPass);
+                                                Pass *InliningPass,
+                                             const TargetLowering *TLI = 0);
 
   /// createStandardLTOPasses - Add the standard list of module passes suitable
   /// for link time optimization.
@@ -95,7 +98,8 @@ namespace llvm {
                                                 bool UnrollLoops,
                                                 bool OptimizeBuiltins,
                                                 bool HaveExceptions,
-                                                Pass *InliningPass) {
+                                                Pass *InliningPass,
+                                                const TargetLowering *TLI) {
     createStandardAliasAnalysisPasses(PM);
 
     if (OptimizationLevel == 0) {
@@ -106,6 +110,8 @@ namespace llvm {
     
     if (UnitAtATime) {
       PM->add(createGlobalOptimizerPass());     // Optimize out global vars
+      if (OptimizationLevel > 2 && !OptimizeSize)
+        PM->add(createFunctionSpecializationPass()); // Clone for constant args
       
       PM->add(createIPSCCPPass());              // IP SCCP
       PM->add(createDeadArgEliminationPass());  // Dead argument elimination
@@ -124,6 +130,7 @@ namespace llvm {
       PM->add(createArgumentPromotionPass());   // Scalarize uninlined fn args
     
     // Start of function pass.
+    PM->add(createHeapToStackPass());           // Turn temporary mallocs into allocas
     // Break up aggregate allocas, using SSAUpdater.
     PM->add(createScalarReplAggregatesPass(-1, false));
     PM->add(createEarlyCSEPass());              // Catch trivial redundancies
@@ -143,8 +150,12 @@ namespace llvm {
     PM->add(createInstructionCombiningPass());  
     PM->add(createIndVarSimplifyPass());        // Canonicalize indvars
     if (OptimizeBuiltins)
-      PM->add(createLoopIdiomPass());           // Recognize idioms like memset.
+      PM->add(createLoopIdiomPass(TLI));        // Recognize idioms like memset.
     PM->add(createLoopDeletionPass());          // Delete dead loops
+    if (OptimizationLevel > 2) {
+      PM->add(createLoopInterchangePass(TLI));  // Improve locality of nests
+      PM->add(createLoopVectorizePass(TLI));    // Vectorize innermost loops
+    }
     if (UnrollLoops)
       PM->add(createLoopUnrollPass());          // Unroll small loops
     PM->add(createInstructionCombiningPass());  // Clean up after the unroller
@@ -156,6 +167,10 @@ namespace llvm {
     // Run instcombine after redundancy elimination to exploit opportunities
     // opened up by them.
     PM->add(createInstructionCombiningPass());
+    if (OptimizationLevel > 2) {
+      PM->add(createSLPVectorizerPass(TLI));    // Vectorize straight-line code
+      PM->add(createInstructionCombiningPass());
+    }
     PM->add(createJumpThreadingPass());         // Thread jumps
     PM->add(createCorrelatedValuePropagationPass());
     PM->add(createDeadStoreEliminationPass());  // Delete dead stores
@@ -171,8 +186,10 @@ namespace llvm {
       if (OptimizationLevel > 2)
         PM->add(createGlobalDCEPass());         // Remove dead fns and globals.
     
-      if (OptimizationLevel > 1)
+      if (OptimizationLevel > 1) {
         PM->add(createConstantMergePass());       // Merge dup global constants
+        PM->add(createMergeFunctionsPass());      // Merge identical functions
+      }
     }
   }
 
@@ -240,6 +257,7 @@ namespace llvm {
     // Run a few AA driven optimizations here and now, to cleanup the code.
     addOnePass(PM, createFunctionAttrsPass(), VerifyEach); // Add nocapture.
     addOnePass(PM, createGlobalsModRefPass(), VerifyEach); // IP alias analysis.
+    addOnePass(PM, createAndersensPass(), VerifyEach);     // IP points-to.
 
     addOnePass(PM, createLICMPass(), VerifyEach);      // Hoist loop invariants.
     addOnePass(PM, createGVNPass(), VerifyEach);       // Remove redundancies.
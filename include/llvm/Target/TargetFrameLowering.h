@@ -107,11 +107,35 @@ public:
   }
 
   /// emitProlog/emitEpilog - These methods insert prolog and epilog code into
-  /// the function.
+  /// the function. The prolog goes into the save point recorded in the
+  /// function's MachineFrameInfo, which is the entry block unless
+  /// enableShrinkWrapping() allowed the inserter to pick a later block.
   virtual void emitPrologue(MachineFunction &MF) const = 0;
   virtual void emitEpilogue(MachineFunction &MF,
                             MachineBasicBlock &MBB) const = 0;
 
+  /// supportsShrinkWrapping - Return true if enableShrinkWrapping may return
+  /// true for some function. The prolog/epilog inserter only computes the
+  /// dominator tree and loop info that shrink wrapping needs if it does.
+  virtual bool supportsShrinkWrapping() const {
+    return false;
+  }
+
+  /// enableShrinkWrapping - Return true if emitPrologue can set up the frame
+  /// in a block other than the entry block, so that paths through the
+  /// function that never touch the frame or a callee saved register skip the
+  /// prolog and epilog entirely.
+  virtual bool enableShrinkWrapping(const MachineFunction &MF) const {
+    return false;
+  }
+
+  /// canUseAsPrologue - Return true if the prolog can be inserted at the top
+  /// of MBB. This only matters when shrink wrapping picks a block other than
+  /// the entry block, where registers that the prolog clobbers may be live.
+  virtual bool canUseAsPrologue(const MachineBasicBlock &MBB) const {
+    return true;
+  }
+
   /// spillCalleeSavedRegisters - Issues instruction(s) to spill all callee
   /// saved registers and returns true if it isn't possible / profitable to do
   /// so by issuing a series of store instructions via
@@ -760,6 +760,39 @@ public:
     return PrefLoopAlignment;
   }
 
+  /// getCacheLineSize - return the size of a data cache line in bytes, or zero
+  /// if it is unknown.
+  unsigned getCacheLineSize() const {
+    return CacheLineSize;
+  }
+
+  /// getDataCacheSize - return the size in bytes of the first level data
+  /// cache, or zero if it is unknown.
+  unsigned getDataCacheSize() const {
+    return DataCacheSize;
+  }
+
+  /// getPrefetchDistance - return how many cycles ahead of a load its data
+  /// should be prefetched, i.e. roughly the latency of a cache miss, or zero
+  /// if software prefetches should not be inserted for this target.
+  unsigned getPrefetchDistance() const {
+    return PrefetchDistance;
+  }
+
+  /// getPrefetchCacheSize - return the size in bytes of the cache that
+  /// software prefetches are for.  Loops that touch less memory than this
+  /// are not prefetched.
+  unsigned getPrefetchCacheSize() const {
+    return PrefetchCacheSize;
+  }
+
+  /// hasFastStringLibCalls - return true if the library implementations of
+  /// strlen, memchr and memcmp are faster than byte-at-a-time loops, so that
+  /// such loops should be replaced by calls.
+  bool hasFastStringLibCalls() const {
+    return FastStringLibCalls;
+  }
+
   /// getShouldFoldAtomicFences - return whether the combiner should fold
   /// fence MEMBARRIER instructions into the atomic intrinsic instructions.
   ///
@@ -1169,6 +1202,36 @@ protected:
     PrefLoopAlignment = Align;
   }
 
+  /// setCacheLineSize - Set the size of a data cache line in bytes.
+  void setCacheLineSize(unsigned Size) {
+    CacheLineSize = Size;
+  }
+
+  /// setDataCacheSize - Set the size of the first level data cache in bytes.
+  void setDataCacheSize(unsigned Size) {
+    DataCacheSize = Size;
+  }
+
+  /// setPrefetchDistance - Set how many cycles ahead of a load its data
+  /// should be prefetched.  Default is zero, which means the target doesn't
+  /// want software prefetches.
+  void setPrefetchDistance(unsigned Cycles) {
+    PrefetchDistance = Cycles;
+  }
+
+  /// setPrefetchCacheSize - Set the size of the cache that software
+  /// prefetches are for, in bytes.
+  void setPrefetchCacheSize(unsigned Size) {
+    PrefetchCacheSize = Size;
+  }
+
+  /// setFastStringLibCalls - Indicate whether the library implementations of
+  /// strlen, memchr and memcmp are faster than byte-at-a-time loops.  Default
+  /// is false.
+  void setFastStringLibCalls(bool isFast = true) {
+    FastStringLibCalls = isFast;
+  }
+
   /// setMinStackArgumentAlignment - Set the minimum stack alignment of an
   /// argument.
   void setMinStackArgumentAlignment(unsigned Align) {
@@ -1556,6 +1619,16 @@ public:
     return true;
   }
 
+  //===--------------------------------------------------------------------===//
+  // Vectorization hooks (used by the IR-level vectorizers).
+  //
+
+  /// getVectorRegisterBitWidth - Return the width in bits of the vector
+  /// registers that IR-level vectorizers should target, or zero if the target
+  /// has no vector registers they should use.  The default implementation
+  /// returns the size of the widest legal vector type.
+  virtual unsigned getVectorRegisterBitWidth() const;
+
   //===--------------------------------------------------------------------===//
   // Div utility functions
   //
@@ -1674,6 +1747,25 @@ private:
   ///
   unsigned PrefLoopAlignment;
 
+  /// CacheLineSize - The size of a data cache line, or zero if unknown.
+  unsigned CacheLineSize;
+
+  /// DataCacheSize - The size of the first level data cache, or zero if
+  /// unknown.
+  unsigned DataCacheSize;
+
+  /// PrefetchDistance - The number of cycles to prefetch data ahead of its
+  /// use, or zero if software prefetches are not wanted.
+  unsigned PrefetchDistance;
+
+  /// PrefetchCacheSize - The size of the cache that software prefetches
+  /// are for.
+  unsigned PrefetchCacheSize;
+
+  /// FastStringLibCalls - Whether the string library functions are faster
+  /// than byte-at-a-time loops.
+  bool FastStringLibCalls;
+
   /// ShouldFoldAtomicFences - Whether fencing MEMBARRIER instructions should
   /// be folded into the enclosed atomic intrinsic instruction by the
   /// combiner.
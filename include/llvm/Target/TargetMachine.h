@@ -107,6 +107,10 @@ protected: // Can only create subclasses.
   unsigned MCNoExecStack : 1;
   unsigned MCUseLoc : 1;
 
+  /// MCTempSymbolTag - Distinguishes the assembler temporaries of this
+  /// output from those of other output it is assembled together with.
+  std::string MCTempSymbolTag;
+
 public:
   virtual ~TargetMachine();
 
@@ -183,6 +187,15 @@ public:
   /// setMCUseLoc - Set whether all we should use dwarf's .loc directive.
   void setMCUseLoc(bool Value) { MCUseLoc = Value; }
 
+  /// getMCTempSymbolTag - Return the text inserted into the names of
+  /// assembler temporary symbols.
+  const std::string &getMCTempSymbolTag() const { return MCTempSymbolTag; }
+
+  /// setMCTempSymbolTag - Set the text inserted into the names of assembler
+  /// temporary symbols, so that output for separate parts of a module can be
+  /// assembled as one.
+  void setMCTempSymbolTag(const std::string &Tag) { MCTempSymbolTag = Tag; }
+
   /// getRelocationModel - Returns the code generation relocation model. The
   /// choices are static, PIC, and dynamic-no-pic, and target default.
   static Reloc::Model getRelocationModel();
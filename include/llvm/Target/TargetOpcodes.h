@@ -78,7 +78,14 @@ namespace TargetOpcode {
 
     /// COPY - Target-independent register copy. This instruction can also be
     /// used to copy between subregisters of virtual registers.
-    COPY = 13
+    COPY = 13,
+
+    /// LIFETIME_START/LIFETIME_END - Mark the beginning and the end of the
+    /// lifetime of the stack object in their frame index operand. They are
+    /// only emitted when optimizing, and the stack coloring pass removes
+    /// them right after instruction selection.
+    LIFETIME_START = 14,
+    LIFETIME_END = 15
   };
 } // end namespace TargetOpcode
 } // end namespace llvm
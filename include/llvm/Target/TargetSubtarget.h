@@ -56,6 +56,12 @@ public:
   virtual bool enablePostRAScheduler(CodeGenOpt::Level OptLevel,
                                      AntiDepBreakMode& Mode,
                                      RegClassVector& CriticalPathRCs) const;
+  // enableMachineScheduler - If the target can benefit from scheduling
+  // machine instructions before register allocation at the specified
+  // optimization level, return true to enable the pre-RA machine scheduler.
+  virtual bool enableMachineScheduler(CodeGenOpt::Level OptLevel) const {
+    return false;
+  }
   // adjustSchedDependency - Perform target specific adjustments to
   // the latency of a schedule dependency.
   virtual void adjustSchedDependency(SUnit *def, SUnit *use, 
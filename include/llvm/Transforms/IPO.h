@@ -207,6 +207,12 @@ ModulePass *createMergeFunctionsPass();
 ///
 ModulePass *createPartialInliningPass();
 
+//===----------------------------------------------------------------------===//
+/// createFunctionSpecializationPass - This pass clones functions for call
+/// sites that pass constant function pointers or flags.
+///
+ModulePass *createFunctionSpecializationPass();
+
 } // End llvm namespace
 
 #endif
@@ -112,6 +112,22 @@ Pass *createLICMPass();
 //
 Pass *createLoopStrengthReducePass(const TargetLowering *TLI = 0);
 
+//===----------------------------------------------------------------------===//
+//
+// LoopDataPrefetch - This pass inserts software prefetches for strided loads
+// in loops that stream through more memory than fits in the cache.  It takes
+// an optional parameter to get the cache parameters of the target.
+//
+Pass *createLoopDataPrefetchPass(const TargetLowering *TLI = 0);
+
+//===----------------------------------------------------------------------===//
+//
+// LoopInterchange - This pass interchanges and tiles perfect nests of two loops
+// to improve their cache locality.  It takes an optional parameter to get the
+// cache parameters of the target.
+//
+Pass *createLoopInterchangePass(const TargetLowering *TLI = 0);
+
 //===----------------------------------------------------------------------===//
 //
 // LoopUnswitch - This pass is a simple loop unswitching pass.
@@ -138,9 +154,28 @@ Pass *createLoopRotatePass();
 
 //===----------------------------------------------------------------------===//
 //
-// LoopIdiom - This pass recognizes and replaces idioms in loops.
+// LoopIdiom - This pass recognizes and replaces idioms in loops.  It takes an
+// optional parameter to ask the target whether the library calls and
+// intrinsics it forms are profitable.
+//
+Pass *createLoopIdiomPass(const TargetLowering *TLI = 0);
+
+//===----------------------------------------------------------------------===//
+//
+// LoopVectorize - This pass vectorizes innermost loops with a computable trip
+// count, keeping the original loop as a scalar epilogue.  It takes an optional
+// parameter used to consult the target machine for the vector register width.
 //
-Pass *createLoopIdiomPass();
+Pass *createLoopVectorizePass(const TargetLowering *TLI = 0);
+
+//===----------------------------------------------------------------------===//
+//
+// SLPVectorizer - This pass packs isomorphic scalar operations on adjacent
+// memory within a basic block into vector operations.  It takes an optional
+// parameter used to consult the target machine for the cost of vector
+// operations.
+//
+FunctionPass *createSLPVectorizerPass(const TargetLowering *TLI = 0);
   
 //===----------------------------------------------------------------------===//
 //
@@ -279,6 +314,21 @@ FunctionPass *createEarlyCSEPass();
 //
 FunctionPass *createGVNPass(bool NoLoads = false);
 
+//===----------------------------------------------------------------------===//
+//
+// NewGVN - This pass partitions all values of a function into congruence
+// classes over a memory SSA form, then eliminates full and partial
+// redundancies of expressions and loads.
+//
+FunctionPass *createNewGVNPass();
+
+//===----------------------------------------------------------------------===//
+//
+// HeapToStack - This pass turns small mallocs whose memory doesn't outlive
+// the function into allocas.
+//
+FunctionPass *createHeapToStackPass();
+
 //===----------------------------------------------------------------------===//
 //
 // MemCpyOpt - This pass performs optimizations related to eliminating memcpy
@@ -20,18 +20,32 @@
 #include "llvm/Type.h"
 #include "llvm/Target/TargetData.h"
 #include "llvm/Assembly/Writer.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/InstIterator.h"
 #include "llvm/Support/raw_ostream.h"
 using namespace llvm;
 
+static cl::opt<unsigned>
+SaturationThreshold("alias-set-saturation-threshold", cl::Hidden,
+                    cl::init(250),
+                    cl::desc("The maximum number of pointers may-alias sets "
+                             "may contain before degradation"));
+
+static cl::opt<unsigned>
+MaxAliasSets("alias-set-max-sets", cl::Hidden, cl::init(1000),
+             cl::desc("The maximum number of alias sets a tracker may "
+                      "contain before degradation"));
+
 /// mergeSetIn - Merge the specified alias set into this alias set.
 ///
 void AliasSet::mergeSetIn(AliasSet &AS, AliasSetTracker &AST) {
   assert(!AS.Forward && "Alias set is already forwarding!");
   assert(!Forward && "This set is a forwarding set!!");
 
+  bool WasMustAlias = isMustAlias();
+
   // Update the alias and access types of this set...
   AccessTy |= AS.AccessTy;
   AliasTy  |= AS.AliasTy;
@@ -56,6 +70,17 @@ void AliasSet::mergeSetIn(AliasSet &AS, AliasSetTracker &AST) {
       AliasTy = MayAlias;
   }
 
+  // Pointers of AS are counted as part of this set from now on.
+  if (isMayAlias()) {
+    if (WasMustAlias)
+      AST.TotalMayAliasSetSize += SetSize;
+    if (AS.isMustAlias())
+      AST.TotalMayAliasSetSize += AS.SetSize;
+  }
+  SetSize += AS.SetSize;
+  AS.SetSize = 0;
+  --AST.NumLiveSets;
+
   if (CallSites.empty()) {            // Merge call sites...
     if (!AS.CallSites.empty())
       std::swap(CallSites, AS.CallSites);
@@ -83,7 +108,13 @@ void AliasSetTracker::removeAliasSet(AliasSet *AS) {
   if (AliasSet *Fwd = AS->Forward) {
     Fwd->dropRef(*this);
     AS->Forward = 0;
+  } else {
+    if (AS->isMayAlias())
+      TotalMayAliasSetSize -= AS->SetSize;
+    --NumLiveSets;
   }
+  if (AS == AliasAnyAS)
+    AliasAnyAS = 0;
   AliasSets.erase(AS);
 }
 
@@ -106,7 +137,7 @@ void AliasSet::addPointer(AliasSetTracker &AST, PointerRec &Entry,
                                          P->getTBAAInfo()),
                  AliasAnalysis::Location(Entry.getValue(), Size, TBAAInfo));
       if (Result != AliasAnalysis::MustAlias)
-        AliasTy = MayAlias;
+        setMayAlias(AST);
       else                  // First entry of must alias must have maximum size!
         P->updateSizeAndTBAAInfo(Size, TBAAInfo);
       assert(Result != AliasAnalysis::NoAlias && "Cannot be part of must set!");
@@ -120,23 +151,35 @@ void AliasSet::addPointer(AliasSetTracker &AST, PointerRec &Entry,
   *PtrListEnd = &Entry;
   PtrListEnd = Entry.setPrevInList(PtrListEnd);
   assert(*PtrListEnd == 0 && "End of list is not null?");
+  ++SetSize;
+  if (isMayAlias())
+    ++AST.TotalMayAliasSetSize;
   addRef();               // Entry points to alias set.
 }
 
-void AliasSet::addCallSite(CallSite CS, AliasAnalysis &AA) {
+/// setMayAlias - Downgrade this set to a may-alias set, keeping the
+/// tracker's count of may-alias pointers up to date.
+void AliasSet::setMayAlias(AliasSetTracker &AST) {
+  if (isMayAlias()) return;
+  AliasTy = MayAlias;
+  AST.TotalMayAliasSetSize += SetSize;
+}
+
+void AliasSet::addCallSite(CallSite CS, AliasSetTracker &AST) {
   CallSites.push_back(CS.getInstruction());
 
-  AliasAnalysis::ModRefBehavior Behavior = AA.getModRefBehavior(CS);
+  AliasAnalysis::ModRefBehavior Behavior =
+    AST.getAliasAnalysis().getModRefBehavior(CS);
   if (Behavior == AliasAnalysis::DoesNotAccessMemory)
     return;
   if (AliasAnalysis::onlyReadsMemory(Behavior)) {
-    AliasTy = MayAlias;
+    setMayAlias(AST);
     AccessTy |= Refs;
     return;
   }
 
   // FIXME: This should use mod/ref information to make this not suck so bad
-  AliasTy = MayAlias;
+  setMayAlias(AST);
   AccessTy = ModRef;
 }
 
@@ -207,6 +250,54 @@ void AliasSetTracker::clear() {
   
   // The alias sets should all be clear now.
   AliasSets.clear();
+  AliasAnyAS = 0;
+  TotalMayAliasSetSize = 0;
+  NumLiveSets = 0;
+}
+
+/// checkSaturation - If the may-alias sets of this tracker, or the number of
+/// sets, have grown past their thresholds, merge everything into one set and
+/// return it.  Otherwise return AS.
+AliasSet &AliasSetTracker::checkSaturation(AliasSet &AS) {
+  if (AliasAnyAS || (TotalMayAliasSetSize <= SaturationThreshold &&
+                     NumLiveSets <= MaxAliasSets))
+    return AS;
+  return mergeAllAliasSets();
+}
+
+/// mergeAllAliasSets - Collapse every alias set into a single may-alias,
+/// mod/ref set.  From here on, pointers and call sites are added to that set
+/// without querying alias analysis, so adding N pointers costs O(N) rather
+/// than O(N^2).
+AliasSet &AliasSetTracker::mergeAllAliasSets() {
+  assert(!AliasAnyAS && "Tracker is already saturated!");
+
+  // Collect the sets first; merging them drops references, which can delete
+  // forwarding sets from the list.
+  std::vector<AliasSet*> ASVector;
+  for (iterator I = begin(), E = end(); I != E; ++I)
+    ASVector.push_back(I);
+
+  AliasSets.push_back(new AliasSet());
+  AliasAnyAS = &AliasSets.back();
+  ++NumLiveSets;
+  AliasAnyAS->AliasTy = AliasSet::MayAlias;
+  AliasAnyAS->AccessTy = AliasSet::ModRef;
+
+  for (unsigned i = 0, e = ASVector.size(); i != e; ++i) {
+    AliasSet *Cur = ASVector[i];
+
+    // A forwarding set only needs to be redirected to the new set.
+    if (AliasSet *FwdTo = Cur->Forward) {
+      Cur->Forward = AliasAnyAS;
+      AliasAnyAS->addRef();
+      FwdTo->dropRef(*this);
+      continue;
+    }
+    AliasAnyAS->mergeSetIn(*Cur, *this);
+  }
+
+  return *AliasAnyAS;
 }
 
 
@@ -217,6 +308,10 @@ void AliasSetTracker::clear() {
 AliasSet *AliasSetTracker::findAliasSetForPointer(const Value *Ptr,
                                                   uint64_t Size,
                                                   const MDNode *TBAAInfo) {
+  // A saturated tracker has one set, which aliases everything.
+  if (AliasAnyAS)
+    return AliasAnyAS;
+
   AliasSet *FoundSet = 0;
   for (iterator I = begin(), E = end(); I != E; ++I) {
     if (I->Forward || !I->aliasesPointer(Ptr, Size, TBAAInfo, AA)) continue;
@@ -236,6 +331,8 @@ AliasSet *AliasSetTracker::findAliasSetForPointer(const Value *Ptr,
 /// alias sets.
 bool AliasSetTracker::containsPointer(Value *Ptr, uint64_t Size,
                                       const MDNode *TBAAInfo) const {
+  if (AliasAnyAS)
+    return true;
   for (const_iterator I = begin(), E = end(); I != E; ++I)
     if (!I->Forward && I->aliasesPointer(Ptr, Size, TBAAInfo, AA))
       return true;
@@ -245,6 +342,9 @@ bool AliasSetTracker::containsPointer(Value *Ptr, uint64_t Size,
 
 
 AliasSet *AliasSetTracker::findAliasSetForCallSite(CallSite CS) {
+  if (AliasAnyAS)
+    return AliasAnyAS;
+
   AliasSet *FoundSet = 0;
   for (iterator I = begin(), E = end(); I != E; ++I) {
     if (I->Forward || !I->aliasesCallSite(CS, AA))
@@ -284,6 +384,7 @@ AliasSet &AliasSetTracker::getAliasSetForPointer(Value *Pointer, uint64_t Size,
   if (New) *New = true;
   // Otherwise create a new alias set to hold the loaded pointer.
   AliasSets.push_back(new AliasSet());
+  ++NumLiveSets;
   AliasSets.back().addPointer(*this, Entry, Size, TBAAInfo);
   return AliasSets.back();
 }
@@ -333,12 +434,15 @@ bool AliasSetTracker::add(CallSite CS) {
 
   AliasSet *AS = findAliasSetForCallSite(CS);
   if (AS) {
-    AS->addCallSite(CS, AA);
+    AS->addCallSite(CS, *this);
+    checkSaturation(*AS);
     return false;
   }
   AliasSets.push_back(new AliasSet());
+  ++NumLiveSets;
   AS = &AliasSets.back();
-  AS->addCallSite(CS, AA);
+  AS->addCallSite(CS, *this);
+  checkSaturation(*AS);
   return true;
 }
 
@@ -366,6 +470,11 @@ void AliasSetTracker::add(const AliasSetTracker &AST) {
   assert(&AA == &AST.AA &&
          "Merging AliasSetTracker objects with different Alias Analyses!");
 
+  // If the other tracker gave up on disambiguating its pointers, there is no
+  // point in querying alias analysis for each of them here.
+  if (AST.AliasAnyAS && !AliasAnyAS)
+    mergeAllAliasSets();
+
   // Loop over all of the alias sets in AST, adding the pointers contained
   // therein into the current alias sets.  This can cause alias sets to be
   // merged together in the current AST.
@@ -396,6 +505,9 @@ void AliasSetTracker::remove(AliasSet &AS) {
   AS.CallSites.clear();
   
   // Clear the alias set.
+  if (AS.isMayAlias())
+    TotalMayAliasSetSize -= AS.SetSize;
+  AS.SetSize = 0;
   unsigned NumRefs = 0;
   while (!AS.empty()) {
     AliasSet::PointerRec *P = AS.PtrList;
@@ -506,6 +618,9 @@ void AliasSetTracker::deleteValue(Value *PtrVal) {
   // If we found one, remove the pointer from the alias set it is in.
   AliasSet::PointerRec *PtrValEnt = I->second;
   AliasSet *AS = PtrValEnt->getAliasSet(*this);
+  --AS->SetSize;
+  if (AS->isMayAlias())
+    --TotalMayAliasSetSize;
 
   // Unlink and delete from the list of values.
   PtrValEnt->eraseFromList();
@@ -540,6 +655,7 @@ void AliasSetTracker::copyValue(Value *From, Value *To) {
   AS->addPointer(*this, Entry, I->second->getSize(),
                  I->second->getTBAAInfo(),
                  true);
+  checkSaturation(*AS);
 }
 
 
@@ -0,0 +1,1349 @@
+//===- Andersens.cpp - Andersen's Interprocedural Alias Analysis ----------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file defines an implementation of Andersen's interprocedural alias
+// analysis: a flow-insensitive, context-insensitive, field-insensitive,
+// inclusion-based points-to analysis over the whole module.
+//
+// The analysis generates four kinds of constraints from the program:
+//
+//   AddressOf  A = &O   A points to the memory object O
+//   Copy       A = B    A points to everything B points to
+//   Load       A = *B   A points to everything any pointee of B points to
+//   Store      *A = B   every pointee of A points to everything B points to
+//
+// Every memory object (global, function, alloca and heap allocation site) has
+// one node that stands for its contents, and every value that may carry a
+// pointer has a node for the set of objects it may point to.  Since pointers
+// can be laundered through integers, integers wider than i1 are tracked like
+// pointers, and so are floating point and vector values, which can copy a
+// pointer through memory.  Values that never hold a pointer get empty sets and
+// are removed before solving.
+//
+// Memory that code outside the module can reach is modelled by one special
+// "universal" object.  Pointers that escape to external code are copied into
+// it, pointers that come back from external code point to it, and everything
+// reachable from it may point to anything reachable from it.  Functions whose
+// address reaches it may be called from outside with any of those pointers.
+//
+// To scale to large modules the solver:
+//
+//  - runs offline variable substitution (hash-based value numbering, "HVN",
+//    Hardekopf and Lin, SAS 2007) before solving, which merges all variables
+//    that provably have the same points-to set and drops the ones that point
+//    to nothing;
+//  - finds and collapses cycles of copy edges while solving (lazy cycle
+//    detection, "LCD", Hardekopf and Lin, PLDI 2007), whenever propagation
+//    along an edge makes no change to two equal sets;
+//  - propagates only the difference between the current and the previously
+//    processed points-to set of each node;
+//  - keeps points-to sets and edge sets in SparseBitVectors.
+//
+// Indirect calls are resolved on the fly: when a new function appears in the
+// points-to set of a callee, the arguments are copied into its formals and its
+// return value into the result of the call.
+//
+// Values created by transformations after the analysis ran are unknown to it,
+// and queries about them are passed on to the next alias analysis.
+//
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "anders-aa"
+#include "llvm/Analysis/Passes.h"
+#include "llvm/Constants.h"
+#include "llvm/DerivedTypes.h"
+#include "llvm/Instructions.h"
+#include "llvm/IntrinsicInst.h"
+#include "llvm/Module.h"
+#include "llvm/Pass.h"
+#include "llvm/Analysis/AliasAnalysis.h"
+#include "llvm/Analysis/MemoryBuiltins.h"
+#include "llvm/Support/CallSite.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/InstIterator.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/SparseBitVector.h"
+#include "llvm/ADT/ValueMap.h"
+#include "llvm/ADT/Statistic.h"
+#include <algorithm>
+#include <map>
+#include <vector>
+using namespace llvm;
+
+STATISTIC(NumNodes         , "Number of points-to nodes");
+STATISTIC(NumConstraints   , "Number of constraints");
+STATISTIC(NumSubstituted   , "Number of nodes merged by variable substitution");
+STATISTIC(NumRemoved       , "Number of nodes that point to nothing");
+STATISTIC(NumCycleNodes    , "Number of nodes collapsed by cycle detection");
+STATISTIC(NumIterations    , "Number of node visits while solving");
+STATISTIC(NumIndirectCallees, "Number of indirect call edges found");
+
+namespace {
+  class Andersens : public ModulePass, public AliasAnalysis {
+    /// Constraint - One constraint between two nodes.  For Load and Store
+    /// constraints Src respectively Dest is the pointer.
+    struct Constraint {
+      enum ConstraintKind { Copy, Load, Store, AddressOf } Kind;
+      unsigned Dest;
+      unsigned Src;
+
+      Constraint(ConstraintKind K, unsigned D, unsigned S)
+        : Kind(K), Dest(D), Src(S) {}
+    };
+
+    /// Node - A variable or the contents of a memory object.
+    struct Node {
+      /// Val - The value this node was created for, or null for nodes that
+      /// don't correspond to a value.
+      const Value *Val;
+
+      /// IsObject - True if this node is the contents of the memory object
+      /// Val, rather than the pointer value Val.
+      bool IsObject;
+
+      /// Rep - The node this one was merged into, or the node itself.
+      unsigned Rep;
+
+      /// PointsTo - The memory objects this node may point to, identified by
+      /// their original node numbers.
+      SparseBitVector<> PointsTo;
+
+      /// OldPointsTo - The part of PointsTo whose consequences were already
+      /// propagated.
+      SparseBitVector<> OldPointsTo;
+
+      /// Edges - The nodes whose points-to sets include this one's.
+      SparseBitVector<> Edges;
+
+      /// Complex - The Load and Store constraints through this node.
+      std::vector<Constraint> Complex;
+
+      /// Calls - The indirect calls through this node.
+      std::vector<unsigned> Calls;
+
+      Node(const Value *V, bool Obj, unsigned R)
+        : Val(V), IsObject(Obj), Rep(R) {}
+    };
+
+    /// IndirectCall - A call through a pointer, resolved while solving.
+    struct IndirectCall {
+      /// Inst - The call, or null for the calls made by external code.
+      const Instruction *Inst;
+      /// Callee - The node of the called pointer.
+      unsigned Callee;
+      std::vector<unsigned> Args;
+      unsigned Result;
+      /// HeapObject - The object returned if the callee turns out to be an
+      /// allocation function.
+      unsigned HeapObject;
+      DenseSet<unsigned> Resolved;
+    };
+
+    /// Special nodes.  NullPtr stands for values that can't point to
+    /// anything; UniversalSet for all memory reachable by external code.
+    enum { NullPtr = 0, UniversalSet = 1, NumSpecialNodes = 2 };
+
+    std::vector<Node> GraphNodes;
+    std::vector<Constraint> Constraints;
+    std::vector<IndirectCall> IndirectCalls;
+
+    /// ValueNodeConfig - Drop the node of a value when it is deleted, but
+    /// don't move it to the replacement of a value, which may be a value we
+    /// know nothing about.
+    struct ValueNodeConfig : ValueMapConfig<const Value*> {
+      enum { FollowRAUW = false };
+    };
+    typedef ValueMap<const Value*, unsigned, ValueNodeConfig> ValueNodeMap;
+
+    /// ValueNodes - The node of each instruction, argument and global value
+    /// that may hold a pointer.  Not every pass that preserves alias analysis
+    /// calls deleteValue, so this has to notice deleted values by itself.
+    ValueNodeMap ValueNodes;
+
+    /// ObjectNodes - The node of each memory object.
+    DenseMap<const Value*, unsigned> ObjectNodes;
+
+    /// ReturnNodes - The node for the return value of each function.
+    DenseMap<const Function*, unsigned> ReturnNodes;
+
+    /// ConstantNodes - Nodes for constant expressions and aggregates, only
+    /// used while the constraints are generated.
+    DenseMap<const Constant*, unsigned> ConstantNodes;
+
+    /// TrackedTypes - Caches isTracked.
+    DenseMap<const Type*, bool> TrackedTypes;
+
+    /// Solving - True once constraints are added straight to the graph.
+    bool Solving;
+
+    std::vector<unsigned> Worklist;
+    std::vector<bool> InWorklist;
+
+    /// CheckedEdges - The edges that lazy cycle detection has started from.
+    DenseSet<std::pair<unsigned, unsigned> > CheckedEdges;
+
+    /// CycleCandidates - The nodes to start cycle detection from at the end
+    /// of the current round.
+    std::vector<unsigned> CycleCandidates;
+
+    /// NewEdges - The number of copy edges added since the last search of the
+    /// whole graph for cycles.
+    unsigned NewEdges;
+
+  public:
+    static char ID; // Class identification, replacement for typeinfo
+    Andersens() : ModulePass(ID), Solving(false), NewEdges(0) {
+      initializeAndersensPass(*PassRegistry::getPassRegistry());
+    }
+
+    bool runOnModule(Module &M);
+
+    virtual void getAnalysisUsage(AnalysisUsage &AU) const {
+      AliasAnalysis::getAnalysisUsage(AU);
+      AU.setPreservesAll();                         // Does not transform code
+    }
+
+    virtual void releaseMemory();
+
+    //------------------------------------------------
+    // Implement the AliasAnalysis API
+    //
+    AliasResult alias(const Location &LocA, const Location &LocB);
+
+    virtual void deleteValue(Value *V);
+    virtual void copyValue(Value *From, Value *To);
+    virtual void addEscapingUse(Use &U);
+
+    /// getAdjustedAnalysisPointer - This method is used when a pass implements
+    /// an analysis interface through multiple inheritance.  If needed, it
+    /// should override this to adjust the this pointer as needed for the
+    /// specified pass info.
+    virtual void *getAdjustedAnalysisPointer(AnalysisID PI) {
+      if (PI == &AliasAnalysis::ID)
+        return (AliasAnalysis*)this;
+      return this;
+    }
+
+    void print(raw_ostream &OS, const Module *M) const;
+
+  private:
+    // Constraint generation.
+    bool isTracked(const Type *Ty);
+    unsigned createNode(const Value *V, bool IsObject);
+    unsigned getNode(Value *V);
+    unsigned getConstantNode(Constant *C);
+    void addCopy(unsigned Dest, unsigned Src);
+    void addLoad(unsigned Dest, unsigned Ptr);
+    void addStore(unsigned Ptr, unsigned Src);
+    void addAddressOf(unsigned Dest, unsigned Obj);
+    void createNodes(Module &M);
+    void addGlobalInitializer(unsigned Obj, Constant *C);
+    void collectConstraints(Module &M);
+    void collectConstraints(Instruction &I);
+    void collectCallConstraints(CallSite CS);
+    void addExternalCall(CallSite CS, const Function *F,
+                         const std::vector<unsigned> &Args, unsigned Result,
+                         unsigned HeapObject);
+    void addDirectCall(const Function *F, const std::vector<unsigned> &Args,
+                       unsigned Result);
+
+    // Offline variable substitution.
+    void substituteVariables(Module &M);
+
+    // Solving.
+    unsigned find(unsigned N);
+    unsigned unite(unsigned A, unsigned B);
+    void pushNode(unsigned N);
+    void addEdge(unsigned Src, unsigned Dest);
+    void buildGraph();
+    void solve();
+    void processNode(unsigned N);
+    void resolveCall(unsigned CallIdx, unsigned Obj);
+    void resolveExternalCaller(unsigned Obj);
+    void getSuccessors(unsigned N, std::vector<unsigned> &Succs);
+    void collapseCycles();
+
+    // Queries.
+    const SparseBitVector<> *getPointsTo(const Value *V);
+    void printNodeName(raw_ostream &OS, unsigned N) const;
+  };
+}
+
+char Andersens::ID = 0;
+INITIALIZE_AG_PASS(Andersens, AliasAnalysis, "anders-aa",
+                   "Andersen's Interprocedural Alias Analysis",
+                   false, true, false)
+
+ModulePass *llvm::createAndersensPass() { return new Andersens(); }
+
+bool Andersens::runOnModule(Module &M) {
+  InitializeAliasAnalysis(this);
+
+  createNodes(M);
+  collectConstraints(M);
+  ConstantNodes.clear();
+  NumNodes += GraphNodes.size();
+  NumConstraints += Constraints.size();
+
+  substituteVariables(M);
+  buildGraph();
+  solve();
+
+  DEBUG(print(dbgs(), &M));
+  return false;
+}
+
+void Andersens::releaseMemory() {
+  GraphNodes.clear();
+  Constraints.clear();
+  IndirectCalls.clear();
+  ValueNodes.clear();
+  ObjectNodes.clear();
+  ReturnNodes.clear();
+  ConstantNodes.clear();
+  TrackedTypes.clear();
+  Worklist.clear();
+  InWorklist.clear();
+  CheckedEdges.clear();
+  CycleCandidates.clear();
+  NewEdges = 0;
+  Solving = false;
+}
+
+//===----------------------------------------------------------------------===//
+//                         Constraint Generation
+//===----------------------------------------------------------------------===//
+
+/// isTracked - Return true if values of type Ty may carry a pointer.
+bool Andersens::isTracked(const Type *Ty) {
+  if (Ty->isPointerTy())
+    return true;
+  if (const IntegerType *ITy = dyn_cast<IntegerType>(Ty))
+    return ITy->getBitWidth() > 1;
+  // A load and store of a double or a vector copies whatever bits are in
+  // memory, pointers included.
+  if (Ty->isFloatingPointTy() || Ty->isVectorTy() || Ty->isX86_MMXTy())
+    return true;
+  if (!isa<CompositeType>(Ty))
+    return false;
+
+  DenseMap<const Type*, bool>::iterator I = TrackedTypes.find(Ty);
+  if (I != TrackedTypes.end())
+    return I->second;
+  bool Tracked = false;
+  if (const StructType *STy = dyn_cast<StructType>(Ty)) {
+    for (unsigned i = 0, e = STy->getNumElements(); i != e && !Tracked; ++i)
+      Tracked = isTracked(STy->getElementType(i));
+  } else if (const SequentialType *SeqTy = dyn_cast<SequentialType>(Ty)) {
+    Tracked = isTracked(SeqTy->getElementType());
+  }
+  TrackedTypes[Ty] = Tracked;
+  return Tracked;
+}
+
+unsigned Andersens::createNode(const Value *V, bool IsObject) {
+  unsigned N = GraphNodes.size();
+  GraphNodes.push_back(Node(V, IsObject, N));
+  return N;
+}
+
+/// getNode - Return the node for the pointer value V.
+unsigned Andersens::getNode(Value *V) {
+  if (!isTracked(V->getType()))
+    return NullPtr;
+  ValueNodeMap::iterator I = ValueNodes.find(V);
+  if (I != ValueNodes.end())
+    return I->second;
+  if (Constant *C = dyn_cast<Constant>(V))
+    return getConstantNode(C);
+  // Inline asm and the like.
+  return NullPtr;
+}
+
+/// getConstantNode - Return a node for a constant expression or aggregate,
+/// which points to whatever its operands point to.
+unsigned Andersens::getConstantNode(Constant *C) {
+  if (isa<ConstantPointerNull>(C) || isa<UndefValue>(C) ||
+      isa<ConstantInt>(C) || isa<ConstantAggregateZero>(C) ||
+      isa<BlockAddress>(C))
+    return NullPtr;
+  if (!isa<ConstantExpr>(C) && !isa<ConstantStruct>(C) &&
+      !isa<ConstantArray>(C) && !isa<ConstantVector>(C))
+    return NullPtr;
+
+  DenseMap<const Constant*, unsigned>::iterator I = ConstantNodes.find(C);
+  if (I != ConstantNodes.end())
+    return I->second;
+
+  // Most constant expressions are casts or GEPs of a single global, which
+  // can share its node.
+  SmallVector<unsigned, 4> Ops;
+  for (unsigned i = 0, e = C->getNumOperands(); i != e; ++i) {
+    unsigned Op = getNode(cast<Constant>(C->getOperand(i)));
+    if (Op != NullPtr && std::find(Ops.begin(), Ops.end(), Op) == Ops.end())
+      Ops.push_back(Op);
+  }
+  unsigned N = NullPtr;
+  if (Ops.size() == 1) {
+    N = Ops[0];
+  } else if (!Ops.empty()) {
+    N = createNode(0, false);
+    for (unsigned i = 0, e = Ops.size(); i != e; ++i)
+      addCopy(N, Ops[i]);
+  }
+  ConstantNodes[C] = N;
+  return N;
+}
+
+// The constraint helpers record constraints while they are generated, and
+// apply them to the graph directly while solving, when indirect calls are
+// resolved.  A complex constraint added while solving is applied to the whole
+// points-to set of its pointer, since the node may not be visited again.
+
+void Andersens::addCopy(unsigned Dest, unsigned Src) {
+  if (Src == NullPtr || Dest == NullPtr || Src == Dest)
+    return;
+  if (Solving)
+    addEdge(Src, Dest);
+  else
+    Constraints.push_back(Constraint(Constraint::Copy, Dest, Src));
+}
+
+void Andersens::addLoad(unsigned Dest, unsigned Ptr) {
+  if (Ptr == NullPtr || Dest == NullPtr)
+    return;
+  if (!Solving) {
+    Constraints.push_back(Constraint(Constraint::Load, Dest, Ptr));
+    return;
+  }
+  Ptr = find(Ptr);
+  GraphNodes[Ptr].Complex.push_back(Constraint(Constraint::Load, Dest, Ptr));
+  SparseBitVector<> Objs(GraphNodes[Ptr].PointsTo);
+  for (SparseBitVector<>::iterator I = Objs.begin(), E = Objs.end();
+       I != E; ++I)
+    addEdge(*I, Dest);
+}
+
+void Andersens::addStore(unsigned Ptr, unsigned Src) {
+  if (Ptr == NullPtr || Src == NullPtr)
+    return;
+  if (!Solving) {
+    Constraints.push_back(Constraint(Constraint::Store, Ptr, Src));
+    return;
+  }
+  Ptr = find(Ptr);
+  GraphNodes[Ptr].Complex.push_back(Constraint(Constraint::Store, Ptr, Src));
+  SparseBitVector<> Objs(GraphNodes[Ptr].PointsTo);
+  for (SparseBitVector<>::iterator I = Objs.begin(), E = Objs.end();
+       I != E; ++I)
+    addEdge(Src, *I);
+}
+
+void Andersens::addAddressOf(unsigned Dest, unsigned Obj) {
+  if (Dest == NullPtr)
+    return;
+  if (!Solving) {
+    Constraints.push_back(Constraint(Constraint::AddressOf, Dest, Obj));
+    return;
+  }
+  Dest = find(Dest);
+  if (GraphNodes[Dest].PointsTo.test_and_set(Obj))
+    pushNode(Dest);
+}
+
+/// createNodes - Create the nodes for all values and memory objects.
+void Andersens::createNodes(Module &M) {
+  createNode(0, false);                         // NullPtr
+  createNode(0, true);                          // UniversalSet
+
+  for (Module::global_iterator I = M.global_begin(), E = M.global_end();
+       I != E; ++I) {
+    ValueNodes[I] = createNode(I, false);
+    ObjectNodes[I] = createNode(I, true);
+  }
+
+  for (Module::iterator F = M.begin(), E = M.end(); F != E; ++F) {
+    ValueNodes[F] = createNode(F, false);
+    ObjectNodes[F] = createNode(F, true);
+    if (F->isDeclaration())
+      continue;
+
+    if (isTracked(F->getReturnType()))
+      ReturnNodes[F] = createNode(F, false);
+    for (Function::arg_iterator AI = F->arg_begin(), AE = F->arg_end();
+         AI != AE; ++AI)
+      if (isTracked(AI->getType()))
+        ValueNodes[AI] = createNode(AI, false);
+
+    for (Function::iterator BB = F->begin(), BE = F->end(); BB != BE; ++BB)
+      for (BasicBlock::iterator I = BB->begin(), IE = BB->end();
+           I != IE; ++I) {
+        if (isTracked(I->getType()))
+          ValueNodes[I] = createNode(I, false);
+        if (isa<AllocaInst>(I) || (isa<CallInst>(I) && isMalloc(I))) {
+          ObjectNodes[I] = createNode(I, true);
+          continue;
+        }
+        // Calls that may turn out to allocate memory get an object for it.
+        CallSite CS(I);
+        if (CS && I->getType()->isPointerTy() &&
+            (!CS.getCalledFunction() ||
+             CS.paramHasAttr(0, Attribute::NoAlias)))
+          ObjectNodes[I] = createNode(I, true);
+      }
+  }
+
+  for (Module::alias_iterator I = M.alias_begin(), E = M.alias_end();
+       I != E; ++I)
+    ValueNodes[I] = createNode(I, false);
+}
+
+/// addGlobalInitializer - Add constraints for the pointers stored in the
+/// object Obj by the initializer C.
+void Andersens::addGlobalInitializer(unsigned Obj, Constant *C) {
+  if (isa<ConstantStruct>(C) || isa<ConstantArray>(C) ||
+      isa<ConstantVector>(C)) {
+    for (unsigned i = 0, e = C->getNumOperands(); i != e; ++i)
+      addGlobalInitializer(Obj, cast<Constant>(C->getOperand(i)));
+    return;
+  }
+  addCopy(Obj, getNode(C));
+}
+
+/// collectConstraints - Generate the constraints for the whole module.
+void Andersens::collectConstraints(Module &M) {
+  // The universal object points to itself, and everything reachable from it
+  // may be read and overwritten by external code.
+  addAddressOf(UniversalSet, UniversalSet);
+  addLoad(UniversalSet, UniversalSet);
+  addStore(UniversalSet, UniversalSet);
+
+  for (Module::global_iterator I = M.global_begin(), E = M.global_end();
+       I != E; ++I) {
+    unsigned Obj = ObjectNodes[I];
+    addAddressOf(ValueNodes[I], Obj);
+    if (I->hasDefinitiveInitializer())
+      addGlobalInitializer(Obj, I->getInitializer());
+    else
+      addCopy(Obj, UniversalSet);
+    if (!I->hasLocalLinkage())
+      addCopy(UniversalSet, ValueNodes[I]);
+  }
+
+  for (Module::alias_iterator I = M.alias_begin(), E = M.alias_end();
+       I != E; ++I) {
+    addCopy(ValueNodes[I], getNode(I->getAliasee()));
+    if (!I->hasLocalLinkage())
+      addCopy(UniversalSet, ValueNodes[I]);
+  }
+
+  for (Module::iterator F = M.begin(), E = M.end(); F != E; ++F) {
+    addAddressOf(ValueNodes[F], ObjectNodes[F]);
+    // Functions that may be called from outside get their arguments from the
+    // universal set; see resolveExternalCaller.
+    if (!F->hasLocalLinkage() || F->mayBeOverridden())
+      addCopy(UniversalSet, ValueNodes[F]);
+
+    for (Function::iterator BB = F->begin(), BE = F->end(); BB != BE; ++BB)
+      for (BasicBlock::iterator I = BB->begin(), IE = BB->end(); I != IE; ++I)
+        collectConstraints(*I);
+  }
+}
+
+/// collectConstraints - Generate the constraints for one instruction.
+void Andersens::collectConstraints(Instruction &I) {
+  switch (I.getOpcode()) {
+  case Instruction::Alloca:
+    addAddressOf(getNode(&I), ObjectNodes[&I]);
+    return;
+  case Instruction::Load:
+    addLoad(getNode(&I), getNode(I.getOperand(0)));
+    return;
+  case Instruction::Store:
+    addStore(getNode(I.getOperand(1)), getNode(I.getOperand(0)));
+    return;
+  case Instruction::Ret:
+    if (I.getNumOperands() && isTracked(I.getOperand(0)->getType()))
+      addCopy(ReturnNodes[I.getParent()->getParent()],
+              getNode(I.getOperand(0)));
+    return;
+  case Instruction::VAArg:
+    addCopy(getNode(&I), UniversalSet);
+    return;
+  case Instruction::Call:
+  case Instruction::Invoke:
+    collectCallConstraints(CallSite(&I));
+    return;
+  default:
+    break;
+  }
+
+  // Everything else (casts, GEPs, arithmetic, PHIs, selects, aggregate
+  // operations) may point to whatever its operands point to.
+  unsigned N = getNode(&I);
+  if (N == NullPtr)
+    return;
+  for (unsigned i = 0, e = I.getNumOperands(); i != e; ++i)
+    addCopy(N, getNode(I.getOperand(i)));
+}
+
+/// addDirectCall - Add the constraints for a call to the function F, which is
+/// defined in this module.
+void Andersens::addDirectCall(const Function *F,
+                              const std::vector<unsigned> &Args,
+                              unsigned Result) {
+  unsigned i = 0;
+  for (Function::const_arg_iterator AI = F->arg_begin(), AE = F->arg_end();
+       AI != AE && i != Args.size(); ++AI, ++i) {
+    ValueNodeMap::iterator N = ValueNodes.find(AI);
+    if (N != ValueNodes.end())
+      addCopy(N->second, Args[i]);
+  }
+  // Variable arguments are only reachable through va_arg, which we don't
+  // model, so let them escape.
+  for (; i != Args.size(); ++i)
+    addCopy(UniversalSet, Args[i]);
+
+  DenseMap<const Function*, unsigned>::iterator R = ReturnNodes.find(F);
+  if (R != ReturnNodes.end())
+    addCopy(Result, R->second);
+}
+
+/// addExternalCall - Add the constraints for a call to an unknown function or
+/// to the declaration F.  The attributes of the call site and of F describe
+/// what the callee can do with its arguments.
+void Andersens::addExternalCall(CallSite CS, const Function *F,
+                                const std::vector<unsigned> &Args,
+                                unsigned Result, unsigned HeapObject) {
+  bool ReadNone = CS.doesNotAccessMemory() || (F && F->doesNotAccessMemory());
+  bool ReadOnly = CS.onlyReadsMemory() || (F && F->onlyReadsMemory());
+  bool NoAliasReturn = CS.paramHasAttr(0, Attribute::NoAlias) ||
+                       (F && F->paramHasAttr(0, Attribute::NoAlias));
+
+  // Intrinsics that don't touch memory compute their result from their
+  // arguments.  Other functions that don't touch memory may still return a
+  // pointer to memory that we don't see.
+  if (ReadNone) {
+    for (unsigned i = 0, e = Args.size(); i != e; ++i)
+      addCopy(Result, Args[i]);
+    if (!F || !F->isIntrinsic())
+      addCopy(Result, UniversalSet);
+    return;
+  }
+
+  for (unsigned i = 0, e = Args.size(); i != e; ++i) {
+    if (Args[i] == NullPtr)
+      continue;
+    bool NoCapture = CS.paramHasAttr(i + 1, Attribute::NoCapture) ||
+                     (F && F->paramHasAttr(i + 1, Attribute::NoCapture));
+    if (!NoCapture) {
+      addCopy(UniversalSet, Args[i]);
+      continue;
+    }
+    // The pointer itself doesn't escape, but what it points to does.
+    addLoad(UniversalSet, Args[i]);
+    if (!ReadOnly)
+      addStore(Args[i], UniversalSet);
+  }
+
+  if (Result == NullPtr)
+    return;
+  if (NoAliasReturn && HeapObject != NullPtr) {
+    addAddressOf(Result, HeapObject);
+    addCopy(HeapObject, UniversalSet);
+  } else {
+    addCopy(Result, UniversalSet);
+  }
+}
+
+void Andersens::collectCallConstraints(CallSite CS) {
+  Instruction *I = CS.getInstruction();
+  unsigned Result = getNode(I);
+  Value *Callee = CS.getCalledValue()->stripPointerCasts();
+
+  if (isMalloc(I)) {
+    addAddressOf(Result, ObjectNodes[I]);
+    return;
+  }
+  if (isFreeCall(I))
+    return;
+  if (const MemTransferInst *MTI = dyn_cast<MemTransferInst>(I)) {
+    // *Dest = *Src, through a temporary.
+    unsigned Tmp = createNode(0, false);
+    addLoad(Tmp, getNode(MTI->getRawSource()));
+    addStore(getNode(MTI->getRawDest()), Tmp);
+    return;
+  }
+  if (isa<MemSetInst>(I) || isa<DbgInfoIntrinsic>(I))
+    return;
+
+  std::vector<unsigned> Args;
+  for (CallSite::arg_iterator AI = CS.arg_begin(), AE = CS.arg_end();
+       AI != AE; ++AI)
+    Args.push_back(getNode(*AI));
+
+  DenseMap<const Value*, unsigned>::iterator Obj = ObjectNodes.find(I);
+  unsigned HeapObject = Obj != ObjectNodes.end() ? Obj->second : NullPtr;
+
+  if (Function *F = dyn_cast<Function>(Callee)) {
+    if (F->isDeclaration() || F->mayBeOverridden())
+      addExternalCall(CS, F, Args, Result, HeapObject);
+    else
+      addDirectCall(F, Args, Result);
+    return;
+  }
+
+  if (isa<InlineAsm>(Callee)) {
+    addExternalCall(CS, 0, Args, Result, HeapObject);
+    return;
+  }
+
+  // Resolve the call while solving, once we know the possible callees.
+  IndirectCall IC;
+  IC.Inst = I;
+  IC.Callee = getNode(CS.getCalledValue());
+  IC.Args = Args;
+  IC.Result = Result;
+  IC.HeapObject = HeapObject;
+  IndirectCalls.push_back(IC);
+}
+
+//===----------------------------------------------------------------------===//
+//                      Offline Variable Substitution
+//===----------------------------------------------------------------------===//
+
+namespace {
+  /// HashSparseBitVector - A cheap hash of the bits set in V.
+  unsigned HashSparseBitVector(const SparseBitVector<> &V) {
+    unsigned H = 0;
+    for (SparseBitVector<>::iterator I = V.begin(), E = V.end(); I != E; ++I)
+      H = H * 37 + *I;
+    return H;
+  }
+}
+
+/// substituteVariables - Hash-based value numbering: label every node with
+/// the set of "sources" its points-to set is built from, and merge the nodes
+/// whose labels are equal.  Copy constraints propagate labels, AddressOf
+/// constraints introduce a label for the object, and nodes whose points-to
+/// set depends on the solution (contents of memory objects, results of loads,
+/// formals of functions called indirectly) get a label of their own.  Nodes
+/// with no label point to nothing and are dropped.
+void Andersens::substituteVariables(Module &M) {
+  unsigned NumGraphNodes = GraphNodes.size();
+  std::vector<bool> Indirect(NumGraphNodes);
+  std::vector<std::vector<unsigned> > Preds(NumGraphNodes);
+  std::vector<SmallVector<unsigned, 1> > Addresses(NumGraphNodes);
+
+  Indirect[UniversalSet] = true;
+  for (unsigned i = NumSpecialNodes; i != NumGraphNodes; ++i)
+    if (GraphNodes[i].IsObject)
+      Indirect[i] = true;
+  for (unsigned i = 0, e = IndirectCalls.size(); i != e; ++i)
+    if (IndirectCalls[i].Result != NullPtr)
+      Indirect[IndirectCalls[i].Result] = true;
+
+  // Formals of functions whose address is taken receive arguments while
+  // solving.
+  for (Module::iterator F = M.begin(), E = M.end(); F != E; ++F) {
+    bool AddressTaken = !F->hasLocalLinkage() || F->mayBeOverridden();
+    for (Value::use_iterator UI = F->use_begin(), UE = F->use_end();
+         UI != UE && !AddressTaken; ++UI) {
+      CallSite CS(*UI);
+      AddressTaken = !CS || !CS.isCallee(UI);
+    }
+    if (!AddressTaken)
+      continue;
+    for (Function::arg_iterator AI = F->arg_begin(), AE = F->arg_end();
+         AI != AE; ++AI) {
+      ValueNodeMap::iterator N = ValueNodes.find(AI);
+      if (N != ValueNodes.end())
+        Indirect[N->second] = true;
+    }
+  }
+
+  for (unsigned i = 0, e = Constraints.size(); i != e; ++i) {
+    const Constraint &C = Constraints[i];
+    switch (C.Kind) {
+    case Constraint::Copy:
+      Preds[C.Dest].push_back(C.Src);
+      break;
+    case Constraint::AddressOf:
+      Addresses[C.Dest].push_back(C.Src);
+      break;
+    case Constraint::Load:
+      Indirect[C.Dest] = true;
+      break;
+    case Constraint::Store:
+      break;
+    }
+  }
+
+  // Label the nodes in topological order of the SCCs of the copy graph, with
+  // an iterative version of Tarjan's algorithm over the predecessor edges.
+  std::vector<unsigned> Label(NumGraphNodes);   // Value number, 0 = empty.
+  std::vector<unsigned> DFSNum(NumGraphNodes);
+  std::vector<unsigned> Low(NumGraphNodes);
+  std::vector<bool> OnStack(NumGraphNodes);
+  std::vector<unsigned> SCCStack;
+  std::vector<std::pair<unsigned, unsigned> > DFSStack;
+  std::vector<SparseBitVector<> > LabelSets(1);
+  std::multimap<unsigned, unsigned> LabelSetHash;
+  std::vector<unsigned> AddressLabel(NumGraphNodes);
+  unsigned NextDFSNum = 1;
+
+  for (unsigned Root = 0; Root != NumGraphNodes; ++Root) {
+    if (DFSNum[Root])
+      continue;
+    DFSStack.push_back(std::make_pair(Root, 0U));
+    DFSNum[Root] = Low[Root] = NextDFSNum++;
+    SCCStack.push_back(Root);
+    OnStack[Root] = true;
+
+    while (!DFSStack.empty()) {
+      unsigned N = DFSStack.back().first;
+      unsigned &NextPred = DFSStack.back().second;
+      if (NextPred != Preds[N].size()) {
+        unsigned P = Preds[N][NextPred++];
+        if (!DFSNum[P]) {
+          DFSNum[P] = Low[P] = NextDFSNum++;
+          SCCStack.push_back(P);
+          OnStack[P] = true;
+          DFSStack.push_back(std::make_pair(P, 0U));
+        } else if (OnStack[P]) {
+          Low[N] = std::min(Low[N], DFSNum[P]);
+        }
+        continue;
+      }
+
+      DFSStack.pop_back();
+      if (!DFSStack.empty())
+        Low[DFSStack.back().first] = std::min(Low[DFSStack.back().first],
+                                              Low[N]);
+      if (Low[N] != DFSNum[N])
+        continue;
+
+      // N is the root of an SCC; all of its predecessors outside it have
+      // their labels already.
+      SmallVector<unsigned, 8> Members;
+      unsigned M;
+      do {
+        M = SCCStack.back();
+        SCCStack.pop_back();
+        OnStack[M] = false;
+        Members.push_back(M);
+      } while (M != N);
+
+      SparseBitVector<> Labels;
+      unsigned OnlyLabel = 0;     // The label if it comes from one source.
+      unsigned NumSources = 0;
+      bool Fresh = false;
+      for (unsigned i = 0, e = Members.size(); i != e; ++i) {
+        unsigned Mem = Members[i];
+        Fresh |= Indirect[Mem];
+        for (unsigned j = 0, je = Addresses[Mem].size(); j != je; ++j) {
+          unsigned Obj = Addresses[Mem][j];
+          if (!AddressLabel[Obj]) {
+            AddressLabel[Obj] = LabelSets.size();
+            LabelSets.push_back(SparseBitVector<>());
+            LabelSets.back().set(AddressLabel[Obj]);
+            LabelSetHash.insert(std::make_pair(
+                HashSparseBitVector(LabelSets.back()), AddressLabel[Obj]));
+          }
+          Labels.set(AddressLabel[Obj]);
+          ++NumSources;
+        }
+        for (unsigned j = 0, je = Preds[Mem].size(); j != je; ++j) {
+          unsigned PL = Label[Preds[Mem][j]];
+          if (!PL || OnStack[Preds[Mem][j]])
+            continue;
+          if (PL != OnlyLabel) {
+            OnlyLabel = PL;
+            ++NumSources;
+          }
+          Labels |= LabelSets[PL];
+        }
+      }
+
+      unsigned L = 0;
+      if (Fresh) {
+        L = LabelSets.size();
+        LabelSets.push_back(SparseBitVector<>());
+        LabelSets.back().set(L);
+        LabelSetHash.insert(std::make_pair(HashSparseBitVector(LabelSets[L]),
+                                           L));
+      } else if (NumSources == 1 && OnlyLabel) {
+        L = OnlyLabel;
+      } else if (!Labels.empty()) {
+        unsigned H = HashSparseBitVector(Labels);
+        typedef std::multimap<unsigned, unsigned>::iterator HashIt;
+        std::pair<HashIt, HashIt> R = LabelSetHash.equal_range(H);
+        for (HashIt I = R.first; I != R.second; ++I)
+          if (LabelSets[I->second] == Labels) {
+            L = I->second;
+            break;
+          }
+        if (!L) {
+          L = LabelSets.size();
+          LabelSets.push_back(Labels);
+          LabelSetHash.insert(std::make_pair(H, L));
+        }
+      }
+      for (unsigned i = 0, e = Members.size(); i != e; ++i)
+        Label[Members[i]] = L;
+    }
+  }
+
+  // Merge the nodes with equal labels and drop the empty ones.
+  std::vector<unsigned> LabelRep(LabelSets.size(), ~0U);
+  for (unsigned N = NumSpecialNodes; N != NumGraphNodes; ++N) {
+    unsigned L = Label[N];
+    if (!L) {
+      GraphNodes[N].Rep = NullPtr;
+      ++NumRemoved;
+      continue;
+    }
+    if (LabelRep[L] == ~0U) {
+      LabelRep[L] = N;
+      continue;
+    }
+    GraphNodes[N].Rep = LabelRep[L];
+    ++NumSubstituted;
+  }
+}
+
+//===----------------------------------------------------------------------===//
+//                               Solving
+//===----------------------------------------------------------------------===//
+
+/// find - Return the representative of N, compressing the path to it.
+unsigned Andersens::find(unsigned N) {
+  unsigned Root = N;
+  while (GraphNodes[Root].Rep != Root)
+    Root = GraphNodes[Root].Rep;
+  while (GraphNodes[N].Rep != Root) {
+    unsigned Next = GraphNodes[N].Rep;
+    GraphNodes[N].Rep = Root;
+    N = Next;
+  }
+  return Root;
+}
+
+/// unite - Merge the representatives of A and B and return the result.
+unsigned Andersens::unite(unsigned A, unsigned B) {
+  A = find(A);
+  B = find(B);
+  if (A == B)
+    return A;
+  // Keep the special nodes as representatives.
+  if (B < A && B < NumSpecialNodes)
+    std::swap(A, B);
+
+  Node &NA = GraphNodes[A];
+  Node &NB = GraphNodes[B];
+  NB.Rep = A;
+  NA.PointsTo |= NB.PointsTo;
+  NA.Edges |= NB.Edges;
+  NA.Edges.reset(A);
+  NA.Edges.reset(B);
+  // Anything that wasn't propagated from both nodes has to be propagated
+  // again.
+  NA.OldPointsTo &= NB.OldPointsTo;
+  NA.Complex.insert(NA.Complex.end(), NB.Complex.begin(), NB.Complex.end());
+  NA.Calls.insert(NA.Calls.end(), NB.Calls.begin(), NB.Calls.end());
+  NB.PointsTo.clear();
+  NB.OldPointsTo.clear();
+  NB.Edges.clear();
+  std::vector<Constraint>().swap(NB.Complex);
+  std::vector<unsigned>().swap(NB.Calls);
+  pushNode(A);
+  return A;
+}
+
+void Andersens::pushNode(unsigned N) {
+  if (InWorklist[N])
+    return;
+  InWorklist[N] = true;
+  Worklist.push_back(N);
+}
+
+/// addEdge - Add a copy edge from Src to Dest and propagate along it.
+void Andersens::addEdge(unsigned Src, unsigned Dest) {
+  Src = find(Src);
+  Dest = find(Dest);
+  if (Src == Dest || Src == NullPtr || Dest == NullPtr)
+    return;
+  if (!GraphNodes[Src].Edges.test_and_set(Dest))
+    return;
+  ++NewEdges;
+  if (GraphNodes[Dest].PointsTo |= GraphNodes[Src].PointsTo)
+    pushNode(Dest);
+}
+
+/// buildGraph - Turn the constraints into the initial constraint graph.
+void Andersens::buildGraph() {
+  InWorklist.resize(GraphNodes.size());
+  for (unsigned i = 0, e = Constraints.size(); i != e; ++i) {
+    Constraint C = Constraints[i];
+    C.Dest = find(C.Dest);
+    C.Src = C.Kind == Constraint::AddressOf ? C.Src : find(C.Src);
+    if (C.Dest == NullPtr || C.Src == NullPtr)
+      continue;
+    switch (C.Kind) {
+    case Constraint::AddressOf:
+      GraphNodes[C.Dest].PointsTo.set(C.Src);
+      break;
+    case Constraint::Copy:
+      if (C.Src != C.Dest)
+        GraphNodes[C.Src].Edges.set(C.Dest);
+      break;
+    case Constraint::Load:
+      GraphNodes[C.Src].Complex.push_back(C);
+      break;
+    case Constraint::Store:
+      GraphNodes[C.Dest].Complex.push_back(C);
+      break;
+    }
+  }
+  std::vector<Constraint>().swap(Constraints);
+
+  for (unsigned i = 0, e = IndirectCalls.size(); i != e; ++i) {
+    unsigned Callee = find(IndirectCalls[i].Callee);
+    if (Callee != NullPtr)
+      GraphNodes[Callee].Calls.push_back(i);
+  }
+
+  // The universal set is the callee of calls from external code.
+  IndirectCall External;
+  External.Inst = 0;
+  External.Callee = UniversalSet;
+  External.Result = NullPtr;
+  External.HeapObject = NullPtr;
+  IndirectCalls.push_back(External);
+  GraphNodes[UniversalSet].Calls.push_back(IndirectCalls.size() - 1);
+
+  for (unsigned N = 0, e = GraphNodes.size(); N != e; ++N)
+    if (find(N) == N && !GraphNodes[N].PointsTo.empty())
+      pushNode(N);
+}
+
+/// solve - Process the worklist in rounds.  The nodes that become ready
+/// during a round are processed in the next one, and the cycles found in the
+/// meantime are collapsed in between, with one depth-first search for all of
+/// them.
+void Andersens::solve() {
+  Solving = true;
+  std::vector<unsigned> Round;
+  while (!Worklist.empty()) {
+    Round.clear();
+    Round.swap(Worklist);
+    for (unsigned i = 0, e = Round.size(); i != e; ++i) {
+      unsigned N = Round[i];
+      InWorklist[N] = false;
+      if (find(N) == N)
+        processNode(N);
+    }
+    // Most cycles are only formed by the edges that loads and stores add
+    // while solving, and lazy cycle detection only finds them after the
+    // sets on them have grown.  Search the whole graph whenever it has
+    // changed that much, which keeps the cost of the searches linear in the
+    // number of edges.
+    if (NewEdges > GraphNodes.size()) {
+      NewEdges = 0;
+      for (unsigned N = 0, e = GraphNodes.size(); N != e; ++N)
+        if (find(N) == N && !GraphNodes[N].Edges.empty())
+          CycleCandidates.push_back(N);
+    }
+    if (!CycleCandidates.empty())
+      collapseCycles();
+  }
+}
+
+/// processNode - Propagate the new part of the points-to set of N through
+/// the constraints and edges out of N.
+void Andersens::processNode(unsigned N) {
+  ++NumIterations;
+  SparseBitVector<> Delta(GraphNodes[N].PointsTo);
+  Delta.intersectWithComplement(GraphNodes[N].OldPointsTo);
+  if (Delta.empty())
+    return;
+  GraphNodes[N].OldPointsTo |= Delta;
+
+  // Resolving calls may add constraints to N, so don't hold on to anything
+  // inside it.
+  for (unsigned i = 0; i != GraphNodes[N].Complex.size(); ++i) {
+    Constraint C = GraphNodes[N].Complex[i];
+    for (SparseBitVector<>::iterator I = Delta.begin(), E = Delta.end();
+         I != E; ++I) {
+      if (C.Kind == Constraint::Load)
+        addEdge(*I, C.Dest);
+      else
+        addEdge(C.Src, *I);
+    }
+  }
+
+  for (unsigned i = 0; i != GraphNodes[N].Calls.size(); ++i) {
+    unsigned Call = GraphNodes[N].Calls[i];
+    for (SparseBitVector<>::iterator I = Delta.begin(), E = Delta.end();
+         I != E; ++I)
+      resolveCall(Call, *I);
+  }
+
+  SmallVector<unsigned, 16> Succs;
+  for (SparseBitVector<>::iterator I = GraphNodes[N].Edges.begin(),
+       E = GraphNodes[N].Edges.end(); I != E; ++I)
+    Succs.push_back(*I);
+  for (unsigned i = 0, e = Succs.size(); i != e; ++i) {
+    unsigned S = find(Succs[i]);
+    if (S == N)
+      continue;
+    if (GraphNodes[S].PointsTo |= Delta) {
+      pushNode(S);
+      continue;
+    }
+    // Equal sets at both ends of an edge hint at a cycle.
+    if (GraphNodes[S].PointsTo == GraphNodes[N].PointsTo &&
+        CheckedEdges.insert(std::make_pair(N, S)).second)
+      CycleCandidates.push_back(S);
+  }
+}
+
+/// resolveCall - Obj has been found to be a possible callee of an indirect
+/// call.  Add the constraints for the call.
+void Andersens::resolveCall(unsigned CallIdx, unsigned Obj) {
+  IndirectCall &IC = IndirectCalls[CallIdx];
+  if (!IC.Resolved.insert(Obj).second)
+    return;
+  if (!IC.Inst) {
+    resolveExternalCaller(Obj);
+    return;
+  }
+
+  CallSite CS(const_cast<Instruction*>(IC.Inst));
+  std::vector<unsigned> Args(IC.Args);
+  if (Obj == UniversalSet) {
+    addExternalCall(CS, 0, Args, IC.Result, IC.HeapObject);
+    return;
+  }
+  const Function *F = dyn_cast_or_null<Function>(GraphNodes[Obj].Val);
+  if (!F || !GraphNodes[Obj].IsObject)
+    return;
+  ++NumIndirectCallees;
+  if (F->isDeclaration() || F->mayBeOverridden())
+    addExternalCall(CS, F, Args, IC.Result, IC.HeapObject);
+  else
+    addDirectCall(F, Args, IC.Result);
+}
+
+/// resolveExternalCaller - Obj has reached the universal set, so if it is a
+/// function, external code may call it with any pointer it can reach.
+void Andersens::resolveExternalCaller(unsigned Obj) {
+  const Function *F = dyn_cast_or_null<Function>(GraphNodes[Obj].Val);
+  if (!F || !GraphNodes[Obj].IsObject || F->isDeclaration())
+    return;
+  for (Function::const_arg_iterator AI = F->arg_begin(), AE = F->arg_end();
+       AI != AE; ++AI) {
+    ValueNodeMap::iterator N = ValueNodes.find(AI);
+    if (N != ValueNodes.end())
+      addCopy(N->second, UniversalSet);
+  }
+  DenseMap<const Function*, unsigned>::iterator R = ReturnNodes.find(F);
+  if (R != ReturnNodes.end())
+    addCopy(UniversalSet, R->second);
+}
+
+/// getSuccessors - Append the copy edges out of N to Succs.
+void Andersens::getSuccessors(unsigned N, std::vector<unsigned> &Succs) {
+  const SparseBitVector<> &Edges = GraphNodes[N].Edges;
+  for (SparseBitVector<>::iterator I = Edges.begin(), E = Edges.end();
+       I != E; ++I)
+    Succs.push_back(*I);
+}
+
+/// collapseCycles - Find the cycles of copy edges reachable from the cycle
+/// candidates with Tarjan's algorithm, and merge the nodes on each of them.
+void Andersens::collapseCycles() {
+  DenseMap<unsigned, unsigned> DFSNum, Low;
+  DenseSet<unsigned> OnStack;
+  std::vector<unsigned> SCCStack;
+  std::vector<std::vector<unsigned> > Cycles;
+  // Each frame holds a node and the successors left to visit.
+  std::vector<std::pair<unsigned, std::vector<unsigned> > > DFSStack;
+  unsigned NextDFSNum = 1;
+
+  for (unsigned c = 0, ce = CycleCandidates.size(); c != ce; ++c) {
+    unsigned Start = find(CycleCandidates[c]);
+    if (DFSNum.count(Start))
+      continue;
+    DFSNum[Start] = Low[Start] = NextDFSNum++;
+    SCCStack.push_back(Start);
+    OnStack.insert(Start);
+    DFSStack.push_back(std::make_pair(Start, std::vector<unsigned>()));
+    getSuccessors(Start, DFSStack.back().second);
+
+    while (!DFSStack.empty()) {
+      unsigned N = DFSStack.back().first;
+      std::vector<unsigned> &Succs = DFSStack.back().second;
+      if (!Succs.empty()) {
+        unsigned S = find(Succs.back());
+        Succs.pop_back();
+        if (S == N)
+          continue;
+        if (!DFSNum.count(S)) {
+          DFSNum[S] = Low[S] = NextDFSNum++;
+          SCCStack.push_back(S);
+          OnStack.insert(S);
+          DFSStack.push_back(std::make_pair(S, std::vector<unsigned>()));
+          getSuccessors(S, DFSStack.back().second);
+        } else if (OnStack.count(S)) {
+          Low[N] = std::min(Low[N], DFSNum[S]);
+        }
+        continue;
+      }
+
+      DFSStack.pop_back();
+      if (!DFSStack.empty()) {
+        unsigned P = DFSStack.back().first;
+        Low[P] = std::min(Low[P], Low[N]);
+      }
+      if (Low[N] != DFSNum[N])
+        continue;
+
+      std::vector<unsigned> SCC;
+      unsigned M;
+      do {
+        M = SCCStack.back();
+        SCCStack.pop_back();
+        OnStack.erase(M);
+        SCC.push_back(M);
+      } while (M != N);
+      if (SCC.size() > 1)
+        Cycles.push_back(SCC);
+    }
+  }
+  CycleCandidates.clear();
+
+  for (unsigned i = 0, e = Cycles.size(); i != e; ++i) {
+    unsigned Rep = Cycles[i][0];
+    for (unsigned j = 1, je = Cycles[i].size(); j != je; ++j)
+      Rep = unite(Rep, Cycles[i][j]);
+    NumCycleNodes += Cycles[i].size() - 1;
+  }
+}
+
+//===----------------------------------------------------------------------===//
+//                                Queries
+//===----------------------------------------------------------------------===//
+
+/// getPointsTo - Return the points-to set of V, or null if V is unknown to
+/// the analysis or might point to something it doesn't model.
+const SparseBitVector<> *Andersens::getPointsTo(const Value *V) {
+  // Look through constant casts and GEPs of globals.
+  while (const ConstantExpr *CE = dyn_cast<ConstantExpr>(V)) {
+    if (CE->getOpcode() != Instruction::BitCast &&
+        CE->getOpcode() != Instruction::GetElementPtr)
+      return 0;
+    V = CE->getOperand(0);
+  }
+
+  ValueNodeMap::iterator I = ValueNodes.find(V);
+  if (I == ValueNodes.end())
+    return 0;
+  const SparseBitVector<> &PointsTo = GraphNodes[find(I->second)].PointsTo;
+  // An empty set means V is null, undefined, or built from an integer that
+  // doesn't come from a pointer, such as a fixed address.
+  if (PointsTo.empty())
+    return 0;
+  return &PointsTo;
+}
+
+AliasAnalysis::AliasResult
+Andersens::alias(const Location &LocA, const Location &LocB) {
+  const SparseBitVector<> *A = getPointsTo(LocA.Ptr);
+  const SparseBitVector<> *B = getPointsTo(LocB.Ptr);
+  if (A && B) {
+    // A pointer into the universal set may point to anything external code
+    // can reach.
+    const SparseBitVector<> &Universal =
+      GraphNodes[find(UniversalSet)].PointsTo;
+    bool AU = A->find_first() == UniversalSet;
+    bool BU = B->find_first() == UniversalSet;
+    if (AU && BU)
+      return AliasAnalysis::alias(LocA, LocB);
+    if (AU ? !Universal.intersects(*B) && !A->intersects(*B) :
+        BU ? !Universal.intersects(*A) && !A->intersects(*B) :
+        !A->intersects(*B))
+      return NoAlias;
+  }
+
+  return AliasAnalysis::alias(LocA, LocB);
+}
+
+void Andersens::deleteValue(Value *V) {
+  ValueNodes.erase(V);
+  AliasAnalysis::deleteValue(V);
+}
+
+void Andersens::copyValue(Value *From, Value *To) {
+  ValueNodeMap::iterator I = ValueNodes.find(From);
+  if (I != ValueNodes.end() && !ValueNodes.count(To))
+    ValueNodes[To] = I->second;
+  AliasAnalysis::copyValue(From, To);
+}
+
+void Andersens::addEscapingUse(Use &U) {
+  // We can't see where the value goes from here; forget about it.
+  ValueNodes.erase(U.get());
+  AliasAnalysis::addEscapingUse(U);
+}
+
+void Andersens::printNodeName(raw_ostream &OS, unsigned N) const {
+  const Node &Nd = GraphNodes[N];
+  if (N == UniversalSet) {
+    OS << "<universal>";
+  } else if (!Nd.Val) {
+    OS << "<tmp" << N << ">";
+  } else if (isa<GlobalValue>(Nd.Val)) {
+    OS << '@' << Nd.Val->getName();
+  } else {
+    OS << '%' << Nd.Val->getName();
+  }
+}
+
+void Andersens::print(raw_ostream &OS, const Module *M) const {
+  Andersens *Self = const_cast<Andersens*>(this);
+  for (Module::const_iterator F = M->begin(), E = M->end(); F != E; ++F) {
+    std::vector<const Value*> Vals;
+    for (Function::const_arg_iterator AI = F->arg_begin(), AE = F->arg_end();
+         AI != AE; ++AI)
+      Vals.push_back(AI);
+    for (const_inst_iterator I = inst_begin(F), IE = inst_end(F); I != IE; ++I)
+      Vals.push_back(&*I);
+
+    for (unsigned i = 0, e = Vals.size(); i != e; ++i) {
+      if (!Vals[i]->getType()->isPointerTy() || !Vals[i]->hasName())
+        continue;
+      ValueNodeMap::const_iterator N = ValueNodes.find(Vals[i]);
+      if (N == ValueNodes.end())
+        continue;
+      OS << "  " << F->getName() << ": %" << Vals[i]->getName() << " -> {";
+      const SparseBitVector<> &PointsTo =
+        GraphNodes[Self->find(N->second)].PointsTo;
+      for (SparseBitVector<>::iterator I = PointsTo.begin(),
+           IE = PointsTo.end(); I != IE; ++I) {
+        OS << ' ';
+        printNodeName(OS, *I);
+      }
+      OS << " }\n";
+    }
+  }
+}
@@ -18,6 +18,7 @@ using namespace llvm;
 
 /// initializeIPA - Initialize all passes linked into the IPA library.
 void llvm::initializeIPA(PassRegistry &Registry) {
+  initializeAndersensPass(Registry);
   initializeBasicCallGraphPass(Registry);
   initializeCallGraphAnalysisGroup(Registry);
   initializeFindUsedTypesPass(Registry);
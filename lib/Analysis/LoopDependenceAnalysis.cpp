@@ -36,6 +36,7 @@
 #include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Target/TargetData.h"
+#include <algorithm>
 using namespace llvm;
 
 STATISTIC(NumAnswered,    "Number of dependence queries answered");
@@ -50,6 +51,7 @@ LoopPass *llvm::createLoopDependenceAnalysisPass() {
 
 INITIALIZE_PASS_BEGIN(LoopDependenceAnalysis, "lda",
                 "Loop Dependence Analysis", false, true)
+INITIALIZE_PASS_DEPENDENCY(LoopInfo)
 INITIALIZE_PASS_DEPENDENCY(ScalarEvolution)
 INITIALIZE_AG_DEPENDENCY(AliasAnalysis)
 INITIALIZE_PASS_END(LoopDependenceAnalysis, "lda",
@@ -102,6 +104,72 @@ static inline const SCEV *GetZeroSCEV(ScalarEvolution *SE) {
   return SE->getConstant(Type::getInt32Ty(SE->getContext()), 0L);
 }
 
+/// GetCommonLoops - Collect the loops containing both A and B, outermost
+/// first.
+static void GetCommonLoops(LoopInfo *LI, const Instruction *A,
+                           const Instruction *B,
+                           SmallVectorImpl<const Loop*> &Nest) {
+  Nest.clear();
+  for (const Loop *L = LI->getLoopFor(A->getParent()); L;
+       L = L->getParentLoop())
+    if (L->contains(B))
+      Nest.push_back(L);
+  std::reverse(Nest.begin(), Nest.end());
+}
+
+/// GetMaxTripCount - Return the maximum number of iterations of L, or zero if
+/// it is unknown.
+static uint64_t GetMaxTripCount(ScalarEvolution *SE, const Loop *L) {
+  const SCEVConstant *BECount =
+    dyn_cast<SCEVConstant>(SE->getMaxBackedgeTakenCount(L));
+  if (!BECount || BECount->getValue()->getValue().getActiveBits() > 32)
+    return 0;
+  return BECount->getValue()->getZExtValue() + 1;
+}
+
+typedef SmallVector<std::pair<const Loop*, int64_t>, 4> CoefficientsTy;
+
+/// SplitLinear - Split S into a start value that is invariant in Nest and the
+/// constant coefficients of the induction variables of the loops in Nest, in
+/// the order they appear in S.  Return false if S is not of this form.
+static bool SplitLinear(const SCEV *S, const SmallVectorImpl<const Loop*> &Nest,
+                        ScalarEvolution *SE, const SCEV *&Start,
+                        CoefficientsTy &Coeffs) {
+  if (Nest.empty())
+    return false;
+  while (const SCEVAddRecExpr *AR = dyn_cast<SCEVAddRecExpr>(S)) {
+    if (!AR->isAffine() ||
+        std::find(Nest.begin(), Nest.end(), AR->getLoop()) == Nest.end())
+      return false;
+    const SCEVConstant *Step =
+      dyn_cast<SCEVConstant>(AR->getStepRecurrence(*SE));
+    if (!Step || Step->getValue()->isZero() ||
+        Step->getValue()->getValue().getMinSignedBits() > 32)
+      return false;
+    Coeffs.push_back(std::make_pair(AR->getLoop(),
+                                    Step->getValue()->getSExtValue()));
+    S = AR->getStart();
+  }
+  Start = S;
+  return SE->isLoopInvariant(S, Nest.front());
+}
+
+static bool CompareCoefficients(const std::pair<const Loop*, int64_t> &A,
+                                const std::pair<const Loop*, int64_t> &B) {
+  return (A.second < 0 ? -A.second : A.second) >
+         (B.second < 0 ? -B.second : B.second);
+}
+
+static int64_t FloorDiv(int64_t A, int64_t B) {
+  int64_t Q = A / B;
+  return (A % B != 0 && (A < 0) != (B < 0)) ? Q - 1 : Q;
+}
+
+static int64_t CeilDiv(int64_t A, int64_t B) {
+  int64_t Q = A / B;
+  return (A % B != 0 && (A < 0) == (B < 0)) ? Q + 1 : Q;
+}
+
 //===----------------------------------------------------------------------===//
 //                             Dependence Testing
 //===----------------------------------------------------------------------===//
@@ -172,14 +240,87 @@ LoopDependenceAnalysis::DependenceResult
 LoopDependenceAnalysis::analyseSIV(const SCEV *A,
                                    const SCEV *B,
                                    Subscript *S) const {
-  return Unknown; // TODO: Implement.
+  // TODO: Weak-zero and weak-crossing SIV tests.
+  return analyseLinear(A, B, S);
 }
 
 LoopDependenceAnalysis::DependenceResult
 LoopDependenceAnalysis::analyseMIV(const SCEV *A,
                                    const SCEV *B,
                                    Subscript *S) const {
-  return Unknown; // TODO: Implement.
+  return analyseLinear(A, B, S);
+}
+
+LoopDependenceAnalysis::DependenceResult
+LoopDependenceAnalysis::analyseLinear(const SCEV *A,
+                                      const SCEV *B,
+                                      Subscript *S) const {
+  const SCEV *AStart, *BStart;
+  CoefficientsTy Coeffs, BCoeffs;
+  if (A->getType() != B->getType() ||
+      !SplitLinear(A, Nest, SE, AStart, Coeffs) ||
+      !SplitLinear(B, Nest, SE, BStart, BCoeffs) ||
+      Coeffs != BCoeffs) {
+    DEBUG(dbgs() << "  -> [?] coefficients differ\n");
+    return Unknown;
+  }
+
+  const SCEVConstant *Diff =
+    dyn_cast<SCEVConstant>(SE->getMinusSCEV(AStart, BStart));
+  if (!Diff || Diff->getValue()->getValue().getMinSignedBits() > 61) {
+    DEBUG(dbgs() << "  -> [?] symbolic difference\n");
+    return Unknown;
+  }
+
+  // Both subscripts have the same value if the sum of the coefficients times
+  // the distances in their loops is Rem.  Solve for the distances of the
+  // loops with the largest coefficients first: the remaining loops can only
+  // make up for a limited amount, Span, which leaves few possible distances.
+  int64_t Rem = Diff->getValue()->getSExtValue();
+  std::stable_sort(Coeffs.begin(), Coeffs.end(), CompareCoefficients);
+  const int64_t MaxSpan = (int64_t)1 << 61;
+  SmallVector<int64_t, 4> Spans(Coeffs.size());
+  int64_t Span = 0;
+  for (unsigned i = Coeffs.size(); i-- != 0; ) {
+    Spans[i] = Span;
+    uint64_t TripCount = GetMaxTripCount(SE, Coeffs[i].first);
+    int64_t Coeff = Coeffs[i].second < 0 ? -Coeffs[i].second
+                                         : Coeffs[i].second;
+    if (Span < 0 || !TripCount ||
+        (int64_t)(TripCount - 1) > (MaxSpan - Span) / Coeff)
+      Span = -1;
+    else
+      Span += Coeff * (int64_t)(TripCount - 1);
+  }
+
+  unsigned i = 0, e = Coeffs.size();
+  for (; i != e && Spans[i] >= 0; ++i) {
+    int64_t Coeff = Coeffs[i].second;
+    int64_t Lo = CeilDiv(Rem - Spans[i], Coeff < 0 ? -Coeff : Coeff);
+    int64_t Hi = FloorDiv(Rem + Spans[i], Coeff < 0 ? -Coeff : Coeff);
+    if (uint64_t TripCount = GetMaxTripCount(SE, Coeffs[i].first)) {
+      Lo = std::max(Lo, -(int64_t)(TripCount - 1));
+      Hi = std::min(Hi, (int64_t)(TripCount - 1));
+    }
+    if (Lo > Hi) {
+      DEBUG(dbgs() << "  -> [I] no distance in loop "
+                   << Coeffs[i].first->getHeader()->getName() << "\n");
+      return Independent;
+    }
+    if (Lo != Hi)
+      break;
+    int64_t Dist = Coeff < 0 ? -Lo : Lo;
+    S->Distances.push_back(std::make_pair(Coeffs[i].first, Dist));
+    Rem -= Coeff * Dist;
+  }
+
+  if (i == e && Rem != 0) {
+    DEBUG(dbgs() << "  -> [I] constant difference\n");
+    return Independent;
+  }
+  DEBUG(dbgs() << "  -> [D] " << S->Distances.size() << " of " << e
+               << " distances known\n");
+  return Dependent;
 }
 
 LoopDependenceAnalysis::DependenceResult
@@ -190,6 +331,8 @@ LoopDependenceAnalysis::analyseSubscript(const SCEV *A,
 
   if (A == B) {
     DEBUG(dbgs() << "  -> [D] same SCEV\n");
+    // The distances need not be zero, e.g. for (i+j, i+j), so compute them.
+    analyseLinear(A, B, S);
     return Dependent;
   }
 
@@ -208,9 +351,16 @@ LoopDependenceAnalysis::analyseSubscript(const SCEV *A,
 }
 
 LoopDependenceAnalysis::DependenceResult
-LoopDependenceAnalysis::analysePair(DependencePair *P) const {
+LoopDependenceAnalysis::analysePair(DependencePair *P) {
   DEBUG(dbgs() << "Analysing:\n" << *P->A << "\n" << *P->B << "\n");
 
+  // Start out with unknown distances in all loops containing the pair.
+  GetCommonLoops(LI, cast<Instruction>(P->A), cast<Instruction>(P->B), Nest);
+  for (unsigned i = 0, e = Nest.size(); i != e; ++i) {
+    Distance D = { Nest[i], false, 0 };
+    P->Distances.push_back(D);
+  }
+
   // We only analyse loads and stores but no possible memory accesses by e.g.
   // free, call, or invoke instructions.
   if (!IsLoadOrStoreInst(P->A) || !IsLoadOrStoreInst(P->B)) {
@@ -271,22 +421,40 @@ LoopDependenceAnalysis::analysePair(DependencePair *P) const {
   }
 
   // Now analyse the collected operand pairs (skipping the GEP ptr offsets).
+  // A subscript we fail to analyse doesn't keep the others from proving
+  // independence, or from determining distances.
+  DependenceResult Result = Dependent;
   for (GEPOpdPairsTy::const_iterator i = opds.begin() + 1, end = opds.end();
        i != end; ++i) {
     Subscript subscript;
     DependenceResult result = analyseSubscript(i->first, i->second, &subscript);
-    if (result != Dependent) {
-      // We either proved independence or failed to analyse this subscript.
-      // Further subscripts will not improve the situation, so abort early.
-      return result;
-    }
+    if (result == Independent)
+      return Independent;
+    if (result == Unknown)
+      Result = Unknown;
+
+    // All subscripts have to be equal in the same pair of iterations, so
+    // different distances for the same loop mean there is no dependence.
+    for (unsigned d = 0, e = subscript.Distances.size(); d != e; ++d)
+      for (unsigned n = 0, ne = P->Distances.size(); n != ne; ++n) {
+        Distance &D = P->Distances[n];
+        if (D.L != subscript.Distances[d].first)
+          continue;
+        if (D.Known && D.Value != subscript.Distances[d].second) {
+          DEBUG(dbgs() << "---> [I] conflicting distances\n");
+          return Independent;
+        }
+        D.Known = true;
+        D.Value = subscript.Distances[d].second;
+      }
     P->Subscripts.push_back(subscript);
   }
-  // We successfully analysed all subscripts but failed to prove independence.
-  return Dependent;
+  // We analysed all subscripts but failed to prove independence.
+  return Result;
 }
 
-bool LoopDependenceAnalysis::depends(Value *A, Value *B) {
+LoopDependenceAnalysis::DependencePair *
+LoopDependenceAnalysis::getAnalysedPair(Value *A, Value *B) {
   assert(isDependencePair(A, B) && "Values form no dependence pair!");
   ++NumAnswered;
 
@@ -300,7 +468,21 @@ bool LoopDependenceAnalysis::depends(Value *A, Value *B) {
     case Unknown:     ++NumUnknown;     break;
     }
   }
-  return p->Result != Independent;
+  return p;
+}
+
+bool LoopDependenceAnalysis::depends(Value *A, Value *B) {
+  return getAnalysedPair(A, B)->Result != Independent;
+}
+
+bool LoopDependenceAnalysis::getDistanceVector(Value *A, Value *B,
+                                        SmallVectorImpl<Distance> &Dist) {
+  DependencePair *p = getAnalysedPair(A, B);
+  if (p->Result == Independent)
+    return false;
+  Dist.clear();
+  Dist.append(p->Distances.begin(), p->Distances.end());
+  return true;
 }
 
 //===----------------------------------------------------------------------===//
@@ -311,6 +493,7 @@ bool LoopDependenceAnalysis::runOnLoop(Loop *L, LPPassManager &) {
   this->L = L;
   AA = &getAnalysis<AliasAnalysis>();
   SE = &getAnalysis<ScalarEvolution>();
+  LI = &getAnalysis<LoopInfo>();
   return false;
 }
 
@@ -323,6 +506,7 @@ void LoopDependenceAnalysis::getAnalysisUsage(AnalysisUsage &AU) const {
   AU.setPreservesAll();
   AU.addRequiredTransitive<AliasAnalysis>();
   AU.addRequiredTransitive<ScalarEvolution>();
+  AU.addRequiredTransitive<LoopInfo>();
 }
 
 static void PrintLoopInfo(raw_ostream &OS,
@@ -346,10 +530,24 @@ static void PrintLoopInfo(raw_ostream &OS,
        end = memrefs.end(); x != end; ++x)
     for (SmallVector<Instruction*, 8>::const_iterator y = x + 1;
          y != end; ++y)
-      if (LDA->isDependencePair(*x, *y))
+      if (LDA->isDependencePair(*x, *y)) {
         OS << "\t" << (x - memrefs.begin()) << "," << (y - memrefs.begin())
-           << ": " << (LDA->depends(*x, *y) ? "dependent" : "independent")
-           << "\n";
+           << ": ";
+        SmallVector<LoopDependenceAnalysis::Distance, 4> dist;
+        if (!LDA->getDistanceVector(*x, *y, dist)) {
+          OS << "independent\n";
+          continue;
+        }
+        OS << "dependent, distance (";
+        for (unsigned i = 0, e = dist.size(); i != e; ++i) {
+          if (i) OS << ", ";
+          if (dist[i].Known)
+            OS << dist[i].Value;
+          else
+            OS << "*";
+        }
+        OS << ")\n";
+      }
 }
 
 void LoopDependenceAnalysis::print(raw_ostream &OS, const Module*) const {
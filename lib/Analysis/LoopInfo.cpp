@@ -246,8 +246,10 @@ unsigned Loop::getSmallConstantTripMultiple() const {
         }
       }
   }
-  // Guard against huge trip counts.
-  if (Result && Result->getValue().getActiveBits() <= 32) {
+  // Guard against huge trip counts, and against a zero trip count, which
+  // comes from a trip count that wraps around.
+  if (Result && Result->getValue().getActiveBits() <= 32 &&
+      !Result->isZero()) {
     return (unsigned)Result->getZExtValue();
   } else {
     return 1;
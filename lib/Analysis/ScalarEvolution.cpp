@@ -3662,6 +3662,13 @@ const SCEV *ScalarEvolution::getMaxBackedgeTakenCount(const Loop *L) {
   return getBackedgeTakenInfo(L).Max;
 }
 
+/// getExitCount - Return the number of times the backedge of the specified
+/// loop is taken before it exits via ExitingBlock, ignoring its other exits.
+const SCEV *ScalarEvolution::getExitCount(const Loop *L,
+                                          BasicBlock *ExitingBlock) {
+  return ComputeBackedgeTakenCountFromExit(L, ExitingBlock).Exact;
+}
+
 /// PushLoopPHIs - Push PHI nodes in the header of the given loop
 /// onto the given Worklist.
 static void
@@ -91,7 +91,7 @@ void VirtRegAuxInfo::CalculateWeightAndHint(LiveInterval &li) {
   const TargetRegisterInfo &tri = *mf_.getTarget().getRegisterInfo();
   MachineBasicBlock *mbb = 0;
   MachineLoop *loop = 0;
-  unsigned loopDepth = 0;
+  float freq = 0;
   bool isExiting = false;
   float totalWeight = 0;
   SmallPtrSet<MachineInstr*, 8> visited;
@@ -110,18 +110,18 @@ void VirtRegAuxInfo::CalculateWeightAndHint(LiveInterval &li) {
     if (!visited.insert(mi))
       continue;
 
-    // Get loop info for mi.
+    // Get loop info and frequency for mi.
     if (mi->getParent() != mbb) {
       mbb = mi->getParent();
       loop = loops_.getLoopFor(mbb);
-      loopDepth = loop ? loop->getLoopDepth() : 0;
+      freq = lis_.getBlockFrequency(mbb);
       isExiting = loop ? loop->isLoopExiting(mbb) : false;
     }
 
     // Calculate instr weight.
     bool reads, writes;
     tie(reads, writes) = mi->readsWritesVirtualRegister(li.reg);
-    float weight = LiveIntervals::getSpillWeight(writes, reads, loopDepth);
+    float weight = (writes + reads) * freq;
 
     // Give extra weight to what looks like a loop induction variable update.
     if (writes && isExiting && lis_.isLiveOutOfMBB(li, mbb))
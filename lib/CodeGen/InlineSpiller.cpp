@@ -200,25 +200,31 @@ void InlineSpiller::reMaterializeAll() {
     return;
 
   // Remove any values that were completely rematted.
-  bool anyRemoved = false;
+  SmallVector<MachineInstr*, 8> DeadDefs;
   for (LiveInterval::vni_iterator I = edit_->getParent().vni_begin(),
        E = edit_->getParent().vni_end(); I != E; ++I) {
     VNInfo *VNI = *I;
-    if (VNI->hasPHIKill() || !edit_->didRematerialize(VNI) ||
-        usedValues_.count(VNI))
+    if (VNI->isUnused() || VNI->hasPHIKill() ||
+        !edit_->didRematerialize(VNI) || usedValues_.count(VNI))
       continue;
     MachineInstr *DefMI = lis_.getInstructionFromIndex(VNI->def);
     DEBUG(dbgs() << "\tremoving dead def: " << VNI->def << '\t' << *DefMI);
-    lis_.RemoveMachineInstrFromMaps(DefMI);
-    vrm_.RemoveMachineInstrFromMaps(DefMI);
-    DefMI->eraseFromParent();
-    VNI->def = SlotIndex();
-    anyRemoved = true;
+    // Partial defs of the register are dead as well.
+    for (unsigned i = 0, e = DefMI->getNumOperands(); i != e; ++i) {
+      MachineOperand &MO = DefMI->getOperand(i);
+      if (MO.isReg() && MO.isDef() && MO.getReg() == edit_->getReg())
+        MO.setIsDead();
+    }
+    DeadDefs.push_back(DefMI);
   }
 
-  if (!anyRemoved)
+  if (DeadDefs.empty())
     return;
 
+  // Deleting the defs removes their values from the parent interval and
+  // shrinks the intervals of the registers they read.
+  edit_->eliminateDeadDefs(DeadDefs, lis_, vrm_, tii_);
+
   // Removing values may cause debug uses where parent is not live.
   for (MachineRegisterInfo::use_iterator RI = mri_.use_begin(edit_->getReg());
        MachineInstr *MI = RI.skipInstruction();) {
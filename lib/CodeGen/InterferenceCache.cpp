@@ -0,0 +1,122 @@
+//===-- InterferenceCache.cpp - Caching per-block interference ------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// InterferenceCache remembers per-block interference in LiveIntervalUnions.
+//
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "regalloc"
+#include "InterferenceCache.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/CodeGen/MachineFunction.h"
+#include "llvm/CodeGen/SlotIndexes.h"
+#include "llvm/Target/TargetRegisterInfo.h"
+
+using namespace llvm;
+
+void InterferenceCache::init(const MachineFunction *mf,
+                             LiveIntervalUnion *liuarray,
+                             const SlotIndexes *indexes,
+                             const TargetRegisterInfo *tri) {
+  MF = mf;
+  LIUArray = liuarray;
+  Indexes = indexes;
+  TRI = tri;
+  PhysRegEntries.assign(TRI->getNumRegs(), 0);
+  RoundRobin = 0;
+  for (unsigned i = 0; i != CacheEntries; ++i)
+    Entries[i].reset(0, LIUArray, TRI, MF, Indexes);
+}
+
+InterferenceCache::Entry *InterferenceCache::get(unsigned PhysReg) {
+  unsigned E = PhysRegEntries[PhysReg];
+  if (E < CacheEntries && Entries[E].getPhysReg() == PhysReg) {
+    if (!Entries[E].valid())
+      Entries[E].revalidate();
+    return &Entries[E];
+  }
+  // No valid entry exists, pick the next round-robin entry.
+  E = RoundRobin;
+  if (++RoundRobin == CacheEntries)
+    RoundRobin = 0;
+  Entries[E].reset(PhysReg, LIUArray, TRI, MF, Indexes);
+  PhysRegEntries[PhysReg] = E;
+  return &Entries[E];
+}
+
+bool InterferenceCache::Entry::valid() const {
+  for (unsigned i = 0, e = Aliases.size(); i != e; ++i)
+    if (Aliases[i].first->changedSince(Aliases[i].second))
+      return false;
+  return true;
+}
+
+void InterferenceCache::Entry::revalidate() {
+  // Invalidate all blocks at once by moving to a new tag.
+  ++Tag;
+  for (unsigned i = 0, e = Aliases.size(); i != e; ++i)
+    Aliases[i].second = Aliases[i].first->getTag();
+}
+
+void InterferenceCache::Entry::reset(unsigned physReg,
+                                     LiveIntervalUnion *LIUArray,
+                                     const TargetRegisterInfo *TRI,
+                                     const MachineFunction *mf,
+                                     const SlotIndexes *indexes) {
+  PhysReg = physReg;
+  MF = mf;
+  Indexes = indexes;
+  Aliases.clear();
+  if (PhysReg)
+    for (const unsigned *AS = TRI->getOverlaps(PhysReg); *AS; ++AS)
+      Aliases.push_back(std::make_pair(&LIUArray[*AS], 0u));
+  // Blocks are only resized when the function changes, and then every tag
+  // is reset with them.
+  unsigned NumBlocks = MF->getNumBlockIDs();
+  if (Blocks.size() != NumBlocks || !PhysReg) {
+    Blocks.assign(NumBlocks, BlockInterference());
+    BlockTags.assign(NumBlocks, 0);
+    Tag = 0;
+  }
+  revalidate();
+}
+
+void InterferenceCache::Entry::update(unsigned MBBNum) {
+  BlockInterference &BI = Blocks[MBBNum];
+  BI.First = BI.Last = SlotIndex();
+  SlotIndex Start, Stop;
+  tie(Start, Stop) = Indexes->getMBBRange(MF->getBlockNumbered(MBBNum));
+
+  for (unsigned i = 0, e = Aliases.size(); i != e; ++i) {
+    LiveIntervalUnion::SegmentIter I = Aliases[i].first->find(Start);
+    if (!I.valid() || I.start() >= Stop)
+      continue;
+    SlotIndex First = std::max(I.start(), Start);
+    if (!BI.First.isValid() || First < BI.First)
+      BI.First = First;
+
+    // Find the last segment starting inside the block.
+    I.advanceTo(Stop);
+    if (!I.valid() || I.start() >= Stop)
+      --I;
+    SlotIndex Last = std::min(I.stop(), Stop);
+    if (!BI.Last.isValid() || BI.Last < Last)
+      BI.Last = Last;
+  }
+  BlockTags[MBBNum] = Tag;
+}
+
+bool InterferenceCache::Entry::overlaps(SlotIndex Start, SlotIndex Stop) {
+  for (unsigned i = 0, e = Aliases.size(); i != e; ++i) {
+    LiveIntervalUnion::SegmentIter I = Aliases[i].first->find(Start);
+    if (I.valid() && I.start() < Stop)
+      return true;
+  }
+  return false;
+}
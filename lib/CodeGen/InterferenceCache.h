@@ -0,0 +1,125 @@
+//===-- InterferenceCache.h - Caching per-block interference ---*- C++ -*--===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// InterferenceCache remembers per-block interference in LiveIntervalUnions.
+//
+// Region splitting evaluates every allocation candidate for every live range it
+// tries to split, and it looks at the same blocks of the same physical
+// registers over and over. The cache records the first and last interfering
+// slot of each block for a physical register and all its aliases, and keeps it
+// until one of the unions changes its tag.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_CODEGEN_INTERFERENCECACHE_H
+#define LLVM_CODEGEN_INTERFERENCECACHE_H
+
+#include "LiveIntervalUnion.h"
+
+namespace llvm {
+
+class MachineFunction;
+class SlotIndexes;
+class TargetRegisterInfo;
+
+class InterferenceCache {
+public:
+  /// BlockInterference - The interference of a physical register in one basic
+  /// block. First is the first interfering slot in the block, and Last is the
+  /// end of the last interfering segment, both clipped to the block. First is
+  /// invalid when there is no interference in the block.
+  struct BlockInterference {
+    SlotIndex First, Last;
+  };
+
+  class Entry {
+    /// PhysReg - The register currently represented.
+    unsigned PhysReg;
+
+    /// Tag - Stamp of the current contents. Blocks computed under an older
+    /// stamp are stale.
+    unsigned Tag;
+
+    /// Aliases - The unions of PhysReg and its aliases, with the tags they
+    /// had when the entry was last validated.
+    SmallVector<std::pair<LiveIntervalUnion*, unsigned>, 8> Aliases;
+
+    /// Blocks - Interference for each basic block, by block number.
+    SmallVector<BlockInterference, 8> Blocks;
+
+    /// BlockTags - The Tag at which each entry of Blocks was computed.
+    SmallVector<unsigned, 8> BlockTags;
+
+    const MachineFunction *MF;
+    const SlotIndexes *Indexes;
+
+    void update(unsigned MBBNum);
+
+  public:
+    Entry() : PhysReg(0), Tag(0), MF(0), Indexes(0) {}
+
+    unsigned getPhysReg() const { return PhysReg; }
+
+    /// valid - Return true if the entry still describes the unions in
+    /// LIUArray.
+    bool valid() const;
+
+    /// reset - Make this entry represent PhysReg.
+    void reset(unsigned PhysReg, LiveIntervalUnion *LIUArray,
+               const TargetRegisterInfo *TRI, const MachineFunction *MF,
+               const SlotIndexes *Indexes);
+
+    /// revalidate - Forget all blocks and record the current union tags.
+    void revalidate();
+
+    /// get - Return the interference in block MBBNum, computing it if needed.
+    const BlockInterference &get(unsigned MBBNum) {
+      if (BlockTags[MBBNum] != Tag)
+        update(MBBNum);
+      return Blocks[MBBNum];
+    }
+
+    /// overlaps - Return true if there is interference in [Start;Stop).
+    bool overlaps(SlotIndex Start, SlotIndex Stop);
+  };
+
+private:
+  enum { CacheEntries = 32 };
+
+  const TargetRegisterInfo *TRI;
+  LiveIntervalUnion *LIUArray;
+  const MachineFunction *MF;
+  const SlotIndexes *Indexes;
+
+  /// PhysRegEntries - Map physical register to the index of the entry that
+  /// last held it. The entry may since have been given to another register.
+  SmallVector<unsigned char, 2> PhysRegEntries;
+
+  /// RoundRobin - Next entry to be replaced.
+  unsigned RoundRobin;
+
+  Entry Entries[CacheEntries];
+
+public:
+  InterferenceCache() : TRI(0), LIUArray(0), MF(0), Indexes(0), RoundRobin(0) {}
+
+  /// init - Prepare the cache for a new function. LIUArray is indexed by
+  /// physical register number.
+  void init(const MachineFunction*, LiveIntervalUnion *LIUArray,
+            const SlotIndexes*, const TargetRegisterInfo*);
+
+  /// get - Return an entry describing the current interference of PhysReg.
+  /// The entry stays valid until one of the unions of PhysReg or its aliases
+  /// is modified.
+  Entry *get(unsigned PhysReg);
+};
+
+} // namespace llvm
+
+#endif
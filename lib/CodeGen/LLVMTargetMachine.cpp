@@ -60,6 +60,8 @@ static cl::opt<bool> DisableMachineSink("disable-machine-sink", cl::Hidden,
     cl::desc("Disable Machine Sinking"));
 static cl::opt<bool> DisableLSR("disable-lsr", cl::Hidden,
     cl::desc("Disable Loop Strength Reduction Pass"));
+static cl::opt<bool> EnableLoopPrefetch("enable-loop-prefetch", cl::Hidden,
+    cl::desc("Enable software prefetching of strided loads in loops"));
 static cl::opt<bool> DisableCGP("disable-cgp", cl::Hidden,
     cl::desc("Disable Codegen Prepare"));
 static cl::opt<bool> PrintLSR("print-lsr-output", cl::Hidden,
@@ -278,6 +280,13 @@ bool LLVMTargetMachine::addCommonCodeGenPasses(PassManagerBase &PM,
     PM.add(createGVNPass(/*NoLoads=*/true));
   }
 
+  // Prefetch strided loads while their addresses are still easy to analyze.
+  // Loops with an unknown trip count are assumed not to fit in the cache, so
+  // this is only done on request.
+  if (OptLevel != CodeGenOpt::None && EnableLoopPrefetch &&
+      getTargetLowering() && getTargetLowering()->getPrefetchDistance())
+    PM.add(createLoopDataPrefetchPass(getTargetLowering()));
+
   // Run loop strength reduction before anything else.
   if (OptLevel != CodeGenOpt::None && !DisableLSR) {
     PM.add(createLoopStrengthReducePass(getTargetLowering()));
@@ -339,6 +348,7 @@ bool LLVMTargetMachine::addCommonCodeGenPasses(PassManagerBase &PM,
   MachineModuleInfo *MMI = new MachineModuleInfo(*getMCAsmInfo(), TAI);
   PM.add(MMI);
   OutContext = &MMI->getContext(); // Return the MCContext specifically by-ref.
+  OutContext->setTempSymbolTag(getMCTempSymbolTag());
 
   // Set up a MachineFunction for the rest of CodeGen to work on.
   PM.add(new MachineFunctionAnalysis(*this, OptLevel));
@@ -363,6 +373,11 @@ bool LLVMTargetMachine::addCommonCodeGenPasses(PassManagerBase &PM,
   if (OptLevel != CodeGenOpt::None)
     PM.add(createOptimizePHIsPass());
 
+  // Merge allocas with disjoint lifetimes before frame indices are resolved.
+  // Lifetime markers are only emitted when optimizing.
+  if (OptLevel != CodeGenOpt::None)
+    PM.add(createStackColoringPass());
+
   // If the target requests it, assign local variables to stack slots relative
   // to one another and simplify frame index references where possible.
   PM.add(createLocalStackSlotAllocationPass());
@@ -384,6 +399,9 @@ bool LLVMTargetMachine::addCommonCodeGenPasses(PassManagerBase &PM,
 
     PM.add(createPeepholeOptimizerPass());
     printAndVerify(PM, "After codegen peephole optimization pass");
+
+    PM.add(createMachineSchedulerPass(OptLevel));
+    printAndVerify(PM, "After Machine Scheduling");
   }
 
   // Pre-ra tail duplication.
@@ -422,7 +440,7 @@ bool LLVMTargetMachine::addCommonCodeGenPasses(PassManagerBase &PM,
   printAndVerify(PM, "After LowerSubregs");
 
   // Insert prolog/epilog code.  Eliminate abstract frame index references...
-  PM.add(createPrologEpilogCodeInserter());
+  PM.add(createPrologEpilogCodeInserter(OptLevel, getFrameLowering()));
   printAndVerify(PM, "After PrologEpilogCodeInserter");
 
   // Run pre-sched2 passes.
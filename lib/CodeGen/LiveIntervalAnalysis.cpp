@@ -18,8 +18,10 @@
 #define DEBUG_TYPE "liveintervals"
 #include "llvm/CodeGen/LiveIntervalAnalysis.h"
 #include "VirtRegMap.h"
+#include "llvm/Function.h"
 #include "llvm/Value.h"
 #include "llvm/Analysis/AliasAnalysis.h"
+#include "llvm/Analysis/ProfileInfo.h"
 #include "llvm/CodeGen/LiveVariables.h"
 #include "llvm/CodeGen/MachineFrameInfo.h"
 #include "llvm/CodeGen/MachineInstr.h"
@@ -64,6 +66,7 @@ INITIALIZE_PASS_DEPENDENCY(TwoAddressInstructionPass)
 INITIALIZE_PASS_DEPENDENCY(ProcessImplicitDefs)
 INITIALIZE_PASS_DEPENDENCY(SlotIndexes)
 INITIALIZE_AG_DEPENDENCY(AliasAnalysis)
+INITIALIZE_AG_DEPENDENCY(ProfileInfo)
 INITIALIZE_PASS_END(LiveIntervals, "liveintervals",
                 "Live Interval Analysis", false, false)
 
@@ -75,6 +78,7 @@ void LiveIntervals::getAnalysisUsage(AnalysisUsage &AU) const {
   AU.addPreserved<LiveVariables>();
   AU.addRequired<MachineLoopInfo>();
   AU.addPreserved<MachineLoopInfo>();
+  AU.addRequired<ProfileInfo>();
   AU.addPreservedID(MachineDominatorsID);
 
   if (!StrongPHIElim) {
@@ -118,6 +122,8 @@ bool LiveIntervals::runOnMachineFunction(MachineFunction &fn) {
   aa_ = &getAnalysis<AliasAnalysis>();
   lv_ = &getAnalysis<LiveVariables>();
   indexes_ = &getAnalysis<SlotIndexes>();
+  loops_ = &getAnalysis<MachineLoopInfo>();
+  profile_ = &getAnalysis<ProfileInfo>();
   allocatableRegs_ = tri_->getAllocatableSet(fn);
 
   computeIntervals();
@@ -745,7 +751,8 @@ LiveInterval* LiveIntervals::dupInterval(LiveInterval *li) {
 /// shrinkToUses - After removing some uses of a register, shrink its live
 /// range to just the remaining uses. This method does not compute reaching
 /// defs for new uses, and it doesn't remove dead defs.
-void LiveIntervals::shrinkToUses(LiveInterval *li) {
+void LiveIntervals::shrinkToUses(LiveInterval *li,
+                                 SmallVectorImpl<MachineInstr*> *dead) {
   DEBUG(dbgs() << "Shrink: " << *li << '\n');
   assert(TargetRegisterInfo::isVirtualRegister(li->reg)
          && "Can't only shrink physical registers");
@@ -846,7 +853,7 @@ void LiveIntervals::shrinkToUses(LiveInterval *li) {
     assert(LII != NewLI.end() && "Missing live range for PHI");
     if (LII->end != VNI->def.getNextSlot())
       continue;
-    if (!VNI->isPHIDef()) {
+    if (VNI->isPHIDef()) {
       // This is a dead PHI. Remove it.
       VNI->setIsUnused(true);
       NewLI.removeRange(*LII);
@@ -855,6 +862,10 @@ void LiveIntervals::shrinkToUses(LiveInterval *li) {
       MachineInstr *MI = getInstructionFromIndex(VNI->def);
       assert(MI && "No instruction defining live value");
       MI->addRegisterDead(li->reg, tri_);
+      if (dead && MI->allDefsAreDead()) {
+        DEBUG(dbgs() << "All defs dead: " << VNI->def << '\t' << *MI);
+        dead->push_back(MI);
+      }
     }
   }
 
@@ -1612,8 +1623,8 @@ rewriteInstructionsForSpills(const LiveInterval &li, bool TrySplit,
     }
 
     // Update spill weight.
-    unsigned loopDepth = loopInfo->getLoopDepth(MBB);
-    nI.weight += getSpillWeight(HasDef, HasUse, loopDepth);
+    float freq = getBlockFrequency(MBB, *loopInfo, profile_);
+    nI.weight += (HasDef + HasUse) * freq;
   }
 
   if (NewVReg && TrySplit && AllCanFold) {
@@ -1706,6 +1717,47 @@ LiveIntervals::getSpillWeight(bool isDef, bool isUse, unsigned loopDepth) {
   return (isDef + isUse) * lc;
 }
 
+/// getProfiledCount - Return the number of times mbb was executed according to
+/// profile, or ProfileInfo::MissingValue if the profile doesn't know.
+static double getProfiledCount(const MachineBasicBlock *mbb,
+                               ProfileInfo &profile) {
+  if (const BasicBlock *bb = mbb->getBasicBlock())
+    return profile.getExecutionCount(bb);
+
+  // Blocks created by the code generator, like split critical edges, have no
+  // IR counterpart. They run at most as often as their only predecessor and
+  // their only successor.
+  double count = ProfileInfo::MissingValue;
+  if (mbb->pred_size() == 1)
+    if (const BasicBlock *bb = (*mbb->pred_begin())->getBasicBlock())
+      count = profile.getExecutionCount(bb);
+  if (mbb->succ_size() == 1)
+    if (const BasicBlock *bb = (*mbb->succ_begin())->getBasicBlock()) {
+      double succCount = profile.getExecutionCount(bb);
+      if (count < 0 || (succCount >= 0 && succCount < count))
+        count = succCount;
+    }
+  return count;
+}
+
+float LiveIntervals::getBlockFrequency(const MachineBasicBlock *mbb,
+                                       const MachineLoopInfo &loops,
+                                       ProfileInfo *profile) {
+  if (profile) {
+    // Functions that never ran in the profiled workload have nothing to say
+    // about their blocks.
+    const Function *fn = mbb->getParent()->getFunction();
+    double entry = profile->getExecutionCount(&fn->getEntryBlock());
+    double count = entry > 0 ? getProfiledCount(mbb, *profile)
+                             : ProfileInfo::MissingValue;
+    // Keep cold blocks slightly above zero. A zero frequency would make the
+    // uses in them free, and spill placement divides by bundle frequencies.
+    if (count >= 0)
+      return std::max(float(count / entry), 1.0f / 1024);
+  }
+  return getSpillWeight(true, false, loops.getLoopDepth(mbb));
+}
+
 void
 LiveIntervals::normalizeSpillWeights(std::vector<LiveInterval*> &NewLIs) {
   for (unsigned i = 0, e = NewLIs.size(); i != e; ++i)
@@ -16,6 +16,9 @@
 #include "llvm/CodeGen/LiveIntervalAnalysis.h"
 #include "llvm/CodeGen/MachineRegisterInfo.h"
 #include "llvm/Target/TargetInstrInfo.h"
+#include "llvm/ADT/SetVector.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/raw_ostream.h"
 
 using namespace llvm;
 
@@ -126,3 +129,70 @@ SlotIndex LiveRangeEdit::rematerializeAt(MachineBasicBlock &MBB,
   return lis.InsertMachineInstrInMaps(--MI).getDefIndex();
 }
 
+void LiveRangeEdit::eliminateDeadDefs(SmallVectorImpl<MachineInstr*> &Dead,
+                                      LiveIntervals &lis, VirtRegMap &vrm,
+                                      const TargetInstrInfo &tii) {
+  SetVector<LiveInterval*,
+            SmallVector<LiveInterval*, 8>,
+            SmallPtrSet<LiveInterval*, 8> > ToShrink;
+
+  for (;;) {
+    // Erase all dead defs.
+    while (!Dead.empty()) {
+      MachineInstr *MI = Dead.pop_back_val();
+      if (!MI->allDefsAreDead())
+        continue;
+
+      // Never delete inline asm.
+      if (MI->isInlineAsm())
+        continue;
+
+      // Use the same criteria as DeadMachineInstructionElim.
+      bool SawStore = false;
+      if (!MI->isSafeToMove(&tii, 0, SawStore))
+        continue;
+
+      // The segments of assigned registers are in the allocator's interference
+      // structures, so their defs have to stay.
+      bool DefinesAssigned = false;
+      for (unsigned i = 0, e = MI->getNumOperands(); i != e; ++i) {
+        const MachineOperand &MO = MI->getOperand(i);
+        if (MO.isReg() && MO.isDef() &&
+            TargetRegisterInfo::isVirtualRegister(MO.getReg()) &&
+            vrm.hasPhys(MO.getReg()))
+          DefinesAssigned = true;
+      }
+      if (DefinesAssigned)
+        continue;
+
+      SlotIndex Idx = lis.getInstructionIndex(MI).getDefIndex();
+      DEBUG(dbgs() << "Deleting dead def " << Idx << '\t' << *MI);
+
+      // Remove the defined values, and remember the intervals that may shrink.
+      for (unsigned i = 0, e = MI->getNumOperands(); i != e; ++i) {
+        const MachineOperand &MO = MI->getOperand(i);
+        if (!MO.isReg() || !TargetRegisterInfo::isVirtualRegister(MO.getReg()))
+          continue;
+        LiveInterval &LI = lis.getInterval(MO.getReg());
+        if (MO.isDef()) {
+          SlotIndex DefIdx = MO.isEarlyClobber() ? Idx.getUseIndex() : Idx;
+          if (VNInfo *VNI = LI.getVNInfoAt(DefIdx))
+            LI.removeValNo(VNI);
+        } else if (!MO.isUndef() && !vrm.hasPhys(LI.reg))
+          ToShrink.insert(&LI);
+      }
+
+      lis.RemoveMachineInstrFromMaps(MI);
+      vrm.RemoveMachineInstrFromMaps(MI);
+      MI->eraseFromParent();
+    }
+
+    if (ToShrink.empty())
+      break;
+
+    // Shrink just one live interval. Then delete new dead defs.
+    LiveInterval *LI = ToShrink.back();
+    ToShrink.pop_back();
+    lis.shrinkToUses(LI, &Dead);
+  }
+}
@@ -128,6 +128,15 @@ public:
   bool didRematerialize(VNInfo *ParentVNI) const {
     return rematted_.count(ParentVNI);
   }
+
+  /// eliminateDeadDefs - Try to delete machine instructions that are now dead
+  /// (allDefsAreDead returns true). The values they define are removed, and
+  /// the live intervals of the registers they read are shrunk one at a time.
+  /// Instructions that become dead in the process are deleted too.
+  /// Intervals of registers that are already assigned are left alone.
+  void eliminateDeadDefs(SmallVectorImpl<MachineInstr*> &Dead,
+                         LiveIntervals&, VirtRegMap&,
+                         const TargetInstrInfo&);
 };
 
 }
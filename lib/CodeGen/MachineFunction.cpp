@@ -477,8 +477,8 @@ MachineFrameInfo::getPristineRegs(const MachineBasicBlock *MBB) const {
   for (const unsigned *CSR = TRI->getCalleeSavedRegs(MF); CSR && *CSR; ++CSR)
     BV.set(*CSR);
 
-  // The entry MBB always has all CSRs pristine.
-  if (MBB == &MF->front())
+  // The entry MBB and the save point always have all CSRs pristine.
+  if (MBB == &MF->front() || MBB == SavePoint)
     return BV;
 
   // On other MBBs the saved CSRs are not pristine.
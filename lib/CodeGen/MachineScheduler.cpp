@@ -0,0 +1,900 @@
+//===-- MachineScheduler.cpp - Pre-RA machine instruction scheduler -------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This implements a bottom-up list scheduler for MachineInstrs that runs
+// before register allocation, after MachineLICM and MachineSinking have moved
+// code between blocks.  The SelectionDAG schedulers only see one DAG at a
+// time; this pass sees the final contents of each block, including copies of
+// the live-ins and the code that was hoisted or sunk into it.
+//
+// The scheduler tracks the number of live virtual registers in each
+// representative register class against the target's register pressure
+// limits, as the SelectionDAG schedulers do.  While every class is below its
+// limit, it hides latency: it picks instructions whose results are ready,
+// honoring the target's hazard recognizer, and prefers the ones on the
+// critical path.  Once a class reaches its limit, it stops waiting on
+// latencies and picks whichever instruction keeps the most values from
+// becoming live.
+//
+// Blocks are scheduled one region at a time, the same way the post-RA
+// scheduler does it.  Liveness of virtual registers is computed for the
+// whole function up front, so values that are live through a region count
+// toward its pressure.  Within an extended basic block, i.e. across the edge
+// to a successor with a single predecessor, the scheduler also accounts for
+// the successor's use of values defined at the bottom of the predecessor, so
+// long-latency instructions feeding that code are started early.  No code is
+// moved between blocks.
+//
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "misched"
+#include "ScheduleDAGInstrs.h"
+#include "llvm/CodeGen/Passes.h"
+#include "llvm/CodeGen/MachineDominators.h"
+#include "llvm/CodeGen/MachineFunctionPass.h"
+#include "llvm/CodeGen/MachineLoopInfo.h"
+#include "llvm/CodeGen/MachineRegisterInfo.h"
+#include "llvm/CodeGen/ScheduleHazardRecognizer.h"
+#include "llvm/Analysis/AliasAnalysis.h"
+#include "llvm/Target/TargetLowering.h"
+#include "llvm/Target/TargetMachine.h"
+#include "llvm/Target/TargetInstrInfo.h"
+#include "llvm/Target/TargetRegisterInfo.h"
+#include "llvm/Target/TargetSubtarget.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/SmallSet.h"
+#include "llvm/ADT/Statistic.h"
+#include <algorithm>
+using namespace llvm;
+
+STATISTIC(NumRegions,       "Number of regions scheduled");
+STATISTIC(NumHighPressure,  "Number of nodes scheduled for register pressure");
+STATISTIC(NumStalls,        "Number of pipeline stalls");
+
+// Machine instruction scheduling is enabled with
+// TargetSubtarget.enableMachineScheduler().  This flag can be used to
+// override the target.
+static cl::opt<bool>
+EnableMachineScheduler("enable-misched",
+                       cl::desc("Enable the pre-RA machine instruction "
+                                "scheduler"),
+                       cl::init(false), cl::Hidden);
+
+// How far into a single-predecessor successor the scheduler looks for uses
+// of values defined at the bottom of a block.
+static cl::opt<unsigned>
+EBBLookahead("misched-ebb-lookahead",
+             cl::desc("Number of instructions of a successor in the same "
+                      "extended basic block to consider when scheduling"),
+             cl::init(8), cl::Hidden);
+
+namespace {
+  class MachineScheduler : public MachineFunctionPass {
+    CodeGenOpt::Level OptLevel;
+
+  public:
+    static char ID;
+    MachineScheduler(CodeGenOpt::Level ol = CodeGenOpt::Default)
+      : MachineFunctionPass(ID), OptLevel(ol) {
+      initializeMachineSchedulerPass(*PassRegistry::getPassRegistry());
+    }
+
+    void getAnalysisUsage(AnalysisUsage &AU) const {
+      AU.setPreservesCFG();
+      AU.addRequired<AliasAnalysis>();
+      AU.addRequired<MachineDominatorTree>();
+      AU.addPreserved<MachineDominatorTree>();
+      AU.addRequired<MachineLoopInfo>();
+      AU.addPreserved<MachineLoopInfo>();
+      MachineFunctionPass::getAnalysisUsage(AU);
+    }
+
+    const char *getPassName() const {
+      return "Pre-RA machine instruction scheduler";
+    }
+
+    bool runOnMachineFunction(MachineFunction &Fn);
+  };
+  char MachineScheduler::ID = 0;
+
+  class ScheduleDAGMI : public ScheduleDAGInstrs {
+    AliasAnalysis *AA;
+    const TargetLowering *TLI;
+
+    /// HazardRec - The hazard recognizer to use.
+    ScheduleHazardRecognizer *HazardRec;
+
+    /// LiveOuts - The virtual registers live out of each block, by block
+    /// number.
+    std::vector<std::vector<unsigned> > LiveOuts;
+
+    /// RCRepID, RCCost - The representative register class of each register
+    /// class, by class ID, and the pressure one register of the class puts on
+    /// it.  RegLimit is the target's register pressure limit for each
+    /// representative class, zero if the class is not tracked, and
+    /// RegPressure the pressure at the current scheduling point.
+    std::vector<unsigned> RCRepID;
+    std::vector<unsigned> RCCost;
+    std::vector<unsigned> RegLimit;
+    std::vector<unsigned> RegPressure;
+
+    /// LiveVRegs - The virtual registers live at the current scheduling
+    /// point, which moves up the block as instructions are scheduled.
+    DenseSet<unsigned> LiveVRegs;
+
+    /// LivePhysRegs - Physical registers that are read below the current
+    /// scheduling point and not yet defined.  Instructions that define them
+    /// are scheduled as soon as possible, so live ranges of physical
+    /// registers stay short.
+    BitVector LivePhysRegs;
+
+    /// RegionPhysDefs - Physical registers that are defined in the current
+    /// region.
+    BitVector RegionPhysDefs;
+
+    /// RegionVRegDefs - Virtual registers defined in the current region.
+    DenseSet<unsigned> RegionVRegDefs;
+
+    /// Reserved - The reserved physical registers, which are never tracked.
+    BitVector Reserved;
+
+    /// KillSegments - For each register killed in the current region, which
+    /// of its live segments end with a kill, counting defs from the bottom of
+    /// the region.  Defs and uses of a register keep their relative order, so
+    /// after scheduling the kill flag moves to the last use of each segment.
+    DenseMap<unsigned, SmallVector<bool, 2> > KillSegments;
+
+    /// Available - Nodes whose successors have all been scheduled and whose
+    /// results are ready at the current cycle.  Pending - Nodes whose
+    /// successors have all been scheduled but which would stall them.
+    std::vector<SUnit*> Available;
+    std::vector<SUnit*> Pending;
+
+    /// CurCycle - The number of cycles from the bottom of the region.
+    unsigned CurCycle;
+
+  public:
+    ScheduleDAGMI(MachineFunction &MF, MachineLoopInfo &MLI,
+                  MachineDominatorTree &MDT, AliasAnalysis *AA);
+
+    ~ScheduleDAGMI();
+
+    /// computeLiveOuts - Compute the virtual registers live out of each block
+    /// of the function.
+    void computeLiveOuts();
+
+    /// StartBlock - Initialize register liveness for scheduling in this
+    /// block.
+    void StartBlock(MachineBasicBlock *BB);
+
+    /// Schedule - Schedule the instruction range using list scheduling.
+    void Schedule();
+
+    /// Observe - Update liveness to account for the current instruction,
+    /// which will not be scheduled.
+    void Observe(MachineInstr *MI);
+
+    /// EmitSchedule - Emit the schedule and restore the kill flags of the
+    /// region.
+    MachineBasicBlock *EmitSchedule();
+
+  private:
+    void getRegClassInfo(unsigned Reg, unsigned &RCId, unsigned &Cost) const;
+    void addLiveVReg(unsigned Reg);
+    void removeLiveVReg(unsigned Reg);
+    void updateLiveness(MachineInstr *MI);
+    bool isHighPressure() const;
+    int getPressureCost(const SUnit *SU, int &Delta) const;
+    bool definesLivePhysReg(const SUnit *SU) const;
+    bool readsLiveInPhysReg(const SUnit *SU) const;
+    bool isPhysRegUseDeferred(const SUnit *SU) const;
+    bool isBetter(SUnit *A, SUnit *B, bool HighPressure) const;
+    void addEBBDeps();
+    void releasePredecessors(SUnit *SU);
+    void advanceCycle();
+    SUnit *pickNode(bool HighPressure, bool AllowDeferred);
+    void scheduleNodeBottomUp(SUnit *SU);
+    void listScheduleBottomUp();
+    void fixupKills();
+  };
+}
+
+INITIALIZE_PASS_BEGIN(MachineScheduler, "machine-scheduler",
+                      "Pre-RA machine instruction scheduler", false, false)
+INITIALIZE_AG_DEPENDENCY(AliasAnalysis)
+INITIALIZE_PASS_DEPENDENCY(MachineDominatorTree)
+INITIALIZE_PASS_DEPENDENCY(MachineLoopInfo)
+INITIALIZE_PASS_END(MachineScheduler, "machine-scheduler",
+                    "Pre-RA machine instruction scheduler", false, false)
+
+FunctionPass *llvm::createMachineSchedulerPass(CodeGenOpt::Level OptLevel) {
+  return new MachineScheduler(OptLevel);
+}
+
+bool MachineScheduler::runOnMachineFunction(MachineFunction &Fn) {
+  // Check for explicit enable/disable of machine instruction scheduling.
+  if (EnableMachineScheduler.getPosition() > 0) {
+    if (!EnableMachineScheduler)
+      return false;
+  } else {
+    const TargetSubtarget &ST = Fn.getTarget().getSubtarget<TargetSubtarget>();
+    if (!ST.enableMachineScheduler(OptLevel))
+      return false;
+  }
+
+  DEBUG(dbgs() << "MachineScheduler: " << Fn.getFunction()->getName()
+               << '\n');
+
+  const TargetInstrInfo *TII = Fn.getTarget().getInstrInfo();
+  MachineLoopInfo &MLI = getAnalysis<MachineLoopInfo>();
+  MachineDominatorTree &MDT = getAnalysis<MachineDominatorTree>();
+  AliasAnalysis *AA = &getAnalysis<AliasAnalysis>();
+
+  ScheduleDAGMI Scheduler(Fn, MLI, MDT, AA);
+  Scheduler.computeLiveOuts();
+
+  for (MachineFunction::iterator MBB = Fn.begin(), MBBe = Fn.end();
+       MBB != MBBe; ++MBB) {
+    Scheduler.StartBlock(MBB);
+
+    // Schedule each sequence of instructions not interrupted by a PHI, a
+    // label or anything else that effectively needs to shut down
+    // scheduling.
+    MachineBasicBlock::iterator Current = MBB->end();
+    unsigned Count = MBB->size(), CurrentCount = Count;
+    for (MachineBasicBlock::iterator I = Current; I != MBB->begin(); ) {
+      MachineInstr *MI = llvm::prior(I);
+      if (MI->isPHI() || TII->isSchedulingBoundary(MI, MBB, Fn)) {
+        Scheduler.Run(MBB, I, Current, CurrentCount);
+        Scheduler.EmitSchedule();
+        Current = MI;
+        CurrentCount = Count - 1;
+        Scheduler.Observe(MI);
+      }
+      I = MI;
+      --Count;
+    }
+    assert(Count == 0 && "Instruction count mismatch!");
+    assert((MBB->begin() == Current || CurrentCount != 0) &&
+           "Instruction count mismatch!");
+    Scheduler.Run(MBB, MBB->begin(), Current, CurrentCount);
+    Scheduler.EmitSchedule();
+
+    Scheduler.FinishBlock();
+  }
+
+  return true;
+}
+
+ScheduleDAGMI::ScheduleDAGMI(MachineFunction &MF, MachineLoopInfo &MLI,
+                             MachineDominatorTree &MDT, AliasAnalysis *AA)
+  : ScheduleDAGInstrs(MF, MLI, MDT), AA(AA), TLI(TM.getTargetLowering()),
+    LivePhysRegs(TRI->getNumRegs()), RegionPhysDefs(TRI->getNumRegs()),
+    Reserved(TRI->getReservedRegs(MF)), CurCycle(0) {
+  HazardRec = TII->CreateTargetHazardRecognizer(&TM, this);
+
+  // Map every register class to the representative class of its first value
+  // type, the same classes the SelectionDAG schedulers track.  Classes whose
+  // type is not legal, e.g. condition codes, are tracked by themselves.
+  unsigned NumRC = TRI->getNumRegClasses();
+  RCRepID.resize(NumRC);
+  RCCost.resize(NumRC);
+  RegLimit.assign(NumRC, 0);
+  RegPressure.assign(NumRC, 0);
+  for (TargetRegisterInfo::regclass_iterator I = TRI->regclass_begin(),
+         E = TRI->regclass_end(); I != E; ++I) {
+    const TargetRegisterClass *RC = *I;
+    const TargetRegisterClass *RepRC = RC;
+    unsigned Cost = 1;
+    EVT VT = *RC->vt_begin();
+    if (VT != MVT::Other && TLI->isTypeLegal(VT) && TLI->getRepRegClassFor(VT)) {
+      RepRC = TLI->getRepRegClassFor(VT);
+      Cost = TLI->getRepRegClassCostFor(VT);
+    }
+    RCRepID[RC->getID()] = RepRC->getID();
+    RCCost[RC->getID()] = Cost;
+    RegLimit[RC->getID()] = TLI->getRegPressureLimit(RC, MF);
+  }
+}
+
+ScheduleDAGMI::~ScheduleDAGMI() {
+  delete HazardRec;
+}
+
+/// computeLiveOuts - Compute the virtual registers live out of each block.
+/// Each register is followed upwards from its uses until its defining blocks
+/// are reached; a use by a PHI makes the register live out of the
+/// corresponding predecessor.
+void ScheduleDAGMI::computeLiveOuts() {
+  unsigned NumBlocks = MF.getNumBlockIDs();
+  LiveOuts.assign(NumBlocks, std::vector<unsigned>());
+  std::vector<unsigned> InStamp(NumBlocks, 0), OutStamp(NumBlocks, 0);
+  SmallVector<MachineBasicBlock*, 4> DefBlocks;
+  SmallVector<MachineBasicBlock*, 16> Worklist;
+
+  for (unsigned i = 0, e = MRI.getNumVirtRegs(); i != e; ++i) {
+    unsigned Reg = TargetRegisterInfo::index2VirtReg(i);
+    unsigned Stamp = i + 1;
+
+    DefBlocks.clear();
+    for (MachineRegisterInfo::def_iterator DI = MRI.def_begin(Reg),
+           DE = MRI.def_end(); DI != DE; ++DI)
+      if (std::find(DefBlocks.begin(), DefBlocks.end(),
+                    DI->getParent()) == DefBlocks.end())
+        DefBlocks.push_back(DI->getParent());
+    if (DefBlocks.empty())
+      continue;
+
+    for (MachineRegisterInfo::use_nodbg_iterator UI = MRI.use_nodbg_begin(Reg),
+           UE = MRI.use_nodbg_end(); UI != UE; ++UI) {
+      MachineInstr *UseMI = &*UI;
+      if (UseMI->isPHI()) {
+        MachineBasicBlock *Pred =
+          UseMI->getOperand(UI.getOperandNo() + 1).getMBB();
+        if (OutStamp[Pred->getNumber()] == Stamp)
+          continue;
+        OutStamp[Pred->getNumber()] = Stamp;
+        LiveOuts[Pred->getNumber()].push_back(Reg);
+        if (std::find(DefBlocks.begin(), DefBlocks.end(),
+                      Pred) == DefBlocks.end() &&
+            InStamp[Pred->getNumber()] != Stamp) {
+          InStamp[Pred->getNumber()] = Stamp;
+          Worklist.push_back(Pred);
+        }
+        continue;
+      }
+      MachineBasicBlock *UseMBB = UseMI->getParent();
+      if (std::find(DefBlocks.begin(), DefBlocks.end(),
+                    UseMBB) != DefBlocks.end() ||
+          InStamp[UseMBB->getNumber()] == Stamp)
+        continue;
+      InStamp[UseMBB->getNumber()] = Stamp;
+      Worklist.push_back(UseMBB);
+    }
+
+    // Every block on the worklist has Reg live in.
+    while (!Worklist.empty()) {
+      MachineBasicBlock *MBB = Worklist.pop_back_val();
+      for (MachineBasicBlock::pred_iterator PI = MBB->pred_begin(),
+             PE = MBB->pred_end(); PI != PE; ++PI) {
+        MachineBasicBlock *Pred = *PI;
+        if (OutStamp[Pred->getNumber()] == Stamp)
+          continue;
+        OutStamp[Pred->getNumber()] = Stamp;
+        LiveOuts[Pred->getNumber()].push_back(Reg);
+        if (std::find(DefBlocks.begin(), DefBlocks.end(),
+                      Pred) == DefBlocks.end() &&
+            InStamp[Pred->getNumber()] != Stamp) {
+          InStamp[Pred->getNumber()] = Stamp;
+          Worklist.push_back(Pred);
+        }
+      }
+    }
+  }
+}
+
+/// StartBlock - Initialize register liveness for scheduling in this block.
+void ScheduleDAGMI::StartBlock(MachineBasicBlock *BB) {
+  ScheduleDAGInstrs::StartBlock(BB);
+  HazardRec->Reset();
+
+  LiveVRegs.clear();
+  std::fill(RegPressure.begin(), RegPressure.end(), 0);
+  const std::vector<unsigned> &LiveOut = LiveOuts[BB->getNumber()];
+  for (unsigned i = 0, e = LiveOut.size(); i != e; ++i)
+    addLiveVReg(LiveOut[i]);
+
+  // Physical registers live out of the block are already pinned; there is
+  // nothing to gain from moving their defs.
+  LivePhysRegs.reset();
+}
+
+void ScheduleDAGMI::getRegClassInfo(unsigned Reg, unsigned &RCId,
+                                    unsigned &Cost) const {
+  unsigned Id = MRI.getRegClass(Reg)->getID();
+  RCId = RCRepID[Id];
+  Cost = RCCost[Id];
+}
+
+void ScheduleDAGMI::addLiveVReg(unsigned Reg) {
+  if (!LiveVRegs.insert(Reg).second)
+    return;
+  unsigned RCId, Cost;
+  getRegClassInfo(Reg, RCId, Cost);
+  RegPressure[RCId] += Cost;
+}
+
+void ScheduleDAGMI::removeLiveVReg(unsigned Reg) {
+  if (!LiveVRegs.erase(Reg))
+    return;
+  unsigned RCId, Cost;
+  getRegClassInfo(Reg, RCId, Cost);
+  RegPressure[RCId] -= std::min(RegPressure[RCId], Cost);
+}
+
+/// updateLiveness - Move the current scheduling point above MI: its defs
+/// are no longer live and its uses are.
+void ScheduleDAGMI::updateLiveness(MachineInstr *MI) {
+  for (unsigned i = 0, e = MI->getNumOperands(); i != e; ++i) {
+    const MachineOperand &MO = MI->getOperand(i);
+    if (!MO.isReg() || !MO.isDef() || !MO.getReg())
+      continue;
+    unsigned Reg = MO.getReg();
+    if (TargetRegisterInfo::isVirtualRegister(Reg)) {
+      removeLiveVReg(Reg);
+    } else {
+      LivePhysRegs.reset(Reg);
+      for (const unsigned *Alias = TRI->getAliasSet(Reg); *Alias; ++Alias)
+        LivePhysRegs.reset(*Alias);
+    }
+  }
+  for (unsigned i = 0, e = MI->getNumOperands(); i != e; ++i) {
+    const MachineOperand &MO = MI->getOperand(i);
+    if (!MO.isReg() || !MO.isUse() || MO.isUndef() || !MO.getReg())
+      continue;
+    unsigned Reg = MO.getReg();
+    if (TargetRegisterInfo::isVirtualRegister(Reg)) {
+      addLiveVReg(Reg);
+    } else if (!Reserved.test(Reg)) {
+      LivePhysRegs.set(Reg);
+      for (const unsigned *Alias = TRI->getAliasSet(Reg); *Alias; ++Alias)
+        LivePhysRegs.set(*Alias);
+    }
+  }
+}
+
+/// Observe - Update liveness to account for the current instruction, which
+/// will not be scheduled.
+void ScheduleDAGMI::Observe(MachineInstr *MI) {
+  updateLiveness(MI);
+}
+
+/// isHighPressure - Return true if some register class is at its limit at the
+/// current scheduling point.
+bool ScheduleDAGMI::isHighPressure() const {
+  for (unsigned i = 0, e = RegPressure.size(); i != e; ++i)
+    if (RegLimit[i] && RegPressure[i] >= RegLimit[i])
+      return true;
+  return false;
+}
+
+/// getPressureCost - Return by how much scheduling SU at the current point
+/// would increase the number of live registers in excess of the limits, and
+/// in Delta the change in the total number of live registers.
+int ScheduleDAGMI::getPressureCost(const SUnit *SU, int &Delta) const {
+  SmallVector<std::pair<unsigned, int>, 4> RCDeltas;
+  MachineInstr *MI = SU->getInstr();
+  for (unsigned i = 0, e = MI->getNumOperands(); i != e; ++i) {
+    const MachineOperand &MO = MI->getOperand(i);
+    if (!MO.isReg() || !MO.getReg() || MO.isUndef() ||
+        !TargetRegisterInfo::isVirtualRegister(MO.getReg()))
+      continue;
+    unsigned Reg = MO.getReg();
+    int Change;
+    if (MO.isDef()) {
+      // The def ends the live range, unless the register is also read here.
+      if (!LiveVRegs.count(Reg) || MI->readsVirtualRegister(Reg))
+        continue;
+      Change = -1;
+    } else {
+      // The use starts a live range, once per register.  Registers defined
+      // above the region are live at its top whichever use comes first.
+      if (LiveVRegs.count(Reg) || !RegionVRegDefs.count(Reg) ||
+          MI->findRegisterUseOperandIdx(Reg) != (int)i)
+        continue;
+      Change = 1;
+    }
+    unsigned RCId, Cost;
+    getRegClassInfo(Reg, RCId, Cost);
+    unsigned j = 0, je = RCDeltas.size();
+    for (; j != je; ++j)
+      if (RCDeltas[j].first == RCId)
+        break;
+    if (j == je)
+      RCDeltas.push_back(std::make_pair(RCId, 0));
+    RCDeltas[j].second += Change * (int)Cost;
+  }
+
+  int Excess = 0;
+  Delta = 0;
+  for (unsigned j = 0, je = RCDeltas.size(); j != je; ++j) {
+    int Limit = RegLimit[RCDeltas[j].first];
+    if (Limit == 0)
+      continue;
+    int Before = RegPressure[RCDeltas[j].first];
+    int After = Before + RCDeltas[j].second;
+    Excess += std::max(After - Limit, 0) - std::max(Before - Limit, 0);
+    Delta += RCDeltas[j].second;
+  }
+  return Excess;
+}
+
+/// definesLivePhysReg - Return true if SU defines a physical register that
+/// is read below the current scheduling point, e.g. an argument copy.
+bool ScheduleDAGMI::definesLivePhysReg(const SUnit *SU) const {
+  MachineInstr *MI = SU->getInstr();
+  for (unsigned i = 0, e = MI->getNumOperands(); i != e; ++i) {
+    const MachineOperand &MO = MI->getOperand(i);
+    if (MO.isReg() && MO.isDef() && !MO.isDead() && MO.getReg() &&
+        TargetRegisterInfo::isPhysicalRegister(MO.getReg()) &&
+        LivePhysRegs.test(MO.getReg()))
+      return true;
+  }
+  return false;
+}
+
+/// readsLiveInPhysReg - Return true if SU reads a physical register that is
+/// not defined in the region, e.g. a copy of an incoming argument.
+bool ScheduleDAGMI::readsLiveInPhysReg(const SUnit *SU) const {
+  MachineInstr *MI = SU->getInstr();
+  for (unsigned i = 0, e = MI->getNumOperands(); i != e; ++i) {
+    const MachineOperand &MO = MI->getOperand(i);
+    if (MO.isReg() && MO.isUse() && MO.getReg() &&
+        TargetRegisterInfo::isPhysicalRegister(MO.getReg()) &&
+        !Reserved.test(MO.getReg()) && !RegionPhysDefs.test(MO.getReg()))
+      return true;
+  }
+  return false;
+}
+
+/// isPhysRegUseDeferred - Return true if SU reads a physical register whose
+/// def in the region still has other successors to wait for.  Scheduling SU
+/// now would leave the register live across those successors, where the
+/// register allocator cannot use it.
+bool ScheduleDAGMI::isPhysRegUseDeferred(const SUnit *SU) const {
+  for (SUnit::const_pred_iterator I = SU->Preds.begin(), E = SU->Preds.end();
+       I != E; ++I)
+    if (I->getKind() == SDep::Data && I->getReg() &&
+        TargetRegisterInfo::isPhysicalRegister(I->getReg()) &&
+        I->getSUnit()->NumSuccsLeft > 1)
+      return true;
+  return false;
+}
+
+/// isBetter - Return true if A should be scheduled above B, i.e. before it in
+/// the bottom-up order.
+bool ScheduleDAGMI::isBetter(SUnit *A, SUnit *B, bool HighPressure) const {
+  // Keep the defs of physical registers next to their uses.
+  bool ADefPhys = definesLivePhysReg(A), BDefPhys = definesLivePhysReg(B);
+  if (ADefPhys != BDefPhys)
+    return ADefPhys;
+
+  // Keep reads of incoming physical registers at the top of the region.
+  bool AReadsLiveIn = readsLiveInPhysReg(A);
+  bool BReadsLiveIn = readsLiveInPhysReg(B);
+  if (AReadsLiveIn != BReadsLiveIn)
+    return !AReadsLiveIn;
+
+  int ADelta, BDelta;
+  int ACost = getPressureCost(A, ADelta);
+  int BCost = getPressureCost(B, BDelta);
+  if (ACost != BCost)
+    return ACost < BCost;
+
+  // Under pressure, finish the shallower expression first: its operands are
+  // the ones that die soonest.  Otherwise prefer the node on the longer path
+  // from the top of the region; it is the one that has to start early.
+  if (HighPressure) {
+    if (ADelta != BDelta)
+      return ADelta < BDelta;
+    if (A->getDepth() != B->getDepth())
+      return A->getDepth() < B->getDepth();
+  } else if (A->getDepth() != B->getDepth()) {
+    return A->getDepth() > B->getDepth();
+  }
+
+  if (ADelta != BDelta)
+    return ADelta < BDelta;
+
+  // Otherwise keep the original order.
+  return A->NodeNum < B->NodeNum;
+}
+
+/// addEBBDeps - If the region is at the bottom of its block, make the exit
+/// wait for the values the successors in the same extended basic block read
+/// near their tops.  A successor with a single predecessor starts executing
+/// right after the region, so such a value should be computed early enough
+/// for its latency to be hidden by the region.
+void ScheduleDAGMI::addEBBDeps() {
+  if (InsertPos != BB->end() && InsertPos != BB->getFirstTerminator())
+    return;
+
+  DenseMap<unsigned, SUnit*> VRegDefSU;
+  for (unsigned i = 0, e = SUnits.size(); i != e; ++i) {
+    MachineInstr *MI = SUnits[i].getInstr();
+    for (unsigned j = 0, je = MI->getNumOperands(); j != je; ++j) {
+      const MachineOperand &MO = MI->getOperand(j);
+      if (MO.isReg() && MO.isDef() && MO.getReg() &&
+          TargetRegisterInfo::isVirtualRegister(MO.getReg()))
+        VRegDefSU[MO.getReg()] = &SUnits[i];
+    }
+  }
+  if (VRegDefSU.empty())
+    return;
+
+  for (MachineBasicBlock::succ_iterator SI = BB->succ_begin(),
+         SE = BB->succ_end(); SI != SE; ++SI) {
+    MachineBasicBlock *Succ = *SI;
+    if (Succ->pred_size() != 1)
+      continue;
+    unsigned Distance = 0;
+    for (MachineBasicBlock::iterator I = Succ->begin(), E = Succ->end();
+         I != E && Distance < EBBLookahead; ++I) {
+      if (I->isPHI() || I->isDebugValue())
+        continue;
+      for (unsigned j = 0, je = I->getNumOperands(); j != je; ++j) {
+        const MachineOperand &MO = I->getOperand(j);
+        if (!MO.isReg() || !MO.isUse() || !MO.getReg() ||
+            !TargetRegisterInfo::isVirtualRegister(MO.getReg()))
+          continue;
+        DenseMap<unsigned, SUnit*>::iterator DI = VRegDefSU.find(MO.getReg());
+        if (DI == VRegDefSU.end())
+          continue;
+        SUnit *DefSU = DI->second;
+        if (DefSU->Latency > Distance + 1)
+          ExitSU.addPred(SDep(DefSU, SDep::Order,
+                              DefSU->Latency - Distance - 1,
+                              /*Reg=*/0, /*isNormalMemory=*/false,
+                              /*isMustAlias=*/false, /*isArtificial=*/true));
+      }
+      ++Distance;
+    }
+  }
+}
+
+/// releasePredecessors - Decrement the successor count of SU's predecessors
+/// and move the ones that become free to the pending list.
+void ScheduleDAGMI::releasePredecessors(SUnit *SU) {
+  for (SUnit::pred_iterator I = SU->Preds.begin(), E = SU->Preds.end();
+       I != E; ++I) {
+    SUnit *PredSU = I->getSUnit();
+#ifndef NDEBUG
+    if (PredSU->NumSuccsLeft == 0) {
+      dbgs() << "*** Scheduling failed! ***\n";
+      PredSU->dump(this);
+      dbgs() << " has been released too many times!\n";
+      llvm_unreachable(0);
+    }
+#endif
+    --PredSU->NumSuccsLeft;
+    PredSU->setHeightToAtLeast(SU->getHeight() + I->getLatency());
+    if (PredSU->NumSuccsLeft == 0 && PredSU != &EntrySU)
+      Pending.push_back(PredSU);
+  }
+}
+
+void ScheduleDAGMI::advanceCycle() {
+  HazardRec->RecedeCycle();
+  ++CurCycle;
+
+  // Move the nodes whose results are now ready to the available list.
+  for (unsigned i = 0; i != Pending.size(); ) {
+    if (Pending[i]->getHeight() <= CurCycle) {
+      Available.push_back(Pending[i]);
+      Pending[i] = Pending.back();
+      Pending.pop_back();
+    } else
+      ++i;
+  }
+}
+
+/// pickNode - Pick the best node to schedule at the current cycle, or return
+/// null if the cycle should advance instead.  Under high register pressure
+/// the pending nodes are candidates too; a stall is cheaper than a spill.
+/// Reads of physical registers whose defs are not ready to follow are only
+/// candidates if AllowDeferred is set.
+SUnit *ScheduleDAGMI::pickNode(bool HighPressure, bool AllowDeferred) {
+  SUnit *Best = 0;
+  for (unsigned i = 0, e = Available.size(); i != e; ++i) {
+    SUnit *SU = Available[i];
+    if (!AllowDeferred && isPhysRegUseDeferred(SU))
+      continue;
+    if (!HighPressure &&
+        HazardRec->getHazardType(SU, 0) != ScheduleHazardRecognizer::NoHazard)
+      continue;
+    if (!Best || isBetter(SU, Best, HighPressure))
+      Best = SU;
+  }
+  if (HighPressure)
+    for (unsigned i = 0, e = Pending.size(); i != e; ++i) {
+      SUnit *SU = Pending[i];
+      if (!AllowDeferred && isPhysRegUseDeferred(SU))
+        continue;
+      if (!Best || isBetter(SU, Best, HighPressure))
+        Best = SU;
+    }
+  return Best;
+}
+
+/// scheduleNodeBottomUp - Add SU to the top of the schedule and update the
+/// liveness and the ready lists.
+void ScheduleDAGMI::scheduleNodeBottomUp(SUnit *SU) {
+  DEBUG(dbgs() << "*** Scheduling [" << CurCycle << "]: ");
+  DEBUG(SU->dump(this));
+
+  std::vector<SUnit*>::iterator I =
+    std::find(Available.begin(), Available.end(), SU);
+  if (I != Available.end()) {
+    Available.erase(I);
+  } else {
+    // A pending node picked to relieve register pressure; its results will
+    // not be ready in time.
+    Pending.erase(std::find(Pending.begin(), Pending.end(), SU));
+    ++NumHighPressure;
+    while (CurCycle < SU->getHeight()) {
+      advanceCycle();
+      ++NumStalls;
+    }
+  }
+
+  // Nodes picked without checking for hazards wait for their units.
+  while (HazardRec->getHazardType(SU, 0) !=
+         ScheduleHazardRecognizer::NoHazard) {
+    advanceCycle();
+    ++NumStalls;
+  }
+
+  SU->setHeightToAtLeast(CurCycle);
+  Sequence.push_back(SU);
+  SU->isScheduled = true;
+  HazardRec->EmitInstruction(SU);
+  updateLiveness(SU->getInstr());
+
+  releasePredecessors(SU);
+  for (unsigned i = 0; i != Pending.size(); ) {
+    if (Pending[i]->getHeight() <= CurCycle) {
+      Available.push_back(Pending[i]);
+      Pending[i] = Pending.back();
+      Pending.pop_back();
+    } else
+      ++i;
+  }
+
+  if (HazardRec->atIssueLimit())
+    advanceCycle();
+}
+
+/// listScheduleBottomUp - The main loop of list scheduling for bottom-up
+/// schedulers.
+void ScheduleDAGMI::listScheduleBottomUp() {
+  CurCycle = 0;
+  Available.clear();
+  Pending.clear();
+
+  // Release the nodes the exit depends on, then the ones nothing depends on.
+  releasePredecessors(&ExitSU);
+  for (unsigned i = 0, e = SUnits.size(); i != e; ++i)
+    if (SUnits[i].Succs.empty())
+      Pending.push_back(&SUnits[i]);
+  for (unsigned i = 0; i != Pending.size(); ) {
+    if (Pending[i]->getHeight() <= CurCycle) {
+      Available.push_back(Pending[i]);
+      Pending[i] = Pending.back();
+      Pending.pop_back();
+    } else
+      ++i;
+  }
+
+  while (!Available.empty() || !Pending.empty()) {
+    bool HighPressure = isHighPressure();
+    SUnit *SU = pickNode(HighPressure, /*AllowDeferred=*/false);
+    if (!SU && Pending.empty())
+      SU = pickNode(HighPressure, /*AllowDeferred=*/true);
+    if (!SU) {
+      advanceCycle();
+      ++NumStalls;
+      continue;
+    }
+    scheduleNodeBottomUp(SU);
+  }
+
+  std::reverse(Sequence.begin(), Sequence.end());
+
+#ifndef NDEBUG
+  VerifySchedule(/*isBottomUp=*/true);
+#endif
+}
+
+/// Schedule - Schedule the instruction range using list scheduling.
+void ScheduleDAGMI::Schedule() {
+  BuildSchedGraph(AA);
+  addEBBDeps();
+
+  // Note the kills and the register defs of the region.  The kill flags
+  // are cleared here and put back on the last uses after scheduling.  The
+  // nodes are numbered from the bottom of the region up.
+  KillSegments.clear();
+  RegionPhysDefs.reset();
+  RegionVRegDefs.clear();
+  DenseMap<unsigned, unsigned> NumDefs;
+  for (unsigned i = 0, e = SUnits.size(); i != e; ++i) {
+    MachineInstr *MI = SUnits[i].getInstr();
+    for (unsigned j = 0, je = MI->getNumOperands(); j != je; ++j) {
+      MachineOperand &MO = MI->getOperand(j);
+      if (!MO.isReg() || !MO.getReg() || !MO.isUse() || !MO.isKill())
+        continue;
+      SmallVector<bool, 2> &Segments = KillSegments[MO.getReg()];
+      unsigned Segment = NumDefs.lookup(MO.getReg());
+      if (Segments.size() <= Segment)
+        Segments.resize(Segment + 1, false);
+      Segments[Segment] = true;
+      MO.setIsKill(false);
+    }
+    for (unsigned j = 0, je = MI->getNumOperands(); j != je; ++j) {
+      const MachineOperand &MO = MI->getOperand(j);
+      if (!MO.isReg() || !MO.getReg() || !MO.isDef())
+        continue;
+      ++NumDefs[MO.getReg()];
+      if (TargetRegisterInfo::isVirtualRegister(MO.getReg())) {
+        RegionVRegDefs.insert(MO.getReg());
+      } else {
+        RegionPhysDefs.set(MO.getReg());
+        for (const unsigned *Alias = TRI->getAliasSet(MO.getReg());
+             *Alias; ++Alias)
+          RegionPhysDefs.set(*Alias);
+      }
+    }
+  }
+
+  DEBUG(dbgs() << "********** MI Scheduling BB#" << BB->getNumber()
+               << " **********\n");
+  DEBUG(for (unsigned su = 0, e = SUnits.size(); su != e; ++su)
+          SUnits[su].dumpAll(this));
+
+  listScheduleBottomUp();
+  ++NumRegions;
+}
+
+/// EmitSchedule - Emit the schedule and restore the kill flags of the
+/// region.
+MachineBasicBlock *ScheduleDAGMI::EmitSchedule() {
+  MachineBasicBlock *MBB = ScheduleDAGInstrs::EmitSchedule();
+  fixupKills();
+  return MBB;
+}
+
+/// fixupKills - Put the kill flags cleared by Schedule back on the last use
+/// of each killed live segment in the new order.
+void ScheduleDAGMI::fixupKills() {
+  if (KillSegments.empty())
+    return;
+  DenseMap<unsigned, unsigned> NumDefs;
+  SmallSet<unsigned, 16> Seen;
+  for (MachineBasicBlock::iterator I = InsertPos; I != Begin; ) {
+    MachineInstr *MI = --I;
+    if (MI->isDebugValue())
+      continue;
+    for (unsigned i = 0, e = MI->getNumOperands(); i != e; ++i) {
+      MachineOperand &MO = MI->getOperand(i);
+      if (!MO.isReg() || !MO.getReg() || !MO.isUse() || MO.isUndef())
+        continue;
+      DenseMap<unsigned, SmallVector<bool, 2> >::iterator KI =
+        KillSegments.find(MO.getReg());
+      if (KI == KillSegments.end() || !Seen.insert(MO.getReg()))
+        continue;
+      unsigned Segment = NumDefs.lookup(MO.getReg());
+      if (Segment < KI->second.size() && KI->second[Segment])
+        MO.setIsKill(true);
+    }
+    for (unsigned i = 0, e = MI->getNumOperands(); i != e; ++i) {
+      const MachineOperand &MO = MI->getOperand(i);
+      if (MO.isReg() && MO.getReg() && MO.isDef() &&
+          KillSegments.count(MO.getReg())) {
+        ++NumDefs[MO.getReg()];
+        Seen.erase(MO.getReg());
+      }
+    }
+  }
+  KillSegments.clear();
+}
@@ -14,6 +14,7 @@
 
 #define DEBUG_TYPE "regalloc"
 #include "AllocationOrder.h"
+#include "InterferenceCache.h"
 #include "LiveIntervalUnion.h"
 #include "LiveRangeEdit.h"
 #include "RegAllocBase.h"
@@ -38,6 +39,7 @@
 #include "llvm/CodeGen/RegAllocRegistry.h"
 #include "llvm/CodeGen/RegisterCoalescer.h"
 #include "llvm/Target/TargetOptions.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/raw_ostream.h"
@@ -45,6 +47,12 @@
 
 using namespace llvm;
 
+static cl::opt<unsigned>
+RegionSplitBudget("greedy-region-split-budget", cl::Hidden,
+                  cl::desc("Live blocks to examine per live range when "
+                           "looking for a better region split candidate"),
+                  cl::init(10000));
+
 static RegisterRegAlloc greedyRegAlloc("greedy", "greedy register allocator",
                                        createGreedyRegisterAllocator);
 
@@ -66,6 +74,7 @@ class RAGreedy : public MachineFunctionPass, public RegAllocBase {
   // state
   std::auto_ptr<Spiller> SpillerInstance;
   std::auto_ptr<SplitAnalysis> SA;
+  InterferenceCache IntfCache;
 
   // splitting state.
 
@@ -309,6 +318,19 @@ unsigned RAGreedy::tryReassignOrEvict(LiveInterval &VirtReg,
 //                              Region Splitting
 //===----------------------------------------------------------------------===//
 
+/// overlapsBlock - Return true if the interference described by BlockIntf
+/// overlaps [Start;Stop). Both must be inside the same basic block.
+static bool overlapsBlock(InterferenceCache::Entry *Intf,
+                          const InterferenceCache::BlockInterference &BlockIntf,
+                          SlotIndex Start, SlotIndex Stop) {
+  if (BlockIntf.First >= Stop || BlockIntf.Last <= Start)
+    return false;
+  if (BlockIntf.First >= Start || BlockIntf.Last <= Stop)
+    return true;
+  // The interference surrounds [Start;Stop), there may be a hole.
+  return Intf->overlaps(Start, Stop);
+}
+
 /// calcInterferenceInfo - Compute per-block outgoing and ingoing constraints
 /// when considering interference from PhysReg. Also compute an optimistic local
 /// cost of this interference pattern.
@@ -330,122 +352,63 @@ float RAGreedy::calcInterferenceInfo(LiveInterval &VirtReg, unsigned PhysReg) {
     BI.OverlapEntry = BI.OverlapExit = false;
   }
 
-  // Add interference info from each PhysReg alias.
-  for (const unsigned *AI = TRI->getOverlaps(PhysReg); *AI; ++AI) {
-    if (!query(VirtReg, *AI).checkInterference())
-      continue;
-    LiveIntervalUnion::SegmentIter IntI =
-      PhysReg2LiveUnion[*AI].find(VirtReg.beginIndex());
-    if (!IntI.valid())
-      continue;
-
-    // Determine which blocks have interference live in or after the last split
-    // point.
-    for (unsigned i = 0, e = SA->LiveBlocks.size(); i != e; ++i) {
-      SplitAnalysis::BlockInfo &BI = SA->LiveBlocks[i];
-      SpillPlacement::BlockConstraint &BC = SpillConstraints[i];
-      SlotIndex Start, Stop;
-      tie(Start, Stop) = Indexes->getMBBRange(BI.MBB);
-
-      // Skip interference-free blocks.
-      if (IntI.start() >= Stop)
-        continue;
+  // Add interference info from the per-block interference of PhysReg and its
+  // aliases.
+  InterferenceCache::Entry *Intf = IntfCache.get(PhysReg);
+  for (unsigned i = 0, e = SA->LiveBlocks.size(); i != e; ++i) {
+    SplitAnalysis::BlockInfo &BI = SA->LiveBlocks[i];
+    SpillPlacement::BlockConstraint &BC = SpillConstraints[i];
+    const InterferenceCache::BlockInterference &BlockIntf =
+      Intf->get(BC.Number);
 
-      // Is the interference live-in?
-      if (BI.LiveIn) {
-        IntI.advanceTo(Start);
-        if (!IntI.valid())
-          break;
-        if (IntI.start() <= Start)
-          BC.Entry = SpillPlacement::MustSpill;
-      }
+    // Skip interference-free blocks.
+    if (!BlockIntf.First.isValid())
+      continue;
 
-      // Is the interference overlapping the last split point?
-      if (BI.LiveOut) {
-        if (IntI.stop() < BI.LastSplitPoint)
-          IntI.advanceTo(BI.LastSplitPoint.getPrevSlot());
-        if (!IntI.valid())
-          break;
-        if (IntI.start() < Stop)
-          BC.Exit = SpillPlacement::MustSpill;
-      }
+    // Is the interference live-in?
+    if (BI.LiveIn && BlockIntf.First <= Indexes->getMBBStartIdx(BI.MBB))
+      BC.Entry = SpillPlacement::MustSpill;
+
+    // Is the interference overlapping the last split point?
+    if (BI.LiveOut && BlockIntf.Last > BI.LastSplitPoint.getPrevSlot())
+      BC.Exit = SpillPlacement::MustSpill;
+
+    // Handle transparent blocks with interference separately.
+    // Transparent blocks never incur any fixed cost.
+    if (BI.LiveThrough && !BI.Uses) {
+      if (BC.Entry != SpillPlacement::MustSpill)
+        BC.Entry = SpillPlacement::PrefSpill;
+      if (BC.Exit != SpillPlacement::MustSpill)
+        BC.Exit = SpillPlacement::PrefSpill;
+      continue;
     }
 
-    // Rewind iterator and check other interferences.
-    IntI.find(VirtReg.beginIndex());
-    for (unsigned i = 0, e = SA->LiveBlocks.size(); i != e; ++i) {
-      SplitAnalysis::BlockInfo &BI = SA->LiveBlocks[i];
-      SpillPlacement::BlockConstraint &BC = SpillConstraints[i];
-      SlotIndex Start, Stop;
-      tie(Start, Stop) = Indexes->getMBBRange(BI.MBB);
-
-      // Skip interference-free blocks.
-      if (IntI.start() >= Stop)
-        continue;
-
-      // Handle transparent blocks with interference separately.
-      // Transparent blocks never incur any fixed cost.
-      if (BI.LiveThrough && !BI.Uses) {
-        IntI.advanceTo(Start);
-        if (!IntI.valid())
-          break;
-        if (IntI.start() >= Stop)
-          continue;
-
-        if (BC.Entry != SpillPlacement::MustSpill)
-          BC.Entry = SpillPlacement::PrefSpill;
-        if (BC.Exit != SpillPlacement::MustSpill)
-          BC.Exit = SpillPlacement::PrefSpill;
-        continue;
-      }
-
-      // Now we only have blocks with uses left.
-      // Check if the interference overlaps the uses.
-      assert(BI.Uses && "Non-transparent block without any uses");
-
-      // Check interference on entry.
-      if (BI.LiveIn && BC.Entry != SpillPlacement::MustSpill) {
-        IntI.advanceTo(Start);
-        if (!IntI.valid())
-          break;
-        // Not live in, but before the first use.
-        if (IntI.start() < BI.FirstUse)
-          BC.Entry = SpillPlacement::PrefSpill;
-      }
-
-      // Does interference overlap the uses in the entry segment
-      // [FirstUse;Kill)?
-      if (BI.LiveIn && !BI.OverlapEntry) {
-        IntI.advanceTo(BI.FirstUse);
-        if (!IntI.valid())
-          break;
-        // A live-through interval has no kill.
-        // Check [FirstUse;LastUse) instead.
-        if (IntI.start() < (BI.LiveThrough ? BI.LastUse : BI.Kill))
-          BI.OverlapEntry = true;
-      }
-
-      // Does interference overlap the uses in the exit segment [Def;LastUse)?
-      if (BI.LiveOut && !BI.LiveThrough && !BI.OverlapExit) {
-        IntI.advanceTo(BI.Def);
-        if (!IntI.valid())
-          break;
-        if (IntI.start() < BI.LastUse)
-          BI.OverlapExit = true;
-      }
-
-      // Check interference on exit.
-      if (BI.LiveOut && BC.Exit != SpillPlacement::MustSpill) {
-        // Check interference between LastUse and Stop.
-        if (BC.Exit != SpillPlacement::PrefSpill) {
-          IntI.advanceTo(BI.LastUse);
-          if (!IntI.valid())
-            break;
-          if (IntI.start() < Stop)
-            BC.Exit = SpillPlacement::PrefSpill;
-        }
-      }
-    }
+    // Now we only have blocks with uses left.
+    // Check if the interference overlaps the uses.
+    assert(BI.Uses && "Non-transparent block without any uses");
+
+    // Check interference on entry: Not live in, but before the first use.
+    if (BI.LiveIn && BC.Entry != SpillPlacement::MustSpill &&
+        BlockIntf.First < BI.FirstUse)
+      BC.Entry = SpillPlacement::PrefSpill;
+
+    // Does interference overlap the uses in the entry segment
+    // [FirstUse;Kill)? A live-through interval has no kill.
+    // Check [FirstUse;LastUse) instead.
+    if (BI.LiveIn &&
+        overlapsBlock(Intf, BlockIntf, BI.FirstUse,
+                      BI.LiveThrough ? BI.LastUse : BI.Kill))
+      BI.OverlapEntry = true;
+
+    // Does interference overlap the uses in the exit segment [Def;LastUse)?
+    if (BI.LiveOut && !BI.LiveThrough &&
+        overlapsBlock(Intf, BlockIntf, BI.Def, BI.LastUse))
+      BI.OverlapExit = true;
+
+    // Check interference on exit between LastUse and Stop.
+    if (BI.LiveOut && BC.Exit != SpillPlacement::MustSpill &&
+        BlockIntf.Last > BI.LastUse)
+      BC.Exit = SpillPlacement::PrefSpill;
   }
 
   // Accumulate a local cost of this interference pattern.
@@ -793,16 +756,34 @@ void RAGreedy::splitAroundRegion(LiveInterval &VirtReg, unsigned PhysReg,
 
 unsigned RAGreedy::tryRegionSplit(LiveInterval &VirtReg, AllocationOrder &Order,
                                   SmallVectorImpl<LiveInterval*> &NewVRegs) {
+  NamedRegionTimer T("Region Split", TimerGroupName, TimePassesIsEnabled);
   BitVector LiveBundles, BestBundles;
   float BestCost = 0;
   unsigned BestReg = 0;
+  // Each candidate costs a walk over the live blocks. Once the budget is
+  // spent, settle for the best candidate found so far.
+  unsigned Budget = RegionSplitBudget;
   Order.rewind();
   while (unsigned PhysReg = Order.next()) {
-    float Cost = calcInterferenceInfo(VirtReg, PhysReg);
+    if (BestReg && Budget < SA->LiveBlocks.size()) {
+      DEBUG(dbgs() << "Region split budget exhausted.\n");
+      break;
+    }
+    Budget -= std::min<unsigned>(Budget, SA->LiveBlocks.size());
+
+    float Cost;
+    {
+      NamedRegionTimer T("Interference", TimerGroupName, TimePassesIsEnabled);
+      Cost = calcInterferenceInfo(VirtReg, PhysReg);
+    }
     if (BestReg && Cost >= BestCost)
       continue;
 
-    SpillPlacer->placeSpills(SpillConstraints, LiveBundles);
+    {
+      NamedRegionTimer T("Spill Placement", TimerGroupName,
+                         TimePassesIsEnabled);
+      SpillPlacer->placeSpills(SpillConstraints, LiveBundles);
+    }
     // No live bundles, defer to splitSingleBlocks().
     if (!LiveBundles.any())
       continue;
@@ -980,6 +961,7 @@ bool RAGreedy::runOnMachineFunction(MachineFunction &mf) {
   SpillPlacer = &getAnalysis<SpillPlacement>();
 
   SA.reset(new SplitAnalysis(*MF, *LIS, *Loops));
+  IntfCache.init(MF, &PhysReg2LiveUnion[0], Indexes, TRI);
 
   allocatePhysRegs();
   addMBBLiveIns(MF);
@@ -25,11 +25,22 @@
 #include "llvm/Target/TargetInstrInfo.h"
 #include "llvm/Target/TargetRegisterInfo.h"
 #include "llvm/Target/TargetSubtarget.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/ADT/SmallSet.h"
 using namespace llvm;
 
+// Huge blocks with thousands of possibly aliasing loads and stores would get
+// a chain edge between nearly every pair of them. Once this many such
+// references are tracked, the next one is made an alias chain node instead,
+// so the edges added per memory reference stay bounded.
+static cl::opt<unsigned>
+MemDepWindow("sched-mem-window",
+             cl::desc("Number of possibly aliasing memory references tracked "
+                      "before they are chained through a single node"),
+             cl::init(200), cl::Hidden);
+
 ScheduleDAGInstrs::ScheduleDAGInstrs(MachineFunction &mf,
                                      const MachineLoopInfo &mli,
                                      const MachineDominatorTree &mdt)
@@ -164,10 +175,22 @@ void ScheduleDAGInstrs::AddSchedBarrierDeps() {
       unsigned Reg = MO.getReg();
       if (Reg == 0) continue;
 
-      assert(TRI->isPhysicalRegister(Reg) && "Virtual register encountered!");
-      Uses[Reg].push_back(&ExitSU);
+      if (TRI->isVirtualRegister(Reg))
+        VRegUses[Reg].push_back(&ExitSU);
+      else
+        Uses[Reg].push_back(&ExitSU);
     }
   } else {
+    // Before register allocation the exit may read virtual registers defined
+    // in the region, e.g. a conditional branch on a computed value.
+    if (ExitMI)
+      for (unsigned i = 0, e = ExitMI->getNumOperands(); i != e; ++i) {
+        const MachineOperand &MO = ExitMI->getOperand(i);
+        if (MO.isReg() && MO.isUse() && MO.getReg() &&
+            TRI->isVirtualRegister(MO.getReg()))
+          VRegUses[MO.getReg()].push_back(&ExitSU);
+      }
+
     // For others, e.g. fallthrough, conditional branch, assume the exit
     // uses all the registers that are livein to the successor blocks.
     SmallSet<unsigned, 8> Seen;
@@ -200,10 +223,19 @@ void ScheduleDAGInstrs::BuildSchedGraph(AliasAnalysis *AA) {
   std::map<const Value *, SUnit *> AliasMemDefs, NonAliasMemDefs;
   std::map<const Value *, std::vector<SUnit *> > AliasMemUses, NonAliasMemUses;
 
+  // The number of entries in PendingLoads, AliasMemDefs and AliasMemUses,
+  // checked against MemDepWindow.
+  unsigned NumAliasMemRefs = 0;
+
+  // The number of stores given an artificial edge to the region exit.
+  unsigned NumExitStores = 0;
+
   // Keep track of dangling debug references to registers.
   std::vector<std::pair<MachineInstr*, unsigned> >
     DanglingDebugValue(TRI->getNumRegs(),
     std::make_pair(static_cast<MachineInstr*>(0), 0));
+  DenseMap<unsigned, std::pair<MachineInstr*, unsigned> >
+    DanglingVRegDebugValue;
 
   // Check to see if the scheduler cares about latencies.
   bool UnitLatencies = ForceUnitLatencies();
@@ -228,9 +260,13 @@ void ScheduleDAGInstrs::BuildSchedGraph(AliasAnalysis *AA) {
     // reinsertion.
     if (MI->isDebugValue()) {
       if (MI->getNumOperands()==3 && MI->getOperand(0).isReg() &&
-          MI->getOperand(0).getReg())
-        DanglingDebugValue[MI->getOperand(0).getReg()] =
-             std::make_pair(MI, DbgValueVec.size());
+          MI->getOperand(0).getReg()) {
+        unsigned Reg = MI->getOperand(0).getReg();
+        if (TRI->isVirtualRegister(Reg))
+          DanglingVRegDebugValue[Reg] = std::make_pair(MI, DbgValueVec.size());
+        else
+          DanglingDebugValue[Reg] = std::make_pair(MI, DbgValueVec.size());
+      }
       DbgValueVec.push_back(MI);
       continue;
     }
@@ -255,7 +291,21 @@ void ScheduleDAGInstrs::BuildSchedGraph(AliasAnalysis *AA) {
       unsigned Reg = MO.getReg();
       if (Reg == 0) continue;
 
-      assert(TRI->isPhysicalRegister(Reg) && "Virtual register encountered!");
+      if (TRI->isVirtualRegister(Reg)) {
+        if (MO.isDef()) {
+          DenseMap<unsigned, std::pair<MachineInstr*, unsigned> >::iterator
+            DI = DanglingVRegDebugValue.find(Reg);
+          if (DI != DanglingVRegDebugValue.end()) {
+            SU->DbgInstrList.push_back(DI->second.first);
+            DbgValueVec[DI->second.second] = 0;
+            DanglingVRegDebugValue.erase(DI);
+          }
+          addVRegDefDeps(SU, Reg, UnitLatencies, SpecialAddressLatency);
+        } else {
+          addVRegUseDeps(SU, Reg);
+        }
+        continue;
+      }
 
       if (MO.isDef() && DanglingDebugValue[Reg].first!=0) {
         SU->DbgInstrList.push_back(DanglingDebugValue[Reg].first);
@@ -451,10 +501,15 @@ void ScheduleDAGInstrs::BuildSchedGraph(AliasAnalysis *AA) {
       PendingLoads.clear();
       AliasMemDefs.clear();
       AliasMemUses.clear();
+      NumAliasMemRefs = 0;
     } else if (TID.mayStore()) {
       bool MayAlias = true;
       TrueMemOrderLatency = STORE_LOAD_LATENCY;
-      if (const Value *V = getUnderlyingObjectForInstr(MI, MFI, MayAlias)) {
+      const Value *V = getUnderlyingObjectForInstr(MI, MFI, MayAlias);
+      if (MayAlias && NumAliasMemRefs >= MemDepWindow)
+        // Too many references to order precisely; start a new alias chain.
+        goto new_alias_chain;
+      if (V) {
         // A store to a specific PseudoSourceValue. Add precise dependencies.
         // Record the def in MemDefs, first adding a dep if there is
         // an existing def.
@@ -467,9 +522,10 @@ void ScheduleDAGInstrs::BuildSchedGraph(AliasAnalysis *AA) {
                                   /*isNormalMemory=*/true));
           I->second = SU;
         } else {
-          if (MayAlias)
+          if (MayAlias) {
             AliasMemDefs[V] = SU;
-          else
+            ++NumAliasMemRefs;
+          } else
             NonAliasMemDefs[V] = SU;
         }
         // Handle the uses in MemUses, if there are any.
@@ -481,6 +537,8 @@ void ScheduleDAGInstrs::BuildSchedGraph(AliasAnalysis *AA) {
           for (unsigned i = 0, e = J->second.size(); i != e; ++i)
             J->second[i]->addPred(SDep(SU, SDep::Order, TrueMemOrderLatency,
                                        /*Reg=*/0, /*isNormalMemory=*/true));
+          if (MayAlias)
+            NumAliasMemRefs -= J->second.size();
           J->second.clear();
         }
         if (MayAlias) {
@@ -500,21 +558,27 @@ void ScheduleDAGInstrs::BuildSchedGraph(AliasAnalysis *AA) {
         goto new_alias_chain;
       }
 
-      if (!ExitSU.isPred(SU))
-        // Push store's up a bit to avoid them getting in between cmp
-        // and branches.
+      // Push store's up a bit to avoid them getting in between cmp
+      // and branches. Stores further up than the memory window are
+      // left alone.
+      if (NumExitStores < MemDepWindow && !ExitSU.isPred(SU)) {
+        ++NumExitStores;
         ExitSU.addPred(SDep(SU, SDep::Order, 0,
                             /*Reg=*/0, /*isNormalMemory=*/false,
                             /*isMustAlias=*/false,
                             /*isArtificial=*/true));
+      }
     } else if (TID.mayLoad()) {
       bool MayAlias = true;
       TrueMemOrderLatency = 0;
       if (MI->isInvariantLoad(AA)) {
         // Invariant load, no chain dependencies needed!
       } else {
-        if (const Value *V = 
-            getUnderlyingObjectForInstr(MI, MFI, MayAlias)) {
+        const Value *V = getUnderlyingObjectForInstr(MI, MFI, MayAlias);
+        if (MayAlias && NumAliasMemRefs >= MemDepWindow)
+          // Too many references to order precisely; start a new alias chain.
+          goto new_alias_chain;
+        if (V) {
           // A load from a specific PseudoSourceValue. Add precise dependencies.
           std::map<const Value *, SUnit *>::iterator I = 
             ((MayAlias) ? AliasMemDefs.find(V) : NonAliasMemDefs.find(V));
@@ -523,9 +587,10 @@ void ScheduleDAGInstrs::BuildSchedGraph(AliasAnalysis *AA) {
           if (I != IE)
             I->second->addPred(SDep(SU, SDep::Order, /*Latency=*/0, /*Reg=*/0,
                                     /*isNormalMemory=*/true));
-          if (MayAlias)
+          if (MayAlias) {
             AliasMemUses[V].push_back(SU);
-          else 
+            ++NumAliasMemRefs;
+          } else
             NonAliasMemUses[V].push_back(SU);
         } else {
           // A load with no underlying object. Depend on all
@@ -535,6 +600,7 @@ void ScheduleDAGInstrs::BuildSchedGraph(AliasAnalysis *AA) {
             I->second->addPred(SDep(SU, SDep::Order, /*Latency=*/0));
           
           PendingLoads.push_back(SU);
+          ++NumAliasMemRefs;
           MayAlias = true;
         }
         
@@ -551,9 +617,64 @@ void ScheduleDAGInstrs::BuildSchedGraph(AliasAnalysis *AA) {
     Defs[i].clear();
     Uses[i].clear();
   }
+  VRegDefs.clear();
+  VRegUses.clear();
   PendingLoads.clear();
 }
 
+/// addVRegDefDeps - Add data dependencies from SU's def of virtual register
+/// Reg to the uses of it seen so far, which are below SU, and an output
+/// dependence on the next def of Reg, if the code is not in SSA form.
+void ScheduleDAGInstrs::addVRegDefDeps(SUnit *SU, unsigned Reg,
+                                       bool UnitLatencies,
+                                       unsigned SpecialAddressLatency) {
+  const TargetSubtarget &ST = TM.getSubtarget<TargetSubtarget>();
+  DenseMap<unsigned, std::vector<SUnit *> >::iterator UI = VRegUses.find(Reg);
+  if (UI != VRegUses.end()) {
+    std::vector<SUnit *> &UseList = UI->second;
+    for (unsigned i = 0, e = UseList.size(); i != e; ++i) {
+      SUnit *UseSU = UseList[i];
+      if (UseSU == SU)
+        continue;
+      unsigned LDataLatency = SU->Latency;
+      // Optionally add in a special extra latency for nodes that feed
+      // addresses.
+      if (SpecialAddressLatency != 0 && !UnitLatencies &&
+          UseSU != &ExitSU) {
+        MachineInstr *UseMI = UseSU->getInstr();
+        const TargetInstrDesc &UseTID = UseMI->getDesc();
+        int RegUseIndex = UseMI->findRegisterUseOperandIdx(Reg);
+        if (RegUseIndex >= 0 &&
+            (UseTID.mayLoad() || UseTID.mayStore()) &&
+            (unsigned)RegUseIndex < UseTID.getNumOperands() &&
+            UseTID.OpInfo[RegUseIndex].isLookupPtrRegClass())
+          LDataLatency += SpecialAddressLatency;
+      }
+      const SDep& dep = SDep(SU, SDep::Data, LDataLatency, Reg);
+      if (!UnitLatencies) {
+        ComputeOperandLatency(SU, UseSU, const_cast<SDep &>(dep));
+        ST.adjustSchedDependency(SU, UseSU, const_cast<SDep &>(dep));
+      }
+      UseSU->addPred(dep);
+    }
+    UseList.clear();
+  }
+
+  SUnit *&DefSU = VRegDefs[Reg];
+  if (DefSU && DefSU != SU)
+    DefSU->addPred(SDep(SU, SDep::Output, /*Latency=*/1, Reg));
+  DefSU = SU;
+}
+
+/// addVRegUseDeps - Add an anti-dependence from SU's use of virtual register
+/// Reg to the next def of it, and remember the use for the def above it.
+void ScheduleDAGInstrs::addVRegUseDeps(SUnit *SU, unsigned Reg) {
+  DenseMap<unsigned, SUnit *>::iterator DI = VRegDefs.find(Reg);
+  if (DI != VRegDefs.end() && DI->second != SU)
+    DI->second->addPred(SDep(SU, SDep::Anti, /*Latency=*/0, Reg));
+  VRegUses[Reg].push_back(SU);
+}
+
 void ScheduleDAGInstrs::FinishBlock() {
   // Nothing to do.
 }
@@ -20,6 +20,7 @@
 #include "llvm/CodeGen/ScheduleDAG.h"
 #include "llvm/Support/Compiler.h"
 #include "llvm/Target/TargetRegisterInfo.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/SmallSet.h"
 #include <map>
 
@@ -109,6 +110,12 @@ namespace llvm {
     /// initialized and destructed for each block.
     std::vector<std::vector<SUnit *> > Defs;
     std::vector<std::vector<SUnit *> > Uses;
+
+    /// VRegDefs, VRegUses - The same for virtual registers, which are only
+    /// seen when scheduling before register allocation.  Virtual registers
+    /// have no aliases, and few of them appear in any one region.
+    DenseMap<unsigned, SUnit *> VRegDefs;
+    DenseMap<unsigned, std::vector<SUnit *> > VRegUses;
  
     /// DbgValueVec - Remember DBG_VALUEs that refer to a particular
     /// register.
@@ -173,6 +180,12 @@ namespace llvm {
     /// used by instructions in the fallthrough block.
     void AddSchedBarrierDeps();
 
+    /// addVRegDefDeps, addVRegUseDeps - Add the dependencies of a def or use
+    /// of a virtual register by SU.
+    void addVRegDefDeps(SUnit *SU, unsigned Reg, bool UnitLatencies,
+                        unsigned SpecialAddressLatency);
+    void addVRegUseDeps(SUnit *SU, unsigned Reg);
+
     /// ComputeLatency - Compute node latency.
     ///
     virtual void ComputeLatency(SUnit *SU);
@@ -120,7 +120,8 @@ void FunctionLoweringInfo::set(const Function &fn, MachineFunction &mf) {
            (TySize > 8 && isa<ArrayType>(Ty) &&
             cast<ArrayType>(Ty)->getElementType()->isIntegerTy(8)));
         StaticAllocaMap[AI] =
-          MF->getFrameInfo()->CreateStackObject(TySize, Align, false, MayNeedSP);
+          MF->getFrameInfo()->CreateStackObject(TySize, Align, false, MayNeedSP,
+                                                AI);
       }
 
   for (; BB != EB; ++BB)
@@ -806,6 +806,16 @@ EmitSpecialNode(SDNode *Node, bool IsClone, bool IsCloned,
             TII->get(TargetOpcode::EH_LABEL)).addSym(S);
     break;
   }
+
+  case ISD::LIFETIME_START:
+  case ISD::LIFETIME_END: {
+    unsigned TarOp = (Node->getOpcode() == ISD::LIFETIME_START) ?
+      TargetOpcode::LIFETIME_START : TargetOpcode::LIFETIME_END;
+    FrameIndexSDNode *FI = cast<FrameIndexSDNode>(Node->getOperand(1));
+    BuildMI(*MBB, InsertPos, Node->getDebugLoc(), TII->get(TarOp))
+      .addFrameIndex(FI->getIndex());
+    break;
+  }
       
   case ISD::INLINEASM: {
     unsigned NumOps = Node->getNumOperands();
@@ -5776,6 +5776,8 @@ std::string SDNode::getOperationName(const SelectionDAG *G) const {
   case ISD::MERGE_VALUES:  return "merge_values";
   case ISD::INLINEASM:     return "inlineasm";
   case ISD::EH_LABEL:      return "eh_label";
+  case ISD::LIFETIME_START: return "lifetime.start";
+  case ISD::LIFETIME_END:  return "lifetime.end";
   case ISD::HANDLENODE:    return "handlenode";
 
   // Unary operators
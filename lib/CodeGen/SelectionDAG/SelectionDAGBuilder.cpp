@@ -19,6 +19,7 @@
 #include "llvm/ADT/SmallSet.h"
 #include "llvm/Analysis/AliasAnalysis.h"
 #include "llvm/Analysis/ConstantFolding.h"
+#include "llvm/Analysis/ValueTracking.h"
 #include "llvm/Constants.h"
 #include "llvm/CallingConv.h"
 #include "llvm/DerivedTypes.h"
@@ -4780,14 +4781,33 @@ SelectionDAGBuilder::visitIntrinsicCall(const CallInst &I, unsigned Intrinsic) {
     return implVisitBinaryAtomic(I, ISD::ATOMIC_SWAP);
 
   case Intrinsic::invariant_start:
-  case Intrinsic::lifetime_start:
     // Discard region information.
     setValue(&I, DAG.getUNDEF(TLI.getPointerTy()));
     return 0;
   case Intrinsic::invariant_end:
-  case Intrinsic::lifetime_end:
     // Discard region information.
     return 0;
+  case Intrinsic::lifetime_start:
+  case Intrinsic::lifetime_end: {
+    // The markers are consumed by stack coloring, which only runs when
+    // optimizing. Otherwise discard region information.
+    if (OptLevel == CodeGenOpt::None)
+      return 0;
+    const AllocaInst *AI =
+      dyn_cast<AllocaInst>(GetUnderlyingObject(I.getArgOperand(1), TD));
+    if (!AI)
+      return 0;
+    DenseMap<const AllocaInst*, int>::iterator SI =
+      FuncInfo.StaticAllocaMap.find(AI);
+    if (SI == FuncInfo.StaticAllocaMap.end())
+      return 0;
+    unsigned Opc = Intrinsic == Intrinsic::lifetime_start ?
+      ISD::LIFETIME_START : ISD::LIFETIME_END;
+    Res = DAG.getNode(Opc, dl, MVT::Other, getRoot(),
+                      DAG.getFrameIndex(SI->second, TLI.getPointerTy(), true));
+    DAG.setRoot(Res);
+    return 0;
+  }
   }
 }
 
@@ -584,6 +584,11 @@ TargetLowering::TargetLowering(const TargetMachine &tm,
   JumpBufSize = 0;
   JumpBufAlignment = 0;
   PrefLoopAlignment = 0;
+  CacheLineSize = 0;
+  DataCacheSize = 0;
+  PrefetchDistance = 0;
+  PrefetchCacheSize = 0;
+  FastStringLibCalls = false;
   MinStackArgumentAlignment = 1;
   ShouldFoldAtomicFences = false;
 
@@ -3096,6 +3101,24 @@ bool TargetLowering::isLegalAddressingMode(const AddrMode &AM,
   return true;
 }
 
+//===----------------------------------------------------------------------===//
+//  Vectorization hooks
+//===----------------------------------------------------------------------===//
+
+/// getVectorRegisterBitWidth - Return the width of the vector registers the
+/// IR-level vectorizers should target.  By default this is the size of the
+/// widest vector type that is legal for the target.
+unsigned TargetLowering::getVectorRegisterBitWidth() const {
+  unsigned Width = 0;
+  for (unsigned i = MVT::FIRST_VECTOR_VALUETYPE;
+       i <= (unsigned)MVT::LAST_VECTOR_VALUETYPE; ++i) {
+    MVT VT = (MVT::SimpleValueType)i;
+    if (isTypeLegal(VT))
+      Width = std::max(Width, VT.getSizeInBits());
+  }
+  return Width;
+}
+
 /// BuildSDIVSequence - Given an ISD::SDIV node expressing a divide by constant,
 /// return a DAG expression to select that will generate the same value by
 /// multiplying by a magic number.  See:
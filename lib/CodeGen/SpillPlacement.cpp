@@ -45,6 +45,7 @@ INITIALIZE_PASS_BEGIN(SpillPlacement, "spill-code-placement",
                       "Spill Code Placement Analysis", true, true)
 INITIALIZE_PASS_DEPENDENCY(EdgeBundles)
 INITIALIZE_PASS_DEPENDENCY(MachineLoopInfo)
+INITIALIZE_AG_DEPENDENCY(ProfileInfo)
 INITIALIZE_PASS_END(SpillPlacement, "spill-code-placement",
                     "Spill Code Placement Analysis", true, true)
 
@@ -54,6 +55,7 @@ void SpillPlacement::getAnalysisUsage(AnalysisUsage &AU) const {
   AU.setPreservesAll();
   AU.addRequiredTransitive<EdgeBundles>();
   AU.addRequiredTransitive<MachineLoopInfo>();
+  AU.addRequiredTransitive<ProfileInfo>();
   MachineFunctionPass::getAnalysisUsage(AU);
 }
 
@@ -170,6 +172,7 @@ bool SpillPlacement::runOnMachineFunction(MachineFunction &mf) {
   MF = &mf;
   bundles = &getAnalysis<EdgeBundles>();
   loops = &getAnalysis<MachineLoopInfo>();
+  profile = &getAnalysis<ProfileInfo>();
 
   assert(!nodes && "Leaking node array");
   nodes = new Node[bundles->getNumBundles()];
@@ -349,7 +352,7 @@ SpillPlacement::placeSpills(const SmallVectorImpl<BlockConstraint> &LiveBlocks,
 /// getBlockFrequency - Return our best estimate of the block frequency which is
 /// the expected number of block executions per function invocation.
 float SpillPlacement::getBlockFrequency(const MachineBasicBlock *MBB) {
-  // Use the unnormalized spill weight for real block frequencies.
-  return LiveIntervals::getSpillWeight(true, false, loops->getLoopDepth(MBB));
+  // Use the same frequencies as the spill weights, measured when we have them.
+  return LiveIntervals::getBlockFrequency(MBB, *loops, profile);
 }
 
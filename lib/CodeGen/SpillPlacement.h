@@ -27,6 +27,7 @@
 #ifndef LLVM_CODEGEN_SPILLPLACEMENT_H
 #define LLVM_CODEGEN_SPILLPLACEMENT_H
 
+#include "llvm/Analysis/ProfileInfo.h"
 #include "llvm/CodeGen/MachineFunctionPass.h"
 
 namespace llvm {
@@ -42,6 +43,7 @@ class SpillPlacement  : public MachineFunctionPass {
   const MachineFunction *MF;
   const EdgeBundles *bundles;
   const MachineLoopInfo *loops;
+  ProfileInfo *profile;
   Node *nodes;
 
   // Nodes that are active in the current computation. Owned by the placeSpills
@@ -748,6 +748,71 @@ void SplitEditor::closeIntv() {
   OpenIdx = 0;
 }
 
+void SplitEditor::transferSimpleValues() {
+  SmallPtrSet<const VNInfo*, 16> Simple;
+  for (LiveInterval::vni_iterator I = Edit.getParent().vni_begin(),
+         E = Edit.getParent().vni_end(); I != E; ++I) {
+    VNInfo *ParentVNI = *I;
+    if (ParentVNI->isUnused())
+      continue;
+    unsigned RegIdx = RegAssign.lookup(ParentVNI->def);
+    LiveIntervalMap &LIM = LIMappers[RegIdx];
+    // A value is simple when it was neither copied nor rematerialized, so the
+    // interval holding its def is the only one that can hold its uses.
+    bool IsSimple = !LIM.isComplexMapped(ParentVNI) &&
+                    !Edit.didRematerialize(ParentVNI);
+    for (unsigned i = 0, e = LIMappers.size(); IsSimple && i != e; ++i)
+      if (i != RegIdx && LIMappers[i].isMapped(ParentVNI))
+        IsSimple = false;
+    if (IsSimple)
+      Simple.insert(ParentVNI);
+    else
+      LIM.markComplexMapped(ParentVNI);
+  }
+  DEBUG(dbgs() << "  " << Simple.size() << " simple values.\n");
+  if (Simple.empty())
+    return;
+
+  for (LiveInterval::const_iterator I = Edit.getParent().begin(),
+         E = Edit.getParent().end(); I != E; ++I)
+    if (Simple.count(I->valno))
+      LIMappers[RegAssign.lookup(I->valno->def)]
+        .addSimpleRange(I->start, I->end, I->valno);
+}
+
+void SplitEditor::deleteRematVictims() {
+  SmallVector<MachineInstr*, 8> Dead;
+  for (LiveInterval::vni_iterator I = Edit.getParent().vni_begin(),
+         E = Edit.getParent().vni_end(); I != E; ++I) {
+    VNInfo *ParentVNI = *I;
+    if (ParentVNI->isUnused() || ParentVNI->isPHIDef() ||
+        !Edit.didRematerialize(ParentVNI))
+      continue;
+    // The value is dead when its range in the new interval ends at its def.
+    LiveInterval *LI = Edit.get(RegAssign.lookup(ParentVNI->def));
+    LiveInterval::iterator LII = LI->FindLiveRangeContaining(ParentVNI->def);
+    if (LII == LI->end() || LII->end != ParentVNI->def.getNextSlot())
+      continue;
+    MachineInstr *MI = LIS.getInstructionFromIndex(ParentVNI->def);
+    assert(MI && "Missing instruction for dead def");
+    // Partial defs of the register are dead as well.
+    for (unsigned i = 0, e = MI->getNumOperands(); i != e; ++i) {
+      MachineOperand &MO = MI->getOperand(i);
+      if (MO.isReg() && MO.isDef() && MO.getReg() == LI->reg)
+        MO.setIsDead();
+    }
+    if (!MI->allDefsAreDead())
+      continue;
+    DEBUG(dbgs() << "  rematted everywhere: " << ParentVNI->def << '\t' << *MI);
+    Dead.push_back(MI);
+  }
+
+  if (Dead.empty())
+    return;
+
+  Edit.eliminateDeadDefs(Dead, LIS, VRM, TII);
+}
+
 /// rewriteAssigned - Rewrite all uses of Edit.getReg().
 void SplitEditor::rewriteAssigned() {
   for (MachineRegisterInfo::reg_iterator RI = MRI.reg_begin(Edit.getReg()),
@@ -822,9 +887,6 @@ void SplitEditor::finish() {
     VNInfo *VNI = LIM.defValue(ParentVNI, ParentVNI->def);
     LIM.getLI()->addRange(LiveRange(ParentVNI->def,
                                     ParentVNI->def.getNextSlot(), VNI));
-    // Mark all values as complex to force liveness computation.
-    // This should really only be necessary for remat victims, but we are lazy.
-    LIM.markComplexMapped(ParentVNI);
   }
 
 #ifndef NDEBUG
@@ -833,14 +895,12 @@ void SplitEditor::finish() {
     assert((*I)->hasAtLeastOneValue() && "Split interval has no value");
 #endif
 
-  // FIXME: Don't recompute the liveness of all values, infer it from the
-  // overlaps between the parent live interval and RegAssign.
   // The mapValue algorithm is only necessary when:
   // - The parent value maps to multiple defs, and new phis are needed, or
   // - The value has been rematerialized before some uses, and we want to
   //   minimize the live range so it only reaches the remaining uses.
-  // All other values have simple liveness that can be computed from RegAssign
-  // and the parent live interval.
+  // All other values keep their parent live ranges.
+  transferSimpleValues();
 
   // Extend live ranges to be live-out for successor PHI values.
   for (LiveInterval::const_vni_iterator I = Edit.getParent().vni_begin(),
@@ -874,7 +934,8 @@ void SplitEditor::finish() {
   // Rewrite instructions.
   rewriteAssigned();
 
-  // FIXME: Delete defs that were rematted everywhere.
+  // Delete defs that were rematted everywhere.
+  deleteRematVictims();
 
   // Get rid of unused values and set phi-kill flags.
   for (LiveRangeEdit::iterator I = Edit.begin(), E = Edit.end(); I != E; ++I)
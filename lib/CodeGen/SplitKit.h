@@ -295,6 +295,15 @@ class SplitEditor {
                         MachineBasicBlock &MBB,
                         MachineBasicBlock::iterator I);
 
+  /// transferSimpleValues - Copy the live ranges of parent values that stay
+  /// in a single new interval directly from the parent, and mark all other
+  /// values complex so their liveness is computed from their uses.
+  void transferSimpleValues();
+
+  /// deleteRematVictims - Delete defs of parent values that were rematerialized
+  /// before all of their uses, and shrink the intervals they read.
+  void deleteRematVictims();
+
   /// rewriteAssigned - Rewrite all uses of Edit.getReg() to assigned registers.
   void rewriteAssigned();
 
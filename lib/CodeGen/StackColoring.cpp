@@ -0,0 +1,474 @@
+//===-- StackColoring.cpp - Merge allocas with disjoint lifetimes ---------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This pass merges the stack objects of static allocas whose lifetimes are
+// disjoint, so they can share one stack slot. StackSlotColoring does the same
+// for spill slots after register allocation, but it cannot see user allocas.
+//
+// Instruction selection turns the llvm.lifetime.start/end intrinsics into
+// LIFETIME_START and LIFETIME_END markers on frame indices. This pass runs
+// right after instruction selection. It computes which markers are live on
+// block boundaries with a data flow analysis over the CFG, and builds a
+// SlotIndexes based live interval for every marked object. Objects whose
+// intervals don't overlap are merged, biggest first, and all references are
+// rewritten to the surviving frame index. The markers are always removed, so
+// no later pass has to deal with them.
+//
+// An object that is accessed outside of its marked lifetime is left alone.
+//
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "stack-coloring"
+#include "llvm/Function.h"
+#include "llvm/Instructions.h"
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/CodeGen/LiveInterval.h"
+#include "llvm/CodeGen/MachineFrameInfo.h"
+#include "llvm/CodeGen/MachineFunctionPass.h"
+#include "llvm/CodeGen/MachineMemOperand.h"
+#include "llvm/CodeGen/MachineModuleInfo.h"
+#include "llvm/CodeGen/Passes.h"
+#include "llvm/CodeGen/PseudoSourceValue.h"
+#include "llvm/CodeGen/SlotIndexes.h"
+#include "llvm/Target/TargetInstrDesc.h"
+#include "llvm/Target/TargetOpcodes.h"
+#include "llvm/Target/TargetRegisterInfo.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DepthFirstIterator.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Statistic.h"
+#include <algorithm>
+using namespace llvm;
+
+static cl::opt<bool>
+DisableColoring("no-stack-coloring",
+                cl::init(false), cl::Hidden,
+                cl::desc("Suppress stack coloring of allocas"));
+
+STATISTIC(NumMarkers,      "Number of lifetime markers found");
+STATISTIC(NumSlotsMerged,  "Number of stack objects merged");
+STATISTIC(StackSpaceSaved, "Number of bytes of stack saved by merging");
+
+namespace {
+  class StackColoring : public MachineFunctionPass {
+    MachineFunction *MF;
+    MachineFrameInfo *MFI;
+    SlotIndexes *Indexes;
+
+    /// BlockLifetimeInfo - Marker summary and live-in / live-out sets of one
+    /// basic block, indexed by frame index.
+    struct BlockLifetimeInfo {
+      /// Begin - Objects whose last marker in the block is a start.
+      BitVector Begin;
+      /// End - Objects whose last marker in the block is an end.
+      BitVector End;
+      BitVector LiveIn, LiveOut;
+    };
+
+    /// BlockLiveness - Indexed by basic block number.
+    SmallVector<BlockLifetimeInfo, 8> BlockLiveness;
+
+    /// Markers - All LIFETIME_START and LIFETIME_END instructions.
+    SmallVector<MachineInstr*, 8> Markers;
+
+    /// Intervals - The lifetime of each marked object, indexed by frame
+    /// index. Unmarked objects have no interval.
+    SmallVector<LiveInterval*, 16> Intervals;
+    VNInfo::Allocator VNInfoAllocator;
+
+    /// Colorable - Marked objects that may be merged.
+    BitVector Colorable;
+
+  public:
+    static char ID; // Pass identification
+    StackColoring() : MachineFunctionPass(ID) {
+      initializeStackColoringPass(*PassRegistry::getPassRegistry());
+    }
+
+    virtual void getAnalysisUsage(AnalysisUsage &AU) const {
+      AU.setPreservesCFG();
+      AU.addRequired<SlotIndexes>();
+      MachineFunctionPass::getAnalysisUsage(AU);
+    }
+
+    virtual bool runOnMachineFunction(MachineFunction &MF);
+    virtual void releaseMemory();
+
+    virtual const char* getPassName() const {
+      return "Stack Coloring";
+    }
+
+  private:
+    static bool isMarker(const MachineInstr *MI) {
+      return MI->getOpcode() == TargetOpcode::LIFETIME_START ||
+             MI->getOpcode() == TargetOpcode::LIFETIME_END;
+    }
+
+    unsigned collectMarkers();
+    void calculateLocalLiveness();
+    void calculateLiveIntervals();
+    void excludeEscapingObjects();
+    unsigned mergeObjects(DenseMap<int, int> &SlotRemap);
+    void remapReferences(const DenseMap<int, int> &SlotRemap);
+    void removeAllMarkers();
+  };
+} // end anonymous namespace
+
+char StackColoring::ID = 0;
+
+INITIALIZE_PASS_BEGIN(StackColoring, "stack-coloring",
+                      "Merge disjoint stack slots", false, false)
+INITIALIZE_PASS_DEPENDENCY(SlotIndexes)
+INITIALIZE_PASS_END(StackColoring, "stack-coloring",
+                    "Merge disjoint stack slots", false, false)
+
+FunctionPass *llvm::createStackColoringPass() {
+  return new StackColoring();
+}
+
+void StackColoring::releaseMemory() {
+  for (unsigned i = 0, e = Intervals.size(); i != e; ++i)
+    delete Intervals[i];
+  Intervals.clear();
+  VNInfoAllocator.Reset();
+  BlockLiveness.clear();
+  Markers.clear();
+}
+
+/// collectMarkers - Find all lifetime markers, compute the Begin and End sets
+/// of every block, and mark the objects they refer to as colorable. Return
+/// the number of marked objects.
+unsigned StackColoring::collectMarkers() {
+  unsigned NumSlots = MFI->getObjectIndexEnd();
+  Colorable.clear();
+  Colorable.resize(NumSlots);
+  BlockLiveness.resize(MF->getNumBlockIDs());
+
+  for (MachineFunction::iterator MBB = MF->begin(), E = MF->end();
+       MBB != E; ++MBB) {
+    BlockLifetimeInfo &BI = BlockLiveness[MBB->getNumber()];
+    BI.Begin.resize(NumSlots);
+    BI.End.resize(NumSlots);
+    BI.LiveIn.resize(NumSlots);
+    BI.LiveOut.resize(NumSlots);
+    for (MachineBasicBlock::iterator MI = MBB->begin(), ME = MBB->end();
+         MI != ME; ++MI) {
+      if (!isMarker(MI))
+        continue;
+      Markers.push_back(MI);
+      int Slot = MI->getOperand(0).getIndex();
+      if (Slot < 0)
+        continue;
+      Colorable.set(Slot);
+      if (MI->getOpcode() == TargetOpcode::LIFETIME_START) {
+        BI.Begin.set(Slot);
+        BI.End.reset(Slot);
+      } else {
+        BI.Begin.reset(Slot);
+        BI.End.set(Slot);
+      }
+    }
+  }
+  NumMarkers += Markers.size();
+  return Colorable.count();
+}
+
+/// calculateLocalLiveness - Propagate the marked lifetimes across the CFG
+/// until the live-in and live-out sets of all blocks are stable.
+void StackColoring::calculateLocalLiveness() {
+  bool Changed = true;
+  while (Changed) {
+    Changed = false;
+    for (df_iterator<MachineFunction*> DI = df_begin(MF), DE = df_end(MF);
+         DI != DE; ++DI) {
+      MachineBasicBlock *MBB = *DI;
+      BlockLifetimeInfo &BI = BlockLiveness[MBB->getNumber()];
+
+      // An object is live into a block if it is live out of a predecessor.
+      BitVector LiveIn(BI.LiveIn.size());
+      for (MachineBasicBlock::const_pred_iterator PI = MBB->pred_begin(),
+           PE = MBB->pred_end(); PI != PE; ++PI)
+        LiveIn |= BlockLiveness[(*PI)->getNumber()].LiveOut;
+
+      // It is live out if it is live in and not ended in the block, or if it
+      // is started in the block.
+      BitVector LiveOut = BI.End;
+      LiveOut.flip();
+      LiveOut &= LiveIn;
+      LiveOut |= BI.Begin;
+
+      if (LiveIn != BI.LiveIn || LiveOut != BI.LiveOut) {
+        BI.LiveIn = LiveIn;
+        BI.LiveOut = LiveOut;
+        Changed = true;
+      }
+    }
+  }
+}
+
+/// calculateLiveIntervals - Build a live interval for every colorable object
+/// from the block live-in sets and the markers inside each block.
+void StackColoring::calculateLiveIntervals() {
+  unsigned NumSlots = Colorable.size();
+  Intervals.assign(NumSlots, 0);
+  for (int Slot = Colorable.find_first(); Slot >= 0;
+       Slot = Colorable.find_next(Slot)) {
+    LiveInterval *LI =
+      new LiveInterval(TargetRegisterInfo::index2StackSlot(Slot), 0.0F);
+    LI->getNextValue(SlotIndex(), 0, VNInfoAllocator);
+    Intervals[Slot] = LI;
+  }
+
+  // OpenAt - Where the current lifetime of each object began in the block.
+  SmallVector<SlotIndex, 16> OpenAt(NumSlots);
+  for (MachineFunction::iterator MBB = MF->begin(), E = MF->end();
+       MBB != E; ++MBB) {
+    BlockLifetimeInfo &BI = BlockLiveness[MBB->getNumber()];
+    SlotIndex Start, Stop;
+    tie(Start, Stop) = Indexes->getMBBRange(MBB);
+
+    BitVector Open = BI.LiveIn;
+    for (int Slot = Open.find_first(); Slot >= 0; Slot = Open.find_next(Slot))
+      OpenAt[Slot] = Start;
+
+    for (MachineBasicBlock::iterator MI = MBB->begin(), ME = MBB->end();
+         MI != ME; ++MI) {
+      if (!isMarker(MI))
+        continue;
+      int Slot = MI->getOperand(0).getIndex();
+      if (Slot < 0)
+        continue;
+      SlotIndex Idx = Indexes->getInstructionIndex(MI);
+      if (MI->getOpcode() == TargetOpcode::LIFETIME_START) {
+        if (!Open.test(Slot)) {
+          Open.set(Slot);
+          OpenAt[Slot] = Idx;
+        }
+      } else if (Open.test(Slot)) {
+        LiveInterval *LI = Intervals[Slot];
+        if (OpenAt[Slot] < Idx)
+          LI->addRange(LiveRange(OpenAt[Slot], Idx, LI->getValNumInfo(0)));
+        Open.reset(Slot);
+      }
+    }
+
+    for (int Slot = Open.find_first(); Slot >= 0; Slot = Open.find_next(Slot)) {
+      LiveInterval *LI = Intervals[Slot];
+      if (OpenAt[Slot] < Stop)
+        LI->addRange(LiveRange(OpenAt[Slot], Stop, LI->getValNumInfo(0)));
+    }
+  }
+}
+
+/// excludeEscapingObjects - The markers only describe the lifetime correctly
+/// if every access to the object lies inside it. Objects that are accessed
+/// outside of their markers, or that can't be merged for other reasons, are
+/// not colorable. Instructions that only compute the address of an object
+/// don't count; the scheduler is free to move them ahead of the start marker.
+void StackColoring::excludeEscapingObjects() {
+  for (int Slot = Colorable.find_first(); Slot >= 0;
+       Slot = Colorable.find_next(Slot))
+    if (Intervals[Slot]->empty() || MFI->isSpillSlotObjectIndex(Slot) ||
+        MFI->isDeadObjectIndex(Slot) || MFI->getObjectSize(Slot) == 0 ||
+        MFI->isObjectPreAllocated(Slot))
+      Colorable.reset(Slot);
+
+  for (MachineFunction::iterator MBB = MF->begin(), E = MF->end();
+       MBB != E; ++MBB)
+    for (MachineBasicBlock::iterator MI = MBB->begin(), ME = MBB->end();
+         MI != ME; ++MI) {
+      const TargetInstrDesc &TID = MI->getDesc();
+      if (!TID.mayLoad() && !TID.mayStore() && !MI->isInlineAsm())
+        continue;
+      for (unsigned i = 0, e = MI->getNumOperands(); i != e; ++i) {
+        const MachineOperand &MO = MI->getOperand(i);
+        if (!MO.isFI())
+          continue;
+        int Slot = MO.getIndex();
+        if (Slot < 0 || !Colorable.test(Slot))
+          continue;
+        if (!Intervals[Slot]->liveAt(Indexes->getInstructionIndex(MI))) {
+          DEBUG(dbgs() << "fi#" << Slot
+                       << " is accessed outside its lifetime: " << *MI);
+          Colorable.reset(Slot);
+        }
+      }
+    }
+}
+
+namespace {
+  /// SlotSizeSorter - Order frame indices by decreasing object size, so the
+  /// biggest objects absorb the smaller ones.
+  struct SlotSizeSorter {
+    const MachineFrameInfo *MFI;
+    SlotSizeSorter(const MachineFrameInfo *mfi) : MFI(mfi) {}
+    bool operator()(int LHS, int RHS) const {
+      int64_t LSize = MFI->getObjectSize(LHS), RSize = MFI->getObjectSize(RHS);
+      if (LSize != RSize)
+        return LSize > RSize;
+      return LHS < RHS;
+    }
+  };
+}
+
+/// mergeObjects - Greedily merge colorable objects with disjoint intervals.
+/// Record the surviving frame index of every merged object in SlotRemap and
+/// return the number of merged objects.
+unsigned StackColoring::mergeObjects(DenseMap<int, int> &SlotRemap) {
+  SmallVector<int, 16> Slots;
+  for (int Slot = Colorable.find_first(); Slot >= 0;
+       Slot = Colorable.find_next(Slot))
+    Slots.push_back(Slot);
+  std::sort(Slots.begin(), Slots.end(), SlotSizeSorter(MFI));
+
+  unsigned NumMerged = 0;
+  for (unsigned i = 0, e = Slots.size(); i != e; ++i) {
+    int To = Slots[i];
+    if (SlotRemap.count(To))
+      continue;
+    LiveInterval *ToLI = Intervals[To];
+    for (unsigned j = i + 1; j != e; ++j) {
+      int From = Slots[j];
+      if (SlotRemap.count(From))
+        continue;
+      // Keep objects that want to sit next to the stack protector apart from
+      // those that don't.
+      if (MFI->MayNeedStackProtector(To) != MFI->MayNeedStackProtector(From))
+        continue;
+      LiveInterval *FromLI = Intervals[From];
+      if (ToLI->overlaps(*FromLI))
+        continue;
+
+      DEBUG(dbgs() << "Merging fi#" << From << " into fi#" << To << '\n');
+      ToLI->MergeRangesInAsValue(*FromLI, ToLI->getValNumInfo(0));
+      SlotRemap[From] = To;
+      unsigned Align = std::max(MFI->getObjectAlignment(To),
+                                MFI->getObjectAlignment(From));
+      MFI->setObjectAlignment(To, Align);
+      StackSpaceSaved += MFI->getObjectSize(From);
+      ++NumMerged;
+    }
+  }
+  NumSlotsMerged += NumMerged;
+  return NumMerged;
+}
+
+/// remapReferences - Rewrite frame index operands, memory operands and debug
+/// variable locations that refer to merged objects.
+void StackColoring::remapReferences(const DenseMap<int, int> &SlotRemap) {
+  // Memory operands refer to the allocas. Accesses to the alloca itself now
+  // access the surviving alloca, but accesses at an offset into it can't be
+  // described relative to another object and lose their value. So do accesses
+  // whose underlying object isn't an alloca: they may point into a merged
+  // alloca, which now overlaps others.
+  DenseMap<const AllocaInst*, const AllocaInst*> AllocaRemap;
+  for (DenseMap<int, int>::const_iterator I = SlotRemap.begin(),
+       E = SlotRemap.end(); I != E; ++I)
+    if (const AllocaInst *From = MFI->getObjectAllocation(I->first))
+      AllocaRemap[From] = MFI->getObjectAllocation(I->second);
+
+  for (MachineFunction::iterator MBB = MF->begin(), E = MF->end();
+       MBB != E; ++MBB)
+    for (MachineBasicBlock::iterator MI = MBB->begin(), ME = MBB->end();
+         MI != ME; ++MI) {
+      for (unsigned i = 0, e = MI->getNumOperands(); i != e; ++i) {
+        MachineOperand &MO = MI->getOperand(i);
+        if (!MO.isFI())
+          continue;
+        DenseMap<int, int>::const_iterator RI = SlotRemap.find(MO.getIndex());
+        if (RI != SlotRemap.end())
+          MO.setIndex(RI->second);
+      }
+
+      for (MachineInstr::mmo_iterator MMI = MI->memoperands_begin(),
+           MME = MI->memoperands_end(); MMI != MME; ++MMI) {
+        MachineMemOperand *MMO = *MMI;
+        const Value *V = MMO->getValue();
+        if (!V)
+          continue;
+        if (const FixedStackPseudoSourceValue *FS =
+              dyn_cast<FixedStackPseudoSourceValue>(V)) {
+          DenseMap<int, int>::const_iterator RI =
+            SlotRemap.find(FS->getFrameIndex());
+          if (RI != SlotRemap.end())
+            MMO->setValue(PseudoSourceValue::getFixedStack(RI->second));
+          continue;
+        }
+        if (isa<PseudoSourceValue>(V))
+          continue;
+        const AllocaInst *AI = dyn_cast<AllocaInst>(GetUnderlyingObject(V));
+        if (!AI) {
+          MMO->setValue(0);
+          continue;
+        }
+        DenseMap<const AllocaInst*, const AllocaInst*>::iterator AR =
+          AllocaRemap.find(AI);
+        if (AR == AllocaRemap.end())
+          continue;
+        MMO->setValue(V == AI ? AR->second : 0);
+      }
+    }
+
+  MachineModuleInfo::VariableDbgInfoMapTy &VMap =
+    MF->getMMI().getVariableDbgInfo();
+  for (MachineModuleInfo::VariableDbgInfoMapTy::iterator VI = VMap.begin(),
+       VE = VMap.end(); VI != VE; ++VI) {
+    DenseMap<int, int>::const_iterator RI =
+      SlotRemap.find(VI->second.first);
+    if (RI != SlotRemap.end())
+      VI->second.first = RI->second;
+  }
+
+  for (DenseMap<int, int>::const_iterator I = SlotRemap.begin(),
+       E = SlotRemap.end(); I != E; ++I)
+    MFI->RemoveStackObject(I->first);
+}
+
+void StackColoring::removeAllMarkers() {
+  for (unsigned i = 0, e = Markers.size(); i != e; ++i) {
+    Indexes->removeMachineInstrFromMaps(Markers[i]);
+    Markers[i]->eraseFromParent();
+  }
+  Markers.clear();
+}
+
+bool StackColoring::runOnMachineFunction(MachineFunction &mf) {
+  MF = &mf;
+  MFI = MF->getFrameInfo();
+  Indexes = &getAnalysis<SlotIndexes>();
+
+  DEBUG(dbgs() << "********** Stack Coloring **********\n"
+               << "********** Function: "
+               << MF->getFunction()->getName() << '\n');
+
+  unsigned NumMarked = collectMarkers();
+  if (Markers.empty())
+    return false;
+
+  // Coloring needs at least two objects to merge.
+  if (DisableColoring || NumMarked < 2) {
+    removeAllMarkers();
+    return true;
+  }
+
+  calculateLocalLiveness();
+  calculateLiveIntervals();
+  excludeEscapingObjects();
+
+  DenseMap<int, int> SlotRemap;
+  if (mergeObjects(SlotRemap))
+    remapReferences(SlotRemap);
+
+  removeAllMarkers();
+  return true;
+}
@@ -17,6 +17,7 @@
 #define DEBUG_TYPE "stack-protector"
 #include "llvm/CodeGen/Passes.h"
 #include "llvm/Analysis/Dominators.h"
+#include "llvm/Analysis/ProfileInfo.h"
 #include "llvm/Attributes.h"
 #include "llvm/Constants.h"
 #include "llvm/DerivedTypes.h"
@@ -75,6 +76,7 @@ namespace {
 
     virtual void getAnalysisUsage(AnalysisUsage &AU) const {
       AU.addPreserved<DominatorTree>();
+      AU.addPreserved<ProfileInfo>();
     }
 
     virtual bool runOnFunction(Function &Fn);
@@ -77,15 +77,23 @@ MCSymbol *MCContext::GetOrCreateSymbol(StringRef Name) {
 
 MCSymbol *MCContext::CreateSymbol(StringRef Name) {
   // Determine whether this is an assembler temporary or normal label.
-  bool isTemporary = Name.startswith(MAI.getPrivateGlobalPrefix());
+  StringRef PrivatePrefix = MAI.getPrivateGlobalPrefix();
+  bool isTemporary = Name.startswith(PrivatePrefix);
+
+  SmallString<128> TaggedName;
+  if (isTemporary && !TempSymbolTag.empty() && !PrivatePrefix.empty()) {
+    (PrivatePrefix + TempSymbolTag +
+     Name.substr(PrivatePrefix.size())).toVector(TaggedName);
+    Name = TaggedName;
+  }
 
   StringMapEntry<bool> *NameEntry = &UsedNames.GetOrCreateValue(Name);
   if (NameEntry->getValue()) {
     assert(isTemporary && "Cannot rename non temporary symbols");
     SmallString<128> NewName;
     do {
-      Twine T = Name + Twine(NextUniqueID++);
-      T.toVector(NewName);
+      NewName.clear();
+      (Name + Twine(NextUniqueID++)).toVector(NewName);
       StringRef foo = NewName;
       NameEntry = &UsedNames.GetOrCreateValue(foo);
     } while (NameEntry->getValue());
@@ -107,9 +115,8 @@ MCSymbol *MCContext::GetOrCreateSymbol(const Twine &Name) {
 
 MCSymbol *MCContext::CreateTempSymbol() {
   SmallString<128> NameSV;
-  Twine Name = Twine(MAI.getPrivateGlobalPrefix()) + "tmp" +
-    Twine(NextUniqueID++);
-  Name.toVector(NameSV);
+  (Twine(MAI.getPrivateGlobalPrefix()) + "tmp" +
+   Twine(NextUniqueID++)).toVector(NameSV);
   return CreateSymbol(NameSV);
 }
 
@@ -75,12 +75,13 @@ public:
 private:
   bool X86FastEmitCompare(const Value *LHS, const Value *RHS, EVT VT);
 
-  bool X86FastEmitLoad(EVT VT, const X86AddressMode &AM, unsigned &RR);
+  bool X86FastEmitLoad(EVT VT, const X86AddressMode &AM, unsigned &RR,
+                       unsigned Alignment = 0);
 
   bool X86FastEmitStore(EVT VT, const Value *Val,
-                        const X86AddressMode &AM);
+                        const X86AddressMode &AM, unsigned Alignment = 0);
   bool X86FastEmitStore(EVT VT, unsigned Val,
-                        const X86AddressMode &AM);
+                        const X86AddressMode &AM, unsigned Alignment = 0);
 
   bool X86FastEmitExtend(ISD::NodeType Opc, EVT DstVT, unsigned Src, EVT SrcVT,
                          unsigned &ResultReg);
@@ -100,6 +101,8 @@ private:
 
   bool X86SelectBranch(const Instruction *I);
 
+  bool X86SelectSwitch(const Instruction *I);
+
   bool X86SelectShift(const Instruction *I);
 
   bool X86SelectSelect(const Instruction *I);
@@ -109,10 +112,18 @@ private:
   bool X86SelectFPExt(const Instruction *I);
   bool X86SelectFPTrunc(const Instruction *I);
 
+  bool X86SelectIntToFP(const Instruction *I, bool IsSigned);
+  bool X86SelectFPToInt(const Instruction *I, bool IsSigned);
+
   bool X86SelectExtractValue(const Instruction *I);
 
   bool X86VisitIntrinsicCall(const IntrinsicInst &I);
   bool X86SelectCall(const Instruction *I);
+  bool DoSelectCall(const Instruction *I, const char *MemIntName);
+
+  bool IsMemcpySmall(uint64_t Len) const;
+  void X86EmitSmallMemcpy(X86AddressMode DestAM, X86AddressMode SrcAM,
+                          uint64_t Len);
 
   const X86InstrInfo *getInstrInfo() const {
     return getTargetMachine()->getInstrInfo();
@@ -164,9 +175,11 @@ bool X86FastISel::isTypeLegal(const Type *Ty, MVT &VT, bool AllowI1) {
 
 /// X86FastEmitLoad - Emit a machine instruction to load a value of type VT.
 /// The address is either pre-computed, i.e. Ptr, or a GlobalAddress, i.e. GV.
+/// Alignment is the known alignment of the address; it picks between the
+/// aligned and unaligned forms of the 128-bit vector loads.
 /// Return true and the result register by reference if it is possible.
 bool X86FastISel::X86FastEmitLoad(EVT VT, const X86AddressMode &AM,
-                                  unsigned &ResultReg) {
+                                  unsigned &ResultReg, unsigned Alignment) {
   // Get opcode and regclass of the output for the given load instruction.
   unsigned Opc = 0;
   const TargetRegisterClass *RC = NULL;
@@ -211,6 +224,21 @@ bool X86FastISel::X86FastEmitLoad(EVT VT, const X86AddressMode &AM,
   case MVT::f80:
     // No f80 support yet.
     return false;
+  case MVT::v4f32:
+    Opc = Alignment >= 16 ? X86::MOVAPSrm : X86::MOVUPSrm;
+    RC  = X86::VR128RegisterClass;
+    break;
+  case MVT::v2f64:
+    Opc = Alignment >= 16 ? X86::MOVAPDrm : X86::MOVUPDrm;
+    RC  = X86::VR128RegisterClass;
+    break;
+  case MVT::v2i64:
+  case MVT::v4i32:
+  case MVT::v8i16:
+  case MVT::v16i8:
+    Opc = Alignment >= 16 ? X86::MOVDQArm : X86::MOVDQUrm;
+    RC  = X86::VR128RegisterClass;
+    break;
   }
 
   ResultReg = createResultReg(RC);
@@ -225,7 +253,7 @@ bool X86FastISel::X86FastEmitLoad(EVT VT, const X86AddressMode &AM,
 /// i.e. V. Return true if it is possible.
 bool
 X86FastISel::X86FastEmitStore(EVT VT, unsigned Val,
-                              const X86AddressMode &AM) {
+                              const X86AddressMode &AM, unsigned Alignment) {
   // Get opcode and regclass of the output for the given store instruction.
   unsigned Opc = 0;
   switch (VT.getSimpleVT().SimpleTy) {
@@ -249,6 +277,18 @@ X86FastISel::X86FastEmitStore(EVT VT, unsigned Val,
   case MVT::f64:
     Opc = Subtarget->hasSSE2() ? X86::MOVSDmr : X86::ST_Fp64m;
     break;
+  case MVT::v4f32:
+    Opc = Alignment >= 16 ? X86::MOVAPSmr : X86::MOVUPSmr;
+    break;
+  case MVT::v2f64:
+    Opc = Alignment >= 16 ? X86::MOVAPDmr : X86::MOVUPDmr;
+    break;
+  case MVT::v2i64:
+  case MVT::v4i32:
+  case MVT::v8i16:
+  case MVT::v16i8:
+    Opc = Alignment >= 16 ? X86::MOVDQAmr : X86::MOVDQUmr;
+    break;
   }
 
   addFullAddress(BuildMI(*FuncInfo.MBB, FuncInfo.InsertPt,
@@ -257,7 +297,8 @@ X86FastISel::X86FastEmitStore(EVT VT, unsigned Val,
 }
 
 bool X86FastISel::X86FastEmitStore(EVT VT, const Value *Val,
-                                   const X86AddressMode &AM) {
+                                   const X86AddressMode &AM,
+                                   unsigned Alignment) {
   // Handle 'null' like i32/i64 0.
   if (isa<ConstantPointerNull>(Val))
     Val = Constant::getNullValue(TD.getIntPtrType(Val->getContext()));
@@ -292,7 +333,7 @@ bool X86FastISel::X86FastEmitStore(EVT VT, const Value *Val,
   if (ValReg == 0)
     return false;
 
-  return X86FastEmitStore(VT, ValReg, AM);
+  return X86FastEmitStore(VT, ValReg, AM, Alignment);
 }
 
 /// X86FastEmitExtend - Emit a machine instruction to extend a value Src of
@@ -640,15 +681,20 @@ bool X86FastISel::X86SelectCallAddress(const Value *V, X86AddressMode &AM) {
 
 /// X86SelectStore - Select and emit code to implement store instructions.
 bool X86FastISel::X86SelectStore(const Instruction *I) {
+  const StoreInst *SI = cast<StoreInst>(I);
   MVT VT;
-  if (!isTypeLegal(I->getOperand(0)->getType(), VT, /*AllowI1=*/true))
+  if (!isTypeLegal(SI->getValueOperand()->getType(), VT, /*AllowI1=*/true))
     return false;
 
   X86AddressMode AM;
-  if (!X86SelectAddress(I->getOperand(1), AM))
+  if (!X86SelectAddress(SI->getPointerOperand(), AM))
     return false;
 
-  return X86FastEmitStore(VT, I->getOperand(0), AM);
+  unsigned Alignment = SI->getAlignment();
+  if (Alignment == 0)
+    Alignment = TD.getABITypeAlignment(SI->getValueOperand()->getType());
+
+  return X86FastEmitStore(VT, SI->getValueOperand(), AM, Alignment);
 }
 
 /// X86SelectRet - Select and emit code to implement ret instructions.
@@ -709,18 +755,42 @@ bool X86FastISel::X86SelectRet(const Instruction *I) {
     // Only handle register returns for now.
     if (!VA.isRegLoc())
       return false;
-    // TODO: For now, don't try to handle cases where getLocInfo()
-    // says Full but the types don't match.
-    if (TLI.getValueType(RV->getType()) != VA.getValVT())
-      return false;
 
     // The calling-convention tables for x87 returns don't tell
     // the whole story.
     if (VA.getLocReg() == X86::ST0 || VA.getLocReg() == X86::ST1)
       return false;
 
-    // Make the copy.
     unsigned SrcReg = Reg + VA.getValNo();
+    EVT SrcVT = TLI.getValueType(RV->getType());
+    EVT DstVT = VA.getValVT();
+    // Small integers are returned extended: as directed by a zeroext or
+    // signext attribute, or to i8 for an i1 without either.
+    if (SrcVT != DstVT) {
+      if (SrcVT != MVT::i1 && SrcVT != MVT::i8 && SrcVT != MVT::i16)
+        return false;
+
+      bool IsSExt = Outs[0].Flags.isSExt();
+      if (SrcVT == MVT::i1) {
+        if (IsSExt)
+          return false;
+        SrcReg = FastEmitZExtFromI1(MVT::i8, SrcReg, /*TODO: Kill=*/false);
+        if (SrcReg == 0)
+          return false;
+        SrcVT = MVT::i8;
+      }
+      if (SrcVT != DstVT) {
+        if (!IsSExt && !Outs[0].Flags.isZExt())
+          return false;
+        SrcReg = FastEmit_r(SrcVT.getSimpleVT(), DstVT.getSimpleVT(),
+                            IsSExt ? ISD::SIGN_EXTEND : ISD::ZERO_EXTEND,
+                            SrcReg, /*TODO: Kill=*/false);
+        if (SrcReg == 0)
+          return false;
+      }
+    }
+
+    // Make the copy.
     unsigned DstReg = VA.getLocReg();
     const TargetRegisterClass* SrcRC = MRI.getRegClass(SrcReg);
     // Avoid a cross-class copy. This is very unlikely.
@@ -741,16 +811,21 @@ bool X86FastISel::X86SelectRet(const Instruction *I) {
 /// X86SelectLoad - Select and emit code to implement load instructions.
 ///
 bool X86FastISel::X86SelectLoad(const Instruction *I)  {
+  const LoadInst *LI = cast<LoadInst>(I);
   MVT VT;
-  if (!isTypeLegal(I->getType(), VT, /*AllowI1=*/true))
+  if (!isTypeLegal(LI->getType(), VT, /*AllowI1=*/true))
     return false;
 
   X86AddressMode AM;
-  if (!X86SelectAddress(I->getOperand(0), AM))
+  if (!X86SelectAddress(LI->getPointerOperand(), AM))
     return false;
 
+  unsigned Alignment = LI->getAlignment();
+  if (Alignment == 0)
+    Alignment = TD.getABITypeAlignment(LI->getType());
+
   unsigned ResultReg = 0;
-  if (X86FastEmitLoad(VT, AM, ResultReg)) {
+  if (X86FastEmitLoad(VT, AM, ResultReg, Alignment)) {
     UpdateValueMap(I, ResultReg);
     return true;
   }
@@ -1070,6 +1145,89 @@ bool X86FastISel::X86SelectBranch(const Instruction *I) {
   return true;
 }
 
+/// X86SelectSwitch - Lower a switch with a handful of cases into a chain of
+/// compares and conditional branches, one compare per machine basic block.
+/// Larger switches are left to SelectionDAG, which can build jump tables and
+/// balanced trees for them.
+bool X86FastISel::X86SelectSwitch(const Instruction *I) {
+  const SwitchInst *SI = cast<SwitchInst>(I);
+  // Case 0 is the default destination.
+  const unsigned MaxCases = 16;
+  if (SI->getNumCases() > MaxCases + 1)
+    return false;
+
+  MVT VT;
+  if (!isTypeLegal(SI->getCondition()->getType(), VT))
+    return false;
+
+  // Only compares against immediates are emitted, so that no constant has to
+  // be materialized outside of the first block.
+  MachineBasicBlock *DefaultMBB = FuncInfo.MBBMap[SI->getDefaultDest()];
+  SmallVector<unsigned, 8> Cases;
+  for (unsigned i = 1, e = SI->getNumCases(); i != e; ++i) {
+    // Cases that branch to the default destination need no test.
+    if (FuncInfo.MBBMap[SI->getSuccessor(i)] == DefaultMBB)
+      continue;
+    if (!X86ChooseCmpImmediateOpcode(VT, SI->getCaseValue(i)))
+      return false;
+    Cases.push_back(i);
+  }
+
+  unsigned CondReg = getRegForValue(SI->getCondition());
+  if (CondReg == 0)
+    return false;
+
+  // Each compare ends its block with a conditional branch to the case and a
+  // fall-through to the block holding the next compare.  The first compare
+  // stays in the current block, so the rest of the LLVM block is still
+  // selected into it.
+  MachineBasicBlock *HeadMBB = FuncInfo.MBB;
+  MachineBasicBlock *CurMBB = HeadMBB;
+  MachineBasicBlock::iterator InsertPt = FuncInfo.InsertPt;
+  SmallVector<MachineBasicBlock *, 8> ChainMBBs;
+  for (unsigned i = 0, e = Cases.size(); i != e; ++i) {
+    if (i != 0) {
+      MachineBasicBlock *NextMBB =
+        FuncInfo.MF->CreateMachineBasicBlock(HeadMBB->getBasicBlock());
+      FuncInfo.MF->insert(llvm::next(MachineFunction::iterator(CurMBB)),
+                          NextMBB);
+      CurMBB->addSuccessor(NextMBB);
+      CurMBB = NextMBB;
+      InsertPt = CurMBB->end();
+      ChainMBBs.push_back(CurMBB);
+    }
+
+    const ConstantInt *CaseVal = SI->getCaseValue(Cases[i]);
+    MachineBasicBlock *CaseMBB = FuncInfo.MBBMap[SI->getSuccessor(Cases[i])];
+    BuildMI(*CurMBB, InsertPt, DL,
+            TII.get(X86ChooseCmpImmediateOpcode(VT, CaseVal)))
+      .addReg(CondReg).addImm(CaseVal->getSExtValue());
+    BuildMI(*CurMBB, InsertPt, DL, TII.get(X86::JE_4)).addMBB(CaseMBB);
+    if (!CurMBB->isSuccessor(CaseMBB))
+      CurMBB->addSuccessor(CaseMBB);
+  }
+
+  if (!CurMBB->isLayoutSuccessor(DefaultMBB))
+    TII.InsertBranch(*CurMBB, DefaultMBB, NULL,
+                     SmallVector<MachineOperand, 0>(), DL);
+  if (!CurMBB->isSuccessor(DefaultMBB))
+    CurMBB->addSuccessor(DefaultMBB);
+
+  // The PHI operands coming from the first block are filled in when the
+  // block is finished.  Add the ones coming from the blocks created here.
+  for (unsigned i = 0, e = FuncInfo.PHINodesToUpdate.size(); i != e; ++i) {
+    MachineInstr *PHI = FuncInfo.PHINodesToUpdate[i].first;
+    for (unsigned j = 0, je = ChainMBBs.size(); j != je; ++j) {
+      if (!ChainMBBs[j]->isSuccessor(PHI->getParent()))
+        continue;
+      PHI->addOperand(
+        MachineOperand::CreateReg(FuncInfo.PHINodesToUpdate[i].second, false));
+      PHI->addOperand(MachineOperand::CreateMBB(ChainMBBs[j]));
+    }
+  }
+  return true;
+}
+
 bool X86FastISel::X86SelectShift(const Instruction *I) {
   unsigned CReg = 0, OpReg = 0, OpImm = 0;
   const TargetRegisterClass *RC = NULL;
@@ -1148,41 +1306,144 @@ bool X86FastISel::X86SelectShift(const Instruction *I) {
   return true;
 }
 
+/// getX86ConditionCode - Return the condition code that is true after a
+/// compare of the operands of a compare with predicate Predicate, setting
+/// SwapArgs if the operands must be compared in the reverse order. Return
+/// COND_INVALID for predicates that need more than one flag test.
+static X86::CondCode getX86ConditionCode(CmpInst::Predicate Predicate,
+                                         bool &SwapArgs) {
+  SwapArgs = false;
+  switch (Predicate) {
+  default:                return X86::COND_INVALID;
+  case CmpInst::FCMP_OGT: return X86::COND_A;
+  case CmpInst::FCMP_OGE: return X86::COND_AE;
+  case CmpInst::FCMP_OLT: SwapArgs = true; return X86::COND_A;
+  case CmpInst::FCMP_OLE: SwapArgs = true; return X86::COND_AE;
+  case CmpInst::FCMP_ONE: return X86::COND_NE;
+  case CmpInst::FCMP_ORD: return X86::COND_NP;
+  case CmpInst::FCMP_UNO: return X86::COND_P;
+  case CmpInst::FCMP_UEQ: return X86::COND_E;
+  case CmpInst::FCMP_UGT: SwapArgs = true; return X86::COND_B;
+  case CmpInst::FCMP_UGE: SwapArgs = true; return X86::COND_BE;
+  case CmpInst::FCMP_ULT: return X86::COND_B;
+  case CmpInst::FCMP_ULE: return X86::COND_BE;
+
+  case CmpInst::ICMP_EQ:  return X86::COND_E;
+  case CmpInst::ICMP_NE:  return X86::COND_NE;
+  case CmpInst::ICMP_UGT: return X86::COND_A;
+  case CmpInst::ICMP_UGE: return X86::COND_AE;
+  case CmpInst::ICMP_ULT: return X86::COND_B;
+  case CmpInst::ICMP_ULE: return X86::COND_BE;
+  case CmpInst::ICMP_SGT: return X86::COND_G;
+  case CmpInst::ICMP_SGE: return X86::COND_GE;
+  case CmpInst::ICMP_SLT: return X86::COND_L;
+  case CmpInst::ICMP_SLE: return X86::COND_LE;
+  }
+}
+
+/// X86ChooseCMovOpcode - Return the register-register CMOVcc opcode for a
+/// select of type VT, or 0 if there is none.
+static unsigned X86ChooseCMovOpcode(EVT VT, X86::CondCode CC) {
+  // Indexed by X86::CondCode.
+  static const unsigned CMov16[] = {
+    X86::CMOVA16rr, X86::CMOVAE16rr, X86::CMOVB16rr, X86::CMOVBE16rr,
+    X86::CMOVE16rr, X86::CMOVG16rr, X86::CMOVGE16rr, X86::CMOVL16rr,
+    X86::CMOVLE16rr, X86::CMOVNE16rr, X86::CMOVNO16rr, X86::CMOVNP16rr,
+    X86::CMOVNS16rr, X86::CMOVO16rr, X86::CMOVP16rr, X86::CMOVS16rr
+  };
+  static const unsigned CMov32[] = {
+    X86::CMOVA32rr, X86::CMOVAE32rr, X86::CMOVB32rr, X86::CMOVBE32rr,
+    X86::CMOVE32rr, X86::CMOVG32rr, X86::CMOVGE32rr, X86::CMOVL32rr,
+    X86::CMOVLE32rr, X86::CMOVNE32rr, X86::CMOVNO32rr, X86::CMOVNP32rr,
+    X86::CMOVNS32rr, X86::CMOVO32rr, X86::CMOVP32rr, X86::CMOVS32rr
+  };
+  static const unsigned CMov64[] = {
+    X86::CMOVA64rr, X86::CMOVAE64rr, X86::CMOVB64rr, X86::CMOVBE64rr,
+    X86::CMOVE64rr, X86::CMOVG64rr, X86::CMOVGE64rr, X86::CMOVL64rr,
+    X86::CMOVLE64rr, X86::CMOVNE64rr, X86::CMOVNO64rr, X86::CMOVNP64rr,
+    X86::CMOVNS64rr, X86::CMOVO64rr, X86::CMOVP64rr, X86::CMOVS64rr
+  };
+  if (CC > X86::COND_S)
+    return 0;
+  switch (VT.getSimpleVT().SimpleTy) {
+  default:       return 0;
+  case MVT::i16: return CMov16[CC];
+  case MVT::i32: return CMov32[CC];
+  case MVT::i64: return CMov64[CC];
+  }
+}
+
 bool X86FastISel::X86SelectSelect(const Instruction *I) {
+  const SelectInst *SI = cast<SelectInst>(I);
   MVT VT;
-  if (!isTypeLegal(I->getType(), VT))
+  if (!isTypeLegal(SI->getType(), VT))
     return false;
 
-  // We only use cmov here, if we don't have a cmov instruction bail.
-  if (!Subtarget->hasCMov()) return false;
-
-  unsigned Opc = 0;
-  const TargetRegisterClass *RC = NULL;
-  if (VT == MVT::i16) {
-    Opc = X86::CMOVE16rr;
-    RC = &X86::GR16RegClass;
-  } else if (VT == MVT::i32) {
-    Opc = X86::CMOVE32rr;
-    RC = &X86::GR32RegClass;
-  } else if (VT == MVT::i64) {
-    Opc = X86::CMOVE64rr;
-    RC = &X86::GR64RegClass;
-  } else {
+  // Integer selects use cmov when the subtarget has it. Everything else uses
+  // the CMOV_* pseudos, which the custom inserter expands into a branch
+  // diamond after instruction selection.
+  bool UseCMov = false;
+  unsigned PseudoOpc = 0;
+  switch (VT.SimpleTy) {
+  default: return false;
+  case MVT::i8:    PseudoOpc = X86::CMOV_GR8;   break;
+  case MVT::i16:   PseudoOpc = X86::CMOV_GR16;  UseCMov = true; break;
+  case MVT::i32:   PseudoOpc = X86::CMOV_GR32;  UseCMov = true; break;
+  case MVT::i64:   UseCMov = true; break;
+  case MVT::f32:   PseudoOpc = X86::CMOV_FR32;  break;
+  case MVT::f64:   PseudoOpc = X86::CMOV_FR64;  break;
+  case MVT::v4f32: PseudoOpc = X86::CMOV_V4F32; break;
+  case MVT::v2f64: PseudoOpc = X86::CMOV_V2F64; break;
+  case MVT::v2i64: PseudoOpc = X86::CMOV_V2I64; break;
+  }
+  if (!Subtarget->hasCMov())
+    UseCMov = false;
+  if (!UseCMov && PseudoOpc == 0)
     return false;
+
+  unsigned TrueReg = getRegForValue(SI->getTrueValue());
+  if (TrueReg == 0) return false;
+  unsigned FalseReg = getRegForValue(SI->getFalseValue());
+  if (FalseReg == 0) return false;
+
+  // Fold a single-use compare from this block into the select, as
+  // X86SelectBranch does for branches, rather than materializing the i1 with
+  // a setcc and testing it again.
+  X86::CondCode CC = X86::COND_INVALID;
+  const CmpInst *CI = dyn_cast<CmpInst>(SI->getCondition());
+  MVT CmpVT;
+  if (CI && CI->hasOneUse() && CI->getParent() == I->getParent() &&
+      isTypeLegal(CI->getOperand(0)->getType(), CmpVT)) {
+    bool SwapArgs;
+    CC = getX86ConditionCode(CI->getPredicate(), SwapArgs);
+    if (CC != X86::COND_INVALID) {
+      const Value *Op0 = CI->getOperand(0), *Op1 = CI->getOperand(1);
+      if (SwapArgs)
+        std::swap(Op0, Op1);
+      if (!X86FastEmitCompare(Op0, Op1, CmpVT))
+        return false;
+    }
   }
 
-  unsigned Op0Reg = getRegForValue(I->getOperand(0));
-  if (Op0Reg == 0) return false;
-  unsigned Op1Reg = getRegForValue(I->getOperand(1));
-  if (Op1Reg == 0) return false;
-  unsigned Op2Reg = getRegForValue(I->getOperand(2));
-  if (Op2Reg == 0) return false;
+  if (CC == X86::COND_INVALID) {
+    unsigned CondReg = getRegForValue(SI->getCondition());
+    if (CondReg == 0) return false;
+    BuildMI(*FuncInfo.MBB, FuncInfo.InsertPt, DL, TII.get(X86::TEST8rr))
+      .addReg(CondReg).addReg(CondReg);
+    CC = X86::COND_NE;
+  }
 
-  BuildMI(*FuncInfo.MBB, FuncInfo.InsertPt, DL, TII.get(X86::TEST8rr))
-    .addReg(Op0Reg).addReg(Op0Reg);
-  unsigned ResultReg = createResultReg(RC);
-  BuildMI(*FuncInfo.MBB, FuncInfo.InsertPt, DL, TII.get(Opc), ResultReg)
-    .addReg(Op1Reg).addReg(Op2Reg);
+  unsigned ResultReg = createResultReg(TLI.getRegClassFor(VT));
+  if (UseCMov) {
+    BuildMI(*FuncInfo.MBB, FuncInfo.InsertPt, DL,
+            TII.get(X86ChooseCMovOpcode(VT, CC)), ResultReg)
+      .addReg(FalseReg).addReg(TrueReg);
+  } else {
+    // The pseudo yields its second operand when the condition holds.
+    BuildMI(*FuncInfo.MBB, FuncInfo.InsertPt, DL, TII.get(PseudoOpc),
+            ResultReg)
+      .addReg(FalseReg).addReg(TrueReg).addImm(CC);
+  }
   UpdateValueMap(I, ResultReg);
   return true;
 }
@@ -1227,6 +1488,83 @@ bool X86FastISel::X86SelectFPTrunc(const Instruction *I) {
   return false;
 }
 
+/// X86SelectIntToFP - Select the int-to-fp conversions that have no direct
+/// SSE pattern: i8 and i16 sources, which are first extended to i32, and
+/// unsigned i32 sources on x86-64, which are converted from a zero-extended
+/// i64.
+bool X86FastISel::X86SelectIntToFP(const Instruction *I, bool IsSigned) {
+  MVT SrcVT, DstVT;
+  if (!isTypeLegal(I->getOperand(0)->getType(), SrcVT) ||
+      !isTypeLegal(I->getType(), DstVT))
+    return false;
+  if (!isScalarFPTypeInSSEReg(DstVT))
+    return false;
+
+  unsigned OpReg = getRegForValue(I->getOperand(0));
+  if (OpReg == 0) return false;
+
+  ISD::NodeType ExtOpc = IsSigned ? ISD::SIGN_EXTEND : ISD::ZERO_EXTEND;
+  MVT IntVT = SrcVT;
+  if (SrcVT == MVT::i8 || SrcVT == MVT::i16)
+    IntVT = MVT::i32;
+  else if (!IsSigned && SrcVT == MVT::i32 && Subtarget->is64Bit())
+    IntVT = MVT::i64;
+  else if (!IsSigned)
+    return false;
+
+  if (IntVT != SrcVT) {
+    OpReg = FastEmit_r(SrcVT, IntVT, ExtOpc, OpReg, /*TODO: Kill=*/false);
+    if (OpReg == 0) return false;
+  }
+
+  unsigned ResultReg = FastEmit_r(IntVT, DstVT, ISD::SINT_TO_FP, OpReg,
+                                  /*Kill=*/IntVT != SrcVT);
+  if (ResultReg == 0) return false;
+  UpdateValueMap(I, ResultReg);
+  return true;
+}
+
+/// X86SelectFPToInt - Select fp-to-int conversions to i8 and i16, which
+/// truncate a conversion to i32, and unsigned conversions to i32 on x86-64,
+/// which take the low half of a conversion to i64.
+bool X86FastISel::X86SelectFPToInt(const Instruction *I, bool IsSigned) {
+  MVT SrcVT, DstVT;
+  if (!isTypeLegal(I->getOperand(0)->getType(), SrcVT) ||
+      !isTypeLegal(I->getType(), DstVT))
+    return false;
+  if (!isScalarFPTypeInSSEReg(SrcVT))
+    return false;
+
+  MVT IntVT;
+  if (DstVT == MVT::i8 && !Subtarget->is64Bit())
+    // Truncating to i8 needs an ABCD register here; leave it to the DAG.
+    return false;
+  else if (DstVT == MVT::i8 || DstVT == MVT::i16)
+    IntVT = MVT::i32;
+  else if (!IsSigned && DstVT == MVT::i32 && Subtarget->is64Bit())
+    IntVT = MVT::i64;
+  else
+    return false;
+
+  unsigned OpReg = getRegForValue(I->getOperand(0));
+  if (OpReg == 0) return false;
+
+  unsigned IntReg = FastEmit_r(SrcVT, IntVT, ISD::FP_TO_SINT, OpReg,
+                               /*TODO: Kill=*/false);
+  if (IntReg == 0) return false;
+
+  unsigned ResultReg;
+  if (IntVT == MVT::i64)
+    ResultReg = FastEmitInst_extractsubreg(DstVT, IntReg, /*Kill=*/true,
+                                           X86::sub_32bit);
+  else
+    ResultReg = FastEmit_r(IntVT, DstVT, ISD::TRUNCATE, IntReg,
+                           /*Kill=*/true);
+  if (ResultReg == 0) return false;
+  UpdateValueMap(I, ResultReg);
+  return true;
+}
+
 bool X86FastISel::X86SelectTrunc(const Instruction *I) {
   if (Subtarget->is64Bit())
     // All other cases should be handled by the tblgen generated code.
@@ -1290,10 +1628,75 @@ bool X86FastISel::X86SelectExtractValue(const Instruction *I) {
   return false;
 }
 
+/// IsMemcpySmall - Return true if a memcpy of Len bytes is short enough to
+/// expand inline rather than call the library.
+bool X86FastISel::IsMemcpySmall(uint64_t Len) const {
+  return Len <= (Subtarget->is64Bit() ? 32 : 16);
+}
+
+/// X86EmitSmallMemcpy - Copy Len bytes from SrcAM to DestAM with integer
+/// loads and stores, widest first.
+void X86FastISel::X86EmitSmallMemcpy(X86AddressMode DestAM,
+                                     X86AddressMode SrcAM, uint64_t Len) {
+  bool i64Legal = Subtarget->is64Bit();
+  while (Len) {
+    MVT VT;
+    if (Len >= 8 && i64Legal)
+      VT = MVT::i64;
+    else if (Len >= 4)
+      VT = MVT::i32;
+    else if (Len >= 2)
+      VT = MVT::i16;
+    else
+      VT = MVT::i8;
+
+    unsigned Reg;
+    bool Emitted = X86FastEmitLoad(VT, SrcAM, Reg);
+    Emitted &= X86FastEmitStore(VT, Reg, DestAM);
+    assert(Emitted && "Failed to emit a load or store!"); (void)Emitted;
+
+    unsigned Size = VT.getSizeInBits() / 8;
+    Len -= Size;
+    DestAM.Disp += Size;
+    SrcAM.Disp += Size;
+  }
+}
+
 bool X86FastISel::X86VisitIntrinsicCall(const IntrinsicInst &I) {
   // FIXME: Handle more intrinsics.
   switch (I.getIntrinsicID()) {
   default: return false;
+  case Intrinsic::memcpy:
+  case Intrinsic::memmove:
+  case Intrinsic::memset: {
+    const MemIntrinsic &MI = cast<MemIntrinsic>(I);
+    if (MI.getAddressSpace() > 255)
+      return false;
+    bool IsSet = isa<MemSetInst>(MI);
+    if (!IsSet &&
+        cast<PointerType>(cast<MemTransferInst>(MI).getRawSource()->getType())
+          ->getAddressSpace() > 255)
+      return false;
+
+    // Expand small constant-length memcpys inline.
+    if (I.getIntrinsicID() == Intrinsic::memcpy && !MI.isVolatile())
+      if (const ConstantInt *Len = dyn_cast<ConstantInt>(MI.getLength()))
+        if (IsMemcpySmall(Len->getZExtValue())) {
+          X86AddressMode DestAM, SrcAM;
+          if (!X86SelectAddress(MI.getRawDest(), DestAM) ||
+              !X86SelectAddress(cast<MemCpyInst>(MI).getRawSource(), SrcAM))
+            return false;
+          X86EmitSmallMemcpy(DestAM, SrcAM, Len->getZExtValue());
+          return true;
+        }
+
+    // Otherwise call the library, as SelectionDAG would.
+    if (MI.getLength()->getType() != TD.getIntPtrType(I.getContext()))
+      return false;
+    const char *Name = IsSet ? "memset" :
+      I.getIntrinsicID() == Intrinsic::memcpy ? "memcpy" : "memmove";
+    return DoSelectCall(&I, Name);
+  }
   case Intrinsic::stackprotector: {
     // Emit code inline code to store the stack guard onto the stack.
     EVT PtrTy = TLI.getPointerTy();
@@ -1420,6 +1823,16 @@ bool X86FastISel::X86SelectCall(const Instruction *I) {
   if (const IntrinsicInst *II = dyn_cast<IntrinsicInst>(CI))
     return X86VisitIntrinsicCall(*II);
 
+  return DoSelectCall(I, 0);
+}
+
+/// DoSelectCall - Emit the call I. If MemIntName is set, I is a memory
+/// intrinsic and is emitted as a call to that library function instead,
+/// dropping the trailing alignment and volatile operands.
+bool X86FastISel::DoSelectCall(const Instruction *I, const char *MemIntName) {
+  const CallInst *CI = cast<CallInst>(I);
+  const Value *Callee = CI->getCalledValue();
+
   // Handle only C and fastcc calling conventions for now.
   ImmutableCallSite CS(CI);
   CallingConv::ID CC = CS.getCallingConv();
@@ -1464,6 +1877,8 @@ bool X86FastISel::X86SelectCall(const Instruction *I) {
     CalleeOp = CalleeAM.Base.Reg;
   } else
     return false;
+  if (MemIntName && !GV)
+    return false;
 
   // Allow calls which produce i1 results.
   bool AndToI1 = false;
@@ -1481,7 +1896,10 @@ bool X86FastISel::X86SelectCall(const Instruction *I) {
   ArgVals.reserve(CS.arg_size());
   ArgVTs.reserve(CS.arg_size());
   ArgFlags.reserve(CS.arg_size());
-  for (ImmutableCallSite::arg_iterator i = CS.arg_begin(), e = CS.arg_end();
+  ImmutableCallSite::arg_iterator ArgEnd = CS.arg_end();
+  if (MemIntName)
+    ArgEnd -= 2;
+  for (ImmutableCallSite::arg_iterator i = CS.arg_begin(), e = ArgEnd;
        i != e; ++i) {
     unsigned Arg = getRegForValue(*i);
     if (Arg == 0)
@@ -1660,8 +2078,11 @@ bool X86FastISel::X86SelectCall(const Instruction *I) {
     }
 
 
-    MIB = BuildMI(*FuncInfo.MBB, FuncInfo.InsertPt, DL, TII.get(CallOpc))
-      .addGlobalAddress(GV, 0, OpFlags);
+    MIB = BuildMI(*FuncInfo.MBB, FuncInfo.InsertPt, DL, TII.get(CallOpc));
+    if (MemIntName)
+      MIB.addExternalSymbol(MemIntName, OpFlags);
+    else
+      MIB.addGlobalAddress(GV, 0, OpFlags);
   }
 
   // Add an implicit use GOT pointer in EBX.
@@ -1758,6 +2179,8 @@ X86FastISel::TargetSelectInstruction(const Instruction *I)  {
     return X86SelectZExt(I);
   case Instruction::Br:
     return X86SelectBranch(I);
+  case Instruction::Switch:
+    return X86SelectSwitch(I);
   case Instruction::Call:
     return X86SelectCall(I);
   case Instruction::LShr:
@@ -1772,6 +2195,14 @@ X86FastISel::TargetSelectInstruction(const Instruction *I)  {
     return X86SelectFPExt(I);
   case Instruction::FPTrunc:
     return X86SelectFPTrunc(I);
+  case Instruction::SIToFP:
+    return X86SelectIntToFP(I, /*IsSigned=*/true);
+  case Instruction::UIToFP:
+    return X86SelectIntToFP(I, /*IsSigned=*/false);
+  case Instruction::FPToSI:
+    return X86SelectFPToInt(I, /*IsSigned=*/true);
+  case Instruction::FPToUI:
+    return X86SelectFPToInt(I, /*IsSigned=*/false);
   case Instruction::ExtractValue:
     return X86SelectExtractValue(I);
   case Instruction::IntToPtr: // Deliberate fall-through.
@@ -340,14 +340,42 @@ void X86FrameLowering::emitCalleeSavedFrameMoves(MachineFunction &MF,
   }
 }
 
+/// supportsShrinkWrapping - COFF targets probe the stack through EAX, see
+/// enableShrinkWrapping.
+bool X86FrameLowering::supportsShrinkWrapping() const {
+  return !STI.isTargetCOFF();
+}
+
+/// enableShrinkWrapping - The prologue can move out of the entry block as
+/// long as no unwind info describes it, and no stack probe needs EAX.
+bool X86FrameLowering::enableShrinkWrapping(const MachineFunction &MF) const {
+  const Function *Fn = MF.getFunction();
+  if (MF.getMMI().hasDebugInfo() || !Fn->doesNotThrow() ||
+      UnwindTablesMandatory)
+    return false;
+  if (STI.isTargetCOFF())
+    return false;
+  // A tail call that moves the return address needs the adjustment on every
+  // path through the function.
+  return MF.getInfo<X86MachineFunctionInfo>()->getTCReturnAddrDelta() == 0;
+}
+
+/// canUseAsPrologue - The prologue adjusts the stack pointer with
+/// instructions that clobber EFLAGS.
+bool X86FrameLowering::canUseAsPrologue(const MachineBasicBlock &MBB) const {
+  return !MBB.isLiveIn(X86::EFLAGS);
+}
+
 /// emitPrologue - Push callee-saved registers onto the stack, which
 /// automatically adjust the stack pointer. Adjust the stack pointer to allocate
 /// space for local variables. Also emit labels used by the exception handler to
 /// generate the exception handling frames.
 void X86FrameLowering::emitPrologue(MachineFunction &MF) const {
-  MachineBasicBlock &MBB = MF.front(); // Prologue goes in entry BB.
-  MachineBasicBlock::iterator MBBI = MBB.begin();
   MachineFrameInfo *MFI = MF.getFrameInfo();
+  // Prologue goes in the save point, normally the entry block.
+  MachineBasicBlock &MBB =
+    MFI->getSavePoint() ? *MFI->getSavePoint() : MF.front();
+  MachineBasicBlock::iterator MBBI = MBB.begin();
   const Function *Fn = MF.getFunction();
   const X86RegisterInfo *RegInfo = TM.getRegisterInfo();
   const X86InstrInfo &TII = *TM.getInstrInfo();
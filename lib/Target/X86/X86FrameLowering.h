@@ -40,6 +40,10 @@ public:
   void emitPrologue(MachineFunction &MF) const;
   void emitEpilogue(MachineFunction &MF, MachineBasicBlock &MBB) const;
 
+  bool supportsShrinkWrapping() const;
+  bool enableShrinkWrapping(const MachineFunction &MF) const;
+  bool canUseAsPrologue(const MachineBasicBlock &MBB) const;
+
   void processFunctionBeforeCalleeSavedScan(MachineFunction &MF,
                                             RegScavenger *RS = NULL) const;
 
@@ -227,7 +227,12 @@ X86TargetLowering::X86TargetLowering(X86TargetMachine &TM)
   // X86 is weird, it always uses i8 for shift amounts and setcc results.
   setShiftAmountType(MVT::i8);
   setBooleanContents(ZeroOrOneBooleanContent);
-  setSchedulingPreference(Sched::RegPressure);
+  // The in-order Atom pipeline cannot hide latency the way the out-of-order
+  // cores do, so schedule for it, backing off when registers get tight.
+  if (Subtarget->isAtom())
+    setSchedulingPreference(Sched::Hybrid);
+  else
+    setSchedulingPreference(Sched::RegPressure);
   setStackPointerRegisterToSaveRestore(X86StackPtr);
 
   if (Subtarget->isTargetWindows() && !Subtarget->isTargetCygMing()) {
@@ -1095,6 +1100,20 @@ X86TargetLowering::X86TargetLowering(X86TargetMachine &TM)
   maxStoresPerMemmoveOptSize = Subtarget->isTargetDarwin() ? 8 : 4;
   setPrefLoopAlignment(16);
   benefitFromCodePlacementOpt = true;
+
+  setCacheLineSize(64);
+  setDataCacheSize(32 * 1024);
+
+  // Software prefetches are lowered to the SSE prefetch instructions.  Aim to
+  // hide a miss to memory, for loops that don't fit in the L2 cache.
+  if (Subtarget->hasSSE1()) {
+    setPrefetchDistance(300);
+    setPrefetchCacheSize(256 * 1024);
+  }
+
+  // The C library searches and compares strings with SSE2.
+  if (Subtarget->hasSSE2())
+    setFastStringLibCalls();
 }
 
 
@@ -9412,6 +9431,14 @@ bool X86TargetLowering::isNarrowingProfitable(EVT VT1, EVT VT2) const {
   return !(VT1 == MVT::i32 && VT2 == MVT::i16);
 }
 
+unsigned X86TargetLowering::getVectorRegisterBitWidth() const {
+  if (Subtarget->hasAVX())
+    return 256;
+  if (Subtarget->hasXMMInt())
+    return 128;
+  return 0;
+}
+
 /// isShuffleMaskLegal - Targets can use this to indicate that they only
 /// support *some* VECTOR_SHUFFLE operations, those with specific masks.
 /// By default, if a target supports the VECTOR_SHUFFLE node, all mask values
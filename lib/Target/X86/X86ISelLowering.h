@@ -624,6 +624,11 @@ namespace llvm {
     /// from i32 to i8 but not from i32 to i16.
     virtual bool isNarrowingProfitable(EVT VT1, EVT VT2) const;
 
+    /// getVectorRegisterBitWidth - Return the width of the vector registers
+    /// the IR-level vectorizers should target: the YMM registers with AVX, the
+    /// XMM registers when SSE2 provides integer vector operations.
+    virtual unsigned getVectorRegisterBitWidth() const;
+
     /// isFPImmLegal - Returns true if the target can instruction select the
     /// specified FP immediate natively. If false, the legalizer will
     /// materialize the FP immediate as a load from a constant pool.
@@ -27,6 +27,7 @@
 #include "llvm/CodeGen/MachineRegisterInfo.h"
 #include "llvm/CodeGen/LiveVariables.h"
 #include "llvm/CodeGen/PseudoSourceValue.h"
+#include "llvm/CodeGen/ScoreboardHazardRecognizer.h"
 #include "llvm/MC/MCInst.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
@@ -3080,6 +3081,32 @@ void X86InstrInfo::SetSSEDomain(MachineInstr *MI, unsigned Domain) const {
   MI->setDesc(get(table[Domain-1]));
 }
 
+// Use a ScoreboardHazardRecognizer for prepass scheduling.  It is a no-op when
+// the processor has no itineraries.
+ScheduleHazardRecognizer *X86InstrInfo::
+CreateTargetHazardRecognizer(const TargetMachine *TM,
+                             const ScheduleDAG *DAG) const {
+  if (usePreRAHazardRecognizer()) {
+    const InstrItineraryData *II = TM->getInstrItineraryData();
+    return new ScoreboardHazardRecognizer(II, DAG, "pre-RA-sched");
+  }
+  return TargetInstrInfoImpl::CreateTargetHazardRecognizer(TM, DAG);
+}
+
+bool X86InstrInfo::isSchedulingBoundary(const MachineInstr *MI,
+                                        const MachineBasicBlock *MBB,
+                                        const MachineFunction &MF) const {
+  switch (MI->getOpcode()) {
+  default: break;
+  case X86::FpGET_ST0_32: case X86::FpGET_ST0_64: case X86::FpGET_ST0_80:
+  case X86::FpGET_ST1_32: case X86::FpGET_ST1_64: case X86::FpGET_ST1_80:
+  case X86::FpSET_ST0_32: case X86::FpSET_ST0_64: case X86::FpSET_ST0_80:
+  case X86::FpSET_ST1_32: case X86::FpSET_ST1_64: case X86::FpSET_ST1_80:
+    return true;
+  }
+  return TargetInstrInfoImpl::isSchedulingBoundary(MI, MBB, MF);
+}
+
 /// getNoopForMachoTarget - Return the noop instruction to use for a noop.
 void X86InstrInfo::getNoopForMachoTarget(MCInst &NopInst) const {
   NopInst.setOpcode(X86::NOOP);
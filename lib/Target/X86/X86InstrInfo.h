@@ -812,6 +812,18 @@ public:
                                        int64_t Offset1, int64_t Offset2,
                                        unsigned NumLoads) const;
 
+  /// CreateTargetHazardRecognizer - Use the itineraries of the selected
+  /// processor to model its issue ports in the latency-aware list schedulers.
+  virtual ScheduleHazardRecognizer *
+  CreateTargetHazardRecognizer(const TargetMachine *TM,
+                               const ScheduleDAG *DAG) const;
+
+  /// isSchedulingBoundary - The x87 pseudos that move values in and out of
+  /// the hardware stack refer to it implicitly and must stay where they are.
+  virtual bool isSchedulingBoundary(const MachineInstr *MI,
+                                    const MachineBasicBlock *MBB,
+                                    const MachineFunction &MF) const;
+
   virtual void getNoopForMachoTarget(MCInst &NopInst) const;
 
   virtual
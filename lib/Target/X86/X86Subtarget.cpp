@@ -163,6 +163,11 @@ bool X86Subtarget::IsLegalToCallImmediateAddr(const TargetMachine &TM) const {
 /// indicating the number of scheduling cycles of backscheduling that
 /// should be attempted.
 unsigned X86Subtarget::getSpecialAddressLatency() const {
+  // Atom executes in order; an address computation only needs to be ready
+  // by the time the load or store reaches the address generation stage.
+  if (isAtom())
+    return 3;
+
   // For x86 out-of-order targets, back-schedule address computations so
   // that loads and stores aren't blocked.
   // This value was chosen arbitrarily.
@@ -272,6 +277,9 @@ void X86Subtarget::AutoDetectSubtargetFeatures() {
     unsigned Model  = 0;
     DetectFamilyModel(EAX, Family, Model);
     IsBTMemSlow = IsAMD || (Family == 6 && Model >= 13);
+    // Atom has an in-order pipeline with its own scheduling model.
+    if (IsIntel && Family == 6 && (Model == 28 || Model == 38))
+      X86ProcFamily = IntelAtom;
     // If it's Nehalem, unaligned memory access is fast.
     if (Family == 15 && Model == 26)
       IsUAMemFast = true;
@@ -288,6 +296,7 @@ X86Subtarget::X86Subtarget(const std::string &TT, const std::string &FS,
   : PICStyle(PICStyles::None)
   , X86SSELevel(NoMMXSSE)
   , X863DNowLevel(NoThreeDNow)
+  , X86ProcFamily(Others)
   , HasCMov(false)
   , HasX86_64(false)
   , HasPOPCNT(false)
@@ -325,8 +334,23 @@ X86Subtarget::X86Subtarget(const std::string &TT, const std::string &FS,
     // Make sure SSE2 is enabled; it is available on all X86-64 CPUs.
     if (Is64Bit && !HasAVX && X86SSELevel < SSE2)
       X86SSELevel = SSE2;
+
+    // Pick up the itineraries of the host processor, if it has any.  The
+    // CPU name comes from the same cpuid data, so a miss just means the
+    // host is not a modelled processor.
+    std::string CPU = sys::getHostCPUName();
+    for (unsigned i = 0; i != ProcItinKVSize; ++i)
+      if (CPU == ProcItinKV[i].Key) {
+        InstrItins = InstrItineraryData(Stages, OperandCycles,
+                                        ForwardingPathes,
+                              (const InstrItinerary *)ProcItinKV[i].Value);
+        break;
+      }
   }
 
+  // After parsing Itineraries, set ItinData.IssueWidth.
+  computeIssueWidth();
+
   // If requesting codegen for X86-64, make sure that 64-bit features
   // are enabled.
   if (Is64Bit) {
@@ -351,6 +375,45 @@ X86Subtarget::X86Subtarget(const std::string &TT, const std::string &FS,
     stackAlignment = StackAlignment;
 }
 
+/// computeIssueWidth - Count the distinct functional units that can start an
+/// instruction.  The out-of-order cores have more ports than they can feed
+/// from the decoders in a cycle, so the result is capped at their four-wide
+/// rename and retire width.
+void X86Subtarget::computeIssueWidth() {
+  if (InstrItins.isEmpty()) {
+    InstrItins.IssueWidth = 0;
+    return;
+  }
+
+  unsigned allStage1Units = 0;
+  for (const InstrItinerary *itin = InstrItins.Itineraries;
+       itin->FirstStage != ~0U; ++itin) {
+    const InstrStage *IS = InstrItins.Stages + itin->FirstStage;
+    allStage1Units |= IS->getUnits();
+  }
+  InstrItins.IssueWidth = 0;
+  while (allStage1Units) {
+    ++InstrItins.IssueWidth;
+    // clear the lowest bit
+    allStage1Units ^= allStage1Units & ~(allStage1Units - 1);
+  }
+  if (InstrItins.IssueWidth > 4)
+    InstrItins.IssueWidth = 4;
+}
+
+bool X86Subtarget::enablePostRAScheduler(
+           CodeGenOpt::Level OptLevel,
+           TargetSubtarget::AntiDepBreakMode& Mode,
+           RegClassVector& CriticalPathRCs) const {
+  Mode = TargetSubtarget::ANTIDEP_CRITICAL;
+  CriticalPathRCs.clear();
+  if (is64Bit())
+    CriticalPathRCs.push_back(&X86::GR64RegClass);
+  else
+    CriticalPathRCs.push_back(&X86::GR32RegClass);
+  return isAtom() && OptLevel >= CodeGenOpt::Default;
+}
+
 /// IsCalleePop - Determines whether the callee is required to pop its
 /// own arguments. Callee pop is necessary to support tail calls.
 bool X86Subtarget::IsCalleePop(bool IsVarArg,
@@ -15,6 +15,7 @@
 #define X86SUBTARGET_H
 
 #include "llvm/ADT/Triple.h"
+#include "llvm/Target/TargetInstrItineraries.h"
 #include "llvm/Target/TargetSubtarget.h"
 #include "llvm/CallingConv.h"
 #include <string>
@@ -45,6 +46,10 @@ protected:
     NoThreeDNow, ThreeDNow, ThreeDNowA
   };
 
+  enum X86ProcFamilyEnum {
+    Others, IntelAtom
+  };
+
   /// PICStyle - Which PIC style to use
   ///
   PICStyles::Style PICStyle;
@@ -57,6 +62,9 @@ protected:
   ///
   X863DNowEnum X863DNowLevel;
 
+  /// X86ProcFamily - X86 processor family: Intel Atom, and others.
+  X86ProcFamilyEnum X86ProcFamily;
+
   /// HasCMov - True if this processor has conditional move instructions
   /// (generally pentium pro+).
   bool HasCMov;
@@ -107,6 +115,9 @@ protected:
   /// TargetTriple - What processor and OS we're targeting.
   Triple TargetTriple;
 
+  /// Selected instruction itineraries (one entry per itinerary class.)
+  InstrItineraryData InstrItins;
+
 private:
   /// Is64Bit - True if the processor supports 64-bit instructions and
   /// pointer size is 64 bit.
@@ -137,6 +148,8 @@ public:
   /// instruction.
   void AutoDetectSubtargetFeatures();
 
+  void computeIssueWidth();
+
   bool is64Bit() const { return Is64Bit; }
 
   PICStyles::Style getPICStyle() const { return PICStyle; }
@@ -162,6 +175,7 @@ public:
   bool hasFMA3() const { return HasFMA3; }
   bool hasFMA4() const { return HasFMA4; }
   bool isBTMemSlow() const { return IsBTMemSlow; }
+  bool isAtom() const { return X86ProcFamily == IntelAtom; }
   bool isUnalignedMemAccessFast() const { return IsUAMemFast; }
   bool hasVectorUAMem() const { return HasVectorUAMem; }
 
@@ -252,6 +266,22 @@ public:
 
   /// IsCalleePop - Test whether a function should pop its own arguments.
   bool IsCalleePop(bool isVarArg, CallingConv::ID CallConv) const;
+
+  /// enablePostRAScheduler - Only the in-order Atom cores gain from the
+  /// post-RA scheduler; the others reorder in hardware.
+  bool enablePostRAScheduler(CodeGenOpt::Level OptLevel,
+                             TargetSubtarget::AntiDepBreakMode& Mode,
+                             RegClassVector& CriticalPathRCs) const;
+
+  /// enableMachineScheduler - Schedule machine instructions for the Atom
+  /// pipeline before register allocation as well.
+  bool enableMachineScheduler(CodeGenOpt::Level OptLevel) const {
+    return isAtom() && OptLevel >= CodeGenOpt::Default;
+  }
+
+  /// getInstrItins - Return the instruction itineraries based on subtarget
+  /// selection.
+  const InstrItineraryData &getInstrItineraryData() const { return InstrItins; }
 };
 
 } // End llvm namespace
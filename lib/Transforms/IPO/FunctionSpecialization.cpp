@@ -0,0 +1,341 @@
+//===-- FunctionSpecialization.cpp - Clone functions for constant args ----===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This pass clones functions for call sites that pass constant arguments which
+// the callee uses to make decisions: function pointers that it calls, and
+// integer flags that it compares, switches or branches on.  IPSCCP can only
+// propagate such a constant when every call site agrees on it; here each
+// distinct set of constants gets its own copy of the function, with the
+// constant arguments removed, and the call sites are redirected to the copy.
+//
+// The clones are not optimized here.  Later passes (IPSCCP, instcombine and the
+// inliner) fold the constants, turn indirect calls into direct ones and inline
+// the callbacks, which makes generic callback-driven routines such as sorting
+// or hashing with a comparison function as fast as hand-written ones.
+//
+// Since every clone grows the program, the pass only considers functions below
+// a size limit, makes a bounded number of clones per function, and stops once
+// the total size of the clones reaches a fraction of the size of the module.
+// Call sites are not weighted by profile information; the sets of constants
+// that are passed by the most call sites are specialized first.
+//
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "function-specialization"
+#include "llvm/Transforms/IPO.h"
+#include "llvm/Constants.h"
+#include "llvm/Instructions.h"
+#include "llvm/Module.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/CallSite.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Statistic.h"
+#include <algorithm>
+#include <map>
+using namespace llvm;
+
+STATISTIC(NumSpecialized, "Number of function specializations created");
+STATISTIC(NumCallsRedirected, "Number of calls redirected to a specialization");
+
+static cl::opt<unsigned>
+MaxFunctionSize("spec-max-size", cl::init(250), cl::Hidden,
+                cl::desc("Don't specialize functions with more instructions "
+                         "than this"));
+
+static cl::opt<unsigned>
+MaxClones("spec-max-clones", cl::init(3), cl::Hidden,
+          cl::desc("Maximum number of specializations of one function"));
+
+static cl::opt<unsigned>
+GrowthPercent("spec-growth", cl::init(10), cl::Hidden,
+              cl::desc("Stop specializing once the clones add this "
+                       "percentage to the size of the module"));
+
+namespace {
+  /// The constant passed for each argument, or null for arguments that are
+  /// not specialized.
+  typedef std::vector<Constant*> SpecKey;
+
+  /// A set of constants passed to a function, and the call sites passing it.
+  struct Candidate {
+    SpecKey Key;
+    SmallVector<Instruction*, 4> Calls;
+  };
+
+  struct FunctionSpecializer : public ModulePass {
+    static char ID; // Pass identification, replacement for typeid
+    FunctionSpecializer() : ModulePass(ID) {
+      initializeFunctionSpecializerPass(*PassRegistry::getPassRegistry());
+    }
+
+    bool runOnModule(Module &M);
+
+  private:
+    bool isSpecializable(const Function &F);
+    bool collectCandidates(Function &F, SmallVectorImpl<bool> &Interesting,
+                           std::vector<Candidate> &Candidates);
+    Function *createSpecialization(Function &F, const SpecKey &Key);
+    void redirectCall(Instruction *Call, Function *Spec, const SpecKey &Key);
+
+    /// The number of instructions the clones may still add to the module.
+    unsigned Budget;
+  };
+}
+
+char FunctionSpecializer::ID = 0;
+INITIALIZE_PASS(FunctionSpecializer, "function-specialization",
+                "Specialize functions for constant arguments", false, false)
+
+ModulePass *llvm::createFunctionSpecializationPass() {
+  return new FunctionSpecializer();
+}
+
+/// getNumInstructions - Return the number of instructions in F.
+static unsigned getNumInstructions(const Function &F) {
+  unsigned Size = 0;
+  for (Function::const_iterator BB = F.begin(), E = F.end(); BB != E; ++BB)
+    Size += BB->size();
+  return Size;
+}
+
+/// isInterestingArgument - Return true if the function makes decisions based
+/// on the value of A, so that passing a constant for it lets the clone fold
+/// away a branch or an indirect call.
+static bool isInterestingArgument(const Argument &A) {
+  const Type *Ty = A.getType();
+  bool IsFnPtr = Ty->isPointerTy() &&
+    cast<PointerType>(Ty)->getElementType()->isFunctionTy();
+  if (!IsFnPtr && !Ty->isIntegerTy())
+    return false;
+
+  for (Value::const_use_iterator UI = A.use_begin(), E = A.use_end();
+       UI != E; ++UI) {
+    const User *U = *UI;
+    if (IsFnPtr) {
+      ImmutableCallSite CS(U);
+      if (CS && CS.getCalledValue() == &A)
+        return true;
+      continue;
+    }
+    if (isa<ICmpInst>(U) || isa<SwitchInst>(U) || isa<BranchInst>(U))
+      return true;
+    if (const SelectInst *SI = dyn_cast<SelectInst>(U))
+      if (SI->getCondition() == &A)
+        return true;
+  }
+  return false;
+}
+
+/// isSpecializableConstant - Return true if C is a value worth specializing
+/// an interesting argument on.
+static bool isSpecializableConstant(const Value *V) {
+  if (isa<ConstantInt>(V))
+    return true;
+  if (const Constant *C = dyn_cast<Constant>(V))
+    if (const Function *F = dyn_cast<Function>(C->stripPointerCasts()))
+      return !F->mayBeOverridden();
+  return false;
+}
+
+bool FunctionSpecializer::isSpecializable(const Function &F) {
+  if (F.isDeclaration() || F.mayBeOverridden() || F.isVarArg() ||
+      F.arg_empty())
+    return false;
+  if (F.hasFnAttr(Attribute::OptimizeForSize) ||
+      F.hasFnAttr(Attribute::NoInline))
+    return false;
+  for (Function::const_iterator BB = F.begin(), E = F.end(); BB != E; ++BB)
+    if (BB->hasAddressTaken())
+      return false;
+  return getNumInstructions(F) <= MaxFunctionSize;
+}
+
+/// collectCandidates - Group the direct calls of F by the constants they pass
+/// for its interesting arguments.  Returns false if nothing is worth cloning.
+bool
+FunctionSpecializer::collectCandidates(Function &F,
+                                       SmallVectorImpl<bool> &Interesting,
+                                       std::vector<Candidate> &Candidates) {
+  bool AnyInteresting = false;
+  for (Function::arg_iterator AI = F.arg_begin(), E = F.arg_end();
+       AI != E; ++AI) {
+    Interesting.push_back(isInterestingArgument(*AI));
+    AnyInteresting |= Interesting.back();
+  }
+  if (!AnyInteresting)
+    return false;
+
+  std::map<SpecKey, unsigned> KeyIndex;
+  unsigned NumUses = 0;
+  for (Value::use_iterator UI = F.use_begin(), E = F.use_end(); UI != E; ++UI) {
+    ++NumUses;
+    CallSite CS(*UI);
+    if (!CS || !CS.isCallee(UI))
+      continue;
+
+    SpecKey Key(F.arg_size());
+    bool AnyConstant = false;
+    for (unsigned i = 0, e = F.arg_size(); i != e; ++i) {
+      Value *V = CS.getArgument(i);
+      if (Interesting[i] && isSpecializableConstant(V)) {
+        Key[i] = cast<Constant>(V);
+        AnyConstant = true;
+      }
+    }
+    if (!AnyConstant)
+      continue;
+
+    std::pair<std::map<SpecKey, unsigned>::iterator, bool> Ins =
+      KeyIndex.insert(std::make_pair(Key, (unsigned)Candidates.size()));
+    if (Ins.second) {
+      Candidates.push_back(Candidate());
+      Candidates.back().Key = Key;
+    }
+    Candidates[Ins.first->second].Calls.push_back(CS.getInstruction());
+  }
+
+  // If every use of a local function passes the same constants, IPSCCP can
+  // propagate them without making a copy.
+  if (F.hasLocalLinkage() && Candidates.size() == 1 &&
+      Candidates[0].Calls.size() == NumUses)
+    return false;
+
+  return !Candidates.empty();
+}
+
+namespace {
+  /// Orders candidates by the number of call sites they cover.
+  struct MoreCalls {
+    bool operator()(const Candidate &L, const Candidate &R) const {
+      return L.Calls.size() > R.Calls.size();
+    }
+  };
+}
+
+/// createSpecialization - Clone F with the arguments in Key replaced by their
+/// constants, and add the clone to the module.
+Function *FunctionSpecializer::createSpecialization(Function &F,
+                                                    const SpecKey &Key) {
+  ValueToValueMapTy VMap;
+  unsigned i = 0;
+  for (Function::arg_iterator AI = F.arg_begin(), E = F.arg_end();
+       AI != E; ++AI, ++i)
+    if (Key[i])
+      VMap[AI] = Key[i];
+
+  Function *Spec = CloneFunction(&F, VMap, /*ModuleLevelChanges=*/false);
+  // With arguments removed, CloneFunction only copies the attribute list.
+  // Take the calling convention, section, alignment and GC from F as well.
+  AttrListPtr Attrs = Spec->getAttributes();
+  Spec->copyAttributesFrom(&F);
+  Spec->setAttributes(Attrs);
+  Spec->setLinkage(GlobalValue::InternalLinkage);
+  Spec->setVisibility(GlobalValue::DefaultVisibility);
+  Spec->setName(F.getName() + ".spec");
+  F.getParent()->getFunctionList().insert(&F, Spec);
+  return Spec;
+}
+
+/// redirectCall - Replace Call with a call to Spec that doesn't pass the
+/// arguments that Spec was specialized on.
+void FunctionSpecializer::redirectCall(Instruction *Call, Function *Spec,
+                                       const SpecKey &Key) {
+  CallSite CS(Call);
+  const AttrListPtr &CallPAL = CS.getAttributes();
+  SmallVector<Value*, 8> Args;
+  SmallVector<AttributeWithIndex, 8> AttributesVec;
+
+  // Add any return attributes.
+  if (Attributes attrs = CallPAL.getRetAttributes())
+    AttributesVec.push_back(AttributeWithIndex::get(0, attrs));
+
+  for (unsigned i = 0, e = Key.size(); i != e; ++i) {
+    if (Key[i])
+      continue;
+    Args.push_back(CS.getArgument(i));
+    if (Attributes Attrs = CallPAL.getParamAttributes(i + 1))
+      AttributesVec.push_back(AttributeWithIndex::get(Args.size(), Attrs));
+  }
+
+  // Add any function attributes.
+  if (Attributes attrs = CallPAL.getFnAttributes())
+    AttributesVec.push_back(AttributeWithIndex::get(~0, attrs));
+
+  Instruction *New;
+  if (InvokeInst *II = dyn_cast<InvokeInst>(Call)) {
+    New = InvokeInst::Create(Spec, II->getNormalDest(), II->getUnwindDest(),
+                             Args.begin(), Args.end(), "", Call);
+    cast<InvokeInst>(New)->setCallingConv(CS.getCallingConv());
+    cast<InvokeInst>(New)->setAttributes(AttrListPtr::get(AttributesVec.begin(),
+                                                        AttributesVec.end()));
+  } else {
+    New = CallInst::Create(Spec, Args.begin(), Args.end(), "", Call);
+    cast<CallInst>(New)->setCallingConv(CS.getCallingConv());
+    cast<CallInst>(New)->setAttributes(AttrListPtr::get(AttributesVec.begin(),
+                                                      AttributesVec.end()));
+    if (cast<CallInst>(Call)->isTailCall())
+      cast<CallInst>(New)->setTailCall();
+  }
+  New->setDebugLoc(Call->getDebugLoc());
+
+  if (!Call->use_empty()) {
+    Call->replaceAllUsesWith(New);
+    New->takeName(Call);
+  }
+  Call->eraseFromParent();
+  ++NumCallsRedirected;
+}
+
+bool FunctionSpecializer::runOnModule(Module &M) {
+  unsigned ModuleSize = 0;
+  SmallVector<Function*, 32> Worklist;
+  for (Module::iterator F = M.begin(), E = M.end(); F != E; ++F) {
+    ModuleSize += getNumInstructions(*F);
+    if (isSpecializable(*F))
+      Worklist.push_back(F);
+  }
+
+  // Always leave room for at least one clone of the largest function we are
+  // willing to copy, so that small modules can be specialized too.
+  Budget = std::max(ModuleSize * GrowthPercent / 100,
+                    (unsigned)MaxFunctionSize);
+
+  bool Changed = false;
+  for (unsigned i = 0, e = Worklist.size(); i != e && Budget; ++i) {
+    Function &F = *Worklist[i];
+    SmallVector<bool, 8> Interesting;
+    std::vector<Candidate> Candidates;
+    if (!collectCandidates(F, Interesting, Candidates))
+      continue;
+
+    std::stable_sort(Candidates.begin(), Candidates.end(), MoreCalls());
+    unsigned Size = getNumInstructions(F);
+    for (unsigned c = 0, ce = std::min((unsigned)Candidates.size(),
+                                       (unsigned)MaxClones); c != ce; ++c) {
+      if (Size > Budget)
+        break;
+      Budget -= Size;
+
+      Candidate &Cand = Candidates[c];
+      Function *Spec = createSpecialization(F, Cand.Key);
+      DEBUG(dbgs() << "FuncSpec: specialized " << F.getName() << " as "
+                   << Spec->getName() << " for " << Cand.Calls.size()
+                   << " call(s)\n");
+      for (unsigned j = 0, je = Cand.Calls.size(); j != je; ++j)
+        redirectCall(Cand.Calls[j], Spec, Cand.Key);
+      ++NumSpecialized;
+      Changed = true;
+    }
+  }
+  return Changed;
+}
@@ -9,13 +9,13 @@
 //
 // This pass looks for equivalent functions that are mergable and folds them.
 //
-// A hash is computed from the function, based on its type and number of
-// basic blocks.
+// A hash is computed from the function, based on its type and on the shape of
+// its CFG and the opcodes and types of its instructions.
 //
 // Once all hashes are computed, we perform an expensive equality comparison
-// on each function pair. This takes n^2/2 comparisons per bucket, so it's
-// important that the hash function be high quality. The equality comparison
-// iterates through each instruction in each basic block.
+// on each function pair with the same hash. This takes n^2/2 comparisons per
+// bucket, so it's important that the hash function be high quality. The
+// equality comparison iterates through each instruction in each basic block.
 //
 // When a match is found the functions are folded. If both functions are
 // overridable, we move the functionality into a new internal function and
@@ -47,6 +47,7 @@
 #include "llvm/Transforms/IPO.h"
 #include "llvm/ADT/DenseSet.h"
 #include "llvm/ADT/FoldingSet.h"
+#include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/ADT/SmallSet.h"
 #include "llvm/ADT/Statistic.h"
 #include "llvm/ADT/STLExtras.h"
@@ -71,20 +72,57 @@ STATISTIC(NumThunksWritten, "Number of thunks generated");
 STATISTIC(NumAliasesWritten, "Number of aliases generated");
 STATISTIC(NumDoubleWeak, "Number of new functions created");
 
+/// Returns a number for the type which is the same for any two types that
+/// FunctionComparator::isEquivalentType considers equal.
+static unsigned profileType(const Type *Ty) {
+  // Pointers are equivalent to each other and to intptr_t.
+  if (Ty->isPointerTy())
+    return Type::IntegerTyID;
+  return Ty->getTypeID();
+}
+
 /// Creates a hash-code for the function which is the same for any two
-/// functions that will compare equal, without looking at the instructions
-/// inside the function.
+/// functions that will compare equal.  Besides the signature, it covers the
+/// shape of the CFG and the opcodes and operand types of the instructions.
+/// The blocks are visited in the same order as FunctionComparator::compare
+/// visits them, so unreachable blocks don't affect the hash.
 static unsigned profileFunction(const Function *F) {
   const FunctionType *FTy = F->getFunctionType();
 
   FoldingSetNodeID ID;
-  ID.AddInteger(F->size());
   ID.AddInteger(F->getCallingConv());
   ID.AddBoolean(F->hasGC());
   ID.AddBoolean(FTy->isVarArg());
-  ID.AddInteger(FTy->getReturnType()->getTypeID());
+  ID.AddInteger(profileType(FTy->getReturnType()));
   for (unsigned i = 0, e = FTy->getNumParams(); i != e; ++i)
-    ID.AddInteger(FTy->getParamType(i)->getTypeID());
+    ID.AddInteger(profileType(FTy->getParamType(i)));
+
+  SmallVector<const BasicBlock *, 8> Worklist;
+  SmallPtrSet<const BasicBlock *, 16> Visited;
+  Worklist.push_back(&F->getEntryBlock());
+  Visited.insert(&F->getEntryBlock());
+  while (!Worklist.empty()) {
+    const BasicBlock *BB = Worklist.pop_back_val();
+    ID.AddInteger(BB->size());
+    for (BasicBlock::const_iterator I = BB->begin(), E = BB->end(); I != E;
+         ++I) {
+      ID.AddInteger(I->getOpcode());
+      ID.AddInteger(profileType(I->getType()));
+      // GEPs with different indices may still add the same offset.
+      if (isa<GetElementPtrInst>(I))
+        continue;
+      ID.AddInteger(I->getNumOperands());
+      for (unsigned i = 0, e = I->getNumOperands(); i != e; ++i) {
+        ID.AddInteger(I->getOperand(i)->getValueID());
+        ID.AddInteger(profileType(I->getOperand(i)->getType()));
+      }
+    }
+
+    const TerminatorInst *TI = BB->getTerminator();
+    for (unsigned i = 0, e = TI->getNumSuccessors(); i != e; ++i)
+      if (Visited.insert(TI->getSuccessor(i)))
+        Worklist.push_back(TI->getSuccessor(i));
+  }
   return ID.ComputeHash();
 }
 
@@ -388,6 +426,10 @@ bool FunctionComparator::enumerate(const Value *V1, const Value *V2) {
     if (C1->isNullValue() && C2->isNullValue() &&
 	isEquivalentType(C1->getType(), C2->getType()))
       return true;
+    // Constants are uniqued, so two of the same type are different values.
+    // This also keeps aggregates away from the bitcast below.
+    if (C1->getType() == C2->getType())
+      return false;
     // Try bitcasting C2 to C1's type. If the bitcast is legal and returns C1
     // then they must have equal bit patterns.
     return C1->getType()->canLosslesslyBitCastTo(C2->getType()) &&
@@ -661,6 +703,11 @@ bool DenseMapInfo<ComparableFunction>::isEqual(const ComparableFunction &LHS,
   if (!LHS.getFunc() || !RHS.getFunc())
     return false;
 
+  // DenseSet probes through entries with other hashes as well; only the
+  // functions that share a hash need the expensive comparison.
+  if (LHS.getHash() != RHS.getHash())
+    return false;
+
   // One of these is a special "underlying pointer comparison only" object.
   if (LHS.getTD() == ComparableFunction::LookupOnly ||
       RHS.getTD() == ComparableFunction::LookupOnly)
@@ -701,6 +748,18 @@ void MergeFunctions::writeThunkOrAlias(Function *F, Function *G) {
   writeThunk(F, G);
 }
 
+// Cast V to DestTy. Pointers compare equal to intptr_t, so a plain bitcast
+// isn't always enough.
+static Value *createCast(IRBuilder<false> &Builder, Value *V,
+                         const Type *DestTy) {
+  const Type *SrcTy = V->getType();
+  if (SrcTy->isIntegerTy() && DestTy->isPointerTy())
+    return Builder.CreateIntToPtr(V, DestTy);
+  if (SrcTy->isPointerTy() && DestTy->isIntegerTy())
+    return Builder.CreatePtrToInt(V, DestTy);
+  return Builder.CreateBitCast(V, DestTy);
+}
+
 // Replace G with a simple tail call to bitcast(F). Also replace direct uses
 // of G with bitcast(F). Deletes G.
 void MergeFunctions::writeThunk(Function *F, Function *G) {
@@ -726,7 +785,7 @@ void MergeFunctions::writeThunk(Function *F, Function *G) {
   const FunctionType *FFTy = F->getFunctionType();
   for (Function::arg_iterator AI = NewG->arg_begin(), AE = NewG->arg_end();
        AI != AE; ++AI) {
-    Args.push_back(Builder.CreateBitCast(AI, FFTy->getParamType(i)));
+    Args.push_back(createCast(Builder, AI, FFTy->getParamType(i)));
     ++i;
   }
 
@@ -736,7 +795,7 @@ void MergeFunctions::writeThunk(Function *F, Function *G) {
   if (NewG->getReturnType()->isVoidTy()) {
     Builder.CreateRetVoid();
   } else {
-    Builder.CreateRet(Builder.CreateBitCast(CI, NewG->getReturnType()));
+    Builder.CreateRet(createCast(Builder, CI, NewG->getReturnType()));
   }
 
   NewG->copyAttributesFrom(G);
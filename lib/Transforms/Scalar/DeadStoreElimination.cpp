@@ -7,11 +7,13 @@
 //
 //===----------------------------------------------------------------------===//
 //
-// This file implements a trivial dead store elimination that only considers
-// basic-block local redundant stores.
-//
-// FIXME: This should eventually be extended to be a post-dominator tree
-// traversal.  Doing so would be pretty trivial.
+// This file implements a dead store elimination that first removes basic-block
+// local redundant stores.  A global phase then removes stores that are
+// completely overwritten in a post-dominating block, found with non-local
+// MemoryDependenceAnalysis queries, and stores to stack objects that are never
+// read again before the function returns.  Proving that no read happens in
+// between is done with a forward scan of the CFG that is bounded by
+// -dse-global-scan-limit.
 //
 //===----------------------------------------------------------------------===//
 
@@ -27,9 +29,12 @@
 #include "llvm/Analysis/Dominators.h"
 #include "llvm/Analysis/MemoryBuiltins.h"
 #include "llvm/Analysis/MemoryDependenceAnalysis.h"
+#include "llvm/Analysis/PostDominators.h"
 #include "llvm/Analysis/ValueTracking.h"
 #include "llvm/Target/TargetData.h"
 #include "llvm/Transforms/Utils/Local.h"
+#include "llvm/Support/CFG.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/ADT/Statistic.h"
@@ -37,6 +42,16 @@ using namespace llvm;
 
 STATISTIC(NumFastStores, "Number of stores deleted");
 STATISTIC(NumFastOther , "Number of other instrs removed");
+STATISTIC(NumGlobalStores, "Number of stores deleted by global DSE");
+
+static cl::opt<bool>
+EnableGlobalDSE("enable-global-dse", cl::init(true), cl::Hidden,
+  cl::desc("Remove stores that are dead across basic blocks"));
+
+static cl::opt<unsigned>
+GlobalDSEScanLimit("dse-global-scan-limit", cl::init(500), cl::Hidden,
+  cl::desc("The maximum number of instructions scanned to prove that a "
+           "store is not read before it is overwritten"));
 
 namespace {
   struct DSE : public FunctionPass {
@@ -59,6 +74,9 @@ namespace {
         // cycles that will confuse alias analysis.
         if (DT.isReachableFromEntry(I))
           Changed |= runOnBasicBlock(*I);
+
+      if (EnableGlobalDSE)
+        Changed |= runGlobal(F, DT);
       
       AA = 0; MD = 0;
       return Changed;
@@ -67,6 +85,13 @@ namespace {
     bool runOnBasicBlock(BasicBlock &BB);
     bool HandleFree(CallInst *F);
     bool handleEndBlock(BasicBlock &BB);
+    bool runGlobal(Function &F, DominatorTree &DT);
+    bool handleNonLocalKiller(Instruction *Inst,
+                              const AliasAnalysis::Location &Loc,
+                              PostDominatorTree &PDT);
+    bool mayBeReadBefore(Instruction *Inst,
+                         const AliasAnalysis::Location &Loc,
+                         Instruction *Killer);
     void RemoveAccessedObjects(const AliasAnalysis::Location &LoadedLoc,
                                SmallPtrSet<Value*, 16> &DeadStackObjects);
 
@@ -75,6 +100,7 @@ namespace {
       AU.addRequired<DominatorTree>();
       AU.addRequired<AliasAnalysis>();
       AU.addRequired<MemoryDependenceAnalysis>();
+      AU.addRequired<PostDominatorTree>();
       AU.addPreserved<AliasAnalysis>();
       AU.addPreserved<DominatorTree>();
       AU.addPreserved<MemoryDependenceAnalysis>();
@@ -86,6 +112,7 @@ char DSE::ID = 0;
 INITIALIZE_PASS_BEGIN(DSE, "dse", "Dead Store Elimination", false, false)
 INITIALIZE_PASS_DEPENDENCY(DominatorTree)
 INITIALIZE_PASS_DEPENDENCY(MemoryDependenceAnalysis)
+INITIALIZE_PASS_DEPENDENCY(PostDominatorTree)
 INITIALIZE_AG_DEPENDENCY(AliasAnalysis)
 INITIALIZE_PASS_END(DSE, "dse", "Dead Store Elimination", false, false)
 
@@ -696,6 +723,162 @@ bool DSE::handleEndBlock(BasicBlock &BB) {
   return MadeChange;
 }
 
+//===----------------------------------------------------------------------===//
+// Global DSE
+//===----------------------------------------------------------------------===//
+
+/// mayReadInRange - Return true if an instruction in [I, E) may read Loc, or
+/// if the scan budget runs out first.
+static bool mayReadInRange(BasicBlock::iterator I, BasicBlock::iterator E,
+                           const AliasAnalysis::Location &Loc,
+                           AliasAnalysis &AA, unsigned &Budget) {
+  for (; I != E; ++I) {
+    if (Budget == 0)
+      return true;
+    --Budget;
+    if (AA.getModRefInfo(I, Loc) & AliasAnalysis::Ref)
+      return true;
+  }
+  return false;
+}
+
+/// mayBeReadBefore - Return true if the memory at Loc written by Inst may be
+/// read on some path from Inst to Killer, or to the end of the function if
+/// Killer is null.  Killer must post-dominate Inst and be in another block.
+bool DSE::mayBeReadBefore(Instruction *Inst,
+                          const AliasAnalysis::Location &Loc,
+                          Instruction *Killer) {
+  unsigned Budget = GlobalDSEScanLimit;
+  BasicBlock *BB = Inst->getParent();
+  BasicBlock *KillerBB = Killer ? Killer->getParent() : 0;
+
+  BasicBlock::iterator Start = Inst;
+  if (mayReadInRange(++Start, BB->end(), Loc, *AA, Budget))
+    return true;
+
+  // Walk the blocks reachable from Inst, stopping at the killing block.  If
+  // Inst's block is reached again through a loop, it is scanned entirely.
+  SmallVector<BasicBlock*, 16> Worklist(succ_begin(BB), succ_end(BB));
+  SmallPtrSet<BasicBlock*, 16> Visited;
+  while (!Worklist.empty()) {
+    BasicBlock *Succ = Worklist.pop_back_val();
+    if (!Visited.insert(Succ))
+      continue;
+
+    if (Succ == KillerBB) {
+      if (mayReadInRange(Succ->begin(), Killer, Loc, *AA, Budget))
+        return true;
+      continue;
+    }
+
+    if (mayReadInRange(Succ->begin(), Succ->end(), Loc, *AA, Budget))
+      return true;
+    Worklist.append(succ_begin(Succ), succ_end(Succ));
+  }
+  return false;
+}
+
+/// handleNonLocalKiller - Inst writes Loc and has no dependency in its own
+/// block.  Remove the writes in other blocks that Inst completely overwrites,
+/// if Inst post-dominates them and nothing reads the memory in between.
+bool DSE::handleNonLocalKiller(Instruction *Inst,
+                               const AliasAnalysis::Location &Loc,
+                               PostDominatorTree &PDT) {
+  BasicBlock *BB = Inst->getParent();
+  SmallVector<NonLocalDepResult, 16> Deps;
+  MD->getNonLocalPointerDependency(Loc, false, BB, Deps);
+
+  bool MadeChange = false;
+  for (unsigned i = 0, e = Deps.size(); i != e; ++i) {
+    // Only a write that must alias the location is a candidate.  Loc.Ptr may
+    // have been phi translated on the way to DepWrite, and the same SSA value
+    // names a different address on another loop iteration, so compare the
+    // write against the translated address rather than Loc.Ptr.
+    const MemDepResult &Res = Deps[i].getResult();
+    if (!Res.isDef() || Deps[i].getAddress() == 0)
+      continue;
+    AliasAnalysis::Location TransLoc = Loc;
+    TransLoc.Ptr = Deps[i].getAddress();
+
+    Instruction *DepWrite = Res.getInst();
+    if (DepWrite->getParent() == BB || !hasMemoryWrite(DepWrite) ||
+        !isRemovable(DepWrite))
+      continue;
+
+    AliasAnalysis::Location DepLoc = getLocForWrite(DepWrite, *AA);
+    if (DepLoc.Ptr == 0 || !isCompleteOverwrite(TransLoc, DepLoc, *AA))
+      continue;
+
+    // A killer that also reads, like memcpy, reads at its own untranslated
+    // address, so only check it for self reads when nothing was translated.
+    if (TransLoc.Ptr != Loc.Ptr ? getLocForRead(Inst, *AA).Ptr != 0
+                                : isPossibleSelfRead(Inst, Loc, DepWrite, *AA))
+      continue;
+
+    if (!PDT.dominates(BB, DepWrite->getParent()) ||
+        mayBeReadBefore(DepWrite, DepLoc, Inst))
+      continue;
+
+    DEBUG(dbgs() << "DSE: Remove Non-Local Dead Store:\n  DEAD: "
+          << *DepWrite << "\n  KILLER: " << *Inst << '\n');
+    DeleteDeadInstruction(DepWrite, *MD);
+    ++NumGlobalStores;
+    MadeChange = true;
+  }
+  return MadeChange;
+}
+
+/// runGlobal - Remove the stores that are dead across basic blocks: the ones
+/// that are overwritten in a post-dominating block, and the stores to stack
+/// objects that are not read again on any path to the end of the function.
+bool DSE::runGlobal(Function &F, DominatorTree &DT) {
+  PostDominatorTree &PDT = getAnalysis<PostDominatorTree>();
+
+  SmallVector<WeakVH, 32> Writes;
+  for (Function::iterator BB = F.begin(), E = F.end(); BB != E; ++BB)
+    if (DT.isReachableFromEntry(BB))
+      for (BasicBlock::iterator I = BB->begin(), IE = BB->end(); I != IE; ++I)
+        if (hasMemoryWrite(I))
+          Writes.push_back(WeakVH(I));
+
+  bool MadeChange = false;
+  for (unsigned i = 0, e = Writes.size(); i != e; ++i) {
+    Instruction *Inst = cast_or_null<Instruction>((Value*)Writes[i]);
+    if (Inst == 0)
+      continue;
+    AliasAnalysis::Location Loc = getLocForWrite(Inst, *AA);
+    if (Loc.Ptr == 0 || !MD->getDependency(Inst).isNonLocal())
+      continue;
+    MadeChange |= handleNonLocalKiller(Inst, Loc, PDT);
+  }
+
+  // Stack objects are dead once the function returns.  Only allocas in the
+  // entry block are considered, so that each one is a single object.
+  BasicBlock *Entry = &F.getEntryBlock();
+  for (unsigned i = 0, e = Writes.size(); i != e; ++i) {
+    Instruction *Inst = cast_or_null<Instruction>((Value*)Writes[i]);
+    if (Inst == 0 || !isRemovable(Inst))
+      continue;
+
+    Value *Object = GetUnderlyingObject(getStoredPointerOperand(Inst));
+    AllocaInst *AI = dyn_cast<AllocaInst>(Object);
+    Argument *Arg = dyn_cast<Argument>(Object);
+    if (!(AI && AI->getParent() == Entry) && !(Arg && Arg->hasByValAttr()))
+      continue;
+
+    AliasAnalysis::Location Loc = getLocForWrite(Inst, *AA);
+    if (Loc.Ptr == 0 || mayBeReadBefore(Inst, Loc, 0))
+      continue;
+
+    DEBUG(dbgs() << "DSE: Remove Store To Dead Stack Object:\n  DEAD: "
+          << *Inst << "\n  Object: " << *Object << '\n');
+    DeleteDeadInstruction(Inst, *MD);
+    ++NumGlobalStores;
+    MadeChange = true;
+  }
+  return MadeChange;
+}
+
 /// RemoveAccessedObjects - Check to see if the specified location may alias any
 /// of the stack objects in the DeadStackObjects set.  If so, they become live
 /// because the location is being loaded.
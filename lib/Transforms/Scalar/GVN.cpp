@@ -52,6 +52,9 @@ STATISTIC(NumPRELoad,   "Number of loads PRE'd");
 static cl::opt<bool> EnablePRE("enable-pre",
                                cl::init(true), cl::Hidden);
 static cl::opt<bool> EnableLoadPRE("enable-load-pre", cl::init(true));
+static cl::opt<bool>
+EnableNewGVN("enable-newgvn", cl::init(false), cl::Hidden,
+             cl::desc("Run the partition-based NewGVN pass in place of GVN"));
 
 //===----------------------------------------------------------------------===//
 //                         ValueTable Class
@@ -498,6 +501,8 @@ namespace {
 
 // createGVNPass - The public interface to this file...
 FunctionPass *llvm::createGVNPass(bool NoLoads) {
+  if (EnableNewGVN && !NoLoads)
+    return createNewGVNPass();
   return new GVN(NoLoads);
 }
 
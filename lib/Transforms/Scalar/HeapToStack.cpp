@@ -0,0 +1,267 @@
+//===- HeapToStack.cpp - Promote short-lived mallocs to allocas -----------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This pass turns calls to malloc with a small constant size into allocas when
+// the memory can't be used after the function returns: the pointer is only
+// loaded from, stored to, compared, freed, and passed to calls that neither
+// capture nor free it.  The matching calls to free are deleted.
+//
+// Only one alloca is created for each malloc, so if the malloc is executed
+// more than once per call of the function, i.e. if it is in a loop, the
+// allocations of different iterations share their memory.  That is only safe
+// if each allocation is dead once the malloc is executed again, which is
+// guaranteed when the pointer doesn't flow through a PHI node or select: every
+// use then sees the allocation of the current iteration.
+//
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "heap-to-stack"
+#include "llvm/Transforms/Scalar.h"
+#include "llvm/Constants.h"
+#include "llvm/DerivedTypes.h"
+#include "llvm/Function.h"
+#include "llvm/Instructions.h"
+#include "llvm/IntrinsicInst.h"
+#include "llvm/Pass.h"
+#include "llvm/Analysis/MemoryBuiltins.h"
+#include "llvm/Support/CallSite.h"
+#include "llvm/Support/CFG.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/ADT/SCCIterator.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Statistic.h"
+using namespace llvm;
+
+STATISTIC(NumPromoted, "Number of mallocs promoted to allocas");
+STATISTIC(NumFreesDeleted, "Number of frees deleted");
+
+static cl::opt<unsigned>
+HeapToStackLimit("heap-to-stack-limit", cl::init(1024), cl::Hidden,
+  cl::desc("Maximum number of bytes of heap memory moved to the stack in "
+           "one function"));
+
+namespace {
+  class HeapToStack : public FunctionPass {
+    /// CyclicBlocks - The blocks that are part of a cycle in the CFG, computed
+    /// on demand.
+    SmallPtrSet<const BasicBlock*, 32> CyclicBlocks;
+    bool ComputedCycles;
+
+  public:
+    static char ID; // Pass identification, replacement for typeid
+    HeapToStack() : FunctionPass(ID) {
+      initializeHeapToStackPass(*PassRegistry::getPassRegistry());
+    }
+
+    virtual bool runOnFunction(Function &F);
+
+    virtual void getAnalysisUsage(AnalysisUsage &AU) const {
+      AU.setPreservesCFG();
+    }
+
+  private:
+    bool isInCycle(const BasicBlock *BB);
+    bool isSafeToPromote(CallInst *Malloc, SmallVectorImpl<CallInst*> &Frees,
+                         SmallVectorImpl<CallInst*> &Calls);
+    void promote(CallInst *Malloc, uint64_t Size,
+                 SmallVectorImpl<CallInst*> &Frees,
+                 SmallVectorImpl<CallInst*> &Calls);
+  };
+}
+
+char HeapToStack::ID = 0;
+INITIALIZE_PASS(HeapToStack, "heap-to-stack",
+                "Promote short-lived mallocs to allocas", false, false)
+
+FunctionPass *llvm::createHeapToStackPass() { return new HeapToStack(); }
+
+/// isInCycle - Return true if BB may be executed more than once per call of
+/// the function.
+bool HeapToStack::isInCycle(const BasicBlock *BB) {
+  if (!ComputedCycles) {
+    ComputedCycles = true;
+    const Function *F = BB->getParent();
+    for (scc_iterator<const Function*> I = scc_begin(F), E = scc_end(F);
+         I != E; ++I)
+      if (I.hasLoop())
+        CyclicBlocks.insert((*I).begin(), (*I).end());
+  }
+  return CyclicBlocks.count(BB);
+}
+
+/// doesNotFree - Return true if the callee of CS can't free the memory passed
+/// as its argument ArgNo without capturing it.
+static bool doesNotFree(CallSite CS, unsigned ArgNo) {
+  if (!CS.paramHasAttr(ArgNo + 1, Attribute::NoCapture))
+    return false;
+  if (CS.onlyReadsMemory())
+    return true;
+  // Library functions get their nocapture attributes from SimplifyLibCalls,
+  // and realloc is the only one of those that frees its argument.  Nothing
+  // can be said about functions defined in this module, since FunctionAttrs
+  // marks the argument of a wrapper around free as nocapture.
+  const Function *F = CS.getCalledFunction();
+  return F && F->isDeclaration() && F->getName() != "realloc" &&
+         F->getName() != "reallocf";
+}
+
+/// isSafeToPromote - Return true if the memory returned by Malloc is not
+/// accessed after the function returns, or after the next execution of Malloc.
+/// Collect the calls that free it in Frees, and the other calls it is passed
+/// to in Calls.
+bool HeapToStack::isSafeToPromote(CallInst *Malloc,
+                                  SmallVectorImpl<CallInst*> &Frees,
+                                  SmallVectorImpl<CallInst*> &Calls) {
+  bool InCycle = isInCycle(Malloc->getParent());
+  SmallVector<std::pair<Instruction*, bool>, 16> Worklist;
+  SmallPtrSet<Instruction*, 16> Visited;
+  // The second element is true if the value may be something other than
+  // Malloc plus an offset.
+  Worklist.push_back(std::make_pair(Malloc, false));
+  Visited.insert(Malloc);
+
+  while (!Worklist.empty()) {
+    Instruction *V = Worklist.back().first;
+    bool Merged = Worklist.back().second;
+    Worklist.pop_back();
+
+    for (Value::use_iterator UI = V->use_begin(), UE = V->use_end();
+         UI != UE; ++UI) {
+      Instruction *U = cast<Instruction>(*UI);
+      switch (U->getOpcode()) {
+      case Instruction::Load:
+      case Instruction::ICmp:
+        continue;
+      case Instruction::Store:
+        // Storing the pointer itself lets it escape.
+        if (U->getOperand(0) == V)
+          return false;
+        continue;
+      case Instruction::BitCast:
+      case Instruction::GetElementPtr:
+        if (Visited.insert(U))
+          Worklist.push_back(std::make_pair(U, Merged));
+        continue;
+      case Instruction::PHI:
+      case Instruction::Select:
+        if (InCycle)
+          return false;
+        if (Visited.insert(U))
+          Worklist.push_back(std::make_pair(U, true));
+        continue;
+      case Instruction::Call:
+      case Instruction::Invoke:
+        break;
+      default:
+        return false;
+      }
+
+      if (CallInst *Free = isFreeCall(U)) {
+        // A free of a value that may not be this allocation must stay.
+        if (Merged || (V != Malloc && !isa<BitCastInst>(V)))
+          return false;
+        Frees.push_back(Free);
+        continue;
+      }
+      if (isa<DbgInfoIntrinsic>(U))
+        continue;
+      if (CallInst *CI = dyn_cast<CallInst>(U))
+        Calls.push_back(CI);
+      if (const IntrinsicInst *II = dyn_cast<IntrinsicInst>(U)) {
+        switch (II->getIntrinsicID()) {
+        case Intrinsic::memset:
+        case Intrinsic::memcpy:
+        case Intrinsic::memmove:
+        case Intrinsic::lifetime_start:
+        case Intrinsic::lifetime_end:
+          continue;
+        default:
+          break;
+        }
+      }
+
+      CallSite CS(U);
+      if (CS.isCallee(UI))
+        return false;
+      if (!doesNotFree(CS, CS.getArgumentNo(UI)))
+        return false;
+    }
+  }
+  return true;
+}
+
+/// promote - Replace Malloc with an alloca of Size bytes in the entry block,
+/// and delete the calls to free it.  The other Calls it is passed to now get
+/// a pointer into the caller's frame, so they can't be tail calls anymore.
+void HeapToStack::promote(CallInst *Malloc, uint64_t Size,
+                          SmallVectorImpl<CallInst*> &Frees,
+                          SmallVectorImpl<CallInst*> &Calls) {
+  // malloc returns memory aligned for any object that fits into it.
+  unsigned Align = 1;
+  while (Align < Size && Align < 16)
+    Align <<= 1;
+
+  LLVMContext &Context = Malloc->getContext();
+  BasicBlock &Entry = Malloc->getParent()->getParent()->getEntryBlock();
+  const Type *Ty = ArrayType::get(Type::getInt8Ty(Context), Size);
+  AllocaInst *AI = new AllocaInst(Ty, 0, Align, Malloc->getName() + ".stack",
+                                  Entry.begin());
+  Value *Ptr = new BitCastInst(AI, Malloc->getType(), "", Malloc);
+  Ptr->takeName(Malloc);
+
+  for (unsigned i = 0, e = Frees.size(); i != e; ++i) {
+    CallInst *Free = Frees[i];
+    Value *Arg = Free->getArgOperand(0);
+    Free->eraseFromParent();
+    if (Instruction *Cast = dyn_cast<BitCastInst>(Arg))
+      if (Cast->use_empty())
+        Cast->eraseFromParent();
+    ++NumFreesDeleted;
+  }
+
+  for (unsigned i = 0, e = Calls.size(); i != e; ++i)
+    Calls[i]->setTailCall(false);
+
+  Malloc->replaceAllUsesWith(Ptr);
+  Malloc->eraseFromParent();
+  ++NumPromoted;
+}
+
+bool HeapToStack::runOnFunction(Function &F) {
+  CyclicBlocks.clear();
+  ComputedCycles = false;
+
+  SmallVector<CallInst*, 8> Mallocs;
+  for (Function::iterator BB = F.begin(), E = F.end(); BB != E; ++BB)
+    for (BasicBlock::iterator I = BB->begin(), IE = BB->end(); I != IE; ++I)
+      if (isa<CallInst>(I) && isMalloc(I))
+        Mallocs.push_back(cast<CallInst>(I));
+
+  bool Changed = false;
+  uint64_t Budget = HeapToStackLimit;
+  for (unsigned i = 0, e = Mallocs.size(); i != e; ++i) {
+    CallInst *Malloc = Mallocs[i];
+    ConstantInt *Size = dyn_cast<ConstantInt>(Malloc->getArgOperand(0));
+    if (!Size || Size->isZero() || Size->getZExtValue() > Budget)
+      continue;
+
+    SmallVector<CallInst*, 4> Frees, Calls;
+    if (!isSafeToPromote(Malloc, Frees, Calls))
+      continue;
+
+    DEBUG(dbgs() << "HeapToStack: promoting " << *Malloc << '\n');
+    Budget -= Size->getZExtValue();
+    promote(Malloc, Size->getZExtValue(), Frees, Calls);
+    Changed = true;
+  }
+  return Changed;
+}
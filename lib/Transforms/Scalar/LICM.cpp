@@ -195,7 +195,25 @@ bool LICM::runOnLoop(Loop *L, LPPassManager &LPM) {
        LoopItr != LoopItrE; ++LoopItr) {
     Loop *InnerL = *LoopItr;
     AliasSetTracker *InnerAST = LoopToAliasSetMap[InnerL];
-    assert(InnerAST && "Where is my AST?");
+    if (InnerAST == 0) {
+      // Loops created by other passes in this loop pass manager, like the
+      // prolog loops of runtime unrolling, are not visited by LICM, so there
+      // is no AST to reuse.
+      for (Loop::block_iterator I = InnerL->block_begin(),
+           E = InnerL->block_end(); I != E; ++I)
+        CurAST->add(**I);
+      LoopToAliasSetMap.erase(InnerL);
+      continue;
+    }
+
+    // The first subloop's AST can simply be adopted instead of copied, which
+    // matters when a deep nest carries thousands of pointers up to the top.
+    LoopToAliasSetMap.erase(InnerL);
+    if (CurAST->getAliasSets().empty()) {
+      delete CurAST;
+      CurAST = InnerAST;
+      continue;
+    }
 
     // What if InnerLoop was modified by other passes ?
     CurAST->add(*InnerAST);
@@ -203,7 +221,6 @@ bool LICM::runOnLoop(Loop *L, LPPassManager &LPM) {
     // Once we've incorporated the inner loop's AST into ours, we don't need the
     // subloop's anymore.
     delete InnerAST;
-    LoopToAliasSetMap.erase(InnerL);
   }
   
   CurLoop = L;
@@ -0,0 +1,284 @@
+//===-- LoopDataPrefetch.cpp - Prefetch strided loads in loops ------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This pass inserts software prefetches for the loads in innermost loops whose
+// address is an affine recurrence with a constant stride, when the loop
+// streams through more memory than the target's cache can hold.
+//
+// Each load is prefetched far enough ahead that the prefetch has completed by
+// the time the load executes: the target provides the latency to hide in
+// cycles, and the number of iterations this takes is estimated from the size
+// of the loop body.  Loads whose addresses are within a cache line of each
+// other share one prefetch.
+//
+// The target describes its caches through TargetLowering; with no target, or
+// a target that doesn't support software prefetching, the pass does nothing
+// unless the parameters are given on the command line.
+//
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "loop-data-prefetch"
+#include "llvm/Transforms/Scalar.h"
+#include "llvm/Constants.h"
+#include "llvm/DerivedTypes.h"
+#include "llvm/Instructions.h"
+#include "llvm/IntrinsicInst.h"
+#include "llvm/Module.h"
+#include "llvm/Analysis/LoopPass.h"
+#include "llvm/Analysis/ProfileInfo.h"
+#include "llvm/Analysis/ScalarEvolutionExpressions.h"
+#include "llvm/Target/TargetLowering.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Statistic.h"
+using namespace llvm;
+
+STATISTIC(NumPrefetches, "Number of prefetches inserted");
+STATISTIC(NumSmallLoops, "Number of loops that fit in the cache");
+
+static cl::opt<unsigned>
+PrefetchDistance("prefetch-distance", cl::init(0), cl::Hidden,
+  cl::desc("Number of cycles to prefetch loads ahead of their use "
+           "(default: from the target)"));
+
+static cl::opt<unsigned>
+PrefetchCacheLineSize("prefetch-cache-line-size", cl::init(0), cl::Hidden,
+  cl::desc("Cache line size in bytes assumed by loop prefetching "
+           "(default: from the target)"));
+
+static cl::opt<unsigned>
+PrefetchCacheSize("prefetch-cache-size", cl::init(0), cl::Hidden,
+  cl::desc("Only prefetch loops that access more bytes than this "
+           "(default: from the target)"));
+
+static cl::opt<unsigned>
+MaxPrefetchesPerLoop("max-prefetches-per-loop", cl::init(8), cl::Hidden,
+  cl::desc("Maximum number of prefetches to insert into one loop"));
+
+namespace {
+  class LoopDataPrefetch : public LoopPass {
+    /// TLI - Keep a pointer of a TargetLowering to consult for the cache
+    /// parameters.
+    const TargetLowering *TLI;
+    ScalarEvolution *SE;
+
+    unsigned CacheLineSize;
+    unsigned Distance;
+    uint64_t CacheSize;
+
+  public:
+    static char ID; // Pass ID, replacement for typeid
+    explicit LoopDataPrefetch(const TargetLowering *tli = 0)
+      : LoopPass(ID), TLI(tli) {
+      initializeLoopDataPrefetchPass(*PassRegistry::getPassRegistry());
+    }
+
+    bool runOnLoop(Loop *L, LPPassManager &LPM);
+
+    virtual void getAnalysisUsage(AnalysisUsage &AU) const {
+      AU.setPreservesCFG();
+      AU.addRequired<LoopInfo>();
+      AU.addPreserved<LoopInfo>();
+      AU.addRequired<ScalarEvolution>();
+      AU.addPreserved<ScalarEvolution>();
+      AU.addPreserved<ProfileInfo>();
+    }
+
+  private:
+    /// Stream - A group of loads that share a prefetch.
+    struct Stream {
+      LoadInst *Load;
+      const SCEVAddRecExpr *AddRec;
+      int64_t Stride;
+    };
+
+    uint64_t getFootprint(const Loop *L, const Stream &S);
+    unsigned getIterationCost(const Loop *L);
+    void insertPrefetch(const Stream &S, int64_t Offset);
+  };
+}
+
+char LoopDataPrefetch::ID = 0;
+INITIALIZE_PASS_BEGIN(LoopDataPrefetch, "loop-data-prefetch",
+                      "Loop Data Prefetch", false, false)
+INITIALIZE_PASS_DEPENDENCY(LoopInfo)
+INITIALIZE_PASS_DEPENDENCY(ScalarEvolution)
+INITIALIZE_PASS_END(LoopDataPrefetch, "loop-data-prefetch",
+                    "Loop Data Prefetch", false, false)
+
+Pass *llvm::createLoopDataPrefetchPass(const TargetLowering *TLI) {
+  return new LoopDataPrefetch(TLI);
+}
+
+/// getTripCount - Return the maximum number of iterations of L, or zero if it
+/// is unknown.
+static uint64_t getTripCount(ScalarEvolution &SE, const Loop *L) {
+  const SCEVConstant *BECount =
+    dyn_cast<SCEVConstant>(SE.getMaxBackedgeTakenCount(L));
+  if (!BECount || BECount->getValue()->getValue().getActiveBits() > 32)
+    return 0;
+  return BECount->getValue()->getZExtValue() + 1;
+}
+
+/// getFootprint - Return the number of bytes S streams through during one
+/// execution of the outermost loop that moves it, or ~0 if it is unknown.
+uint64_t LoopDataPrefetch::getFootprint(const Loop *L, const Stream &S) {
+  uint64_t Stride = S.Stride < 0 ? -S.Stride : S.Stride;
+  uint64_t TripCount = getTripCount(*SE, L);
+  if (!TripCount)
+    return ~0ULL;
+  uint64_t Footprint = Stride * TripCount;
+
+  // If the start of the stream moves in the enclosing loops, so does the
+  // memory it covers.
+  const SCEV *Start = S.AddRec->getStart();
+  for (const Loop *P = L->getParentLoop(); P; P = P->getParentLoop()) {
+    if (SE->isLoopInvariant(Start, P))
+      break;
+    uint64_t OuterTripCount = getTripCount(*SE, P);
+    if (!OuterTripCount || Footprint > ~0ULL / OuterTripCount)
+      return ~0ULL;
+    Footprint *= OuterTripCount;
+  }
+  return Footprint;
+}
+
+/// getIterationCost - Estimate the number of cycles one iteration of L takes,
+/// assuming one cycle per instruction.
+unsigned LoopDataPrefetch::getIterationCost(const Loop *L) {
+  unsigned Cost = 0;
+  for (Loop::block_iterator BI = L->block_begin(), BE = L->block_end();
+       BI != BE; ++BI)
+    for (BasicBlock::iterator I = (*BI)->begin(), E = (*BI)->end();
+         I != E; ++I) {
+      if (isa<PHINode>(I) || isa<DbgInfoIntrinsic>(I) || isa<CastInst>(I))
+        continue;
+      ++Cost;
+    }
+  return Cost ? Cost : 1;
+}
+
+/// insertPrefetch - Prefetch the address of S.Load plus Offset bytes, right
+/// before the load.
+void LoopDataPrefetch::insertPrefetch(const Stream &S, int64_t Offset) {
+  LoadInst *LI = S.Load;
+  LLVMContext &Context = LI->getContext();
+  const Type *I8Ptr =
+    Type::getInt8PtrTy(Context, LI->getPointerAddressSpace());
+  Value *Ptr = LI->getPointerOperand();
+  if (Ptr->getType() != I8Ptr)
+    Ptr = new BitCastInst(Ptr, I8Ptr, "", LI);
+  Value *Idx = ConstantInt::get(Type::getInt64Ty(Context), Offset);
+  Value *Addr = GetElementPtrInst::Create(Ptr, Idx, "prefetch.addr", LI);
+
+  Module *M = LI->getParent()->getParent()->getParent();
+  Value *Prefetch = Intrinsic::getDeclaration(M, Intrinsic::prefetch);
+  Value *Args[] = {
+    Addr,
+    ConstantInt::get(Type::getInt32Ty(Context), 0),   // read
+    ConstantInt::get(Type::getInt32Ty(Context), 3)    // keep in all caches
+  };
+  CallInst::Create(Prefetch, Args, Args + 3, "", LI);
+  ++NumPrefetches;
+}
+
+bool LoopDataPrefetch::runOnLoop(Loop *L, LPPassManager &LPM) {
+  // Only innermost loops run long enough between their loads for this to
+  // pay off.
+  if (!L->empty())
+    return false;
+
+  CacheLineSize = PrefetchCacheLineSize;
+  Distance = PrefetchDistance;
+  CacheSize = PrefetchCacheSize;
+  if (TLI) {
+    if (!CacheLineSize)
+      CacheLineSize = TLI->getCacheLineSize();
+    if (!Distance)
+      Distance = TLI->getPrefetchDistance();
+    if (!CacheSize)
+      CacheSize = TLI->getPrefetchCacheSize();
+  }
+  if (!CacheLineSize || !Distance)
+    return false;
+
+  SE = &getAnalysis<ScalarEvolution>();
+
+  // Collect the strided loads, one per cache line.
+  SmallVector<Stream, 8> Streams;
+  for (Loop::block_iterator BI = L->block_begin(), BE = L->block_end();
+       BI != BE; ++BI)
+    for (BasicBlock::iterator I = (*BI)->begin(), E = (*BI)->end();
+         I != E; ++I) {
+      LoadInst *LI = dyn_cast<LoadInst>(I);
+      if (!LI || LI->isVolatile())
+        continue;
+      const SCEVAddRecExpr *AddRec =
+        dyn_cast<SCEVAddRecExpr>(SE->getSCEV(LI->getPointerOperand()));
+      if (!AddRec || AddRec->getLoop() != L || !AddRec->isAffine())
+        continue;
+      const SCEVConstant *Step =
+        dyn_cast<SCEVConstant>(AddRec->getStepRecurrence(*SE));
+      if (!Step || Step->getValue()->isZero() ||
+          Step->getValue()->getValue().getMinSignedBits() > 32)
+        continue;
+
+      bool Covered = false;
+      for (unsigned i = 0, e = Streams.size(); i != e && !Covered; ++i) {
+        const SCEVConstant *Diff =
+          dyn_cast<SCEVConstant>(SE->getMinusSCEV(AddRec, Streams[i].AddRec));
+        if (!Diff)
+          continue;
+        int64_t D = Diff->getValue()->getSExtValue();
+        Covered = (D < 0 ? -D : D) < (int64_t)CacheLineSize;
+      }
+      if (Covered)
+        continue;
+
+      Stream S;
+      S.Load = LI;
+      S.AddRec = AddRec;
+      S.Stride = Step->getValue()->getSExtValue();
+      Streams.push_back(S);
+    }
+  if (Streams.empty())
+    return false;
+
+  // Leave loops whose data stays in the cache alone.
+  if (CacheSize) {
+    uint64_t Footprint = 0;
+    for (unsigned i = 0, e = Streams.size(); i != e; ++i) {
+      uint64_t F = getFootprint(L, Streams[i]);
+      Footprint = F > ~0ULL - Footprint ? ~0ULL : Footprint + F;
+    }
+    if (Footprint <= CacheSize) {
+      ++NumSmallLoops;
+      return false;
+    }
+  }
+
+  unsigned Cost = getIterationCost(L);
+  unsigned Iterations = (Distance + Cost - 1) / Cost;
+  DEBUG(dbgs() << "LoopDataPrefetch: prefetching " << Streams.size()
+               << " streams " << Iterations << " iterations ahead in loop "
+               << L->getHeader()->getName() << '\n');
+
+  unsigned NumStreams = std::min<unsigned>(Streams.size(),
+                                           MaxPrefetchesPerLoop);
+  for (unsigned i = 0; i != NumStreams; ++i) {
+    int64_t Offset = Streams[i].Stride * (int64_t)Iterations;
+    // Prefetching less than a line ahead fetches the line being loaded.
+    if ((Offset < 0 ? -Offset : Offset) < (int64_t)CacheLineSize)
+      Offset = Offset < 0 ? -(int64_t)CacheLineSize : CacheLineSize;
+    insertPrefetch(Streams[i], Offset);
+  }
+  return true;
+}
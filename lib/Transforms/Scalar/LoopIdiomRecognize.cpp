@@ -11,27 +11,29 @@
 // non-loop form.  In cases that this kicks in, it can be a significant
 // performance win.
 //
+// Counted loops that store a splat value to consecutive memory, possibly with
+// several adjacent stores per iteration, become memsets, and loops that copy
+// memory become memcpys.  Loops without side effects that search memory for a
+// byte (strlen, memchr), compare memory (memcmp), or count the bits of a value
+// (ctpop, ctlz) are replaced as a whole, if the target says that the library
+// call or intrinsic is fast.  memcmp may read the whole range even when the
+// blocks differ early, so it is only formed when all of it can be read.
+//
 //===----------------------------------------------------------------------===//
 //
 // TODO List:
 //
 // Future loop memory idioms to recognize:
-//   memcmp, memmove, strlen, etc.
+//   memmove, etc.
 // Future floating point idioms to recognize in -ffast-math mode:
 //   fpowi
 // Future integer operation idioms to recognize:
-//   ctpop, ctlz, cttz
+//   cttz
 //
 // Beware that isel's default lowering for ctpop is highly inefficient for
 // i64 and larger types when i64 is legal and the value has few bits set.  It
 // would be good to enhance isel to emit a loop for ctpop in this case.
 //
-// We should enhance the memset/memcpy recognition to handle multiple stores in
-// the loop.  This would handle things like:
-//   void foo(_Complex float *P)
-//     for (i) { __real__(*P) = 0;  __imag__(*P) = 0; }
-// this is also "Example 2" from http://blog.regehr.org/archives/320
-//
 // This could recognize common matrix multiplies and dot product idioms and
 // replace them with calls to BLAS (if linked in??).
 //
@@ -39,6 +41,7 @@
 
 #define DEBUG_TYPE "loop-idiom"
 #include "llvm/Transforms/Scalar.h"
+#include "llvm/GlobalVariable.h"
 #include "llvm/IntrinsicInst.h"
 #include "llvm/Analysis/AliasAnalysis.h"
 #include "llvm/Analysis/LoopPass.h"
@@ -46,15 +49,35 @@
 #include "llvm/Analysis/ScalarEvolutionExpander.h"
 #include "llvm/Analysis/ValueTracking.h"
 #include "llvm/Target/TargetData.h"
+#include "llvm/Target/TargetLowering.h"
+#include "llvm/Transforms/Utils/BuildLibCalls.h"
 #include "llvm/Transforms/Utils/Local.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/IRBuilder.h"
 #include "llvm/Support/raw_ostream.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/ADT/Statistic.h"
+#include <algorithm>
 using namespace llvm;
 
 STATISTIC(NumMemSet, "Number of memset's formed from loop stores");
 STATISTIC(NumMemCpy, "Number of memcpy's formed from loop load+stores");
+STATISTIC(NumStrLen, "Number of strlen's formed from loops");
+STATISTIC(NumMemChr, "Number of memchr's formed from loops");
+STATISTIC(NumMemCmp, "Number of memcmp's formed from loops");
+STATISTIC(NumBitCount, "Number of ctpop's and ctlz's formed from loops");
+
+static cl::opt<bool>
+FastStringLibCalls("loop-idiom-string-libcalls", cl::init(false), cl::Hidden,
+  cl::desc("Replace byte search and compare loops by library calls when no "
+           "target information is available"));
+
+static cl::opt<bool>
+FastBitCount("loop-idiom-bitcount", cl::init(false), cl::Hidden,
+  cl::desc("Replace bit counting loops by intrinsics when no target "
+           "information is available"));
 
 namespace {
   class LoopIdiomRecognize : public LoopPass {
@@ -62,9 +85,16 @@ namespace {
     const TargetData *TD;
     DominatorTree *DT;
     ScalarEvolution *SE;
+    LoopInfo *LI;
+
+    /// TLI - Keep a pointer of a TargetLowering to consult for whether the
+    /// library calls and intrinsics are profitable.  This is null when no
+    /// target information is available.
+    const TargetLowering *TLI;
   public:
     static char ID;
-    explicit LoopIdiomRecognize() : LoopPass(ID) {
+    explicit LoopIdiomRecognize(const TargetLowering *tli = 0)
+      : LoopPass(ID), TLI(tli) {
       initializeLoopIdiomRecognizePass(*PassRegistry::getPassRegistry());
     }
 
@@ -73,17 +103,30 @@ namespace {
                         SmallVectorImpl<BasicBlock*> &ExitBlocks);
 
     bool processLoopStore(StoreInst *SI, const SCEV *BECount);
+    bool processLoopStoreGroup(StoreInst *SI, const SCEVAddRecExpr *StoreEv,
+                               const SCEV *BECount);
     bool processLoopMemSet(MemSetInst *MSI, const SCEV *BECount);
     
     bool processLoopStoreOfSplatValue(Value *DestPtr, unsigned StoreSize,
                                       unsigned StoreAlignment,
-                                      Value *SplatValue, Instruction *TheStore,
+                                      Value *SplatValue,
+                                      SmallPtrSet<Instruction*, 8> &TheStores,
                                       const SCEVAddRecExpr *Ev,
                                       const SCEV *BECount);
     bool processLoopStoreOfLoopLoad(StoreInst *SI, unsigned StoreSize,
                                     const SCEVAddRecExpr *StoreEv,
                                     const SCEVAddRecExpr *LoadEv,
                                     const SCEV *BECount);
+
+    bool recognizeSearch(LPPassManager &LPM);
+    bool recognizeBitCount(LPPassManager &LPM);
+    bool isExitValueComputable(BasicBlock *ExitingBB, bool KnownIteration,
+                               Value *Zero);
+    Value *getExitValue(Value *V, Value *Iteration, Value *Zero,
+                        SCEVExpander &Expander);
+    void replaceLoop(Value *Cond, BasicBlock *TrueExiting, Value *TrueIteration,
+                     BasicBlock *FalseExiting, Value *FalseIteration,
+                     Value *Zero, LPPassManager &LPM);
       
     /// This transformation requires natural loop information & requires that
     /// loop preheaders be inserted into the CFG.
@@ -117,7 +160,9 @@ INITIALIZE_AG_DEPENDENCY(AliasAnalysis)
 INITIALIZE_PASS_END(LoopIdiomRecognize, "loop-idiom", "Recognize loop idioms",
                     false, false)
 
-Pass *llvm::createLoopIdiomPass() { return new LoopIdiomRecognize(); }
+Pass *llvm::createLoopIdiomPass(const TargetLowering *TLI) {
+  return new LoopIdiomRecognize(TLI);
+}
 
 /// DeleteDeadInstruction - Delete this instruction.  Before we do, go through
 /// and zero out all the operands of this instruction.  If any of them become
@@ -156,8 +201,21 @@ static void DeleteDeadInstruction(Instruction *I, ScalarEvolution &SE) {
 bool LoopIdiomRecognize::runOnLoop(Loop *L, LPPassManager &LPM) {
   CurLoop = L;
   
-  // The trip count of the loop must be analyzable.
+  // We require target data for now.
+  TD = getAnalysisIfAvailable<TargetData>();
+  if (TD == 0) return false;
+
   SE = &getAnalysis<ScalarEvolution>();
+  DT = &getAnalysis<DominatorTree>();
+  LI = &getAnalysis<LoopInfo>();
+
+  // Loops that search memory or count bits run until they find what they are
+  // looking for, and are replaced as a whole.
+  if (L->empty() && L->getLoopPreheader() && L->hasDedicatedExits() &&
+      (recognizeSearch(LPM) || recognizeBitCount(LPM)))
+    return true;
+
+  // The trip count of the loop must be analyzable.
   if (!SE->hasLoopInvariantBackedgeTakenCount(L))
     return false;
   const SCEV *BECount = SE->getBackedgeTakenCount(L);
@@ -169,13 +227,6 @@ bool LoopIdiomRecognize::runOnLoop(Loop *L, LPPassManager &LPM) {
     if (BECst->getValue()->getValue() == 0)
       return false;
   
-  // We require target data for now.
-  TD = getAnalysisIfAvailable<TargetData>();
-  if (TD == 0) return false;
-
-  DT = &getAnalysis<DominatorTree>();
-  LoopInfo &LI = getAnalysis<LoopInfo>();
-  
   SmallVector<BasicBlock*, 8> ExitBlocks;
   CurLoop->getUniqueExitBlocks(ExitBlocks);
 
@@ -188,7 +239,7 @@ bool LoopIdiomRecognize::runOnLoop(Loop *L, LPPassManager &LPM) {
   for (Loop::block_iterator BI = L->block_begin(), E = L->block_end(); BI != E;
        ++BI) {
     // Ignore blocks in subloops.
-    if (LI.getLoopFor(*BI) != CurLoop)
+    if (LI->getLoopFor(*BI) != CurLoop)
       continue;
     
     MadeChange |= runOnLoopBlock(*BI, BECount, ExitBlocks);
@@ -269,16 +320,25 @@ bool LoopIdiomRecognize::processLoopStore(StoreInst *SI, const SCEV *BECount) {
   
   // TODO: Could also handle negative stride here someday, that will require the
   // validity check in mayLoopAccessLocation to be updated though.
-  if (Stride == 0 || StoreSize != Stride->getValue()->getValue())
+  if (Stride == 0)
     return false;
+
+  // If the stride is larger than the store, other stores in the loop may fill
+  // the rest of it, as in:
+  //   for (i) { __real__(P[i]) = 0;  __imag__(P[i]) = 0; }
+  if (StoreSize != Stride->getValue()->getValue())
+    return processLoopStoreGroup(SI, StoreEv, BECount);
   
   // If the stored value is a byte-wise value (like i32 -1), then it may be
   // turned into a memset of i8 -1, assuming that all the consequtive bytes
   // are stored.  A store of i32 0x01020304 can never be turned into a memset.
-  if (Value *SplatValue = isBytewiseValue(StoredVal))
+  if (Value *SplatValue = isBytewiseValue(StoredVal)) {
+    SmallPtrSet<Instruction*, 8> TheStores;
+    TheStores.insert(SI);
     if (processLoopStoreOfSplatValue(StorePtr, StoreSize, SI->getAlignment(),
-                                     SplatValue, SI, StoreEv, BECount))
+                                     SplatValue, TheStores, StoreEv, BECount))
       return true;
+  }
 
   // If the stored value is a strided load in the same loop with the same stride
   // this this may be transformable into a memcpy.  This kicks in for stuff like
@@ -296,6 +356,72 @@ bool LoopIdiomRecognize::processLoopStore(StoreInst *SI, const SCEV *BECount) {
   return false;
 }
 
+/// processLoopStoreGroup - See if SI is one of several stores of the same
+/// memsetable value in its block that together cover each stride of the loop.
+/// If so, promote them to a single memset.
+bool LoopIdiomRecognize::
+processLoopStoreGroup(StoreInst *SI, const SCEVAddRecExpr *StoreEv,
+                      const SCEV *BECount) {
+  Value *SplatValue = isBytewiseValue(SI->getValueOperand());
+  if (SplatValue == 0)
+    return false;
+
+  // Reject negative strides and strides that overflow an unsigned.
+  const SCEVConstant *Stride = cast<SCEVConstant>(StoreEv->getOperand(1));
+  if (Stride->getValue()->getValue().isNegative() ||
+      Stride->getValue()->getValue().getActiveBits() > 32)
+    return false;
+  uint64_t StrideSize = Stride->getValue()->getZExtValue();
+
+  // Collect the stores in this block with the same stride and value, keyed by
+  // their offset from SI.
+  typedef std::pair<int64_t, StoreInst*> OffsetStore;
+  SmallVector<OffsetStore, 8> Group;
+  BasicBlock *BB = SI->getParent();
+  for (BasicBlock::iterator I = BB->begin(), E = BB->end(); I != E; ++I) {
+    StoreInst *Other = dyn_cast<StoreInst>(I);
+    if (Other == 0 || Other->isVolatile() ||
+        isBytewiseValue(Other->getValueOperand()) != SplatValue)
+      continue;
+    const SCEVAddRecExpr *Ev =
+      dyn_cast<SCEVAddRecExpr>(SE->getSCEV(Other->getPointerOperand()));
+    if (Ev == 0 || Ev->getLoop() != CurLoop || !Ev->isAffine() ||
+        Ev->getOperand(1) != Stride)
+      continue;
+    const SCEVConstant *Offset =
+      dyn_cast<SCEVConstant>(SE->getMinusSCEV(Ev->getStart(),
+                                              StoreEv->getStart()));
+    if (Offset == 0 || Offset->getValue()->getValue().getMinSignedBits() > 32)
+      continue;
+    Group.push_back(std::make_pair(Offset->getValue()->getSExtValue(), Other));
+  }
+  std::sort(Group.begin(), Group.end());
+
+  // The stores have to cover the stride without gaps, and not extend into the
+  // next one.
+  SmallPtrSet<Instruction*, 8> TheStores;
+  int64_t Begin = Group[0].first, End = Begin;
+  for (unsigned i = 0, e = Group.size(); i != e; ++i) {
+    uint64_t SizeInBits =
+      TD->getTypeSizeInBits(Group[i].second->getValueOperand()->getType());
+    if ((SizeInBits & 7) || Group[i].first > End)
+      return false;
+    End = std::max(End, Group[i].first + int64_t(SizeInBits >> 3));
+    TheStores.insert(Group[i].second);
+  }
+  if (End - Begin != int64_t(StrideSize))
+    return false;
+
+  // The memset starts at the store with the lowest address.
+  StoreInst *First = Group[0].second;
+  const SCEVAddRecExpr *FirstEv =
+    cast<SCEVAddRecExpr>(SE->getSCEV(First->getPointerOperand()));
+  return processLoopStoreOfSplatValue(First->getPointerOperand(),
+                                      (unsigned)StrideSize,
+                                      First->getAlignment(), SplatValue,
+                                      TheStores, FirstEv, BECount);
+}
+
 /// processLoopMemSet - See if this memset can be promoted to a large memset.
 bool LoopIdiomRecognize::
 processLoopMemSet(MemSetInst *MSI, const SCEV *BECount) {
@@ -325,19 +451,22 @@ processLoopMemSet(MemSetInst *MSI, const SCEV *BECount) {
   if (Stride == 0 || MSI->getLength() != Stride->getValue())
     return false;
   
+  SmallPtrSet<Instruction*, 8> TheStores;
+  TheStores.insert(MSI);
   return processLoopStoreOfSplatValue(Pointer, (unsigned)SizeInBytes,
                                       MSI->getAlignment(), MSI->getValue(),
-                                      MSI, Ev, BECount);
+                                      TheStores, Ev, BECount);
 }
 
 
 /// mayLoopAccessLocation - Return true if the specified loop might access the
 /// specified pointer location, which is a loop-strided access.  The 'Access'
 /// argument specifies what the verboten forms of access are (read or write).
+/// The stores being promoted are ignored.
 static bool mayLoopAccessLocation(Value *Ptr,AliasAnalysis::ModRefResult Access,
                                   Loop *L, const SCEV *BECount,
                                   unsigned StoreSize, AliasAnalysis &AA,
-                                  Instruction *IgnoredStore) {
+                           const SmallPtrSet<Instruction*, 8> &IgnoredStores) {
   // Get the location that may be stored across the loop.  Since the access is
   // strided positively through memory, we say that the modified location starts
   // at the pointer and has infinite size.
@@ -357,7 +486,7 @@ static bool mayLoopAccessLocation(Value *Ptr,AliasAnalysis::ModRefResult Access,
   for (Loop::block_iterator BI = L->block_begin(), E = L->block_end(); BI != E;
        ++BI)
     for (BasicBlock::iterator I = (*BI)->begin(), E = (*BI)->end(); I != E; ++I)
-      if (&*I != IgnoredStore &&
+      if (!IgnoredStores.count(I) &&
           (AA.getModRefInfo(I, StoreLoc) & Access))
         return true;
 
@@ -369,7 +498,7 @@ static bool mayLoopAccessLocation(Value *Ptr,AliasAnalysis::ModRefResult Access,
 bool LoopIdiomRecognize::
 processLoopStoreOfSplatValue(Value *DestPtr, unsigned StoreSize, 
                              unsigned StoreAlignment, Value *SplatValue, 
-                             Instruction *TheStore,
+                             SmallPtrSet<Instruction*, 8> &TheStores,
                              const SCEVAddRecExpr *Ev, const SCEV *BECount) {
   // Verify that the stored value is loop invariant.  If not, we can't promote
   // the memset.
@@ -382,7 +511,7 @@ processLoopStoreOfSplatValue(Value *DestPtr, unsigned StoreSize,
   // or write to the aliased location.  Check for an alias.
   if (mayLoopAccessLocation(DestPtr, AliasAnalysis::ModRef,
                             CurLoop, BECount,
-                            StoreSize, getAnalysis<AliasAnalysis>(), TheStore))
+                            StoreSize, getAnalysis<AliasAnalysis>(), TheStores))
     return false;
   
   // Okay, everything looks good, insert the memset.
@@ -418,12 +547,15 @@ processLoopStoreOfSplatValue(Value *DestPtr, unsigned StoreSize,
     Builder.CreateMemSet(BasePtr, SplatValue, NumBytes, StoreAlignment);
   
   DEBUG(dbgs() << "  Formed memset: " << *NewCall << "\n"
-               << "    from store to: " << *Ev << " at: " << *TheStore << "\n");
+               << "    from " << TheStores.size() << " store(s) to: " << *Ev
+               << "\n");
   (void)NewCall;
   
-  // Okay, the memset has been formed.  Zap the original store and anything that
-  // feeds into it.
-  DeleteDeadInstruction(TheStore, *SE);
+  // Okay, the memset has been formed.  Zap the original stores and anything
+  // that feeds into them.
+  for (SmallPtrSet<Instruction*, 8>::iterator I = TheStores.begin(),
+       E = TheStores.end(); I != E; ++I)
+    DeleteDeadInstruction(*I, *SE);
   ++NumMemSet;
   return true;
 }
@@ -442,16 +574,18 @@ processLoopStoreOfLoopLoad(StoreInst *SI, unsigned StoreSize,
   // would be unsafe to do if there is anything else in the loop that may read
   // or write to the stored location (including the load feeding the stores).
   // Check for an alias.
+  SmallPtrSet<Instruction*, 8> TheStores;
+  TheStores.insert(SI);
   if (mayLoopAccessLocation(SI->getPointerOperand(), AliasAnalysis::ModRef,
                             CurLoop, BECount, StoreSize,
-                            getAnalysis<AliasAnalysis>(), SI))
+                            getAnalysis<AliasAnalysis>(), TheStores))
     return false;
 
   // For a memcpy, we have to make sure that the input array is not being
   // mutated by the loop.
   if (mayLoopAccessLocation(LI->getPointerOperand(), AliasAnalysis::Mod,
                             CurLoop, BECount, StoreSize,
-                            getAnalysis<AliasAnalysis>(), SI))
+                            getAnalysis<AliasAnalysis>(), TheStores))
     return false;
   
   // Okay, everything looks good, insert the memcpy.
@@ -502,3 +636,405 @@ processLoopStoreOfLoopLoad(StoreInst *SI, unsigned StoreSize,
   ++NumMemCpy;
   return true;
 }
+
+/// getByteLoad - If V is a byte that loop L loads from consecutive addresses
+/// in each iteration, return the address recurrence.
+static const SCEVAddRecExpr *getByteLoad(Value *V, Loop *L,
+                                         ScalarEvolution *SE) {
+  LoadInst *LI = dyn_cast<LoadInst>(V);
+  if (LI == 0 || LI->isVolatile() || !LI->getType()->isIntegerTy(8) ||
+      LI->getPointerAddressSpace() != 0 || !L->contains(LI->getParent()))
+    return 0;
+  const SCEVAddRecExpr *Ev =
+    dyn_cast<SCEVAddRecExpr>(SE->getSCEV(LI->getPointerOperand()));
+  if (Ev == 0 || Ev->getLoop() != L || !Ev->isAffine() ||
+      !Ev->getOperand(1)->isOne())
+    return 0;
+  return Ev;
+}
+
+/// isDereferenceableRange - Return true if the Size bytes starting at S can be
+/// read without trapping because they lie within an alloca or a global
+/// variable of known size.
+static bool isDereferenceableRange(const SCEV *S, uint64_t Size,
+                                   const TargetData *TD) {
+  int64_t Offset = 0;
+  if (const SCEVAddExpr *Add = dyn_cast<SCEVAddExpr>(S)) {
+    const SCEVConstant *C = dyn_cast<SCEVConstant>(Add->getOperand(0));
+    if (Add->getNumOperands() != 2 || C == 0)
+      return false;
+    Offset = C->getValue()->getSExtValue();
+    S = Add->getOperand(1);
+  }
+  const SCEVUnknown *U = dyn_cast<SCEVUnknown>(S);
+  if (U == 0)
+    return false;
+
+  int64_t BaseOffset = 0;
+  Value *Base =
+    GetPointerBaseWithConstantOffset(U->getValue(), BaseOffset, *TD);
+  Offset += BaseOffset;
+
+  uint64_t ObjSize;
+  if (AllocaInst *AI = dyn_cast<AllocaInst>(Base)) {
+    if (AI->isArrayAllocation())
+      return false;
+    ObjSize = TD->getTypeAllocSize(AI->getAllocatedType());
+  } else if (GlobalVariable *GV = dyn_cast<GlobalVariable>(Base)) {
+    if (GV->mayBeOverridden())
+      return false;
+    ObjSize = TD->getTypeAllocSize(GV->getType()->getElementType());
+  } else {
+    return false;
+  }
+  return Offset >= 0 && (uint64_t)Offset <= ObjSize &&
+         Size <= ObjSize - Offset;
+}
+
+/// recognizeSearch - See if the current loop searches memory for a byte or
+/// compares two blocks of memory byte by byte, and replace it by a call to
+/// strlen, memchr or memcmp.
+bool LoopIdiomRecognize::recognizeSearch(LPPassManager &LPM) {
+  if (TLI ? !TLI->hasFastStringLibCalls() : !FastStringLibCalls)
+    return false;
+
+  // Don't turn the library functions into calls to themselves.
+  StringRef Name = CurLoop->getHeader()->getParent()->getName();
+  if (Name == "strlen" || Name == "memchr" || Name == "memcmp")
+    return false;
+
+  BasicBlock *Latch = CurLoop->getLoopLatch();
+  if (Latch == 0)
+    return false;
+  for (Loop::block_iterator BI = CurLoop->block_begin(),
+       E = CurLoop->block_end(); BI != E; ++BI)
+    for (BasicBlock::iterator I = (*BI)->begin(), E = (*BI)->end(); I != E; ++I)
+      if (I->mayHaveSideEffects() ||
+          (isa<LoadInst>(I) && cast<LoadInst>(I)->isVolatile()))
+        return false;
+
+  // One exit has to test a byte loaded in the current iteration, against an
+  // invariant value for strlen and memchr, or against a byte loaded from
+  // another block of memory for memcmp.  The other exit, if any, bounds the
+  // number of iterations.  Both have to be tested in each iteration.
+  SmallVector<BasicBlock*, 4> ExitingBlocks;
+  CurLoop->getExitingBlocks(ExitingBlocks);
+  if (ExitingBlocks.size() > 2)
+    return false;
+
+  BasicBlock *SearchBB = 0, *BoundBB = 0;
+  const SCEVAddRecExpr *Ev = 0, *OtherEv = 0;
+  Value *Char = 0;
+  for (unsigned i = 0, e = ExitingBlocks.size(); i != e; ++i) {
+    BasicBlock *BB = ExitingBlocks[i];
+    BranchInst *BI = dyn_cast<BranchInst>(BB->getTerminator());
+    if (BI == 0 || !DT->dominates(BB, Latch))
+      return false;
+
+    ICmpInst *Cmp = dyn_cast<ICmpInst>(BI->getCondition());
+    if (SearchBB == 0 && Cmp && Cmp->isEquality()) {
+      bool ExitOnTrue = !CurLoop->contains(BI->getSuccessor(0));
+      bool ExitOnEqual = ExitOnTrue == (Cmp->getPredicate()==ICmpInst::ICMP_EQ);
+      const SCEVAddRecExpr *LHS = getByteLoad(Cmp->getOperand(0), CurLoop, SE);
+      const SCEVAddRecExpr *RHS = getByteLoad(Cmp->getOperand(1), CurLoop, SE);
+      if (LHS && RHS && !ExitOnEqual) {
+        SearchBB = BB;
+        Ev = LHS;
+        OtherEv = RHS;
+        continue;
+      }
+      Value *Other = Cmp->getOperand(LHS ? 1 : 0);
+      if ((LHS || RHS) && ExitOnEqual && CurLoop->isLoopInvariant(Other)) {
+        SearchBB = BB;
+        Ev = LHS ? LHS : RHS;
+        Char = Other;
+        continue;
+      }
+    }
+    BoundBB = BB;
+  }
+  if (SearchBB == 0)
+    return false;
+
+  // The values live out of the loop have to be computable from the iteration
+  // it exits in.  memcmp doesn't tell where the blocks differ.
+  bool IsMemCmp = OtherEv != 0;
+  if (!isExitValueComputable(SearchBB, !IsMemCmp, 0))
+    return false;
+
+  BasicBlock *Preheader = CurLoop->getLoopPreheader();
+  Instruction *InsertPt = Preheader->getTerminator();
+  IRBuilder<> Builder(InsertPt);
+  SCEVExpander Expander(*SE);
+  const Type *IntPtr = TD->getIntPtrType(Preheader->getContext());
+
+  // Without a bound, only strlen stops by itself.  A memcmp has no Char.
+  if (BoundBB == 0) {
+    Constant *C = dyn_cast_or_null<Constant>(Char);
+    if (C == 0 || !C->isNullValue())
+      return false;
+    Value *Base =
+      Expander.expandCodeFor(Ev->getStart(), Builder.getInt8PtrTy(), InsertPt);
+    Value *Len = EmitStrLen(Base, Builder, TD);
+    DEBUG(dbgs() << "  Formed strlen: " << *Len << "\n");
+    replaceLoop(0, SearchBB, Len, 0, 0, 0, LPM);
+    ++NumStrLen;
+    return true;
+  }
+
+  const SCEV *Count = SE->getExitCount(CurLoop, BoundBB);
+  if (isa<SCEVCouldNotCompute>(Count) ||
+      !SE->isLoopInvariant(Count, CurLoop) ||
+      !isExitValueComputable(BoundBB, true, 0))
+    return false;
+
+  // The loop exits via the bound in iteration Count.  Whether it looks at the
+  // byte of that iteration depends on which test comes first.
+  const SCEV *LenS = SE->getTruncateOrZeroExtend(Count, IntPtr);
+  if (DT->dominates(SearchBB, BoundBB))
+    LenS = SE->getAddExpr(LenS, SE->getConstant(IntPtr, 1));
+
+  // Unlike the loop, memcmp may read past the first difference.
+  if (IsMemCmp) {
+    const SCEVConstant *C = dyn_cast<SCEVConstant>(LenS);
+    if (C == 0)
+      return false;
+    uint64_t Size = C->getValue()->getZExtValue();
+    if (!isDereferenceableRange(Ev->getStart(), Size, TD) ||
+        !isDereferenceableRange(OtherEv->getStart(), Size, TD))
+      return false;
+  }
+  Value *Len = Expander.expandCodeFor(LenS, IntPtr, InsertPt);
+  Value *BoundIteration =
+    Expander.expandCodeFor(Count, Count->getType(), InsertPt);
+  Value *Base =
+    Expander.expandCodeFor(Ev->getStart(), Builder.getInt8PtrTy(), InsertPt);
+
+  Value *Found, *FoundIteration = 0;
+  if (IsMemCmp) {
+    Value *OtherBase = Expander.expandCodeFor(OtherEv->getStart(),
+                                              Builder.getInt8PtrTy(), InsertPt);
+    Value *Diff = EmitMemCmp(Base, OtherBase, Len, Builder, TD);
+    DEBUG(dbgs() << "  Formed memcmp: " << *Diff << "\n");
+    Found = Builder.CreateICmpNE(Diff, Constant::getNullValue(Diff->getType()),
+                                 "memcmp.ne");
+    ++NumMemCmp;
+  } else {
+    Value *C32 = Builder.CreateZExt(Char, Builder.getInt32Ty());
+    Value *Ptr = EmitMemChr(Base, C32, Len, Builder, TD);
+    DEBUG(dbgs() << "  Formed memchr: " << *Ptr << "\n");
+    Found = Builder.CreateIsNotNull(Ptr, "memchr.found");
+    FoundIteration = Builder.CreateSub(Builder.CreatePtrToInt(Ptr, IntPtr),
+                                       Builder.CreatePtrToInt(Base, IntPtr),
+                                       "memchr.index");
+    ++NumMemChr;
+  }
+  replaceLoop(Found, SearchBB, FoundIteration, BoundBB, BoundIteration, 0, LPM);
+  return true;
+}
+
+/// recognizeBitCount - See if the current loop counts the set bits of a
+/// value, or its significant bits, and replace it by ctpop or ctlz:
+///   do { x &= x - 1; ++n; } while (x);
+///   do { x >>= 1; ++n; } while (x);
+bool LoopIdiomRecognize::recognizeBitCount(LPPassManager &LPM) {
+  BasicBlock *BB = CurLoop->getHeader();
+  if (CurLoop->getBlocks().size() != 1)
+    return false;
+
+  // The loop has to exit when the value becomes zero.
+  BranchInst *BI = dyn_cast<BranchInst>(BB->getTerminator());
+  if (BI == 0 || !BI->isConditional())
+    return false;
+  ICmpInst *Cmp = dyn_cast<ICmpInst>(BI->getCondition());
+  ConstantInt *Zero = Cmp ? dyn_cast<ConstantInt>(Cmp->getOperand(1)) : 0;
+  if (Zero == 0 || !Zero->isZero() || !Cmp->isEquality() ||
+      CurLoop->contains(BI->getSuccessor(0)) !=
+        (Cmp->getPredicate() == ICmpInst::ICMP_NE))
+    return false;
+
+  BinaryOperator *Next = dyn_cast<BinaryOperator>(Cmp->getOperand(0));
+  if (Next == 0 || Next->getParent() != BB)
+    return false;
+  PHINode *PN = 0;
+  Intrinsic::ID IID;
+  if (Next->getOpcode() == Instruction::LShr) {
+    ConstantInt *One = dyn_cast<ConstantInt>(Next->getOperand(1));
+    if (One == 0 || !One->isOne())
+      return false;
+    PN = dyn_cast<PHINode>(Next->getOperand(0));
+    IID = Intrinsic::ctlz;
+  } else if (Next->getOpcode() == Instruction::And) {
+    for (unsigned i = 0; i != 2 && PN == 0; ++i) {
+      BinaryOperator *Dec = dyn_cast<BinaryOperator>(Next->getOperand(1 - i));
+      if (Dec == 0 || Dec->getOpcode() != Instruction::Add ||
+          Dec->getOperand(0) != Next->getOperand(i))
+        continue;
+      ConstantInt *MinusOne = dyn_cast<ConstantInt>(Dec->getOperand(1));
+      if (MinusOne && MinusOne->isAllOnesValue())
+        PN = dyn_cast<PHINode>(Next->getOperand(i));
+    }
+    IID = Intrinsic::ctpop;
+  } else {
+    return false;
+  }
+  if (PN == 0 || PN->getParent() != BB ||
+      PN->getIncomingValueForBlock(BB) != Next)
+    return false;
+
+  const Type *Ty = PN->getType();
+  if (TLI ? !TLI->isOperationLegalOrCustom(IID == Intrinsic::ctpop ?
+                                           ISD::CTPOP : ISD::CTLZ,
+                                           TLI->getValueType(Ty)) :
+            !FastBitCount)
+    return false;
+
+  for (BasicBlock::iterator I = BB->begin(), E = BB->end(); I != E; ++I)
+    if (I->mayHaveSideEffects())
+      return false;
+  if (!isExitValueComputable(BB, true, Next))
+    return false;
+
+  // The loop runs once for each bit, but also once if there are none.
+  BasicBlock *Preheader = CurLoop->getLoopPreheader();
+  IRBuilder<> Builder(Preheader->getTerminator());
+  Value *X = PN->getIncomingValueForBlock(Preheader);
+  Function *F = Intrinsic::getDeclaration(Preheader->getParent()->getParent(),
+                                          IID, &Ty, 1);
+  Value *Count = Builder.CreateCall(F, X);
+  if (IID == Intrinsic::ctlz)
+    Count = Builder.CreateSub(ConstantInt::get(Ty,Ty->getPrimitiveSizeInBits()),
+                              Count);
+  Value *Iteration =
+    Builder.CreateSub(Count, Builder.CreateZExt(Builder.CreateIsNotNull(X), Ty),
+                      "bitcount.iter");
+  DEBUG(dbgs() << "  Formed bit count: " << *Count << "\n");
+  replaceLoop(0, BB, Iteration, 0, 0, Next, LPM);
+  ++NumBitCount;
+  return true;
+}
+
+/// isExitValueComputable - Return true if the values that the current loop
+/// passes from ExitingBB to its exit block can be computed without running
+/// the loop.  These are loop invariant values, Zero, and affine recurrences
+/// of the loop if the iteration in which the loop exits is known.
+bool LoopIdiomRecognize::isExitValueComputable(BasicBlock *ExitingBB,
+                                               bool KnownIteration,
+                                               Value *Zero) {
+  TerminatorInst *TI = ExitingBB->getTerminator();
+  for (unsigned i = 0, e = TI->getNumSuccessors(); i != e; ++i) {
+    BasicBlock *Exit = TI->getSuccessor(i);
+    if (CurLoop->contains(Exit))
+      continue;
+    for (BasicBlock::iterator I = Exit->begin(); isa<PHINode>(I); ++I) {
+      Value *V = cast<PHINode>(I)->getIncomingValueForBlock(ExitingBB);
+      Instruction *Inst = dyn_cast<Instruction>(V);
+      if (Inst == 0 || !CurLoop->contains(Inst->getParent()) || V == Zero)
+        continue;
+      if (!KnownIteration || !SE->isSCEVable(V->getType()))
+        return false;
+      const SCEVAddRecExpr *AR = dyn_cast<SCEVAddRecExpr>(SE->getSCEV(V));
+      if (AR == 0 || AR->getLoop() != CurLoop || !AR->isAffine())
+        return false;
+    }
+  }
+  return true;
+}
+
+/// getExitValue - Return the value that V, which isExitValueComputable
+/// accepted, has in the given iteration of the current loop, expanding code
+/// for it in the preheader.
+Value *LoopIdiomRecognize::getExitValue(Value *V, Value *Iteration,
+                                        Value *Zero, SCEVExpander &Expander) {
+  Instruction *Inst = dyn_cast<Instruction>(V);
+  if (Inst == 0 || !CurLoop->contains(Inst->getParent()))
+    return V;
+  if (V == Zero)
+    return Constant::getNullValue(V->getType());
+
+  const SCEVAddRecExpr *AR = cast<SCEVAddRecExpr>(SE->getSCEV(V));
+  const Type *Ty = SE->getEffectiveSCEVType(AR->getType());
+  const SCEV *It = SE->getTruncateOrZeroExtend(SE->getSCEV(Iteration), Ty);
+  return Expander.expandCodeFor(AR->evaluateAtIteration(It, *SE), V->getType(),
+                        CurLoop->getLoopPreheader()->getTerminator());
+}
+
+/// replaceLoop - Replace the current loop, which has no side effects, by a
+/// branch from the preheader to the exit of TrueExiting if Cond is true or
+/// null, and to the exit of FalseExiting otherwise.  The exit blocks receive
+/// the values the loop would have passed them in the given iterations.
+void LoopIdiomRecognize::replaceLoop(Value *Cond, BasicBlock *TrueExiting,
+                                     Value *TrueIteration,
+                                     BasicBlock *FalseExiting,
+                                     Value *FalseIteration, Value *Zero,
+                                     LPPassManager &LPM) {
+  BasicBlock *Preheader = CurLoop->getLoopPreheader();
+  BasicBlock *Exiting[2] = { TrueExiting, FalseExiting };
+  Value *Iteration[2] = { TrueIteration, FalseIteration };
+  BasicBlock *Exits[2] = { 0, 0 };
+  unsigned NumExits = Cond ? 2 : 1;
+
+  // Compute the new values of the exit block PHIs.  If both exits lead to the
+  // same block, select between their values.
+  SCEVExpander Expander(*SE);
+  IRBuilder<> Builder(Preheader->getTerminator());
+  DenseMap<PHINode*, Value*> ExitValues;
+  for (unsigned i = 0; i != NumExits; ++i) {
+    TerminatorInst *TI = Exiting[i]->getTerminator();
+    Exits[i] = TI->getSuccessor(CurLoop->contains(TI->getSuccessor(0)));
+    for (BasicBlock::iterator I = Exits[i]->begin(); isa<PHINode>(I); ++I) {
+      PHINode *PN = cast<PHINode>(I);
+      Value *V = getExitValue(PN->getIncomingValueForBlock(Exiting[i]),
+                              Iteration[i], Zero, Expander);
+      Value *&Entry = ExitValues[PN];
+      Entry = Entry ? Builder.CreateSelect(Cond, Entry, V) : V;
+    }
+  }
+
+  // Tell ScalarEvolution that the loop is deleted before deleting it.
+  SE->forgetLoop(CurLoop);
+
+  // Branch from the preheader directly to the exit blocks.
+  TerminatorInst *OldTI = Preheader->getTerminator();
+  if (NumExits == 2 && Exits[0] != Exits[1])
+    BranchInst::Create(Exits[0], Exits[1], Cond, OldTI);
+  else
+    BranchInst::Create(Exits[0], OldTI);
+  OldTI->eraseFromParent();
+
+  for (unsigned i = 0; i != NumExits; ++i) {
+    if (i == 1 && Exits[1] == Exits[0])
+      break;
+    for (BasicBlock::iterator I = Exits[i]->begin(); isa<PHINode>(I); ++I) {
+      PHINode *PN = cast<PHINode>(I);
+      for (unsigned j = PN->getNumIncomingValues(); j != 0; --j)
+        if (CurLoop->contains(PN->getIncomingBlock(j - 1)))
+          PN->removeIncomingValue(j - 1, false);
+      PN->addIncoming(ExitValues[PN], Preheader);
+    }
+  }
+
+  // Update the dominator tree and delete the blocks of the loop, as
+  // LoopDeletion does.
+  SmallVector<DomTreeNode*, 8> ChildNodes;
+  for (Loop::block_iterator BI = CurLoop->block_begin(),
+       E = CurLoop->block_end(); BI != E; ++BI) {
+    DomTreeNode *Node = DT->getNode(*BI);
+    ChildNodes.append(Node->begin(), Node->end());
+    for (unsigned i = 0, e = ChildNodes.size(); i != e; ++i)
+      DT->changeImmediateDominator(ChildNodes[i], DT->getNode(Preheader));
+    ChildNodes.clear();
+    DT->eraseNode(*BI);
+    (*BI)->dropAllReferences();
+  }
+  for (Loop::block_iterator BI = CurLoop->block_begin(),
+       E = CurLoop->block_end(); BI != E; ++BI)
+    (*BI)->eraseFromParent();
+
+  SmallPtrSet<BasicBlock*, 8> Blocks;
+  Blocks.insert(CurLoop->block_begin(), CurLoop->block_end());
+  for (SmallPtrSet<BasicBlock*, 8>::iterator I = Blocks.begin(),
+       E = Blocks.end(); I != E; ++I)
+    LI->removeBlock(*I);
+  LPM.deleteLoopFromQueue(CurLoop);
+}
@@ -0,0 +1,592 @@
+//===- LoopInterchange.cpp - Interchange and tile loop nests --------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This pass improves the cache locality of perfectly nested pairs of loops.  If
+// the inner loop walks memory with a larger stride than the outer loop, the two
+// loops are interchanged:
+//
+//   for (i = 0; i < N; ++i)              for (j = 0; j < M; ++j)
+//     for (j = 0; j < M; ++j)     ==>      for (i = 0; i < N; ++i)
+//       A[j][i] += B[j][i];                  A[j][i] += B[j][i];
+//
+// If some access still has a stride of a cache line or more in the inner loop
+// while the outer loop moves it by less than a line, as in a transpose, the
+// lines fetched by one run of the inner loop are reused by the next run only
+// if they are still in the cache.  The inner loop is then strip-mined into
+// tiles whose data fits in the first level data cache, and the loop over the
+// tiles is moved outside:
+//
+//   for (jj = 0; jj < M; jj += T)
+//     for (i = 0; i < N; ++i)
+//       for (j = jj; j < min(jj + T, M); ++j)
+//         A[i][j] = B[j][i];
+//
+// Both transformations reorder the iterations of the two loops, which is only
+// legal if no dependence has distances of opposite signs in them.  This is
+// checked with the distance vectors of LoopDependenceAnalysis.
+//
+// The nest has to be in the form LoopRotate and IndVarSimplify produce: both
+// loops are bottom-tested with a single induction variable, the trip count of
+// the inner loop doesn't depend on the outer loop, and the outer loop does
+// nothing but compute values for the inner loop and step its induction
+// variable.
+//
+// The cache parameters come from the target if it is known, and from the
+// command line otherwise.
+//
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "loop-interchange"
+#include "llvm/Transforms/Scalar.h"
+#include "llvm/Constants.h"
+#include "llvm/Instructions.h"
+#include "llvm/Analysis/Dominators.h"
+#include "llvm/Analysis/LoopDependenceAnalysis.h"
+#include "llvm/Analysis/LoopPass.h"
+#include "llvm/Analysis/ScalarEvolutionExpander.h"
+#include "llvm/Analysis/ScalarEvolutionExpressions.h"
+#include "llvm/Target/TargetLowering.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/IRBuilder.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Statistic.h"
+using namespace llvm;
+
+STATISTIC(NumInterchanged, "Number of loop nests interchanged");
+STATISTIC(NumTiled,        "Number of loop nests tiled");
+
+static cl::opt<unsigned>
+CacheLineSize("loop-interchange-cache-line-size", cl::init(64), cl::Hidden,
+  cl::desc("Cache line size in bytes to assume when no target information "
+           "is available"));
+
+static cl::opt<unsigned>
+DataCacheSize("loop-interchange-cache-size", cl::init(32 * 1024), cl::Hidden,
+  cl::desc("Data cache size in bytes to assume when no target information "
+           "is available"));
+
+static cl::opt<bool>
+DisableTiling("disable-loop-tiling", cl::init(false), cl::Hidden,
+  cl::desc("Only interchange loop nests, don't tile them"));
+
+namespace {
+  /// IndVar - The induction variable of a loop of the nest: Phi starts at a
+  /// value invariant in the nest and is incremented by Step in Next, and the
+  /// loop continues while Cond has the value of the latch branch successor
+  /// that leads back to the header.
+  struct IndVar {
+    PHINode *Phi;
+    BinaryOperator *Next;
+    ICmpInst *Cond;
+    BranchInst *Br;
+    int64_t Step;
+  };
+
+  class LoopInterchange : public LoopPass {
+    /// TLI - Keep a pointer of a TargetLowering to consult for the cache
+    /// parameters.  This is null when no target information is available.
+    const TargetLowering *TLI;
+
+    LoopInfo *LI;
+    DominatorTree *DT;
+    ScalarEvolution *SE;
+    LoopDependenceAnalysis *LDA;
+
+    unsigned LineSize;
+    unsigned CacheSize;
+
+    // The loop nest being transformed.
+    Loop *Outer, *Inner;
+    BasicBlock *Preheader, *OuterHeader, *OuterLatch, *InnerHeader,
+               *InnerLatch, *Exit;
+    IndVar OuterIV, InnerIV;
+    SmallVector<Instruction*, 16> Accesses;
+
+  public:
+    static char ID; // Pass identification, replacement for typeid
+    explicit LoopInterchange(const TargetLowering *tli = 0)
+      : LoopPass(ID), TLI(tli) {
+      initializeLoopInterchangePass(*PassRegistry::getPassRegistry());
+    }
+
+    bool runOnLoop(Loop *L, LPPassManager &LPM);
+
+    virtual void getAnalysisUsage(AnalysisUsage &AU) const {
+      AU.addRequired<LoopInfo>();
+      AU.addPreserved<LoopInfo>();
+      AU.addRequiredID(LoopSimplifyID);
+      AU.addPreservedID(LoopSimplifyID);
+      AU.addRequiredID(LCSSAID);
+      AU.addPreservedID(LCSSAID);
+      AU.addRequired<ScalarEvolution>();
+      AU.addPreserved<ScalarEvolution>();
+      AU.addRequired<LoopDependenceAnalysis>();
+      AU.addRequired<DominatorTree>();
+      AU.addPreserved<DominatorTree>();
+    }
+
+  private:
+    bool analyzeNest(Loop *L);
+    bool analyzeIndVar(Loop *L, BasicBlock *Header, BasicBlock *Latch,
+                       IndVar &IV);
+    bool isLegal();
+    unsigned getCost(const Loop *L);
+    unsigned getTileSize();
+
+    void interchange();
+    void tile(unsigned TileSize, LPPassManager &LPM);
+  };
+}
+
+char LoopInterchange::ID = 0;
+INITIALIZE_PASS_BEGIN(LoopInterchange, "loop-interchange",
+                      "Interchange and tile loop nests", false, false)
+INITIALIZE_PASS_DEPENDENCY(LoopInfo)
+INITIALIZE_PASS_DEPENDENCY(DominatorTree)
+INITIALIZE_PASS_DEPENDENCY(LoopSimplify)
+INITIALIZE_PASS_DEPENDENCY(LCSSA)
+INITIALIZE_PASS_DEPENDENCY(ScalarEvolution)
+INITIALIZE_PASS_DEPENDENCY(LoopDependenceAnalysis)
+INITIALIZE_PASS_END(LoopInterchange, "loop-interchange",
+                    "Interchange and tile loop nests", false, false)
+
+Pass *llvm::createLoopInterchangePass(const TargetLowering *TLI) {
+  return new LoopInterchange(TLI);
+}
+
+bool LoopInterchange::runOnLoop(Loop *L, LPPassManager &LPM) {
+  LineSize = CacheLineSize;
+  CacheSize = DataCacheSize;
+  if (TLI) {
+    LineSize = TLI->getCacheLineSize();
+    CacheSize = TLI->getDataCacheSize();
+  }
+  if (!LineSize)
+    return false;
+
+  LI = &getAnalysis<LoopInfo>();
+  DT = &getAnalysis<DominatorTree>();
+  SE = &getAnalysis<ScalarEvolution>();
+  LDA = &getAnalysis<LoopDependenceAnalysis>();
+
+  if (!analyzeNest(L) || !isLegal())
+    return false;
+
+  bool Changed = false;
+  if (getCost(Outer) < getCost(Inner)) {
+    DEBUG(dbgs() << "LoopInterchange: interchanging " << Outer->getHeader()->getName()
+                 << " and " << Inner->getHeader()->getName() << '\n');
+    interchange();
+    ++NumInterchanged;
+    Changed = true;
+    SE->forgetLoop(L);
+    if (!analyzeNest(L))
+      return true;
+  }
+
+  if (unsigned TileSize = getTileSize()) {
+    DEBUG(dbgs() << "LoopInterchange: tiling " << Inner->getHeader()->getName()
+                 << " by " << TileSize << '\n');
+    tile(TileSize, LPM);
+    ++NumTiled;
+    Changed = true;
+  }
+  return Changed;
+}
+
+//===----------------------------------------------------------------------===//
+// Analysis
+//===----------------------------------------------------------------------===//
+
+/// analyzeIndVar - Find the induction variable of L, which is the only PHI in
+/// Header, and the exit test in Latch.
+bool LoopInterchange::analyzeIndVar(Loop *L, BasicBlock *Header,
+                                    BasicBlock *Latch, IndVar &IV) {
+  IV.Phi = dyn_cast<PHINode>(Header->begin());
+  if (!IV.Phi || isa<PHINode>(++BasicBlock::iterator(IV.Phi)) ||
+      !IV.Phi->getType()->isIntegerTy())
+    return false;
+
+  // The start value has to be the same in each run of the loop.
+  Value *Start = IV.Phi->getIncomingValueForBlock(L->getLoopPreheader());
+  if (!Outer->isLoopInvariant(Start))
+    return false;
+
+  IV.Next = dyn_cast<BinaryOperator>(IV.Phi->getIncomingValueForBlock(Latch));
+  if (!IV.Next || IV.Next->getOpcode() != Instruction::Add ||
+      IV.Next->getOperand(0) != IV.Phi || !L->contains(IV.Next))
+    return false;
+  ConstantInt *Step = dyn_cast<ConstantInt>(IV.Next->getOperand(1));
+  if (!Step || Step->isZero() || Step->getValue().getMinSignedBits() > 32)
+    return false;
+  IV.Step = Step->getSExtValue();
+
+  // The loop has to exit when the induction variable reaches a bound that is
+  // invariant in the nest.
+  IV.Br = dyn_cast<BranchInst>(Latch->getTerminator());
+  if (!IV.Br || !IV.Br->isConditional())
+    return false;
+  IV.Cond = dyn_cast<ICmpInst>(IV.Br->getCondition());
+  if (!IV.Cond || !IV.Cond->hasOneUse() || IV.Cond->getParent() != Latch)
+    return false;
+  Value *LHS = IV.Cond->getOperand(0), *RHS = IV.Cond->getOperand(1);
+  if (LHS != IV.Phi && LHS != IV.Next)
+    std::swap(LHS, RHS);
+  if ((LHS != IV.Phi && LHS != IV.Next) || !Outer->isLoopInvariant(RHS))
+    return false;
+
+  // Other users of the increment are given their own copy, so it may only be
+  // used in the loop.
+  for (Value::use_iterator UI = IV.Next->use_begin(), UE = IV.Next->use_end();
+       UI != UE; ++UI)
+    if (!L->contains(cast<Instruction>(*UI)->getParent()))
+      return false;
+  return true;
+}
+
+/// analyzeNest - Check that L is the outer loop of a nest we can transform,
+/// and collect its memory accesses.
+bool LoopInterchange::analyzeNest(Loop *L) {
+  Accesses.clear();
+  if (L->getSubLoops().size() != 1)
+    return false;
+  Outer = L;
+  Inner = L->getSubLoops()[0];
+  if (!Inner->empty())
+    return false;
+
+  Preheader = Outer->getLoopPreheader();
+  OuterHeader = Outer->getHeader();
+  OuterLatch = Outer->getLoopLatch();
+  Exit = Outer->getExitBlock();
+  InnerHeader = Inner->getHeader();
+  InnerLatch = Inner->getLoopLatch();
+  if (!Preheader || !OuterLatch || !Exit || !InnerLatch ||
+      Outer->getExitingBlock() != OuterLatch ||
+      Inner->getExitingBlock() != InnerLatch ||
+      Inner->getLoopPreheader() != OuterHeader ||
+      Inner->getExitBlock() != OuterLatch ||
+      OuterLatch->getSinglePredecessor() != InnerLatch ||
+      Outer->getBlocks().size() != Inner->getBlocks().size() + 2)
+    return false;
+
+  if (!analyzeIndVar(Outer, OuterHeader, OuterLatch, OuterIV) ||
+      !analyzeIndVar(Inner, InnerHeader, InnerLatch, InnerIV))
+    return false;
+
+  // The outer latch only steps the outer induction variable, and the outer
+  // header only computes values for the inner loop, which can be recomputed
+  // in each of its iterations.
+  if (OuterLatch->size() != 3 || OuterIV.Next->getParent() != OuterLatch)
+    return false;
+  for (BasicBlock::iterator I = OuterHeader->begin(),
+       E = OuterHeader->getTerminator(); I != E; ++I)
+    if (&*I != OuterIV.Phi &&
+        (I->mayHaveSideEffects() || I->mayReadFromMemory()))
+      return false;
+
+  // Values computed in the nest must not be used after it, and the inner
+  // loop may only access memory with loads and stores.
+  for (Loop::block_iterator BI = Outer->block_begin(), BE = Outer->block_end();
+       BI != BE; ++BI)
+    for (BasicBlock::iterator I = (*BI)->begin(), E = (*BI)->end();
+         I != E; ++I) {
+      for (Value::use_iterator UI = I->use_begin(), UE = I->use_end();
+           UI != UE; ++UI)
+        if (!Outer->contains(cast<Instruction>(*UI)->getParent()))
+          return false;
+      if (!I->mayReadFromMemory() && !I->mayWriteToMemory())
+        continue;
+      if (LoadInst *LD = dyn_cast<LoadInst>(I)) {
+        if (LD->isVolatile())
+          return false;
+      } else if (StoreInst *ST = dyn_cast<StoreInst>(I)) {
+        if (ST->isVolatile())
+          return false;
+      } else {
+        return false;
+      }
+      Accesses.push_back(I);
+    }
+  return true;
+}
+
+/// isLegal - Return true if no dependence between the accesses of the nest is
+/// carried by the outer loop in one direction and by the inner loop in the
+/// other, so that the iterations of the two loops can be reordered freely.
+bool LoopInterchange::isLegal() {
+  SmallVector<LoopDependenceAnalysis::Distance, 4> Dist;
+  for (unsigned i = 0, e = Accesses.size(); i != e; ++i)
+    for (unsigned j = i; j != e; ++j) {
+      Instruction *A = Accesses[i], *B = Accesses[j];
+      if (!LDA->isDependencePair(A, B) || !LDA->getDistanceVector(A, B, Dist))
+        continue;
+
+      // A dependence carried by a loop enclosing the nest is not affected.
+      unsigned k = 0;
+      while (Dist[k].L != Outer && Dist[k].Known && Dist[k].Value == 0)
+        ++k;
+      if (Dist[k].L != Outer && Dist[k].Known)
+        continue;
+      while (Dist[k].L != Outer)
+        ++k;
+
+      const LoopDependenceAnalysis::Distance &O = Dist[k], &I = Dist[k + 1];
+      if ((O.Known && O.Value == 0) || (I.Known && I.Value == 0))
+        continue;
+      if (O.Known && I.Known && (O.Value < 0) == (I.Value < 0))
+        continue;
+      DEBUG(dbgs() << "LoopInterchange: dependence prevents reordering: "
+                   << *A << " and " << *B << '\n');
+      return false;
+    }
+  return true;
+}
+
+/// getStride - Return in Stride by how many bytes the address Ptr moves in each
+/// iteration of L.  Return false if this is not a constant.
+static bool getStride(ScalarEvolution *SE, Value *Ptr, const Loop *L,
+                      int64_t &Stride) {
+  const SCEV *S = SE->getSCEV(Ptr);
+  while (const SCEVAddRecExpr *AR = dyn_cast<SCEVAddRecExpr>(S)) {
+    if (AR->getLoop() == L) {
+      const SCEVConstant *Step =
+        dyn_cast<SCEVConstant>(AR->getStepRecurrence(*SE));
+      if (!AR->isAffine() || !Step ||
+          Step->getValue()->getValue().getMinSignedBits() > 32)
+        return false;
+      Stride = Step->getValue()->getSExtValue();
+      return true;
+    }
+    S = AR->getStart();
+  }
+  Stride = 0;
+  return SE->isLoopInvariant(S, L);
+}
+
+static Value *getPointerOperand(Instruction *I) {
+  if (LoadInst *LD = dyn_cast<LoadInst>(I))
+    return LD->getPointerOperand();
+  return cast<StoreInst>(I)->getPointerOperand();
+}
+
+/// getCost - Estimate how many bytes of cache lines the accesses of the nest
+/// bring in per iteration if L is the inner loop.
+unsigned LoopInterchange::getCost(const Loop *L) {
+  unsigned Cost = 0;
+  for (unsigned i = 0, e = Accesses.size(); i != e; ++i) {
+    int64_t Stride;
+    if (!getStride(SE, getPointerOperand(Accesses[i]), L, Stride))
+      Cost += LineSize;
+    else
+      Cost += std::min<uint64_t>(Stride < 0 ? -Stride : Stride, LineSize);
+  }
+  return Cost;
+}
+
+/// getTileSize - Return the number of iterations of the inner loop per tile,
+/// or zero if the nest should not be tiled.
+unsigned LoopInterchange::getTileSize() {
+  if (DisableTiling || !CacheSize)
+    return 0;
+
+  // Tiling pays off for accesses that touch a new line in each iteration of
+  // the inner loop, but stay within a line in the outer loop.
+  bool Reuse = false;
+  for (unsigned i = 0, e = Accesses.size(); i != e && !Reuse; ++i) {
+    Value *Ptr = getPointerOperand(Accesses[i]);
+    int64_t InnerStride, OuterStride;
+    if (getStride(SE, Ptr, Outer, OuterStride) &&
+        (OuterStride < 0 ? -OuterStride : OuterStride) < LineSize &&
+        (!getStride(SE, Ptr, Inner, InnerStride) ||
+         (InnerStride < 0 ? -InnerStride : InnerStride) >= LineSize))
+      Reuse = true;
+  }
+  if (!Reuse)
+    return 0;
+
+  // Keep the lines of a tile in half of the cache, to leave room for
+  // conflicts and other data.
+  unsigned TileSize = CacheSize / 2 / getCost(Inner);
+  if (TileSize < 2)
+    return 0;
+  TileSize = 1U << Log2_32(TileSize);
+
+  // Tiling only makes sense if the inner loop doesn't fit in a tile anyway.
+  const SCEV *BECount = SE->getBackedgeTakenCount(Inner);
+  if (isa<SCEVCouldNotCompute>(BECount) ||
+      BECount->getType() != InnerIV.Phi->getType() ||
+      !SE->isLoopInvariant(BECount, Outer))
+    return 0;
+  const SCEV *MaxBECount = SE->getMaxBackedgeTakenCount(Inner);
+  if (const SCEVConstant *C = dyn_cast<SCEVConstant>(MaxBECount))
+    if (C->getValue()->getValue().ult(TileSize))
+      return 0;
+
+  // The inner loop checks for the end of its tile by equality, so the
+  // induction variable may not wrap around within a tile.
+  unsigned BitWidth = SE->getTypeSizeInBits(BECount->getType());
+  uint64_t Step = InnerIV.Step < 0 ? -InnerIV.Step : InnerIV.Step;
+  if (BitWidth > 64 ||
+      APInt(64, TileSize * Step).getActiveBits() >= BitWidth)
+    return 0;
+  return TileSize;
+}
+
+//===----------------------------------------------------------------------===//
+// Transformation
+//===----------------------------------------------------------------------===//
+
+/// setLatchBranch - Make the latch branch Br continue to Header while Cond has
+/// the value it had in From's latch branch to its header, and leave to Exit
+/// otherwise.
+static void setLatchBranch(BranchInst *Br, const IndVar &From,
+                           BasicBlock *FromHeader, BasicBlock *Header,
+                           BasicBlock *Exit) {
+  unsigned Continue = From.Br->getSuccessor(0) == FromHeader ? 0 : 1;
+  Br->setCondition(From.Cond);
+  Br->setSuccessor(Continue, Header);
+  Br->setSuccessor(1 - Continue, Exit);
+}
+
+/// interchange - Swap the loop control of the two loops of the nest: the outer
+/// induction variable and its exit test move to the inner loop and the other
+/// way around.  Instructions in the outer header move to the inner header.
+void LoopInterchange::interchange() {
+  // Give users of the inner increment in the loop body their own copy.
+  Instruction *Copy = 0;
+  for (Value::use_iterator UI = InnerIV.Next->use_begin(),
+       UE = InnerIV.Next->use_end(); UI != UE; ) {
+    Use &U = UI.getUse();
+    ++UI;
+    if (U.getUser() == InnerIV.Phi || U.getUser() == InnerIV.Cond)
+      continue;
+    if (!Copy) {
+      Copy = InnerIV.Next->clone();
+      Copy->setName(InnerIV.Next->getName() + ".body");
+      Copy->insertBefore(InnerIV.Next);
+    }
+    U.set(Copy);
+  }
+
+  // Sink the code in the outer header into the inner loop.
+  SmallVector<Instruction*, 8> Sink;
+  for (BasicBlock::iterator I = OuterHeader->getFirstNonPHI(),
+       E = OuterHeader->getTerminator(); I != E; ++I)
+    Sink.push_back(I);
+  Instruction *InsertPt = InnerHeader->getFirstNonPHI();
+  for (unsigned i = 0, e = Sink.size(); i != e; ++i)
+    Sink[i]->moveBefore(InsertPt);
+
+  // Swap the induction variables.
+  OuterIV.Phi->moveBefore(InnerHeader->begin());
+  InnerIV.Phi->moveBefore(OuterHeader->begin());
+  OuterIV.Phi->setIncomingBlock(OuterIV.Phi->getBasicBlockIndex(Preheader),
+                                OuterHeader);
+  OuterIV.Phi->setIncomingBlock(OuterIV.Phi->getBasicBlockIndex(OuterLatch),
+                                InnerLatch);
+  InnerIV.Phi->setIncomingBlock(InnerIV.Phi->getBasicBlockIndex(OuterHeader),
+                                Preheader);
+  InnerIV.Phi->setIncomingBlock(InnerIV.Phi->getBasicBlockIndex(InnerLatch),
+                                OuterLatch);
+
+  // And their exit tests.
+  OuterIV.Next->moveBefore(InnerIV.Br);
+  OuterIV.Cond->moveBefore(InnerIV.Br);
+  InnerIV.Next->moveBefore(OuterIV.Br);
+  InnerIV.Cond->moveBefore(OuterIV.Br);
+  IndVar OldInner = InnerIV;
+  setLatchBranch(InnerIV.Br, OuterIV, OuterHeader, InnerHeader, OuterLatch);
+  setLatchBranch(OuterIV.Br, OldInner, InnerHeader, OuterHeader, Exit);
+}
+
+/// tile - Strip-mine the inner loop into tiles of TileSize iterations, and
+/// wrap the nest in a loop over the tiles.
+void LoopInterchange::tile(unsigned TileSize, LPPassManager &LPM) {
+  const Type *Ty = InnerIV.Phi->getType();
+  SCEVExpander Expander(*SE);
+  Value *BECount = Expander.expandCodeFor(SE->getBackedgeTakenCount(Inner), Ty,
+                                          Preheader->getTerminator());
+  SE->forgetLoop(Outer);
+
+  LLVMContext &Context = Ty->getContext();
+  Function *F = OuterHeader->getParent();
+  BasicBlock *TileHeader =
+    BasicBlock::Create(Context, "tile.header", F, OuterHeader);
+  BasicBlock *TileLatch = BasicBlock::Create(Context, "tile.latch", F, Exit);
+  Preheader->getTerminator()->replaceUsesOfWith(OuterHeader, TileHeader);
+
+  // The tile header computes the range of the inner induction variable in
+  // this tile: TileSize iterations, or what is left of the loop.
+  IRBuilder<> B(TileHeader);
+  PHINode *Tile = B.CreatePHI(Ty, "tile");
+  Tile->addIncoming(ConstantInt::get(Ty, 0), Preheader);
+  Value *Step = ConstantInt::get(Ty, InnerIV.Step);
+  Value *MaxLast = ConstantInt::get(Ty, TileSize - 1);
+  Value *Left = B.CreateSub(BECount, Tile, "tile.left");
+  Value *Last = B.CreateSelect(B.CreateICmpULT(Left, MaxLast), Left, MaxLast,
+                               "tile.last");
+  Value *Start = InnerIV.Phi->getIncomingValueForBlock(OuterHeader);
+  Value *TileStart = B.CreateAdd(Start, B.CreateMul(Tile, Step), "tile.start");
+  Value *TileEnd =
+    B.CreateAdd(TileStart,
+                B.CreateMul(B.CreateAdd(Last, ConstantInt::get(Ty, 1)), Step),
+                "tile.end");
+  Value *More = B.CreateICmpUGT(Left, MaxLast, "tile.more");
+  B.CreateBr(OuterHeader);
+  OuterIV.Phi->setIncomingBlock(OuterIV.Phi->getBasicBlockIndex(Preheader),
+                                TileHeader);
+  InnerIV.Phi->setIncomingValue(InnerIV.Phi->getBasicBlockIndex(OuterHeader),
+                                TileStart);
+
+  // The inner loop ends with its tile.
+  Value *TileCond = new ICmpInst(InnerIV.Br, ICmpInst::ICMP_NE, InnerIV.Next,
+                                 TileEnd, "tile.cond");
+  InnerIV.Br->setCondition(TileCond);
+  InnerIV.Br->setSuccessor(0, InnerHeader);
+  InnerIV.Br->setSuccessor(1, OuterLatch);
+  InnerIV.Cond->eraseFromParent();
+
+  // The outer loop is followed by the next tile, if there is one.
+  for (unsigned i = 0, e = OuterIV.Br->getNumSuccessors(); i != e; ++i)
+    if (OuterIV.Br->getSuccessor(i) == Exit)
+      OuterIV.Br->setSuccessor(i, TileLatch);
+  B.SetInsertPoint(TileLatch);
+  Value *TileNext = B.CreateAdd(Tile, ConstantInt::get(Ty, TileSize),
+                                "tile.next");
+  B.CreateCondBr(More, TileHeader, Exit);
+  Tile->addIncoming(TileNext, TileLatch);
+  for (BasicBlock::iterator I = Exit->begin(); isa<PHINode>(I); ++I) {
+    PHINode *PN = cast<PHINode>(I);
+    PN->setIncomingBlock(PN->getBasicBlockIndex(OuterLatch), TileLatch);
+  }
+
+  // Update the dominator tree.
+  DT->addNewBlock(TileHeader, Preheader);
+  DT->changeImmediateDominator(OuterHeader, TileHeader);
+  DT->addNewBlock(TileLatch, OuterLatch);
+  DT->changeImmediateDominator(Exit, TileLatch);
+
+  // Update loop info: the tile loop encloses the nest.
+  Loop *TileLoop = new Loop();
+  if (Loop *Parent = Outer->getParentLoop())
+    Parent->replaceChildLoopWith(Outer, TileLoop);
+  else
+    LI->changeTopLevelLoop(Outer, TileLoop);
+  TileLoop->addChildLoop(Outer);
+  TileLoop->addBasicBlockToLoop(TileHeader, LI->getBase());
+  for (Loop::block_iterator BI = Outer->block_begin(), BE = Outer->block_end();
+       BI != BE; ++BI)
+    TileLoop->addBlockEntry(*BI);
+  TileLoop->addBasicBlockToLoop(TileLatch, LI->getBase());
+  LPM.insertLoopIntoQueue(TileLoop);
+}
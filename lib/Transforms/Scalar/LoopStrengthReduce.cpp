@@ -62,6 +62,7 @@
 #include "llvm/Analysis/IVUsers.h"
 #include "llvm/Analysis/Dominators.h"
 #include "llvm/Analysis/LoopPass.h"
+#include "llvm/Analysis/ProfileInfo.h"
 #include "llvm/Analysis/ScalarEvolutionExpander.h"
 #include "llvm/Assembly/Writer.h"
 #include "llvm/Transforms/Utils/BasicBlockUtils.h"
@@ -69,6 +70,8 @@
 #include "llvm/ADT/SmallBitVector.h"
 #include "llvm/ADT/SetVector.h"
 #include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/ValueHandle.h"
 #include "llvm/Support/raw_ostream.h"
@@ -76,6 +79,29 @@
 #include <algorithm>
 using namespace llvm;
 
+STATISTIC(NumBudgetLoops,
+          "Number of loops that hit the LSR complexity budget");
+STATISTIC(NumFallbackLoops,
+          "Number of loops whose IVs were kept because of the budget");
+
+// The complexity budget bounds the time LSR spends on one loop.  Past the
+// budget, the search degrades gracefully: formula generation stops, the
+// heuristics prune harder, and the solver settles for the best solution found
+// so far.  Loops that are hopelessly large keep the IVs they have.
+static cl::opt<unsigned>
+MaxUses("lsr-max-uses", cl::Hidden, cl::init(512),
+        cl::desc("Leave loops with more interesting IV uses than this alone"));
+
+static cl::opt<unsigned>
+FormulaBudget("lsr-formula-budget", cl::Hidden, cl::init(16384),
+              cl::desc("Maximum number of reuse formulae to generate for "
+                       "one loop"));
+
+static cl::opt<unsigned>
+SolverBudget("lsr-solver-budget", cl::Hidden, cl::init(1 << 20),
+             cl::desc("Maximum number of formulae the solver rates for one "
+                      "loop"));
+
 namespace {
 
 /// RegSortData - This class holds data which is used to order reuse candidates.
@@ -1273,6 +1299,13 @@ class LSRInstance {
   Loop *const L;
   bool Changed;
 
+  /// FormulaeLeft - The number of formulae that may still be generated before
+  /// the formula budget for this loop runs out.
+  size_t FormulaeLeft;
+
+  /// HitBudget - True if some part of the complexity budget ran out.
+  bool HitBudget;
+
   /// IVIncInsertPos - This is the insert position that the current loop's
   /// induction variable increment should be placed. In simple loops, this is
   /// the latch block's terminator. But in more complicated cases, this is a
@@ -1357,8 +1390,9 @@ public:
                     SmallVectorImpl<const Formula *> &Workspace,
                     const Cost &CurCost,
                     const SmallPtrSet<const SCEV *, 16> &CurRegs,
-                    DenseSet<const SCEV *> &VisitedRegs) const;
-  void Solve(SmallVectorImpl<const Formula *> &Solution) const;
+                    DenseSet<const SCEV *> &VisitedRegs,
+                    unsigned &StepsLeft) const;
+  void Solve(SmallVectorImpl<const Formula *> &Solution);
 
   BasicBlock::iterator
     HoistInsertPosition(BasicBlock::iterator IP,
@@ -2125,9 +2159,17 @@ void LSRInstance::CountRegisters(const Formula &F, size_t LUIdx) {
 /// InsertFormula - If the given formula has not yet been inserted, add it to
 /// the list, and return true. Return false otherwise.
 bool LSRInstance::InsertFormula(LSRUse &LU, unsigned LUIdx, const Formula &F) {
+  // Once the formula budget is spent, the search has to make do with the
+  // formulae generated so far.
+  if (FormulaeLeft == 0) {
+    HitBudget = true;
+    return false;
+  }
+
   if (!LU.InsertFormula(F))
     return false;
 
+  --FormulaeLeft;
   CountRegisters(F, LUIdx);
   return true;
 }
@@ -2762,6 +2804,8 @@ void LSRInstance::GenerateCrossUseConstantOffsets() {
 /// GenerateAllReuseFormulae - Generate formulae for each use.
 void
 LSRInstance::GenerateAllReuseFormulae() {
+  FormulaeLeft = FormulaBudget;
+
   // This is split into multiple loops so that hasRegsUsedByUsesOtherThan
   // queries are more precise.
   for (size_t LUIdx = 0, NumUses = Uses.size(); LUIdx != NumUses; ++LUIdx) {
@@ -3097,6 +3141,10 @@ void LSRInstance::NarrowSearchSpaceByPickingWinnerRegs() {
       }
     }
 
+    // Every register has been tried; leave the rest to the bounded solver.
+    if (!Best)
+      break;
+
     DEBUG(dbgs() << "Narrowing the search space by assuming " << *Best
                  << " will yield profitable reuse.\n");
     Taken.insert(Best);
@@ -3147,7 +3195,8 @@ void LSRInstance::SolveRecurse(SmallVectorImpl<const Formula *> &Solution,
                                SmallVectorImpl<const Formula *> &Workspace,
                                const Cost &CurCost,
                                const SmallPtrSet<const SCEV *, 16> &CurRegs,
-                               DenseSet<const SCEV *> &VisitedRegs) const {
+                               DenseSet<const SCEV *> &VisitedRegs,
+                               unsigned &StepsLeft) const {
   // Some ideas:
   //  - prune more:
   //    - use more aggressive filtering
@@ -3158,6 +3207,11 @@ void LSRInstance::SolveRecurse(SmallVectorImpl<const Formula *> &Solution,
   //      and bail early.
   //    - track register sets with SmallBitVector
 
+  // Once the step budget is spent, stop searching as soon as there is any
+  // solution at all.
+  if (StepsLeft == 0 && !Solution.empty())
+    return;
+
   const LSRUse &LU = Uses[Workspace.size()];
 
   // If this use references any register that's already a part of the
@@ -3178,6 +3232,9 @@ retry:
        E = LU.Formulae.end(); I != E; ++I) {
     const Formula &F = *I;
 
+    if (StepsLeft == 0 && !Solution.empty())
+      return;
+
     // Ignore formulae which do not use any of the required registers.
     for (SmallSetVector<const SCEV *, 4>::const_iterator J = ReqRegs.begin(),
          JE = ReqRegs.end(); J != JE; ++J) {
@@ -3191,6 +3248,8 @@ retry:
 
     // Evaluate the cost of the current formula. If it's already worse than
     // the current best, prune the search at that point.
+    if (StepsLeft)
+      --StepsLeft;
     NewCost = CurCost;
     NewRegs = CurRegs;
     NewCost.RateFormula(F, NewRegs, VisitedRegs, L, LU.Offsets, SE, DT);
@@ -3198,7 +3257,7 @@ retry:
       Workspace.push_back(&F);
       if (Workspace.size() != Uses.size()) {
         SolveRecurse(Solution, SolutionCost, Workspace, NewCost,
-                     NewRegs, VisitedRegs);
+                     NewRegs, VisitedRegs, StepsLeft);
         if (F.getNumRegs() == 1 && Workspace.size() == 1)
           VisitedRegs.insert(F.ScaledReg ? F.ScaledReg : F.BaseRegs[0]);
       } else {
@@ -3228,7 +3287,7 @@ retry:
 
 /// Solve - Choose one formula from each use. Return the results in the given
 /// Solution vector.
-void LSRInstance::Solve(SmallVectorImpl<const Formula *> &Solution) const {
+void LSRInstance::Solve(SmallVectorImpl<const Formula *> &Solution) {
   SmallVector<const Formula *, 8> Workspace;
   Cost SolutionCost;
   SolutionCost.Loose();
@@ -3236,10 +3295,16 @@ void LSRInstance::Solve(SmallVectorImpl<const Formula *> &Solution) const {
   SmallPtrSet<const SCEV *, 16> CurRegs;
   DenseSet<const SCEV *> VisitedRegs;
   Workspace.reserve(Uses.size());
+  unsigned StepsLeft = SolverBudget;
 
   // SolveRecurse does all the work.
   SolveRecurse(Solution, SolutionCost, Workspace, CurCost,
-               CurRegs, VisitedRegs);
+               CurRegs, VisitedRegs, StepsLeft);
+  if (StepsLeft == 0) {
+    DEBUG(dbgs() << "LSR solver budget exhausted; using the best solution "
+                    "found so far.\n");
+    HitBudget = true;
+  }
 
   // Ok, we've now made all our decisions.
   DEBUG(dbgs() << "\n"
@@ -3658,7 +3723,8 @@ LSRInstance::LSRInstance(const TargetLowering *tli, Loop *l, Pass *P)
     SE(P->getAnalysis<ScalarEvolution>()),
     DT(P->getAnalysis<DominatorTree>()),
     LI(P->getAnalysis<LoopInfo>()),
-    TLI(tli), L(l), Changed(false), IVIncInsertPos(0) {
+    TLI(tli), L(l), Changed(false), FormulaeLeft(~size_t(0)),
+    HitBudget(false), IVIncInsertPos(0) {
 
   // If LoopSimplify form is not available, stay out of trouble.
   if (!L->isLoopSimplifyForm()) return;
@@ -3682,6 +3748,15 @@ LSRInstance::LSRInstance(const TargetLowering *tli, Loop *l, Pass *P)
   DEBUG(dbgs() << "LSR found " << Uses.size() << " uses:\n";
         print_uses(dbgs()));
 
+  // Even the pruned search would take too long on a loop this large, so keep
+  // its current IVs.
+  if (Uses.size() > MaxUses) {
+    DEBUG(dbgs() << "LSR skipping loop with too many uses.\n");
+    ++NumBudgetLoops;
+    ++NumFallbackLoops;
+    return;
+  }
+
   // Now use the reuse data to generate a bunch of interesting ways
   // to formulate the values needed for the uses.
   GenerateAllReuseFormulae();
@@ -3692,6 +3767,9 @@ LSRInstance::LSRInstance(const TargetLowering *tli, Loop *l, Pass *P)
   SmallVector<const Formula *, 8> Solution;
   Solve(Solution);
 
+  if (HitBudget)
+    ++NumBudgetLoops;
+
   // Release memory that is no longer needed.
   Factors.clear();
   Types.clear();
@@ -3826,6 +3904,7 @@ void LoopStrengthReduce::getAnalysisUsage(AnalysisUsage &AU) const {
   AU.addPreserved<ScalarEvolution>();
   AU.addRequired<IVUsers>();
   AU.addPreserved<IVUsers>();
+  AU.addPreserved<ProfileInfo>();
 }
 
 bool LoopStrengthReduce::runOnLoop(Loop *L, LPPassManager & /*LPM*/) {
@@ -39,6 +39,15 @@ UnrollAllowPartial("unroll-allow-partial", cl::init(false), cl::Hidden,
   cl::desc("Allows loops to be partially unrolled until "
            "-unroll-threshold loop size is reached."));
 
+static cl::opt<bool>
+UnrollRuntime("unroll-runtime", cl::init(true), cl::Hidden,
+  cl::desc("Unroll loops with run-time trip counts"));
+
+static cl::opt<unsigned>
+UnrollRuntimeCount("unroll-runtime-count", cl::init(8), cl::Hidden,
+  cl::desc("The largest count used to unroll loops with run-time trip "
+           "counts"));
+
 namespace {
   class LoopUnroll : public LoopPass {
   public:
@@ -70,6 +79,7 @@ namespace {
       AU.addPreservedID(LoopSimplifyID);
       AU.addRequiredID(LCSSAID);
       AU.addPreservedID(LCSSAID);
+      AU.addRequired<ScalarEvolution>();
       AU.addPreserved<ScalarEvolution>();
       // FIXME: Loop unroll requires LCSSA. And LCSSA requires dom info.
       // If loop unroll does not preserve dom info then LCSSA pass on next
@@ -85,6 +95,7 @@ INITIALIZE_PASS_BEGIN(LoopUnroll, "loop-unroll", "Unroll loops", false, false)
 INITIALIZE_PASS_DEPENDENCY(LoopInfo)
 INITIALIZE_PASS_DEPENDENCY(LoopSimplify)
 INITIALIZE_PASS_DEPENDENCY(LCSSA)
+INITIALIZE_PASS_DEPENDENCY(ScalarEvolution)
 INITIALIZE_PASS_END(LoopUnroll, "loop-unroll", "Unroll loops", false, false)
 
 Pass *llvm::createLoopUnrollPass() { return new LoopUnroll(); }
@@ -127,16 +138,33 @@ bool LoopUnroll::runOnLoop(Loop *L, LPPassManager &LPM) {
   // Find trip count
   unsigned TripCount = L->getSmallConstantTripCount();
   unsigned Count = UnrollCount;
+  bool Runtime = false;
 
   // Automatically select an unroll count.
   if (Count == 0) {
     // Conservative heuristic: if we know the trip count, see if we can
     // completely unroll (subject to the threshold, checked below); otherwise
     // try to find greatest modulo of the trip count which is still under
-    // threshold value.
-    if (TripCount == 0)
+    // threshold value.  If the trip count is only known at run time, start
+    // from the runtime unroll count and halve it until it fits.
+    if (TripCount != 0)
+      Count = TripCount;
+    else if (UnrollRuntime) {
+      // Loops that are known to run only a few iterations, like the prolog
+      // loops created by runtime unrolling itself, are not worth it.
+      ScalarEvolution *SE = &getAnalysis<ScalarEvolution>();
+      const SCEV *BECount = SE->getBackedgeTakenCount(L);
+      if (isa<SCEVCouldNotCompute>(BECount))
+        return false;
+      const SCEV *TripCountSC =
+        SE->getAddExpr(BECount, SE->getConstant(BECount->getType(), 1));
+      if (SE->getUnsignedRange(TripCountSC).getUnsignedMax()
+            .ult(UnrollRuntimeCount))
+        return false;
+      Count = UnrollRuntimeCount;
+      Runtime = true;
+    } else
       return false;
-    Count = TripCount;
   }
 
   // Enforce the threshold.
@@ -149,7 +177,18 @@ bool LoopUnroll::runOnLoop(Loop *L, LPPassManager &LPM) {
       return false;
     }
     uint64_t Size = (uint64_t)LoopSize*Count;
-    if (TripCount != 1 && Size > CurrentThreshold) {
+    if (Runtime) {
+      // The prolog loop adds another copy of the loop body.
+      while (Count > 1 && Size + LoopSize > CurrentThreshold) {
+        Count >>= 1;
+        Size = (uint64_t)LoopSize*Count;
+      }
+      if (Count < 2) {
+        DEBUG(dbgs() << "  Too large to unroll with a run-time trip count\n");
+        return false;
+      }
+      DEBUG(dbgs() << "  run-time unrolling with count: " << Count << "\n");
+    } else if (TripCount != 1 && Size > CurrentThreshold) {
       DEBUG(dbgs() << "  Too large to fully unroll with count: " << Count
             << " because size: " << Size << ">" << CurrentThreshold << "\n");
       if (!UnrollAllowPartial) {
@@ -172,7 +211,7 @@ bool LoopUnroll::runOnLoop(Loop *L, LPPassManager &LPM) {
 
   // Unroll the loop.
   Function *F = L->getHeader()->getParent();
-  if (!UnrollLoop(L, Count, LI, &LPM))
+  if (!UnrollLoop(L, Count, LI, &LPM, Runtime))
     return false;
 
   // FIXME: Reconstruct dom info, because it is not preserved properly.
@@ -0,0 +1,998 @@
+//===- LoopVectorize.cpp - Vectorize innermost loops ----------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This pass vectorizes innermost loops whose trip count can be computed by
+// ScalarEvolution.  A loop like:
+//
+//   for (i = 0; i < n; ++i)
+//     A[i] = B[i] + C[i];
+//
+// is rewritten so that VF consecutive iterations are executed at once by
+// <VF x T> operations, where VF is chosen from the width of the target's vector
+// registers and the widest scalar type in the loop.  The original loop is kept
+// as the scalar epilogue that executes the remaining (n mod VF) iterations:
+//
+//        preheader:  TC = trip count, VecTC = TC - TC mod VF
+//            |       (if VecTC == 0, go straight to the scalar loop)
+//      vector.memcheck: runtime alias checks, if any are needed
+//            |       (if the accessed ranges overlap, run the scalar loop)
+//         vector.ph
+//            |
+//        vector.body <-+  VF iterations per trip
+//            |---------+
+//      middle.block:  reduce vector reductions, compute resume values
+//          |       |
+//     scalar.ph    |   (skip the epilogue if VecTC == TC)
+//          |       |
+//     scalar loop  |
+//          |       |
+//         exit block
+//
+// The loop body must be a single basic block.  Every header PHI has to be an
+// induction variable or a reduction, and the only memory accesses allowed are
+// non-volatile loads and stores to consecutive or loop-invariant addresses.
+// Dependences between accesses are proven absent with LoopDependenceAnalysis,
+// AliasAnalysis and the SCEV distance between accesses; pairs that cannot be
+// proven independent at compile time get a runtime overlap check.
+//
+// TODO: if-conversion of loop bodies with control flow, interleaving, reverse
+// and strided accesses, and floating point reductions under fast-math.
+//
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "loop-vectorize"
+#include "llvm/Transforms/Scalar.h"
+#include "llvm/Constants.h"
+#include "llvm/DerivedTypes.h"
+#include "llvm/Instructions.h"
+#include "llvm/Analysis/AliasAnalysis.h"
+#include "llvm/Analysis/Dominators.h"
+#include "llvm/Analysis/LoopDependenceAnalysis.h"
+#include "llvm/Analysis/LoopPass.h"
+#include "llvm/Analysis/ScalarEvolutionExpander.h"
+#include "llvm/Analysis/ScalarEvolutionExpressions.h"
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/Target/TargetData.h"
+#include "llvm/Target/TargetLowering.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/IRBuilder.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/Statistic.h"
+using namespace llvm;
+
+STATISTIC(NumVectorized,     "Number of loops vectorized");
+STATISTIC(NumRuntimeChecked, "Number of vectorized loops with alias checks");
+
+static cl::opt<unsigned>
+VectorRegisterWidth("loop-vectorize-width", cl::init(128), cl::Hidden,
+  cl::desc("Vector register width in bits to assume when no target "
+           "information is available"));
+
+static cl::opt<unsigned>
+MaxRuntimeChecks("loop-vectorize-max-checks", cl::init(8), cl::Hidden,
+  cl::desc("The maximum number of runtime alias checks to emit for a "
+           "vectorized loop"));
+
+namespace {
+  /// MemAccess - A load or store in the loop being vectorized.
+  struct MemAccess {
+    Instruction *Inst;
+    Value *Ptr;
+    const Type *EltTy;
+    /// Rec - The address recurrence of a consecutive access, or null if the
+    /// address is loop invariant.
+    const SCEVAddRecExpr *Rec;
+    bool IsWrite;
+  };
+
+  /// Reduction - A header PHI that accumulates a value with an associative
+  /// and commutative operator across iterations.
+  struct Reduction {
+    PHINode *Phi;
+    Instruction::BinaryOps Opcode;
+    /// LoopVal - The value of the reduction flowing around the backedge.
+    Instruction *LoopVal;
+  };
+
+  class LoopVectorize : public LoopPass {
+    /// TLI - Keep a pointer of a TargetLowering to consult for the vector
+    /// register width.  This is null when no target information is available.
+    const TargetLowering *TLI;
+
+    Loop *CurLoop;
+    BasicBlock *Preheader, *Body;
+    const TargetData *TD;
+    ScalarEvolution *SE;
+    AliasAnalysis *AA;
+    LoopDependenceAnalysis *LDA;
+    DominatorTree *DT;
+    LoopInfo *LI;
+
+    /// VF - The vectorization factor for the current loop.
+    unsigned VF;
+    const SCEV *BECount;
+
+    SmallVector<PHINode*, 4> Inductions;
+    SmallVector<Reduction, 4> Reductions;
+    SmallVector<MemAccess, 16> Accesses;
+    SmallVector<std::pair<unsigned, unsigned>, 8> RuntimeChecks;
+
+    /// Widen - Instructions of the loop body whose values are needed as
+    /// vectors in the vectorized loop.
+    SmallPtrSet<Instruction*, 32> Widen;
+
+    /// VectorMap - Map from scalar values to their vectorized counterparts.
+    DenseMap<Value*, Value*> VectorMap;
+
+    // State used while generating the vector loop.
+    BasicBlock *VecPH, *VecBody;
+    PHINode *Index;
+    IRBuilder<> *Builder;
+
+  public:
+    static char ID; // Pass identification, replacement for typeid
+    explicit LoopVectorize(const TargetLowering *tli = 0)
+      : LoopPass(ID), TLI(tli) {
+      initializeLoopVectorizePass(*PassRegistry::getPassRegistry());
+    }
+
+    bool runOnLoop(Loop *L, LPPassManager &LPM);
+
+    virtual void getAnalysisUsage(AnalysisUsage &AU) const {
+      AU.addRequired<LoopInfo>();
+      AU.addPreserved<LoopInfo>();
+      AU.addRequiredID(LoopSimplifyID);
+      AU.addPreservedID(LoopSimplifyID);
+      AU.addRequiredID(LCSSAID);
+      AU.addPreservedID(LCSSAID);
+      AU.addRequired<ScalarEvolution>();
+      AU.addPreserved<ScalarEvolution>();
+      AU.addRequired<AliasAnalysis>();
+      AU.addPreserved<AliasAnalysis>();
+      AU.addRequired<LoopDependenceAnalysis>();
+      AU.addRequired<DominatorTree>();
+      AU.addPreserved<DominatorTree>();
+    }
+
+  private:
+    void clear();
+    bool canVectorizeLoop();
+    bool analyzePHIs();
+    bool isReduction(PHINode *PN);
+    bool analyzeMemoryAccesses();
+    bool analyzeWidenedValues(BasicBlock *Exit);
+    bool isWidenable(Instruction *I) const;
+    bool checkDependences();
+    unsigned getVectorizationFactor();
+    bool isLegalVectorizationFactor(uint64_t MaxBits) const;
+
+    void vectorizeLoop(LPPassManager &LPM);
+    Value *emitRuntimeChecks(Value *TC, Instruction *Loc);
+    Value *getVectorValue(Value *V);
+    Value *getInductionVector(PHINode *PN);
+    Value *getConsecutivePointer(const MemAccess &MA, const Type *VecTy);
+    Value *getSplat(Value *V, IRBuilder<> &B);
+    unsigned getAlignment(Instruction *I, const Type *EltTy) const;
+  };
+}
+
+char LoopVectorize::ID = 0;
+INITIALIZE_PASS_BEGIN(LoopVectorize, "loop-vectorize",
+                      "Vectorize innermost loops", false, false)
+INITIALIZE_PASS_DEPENDENCY(LoopInfo)
+INITIALIZE_PASS_DEPENDENCY(DominatorTree)
+INITIALIZE_PASS_DEPENDENCY(LoopSimplify)
+INITIALIZE_PASS_DEPENDENCY(LCSSA)
+INITIALIZE_PASS_DEPENDENCY(ScalarEvolution)
+INITIALIZE_PASS_DEPENDENCY(LoopDependenceAnalysis)
+INITIALIZE_AG_DEPENDENCY(AliasAnalysis)
+INITIALIZE_PASS_END(LoopVectorize, "loop-vectorize",
+                    "Vectorize innermost loops", false, false)
+
+Pass *llvm::createLoopVectorizePass(const TargetLowering *TLI) {
+  return new LoopVectorize(TLI);
+}
+
+void LoopVectorize::clear() {
+  Inductions.clear();
+  Reductions.clear();
+  Accesses.clear();
+  RuntimeChecks.clear();
+  Widen.clear();
+  VectorMap.clear();
+}
+
+bool LoopVectorize::runOnLoop(Loop *L, LPPassManager &LPM) {
+  CurLoop = L;
+  TD = getAnalysisIfAvailable<TargetData>();
+  if (TD == 0) return false;
+
+  SE = &getAnalysis<ScalarEvolution>();
+  AA = &getAnalysis<AliasAnalysis>();
+  LDA = &getAnalysis<LoopDependenceAnalysis>();
+  DT = &getAnalysis<DominatorTree>();
+  LI = &getAnalysis<LoopInfo>();
+
+  clear();
+  if (!canVectorizeLoop())
+    return false;
+
+  DEBUG(dbgs() << "LV: Vectorizing loop %" << L->getHeader()->getName()
+               << " in " << L->getHeader()->getParent()->getName()
+               << " with VF=" << VF << " and " << RuntimeChecks.size()
+               << " runtime checks\n");
+
+  vectorizeLoop(LPM);
+  clear();
+  ++NumVectorized;
+  return true;
+}
+
+//===----------------------------------------------------------------------===//
+// Legality and profitability
+//===----------------------------------------------------------------------===//
+
+/// isVectorElementType - Return true if values of type Ty can be packed into
+/// vectors whose memory layout matches an array of Ty.
+static bool isVectorElementType(const Type *Ty) {
+  if (Ty->isFloatTy() || Ty->isDoubleTy())
+    return true;
+  if (const IntegerType *ITy = dyn_cast<IntegerType>(Ty)) {
+    unsigned Bits = ITy->getBitWidth();
+    return Bits == 8 || Bits == 16 || Bits == 32 || Bits == 64;
+  }
+  return false;
+}
+
+/// canVectorizeLoop - Check whether the current loop has a shape we can
+/// vectorize, and compute everything the transformation needs.
+bool LoopVectorize::canVectorizeLoop() {
+  // Only innermost loops whose body is one basic block are handled.
+  if (!CurLoop->empty() || CurLoop->getBlocks().size() != 1)
+    return false;
+
+  Body = CurLoop->getHeader();
+  Preheader = CurLoop->getLoopPreheader();
+  BasicBlock *Exit = CurLoop->getExitBlock();
+  if (!Preheader || !Exit || CurLoop->getLoopLatch() != Body ||
+      Exit->getSinglePredecessor() != Body)
+    return false;
+
+  BranchInst *Br = dyn_cast<BranchInst>(Body->getTerminator());
+  if (!Br || !Br->isConditional())
+    return false;
+
+  // The trip count must be computable on entry to the loop, and must fit in a
+  // pointer-sized integer.
+  BECount = SE->getBackedgeTakenCount(CurLoop);
+  if (isa<SCEVCouldNotCompute>(BECount) ||
+      !BECount->getType()->isIntegerTy() ||
+      SE->getTypeSizeInBits(BECount->getType()) >
+        TD->getPointerSizeInBits())
+    return false;
+
+  // The exit condition may only be used by the branch.
+  if (Instruction *Cond = dyn_cast<Instruction>(Br->getCondition()))
+    if (CurLoop->contains(Cond) && !Cond->hasOneUse())
+      return false;
+
+  if (!analyzePHIs() || !analyzeMemoryAccesses() ||
+      !analyzeWidenedValues(Exit))
+    return false;
+
+  VF = getVectorizationFactor();
+  return VF >= 2;
+}
+
+/// analyzePHIs - Classify every header PHI as an induction variable or a
+/// reduction.  Anything else is a recurrence we cannot vectorize.
+bool LoopVectorize::analyzePHIs() {
+  for (BasicBlock::iterator I = Body->begin(); isa<PHINode>(I); ++I) {
+    PHINode *PN = cast<PHINode>(I);
+    if (PN->getType()->isIntegerTy() || PN->getType()->isPointerTy()) {
+      const SCEVAddRecExpr *AR =
+        dyn_cast<SCEVAddRecExpr>(SE->getSCEV(PN));
+      if (AR && AR->getLoop() == CurLoop && AR->isAffine()) {
+        Inductions.push_back(PN);
+        continue;
+      }
+    }
+
+    if (!isReduction(PN)) {
+      DEBUG(dbgs() << "LV: Unsupported recurrence: " << *PN << "\n");
+      return false;
+    }
+  }
+  return !Inductions.empty();
+}
+
+/// isReduction - Return true if PN is the start of a chain of binary operators
+/// of one kind that each feed only the next, the last of which flows back
+/// into PN.  Intermediate values of such a chain are never observed, so the
+/// partial results can be kept per vector lane.
+bool LoopVectorize::isReduction(PHINode *PN) {
+  if (!PN->getType()->isIntegerTy() || !isVectorElementType(PN->getType()))
+    return false;
+
+  Value *Back = PN->getIncomingValueForBlock(Body);
+  Instruction *Cur = PN;
+  Instruction::BinaryOps Opcode = Instruction::BinaryOpsEnd;
+  while (Cur != Back) {
+    // Every link in the chain feeds exactly one instruction in the loop.
+    if (!Cur->hasOneUse())
+      return false;
+    BinaryOperator *BO = dyn_cast<BinaryOperator>(*Cur->use_begin());
+    if (!BO || !CurLoop->contains(BO) ||
+        (BO->getOperand(0) == Cur && BO->getOperand(1) == Cur))
+      return false;
+    switch (BO->getOpcode()) {
+    case Instruction::Add:
+    case Instruction::Mul:
+    case Instruction::And:
+    case Instruction::Or:
+    case Instruction::Xor:
+      break;
+    default:
+      return false;
+    }
+    if (Opcode != Instruction::BinaryOpsEnd && BO->getOpcode() != Opcode)
+      return false;
+    Opcode = BO->getOpcode();
+    Cur = BO;
+  }
+
+  if (Cur == PN)
+    return false;
+
+  // The final value may only be used by the PHI and outside the loop.
+  for (Value::use_iterator UI = Cur->use_begin(), E = Cur->use_end();
+       UI != E; ++UI)
+    if (*UI != PN && CurLoop->contains(cast<Instruction>(*UI)))
+      return false;
+
+  Reduction R;
+  R.Phi = PN;
+  R.Opcode = Opcode;
+  R.LoopVal = Cur;
+  Reductions.push_back(R);
+  return true;
+}
+
+/// analyzeMemoryAccesses - Collect the loads and stores of the loop, and
+/// reject the loop if anything else touches memory or an access is not to a
+/// consecutive or loop-invariant address.
+bool LoopVectorize::analyzeMemoryAccesses() {
+  for (BasicBlock::iterator I = Body->begin(), E = Body->end(); I != E; ++I) {
+    Value *Ptr;
+    const Type *EltTy;
+    bool IsWrite;
+    if (LoadInst *LI = dyn_cast<LoadInst>(I)) {
+      if (LI->isVolatile()) return false;
+      Ptr = LI->getPointerOperand();
+      EltTy = LI->getType();
+      IsWrite = false;
+    } else if (StoreInst *SI = dyn_cast<StoreInst>(I)) {
+      if (SI->isVolatile()) return false;
+      Ptr = SI->getPointerOperand();
+      EltTy = SI->getValueOperand()->getType();
+      IsWrite = true;
+    } else {
+      if (I->mayReadFromMemory() || I->mayWriteToMemory() ||
+          I->mayHaveSideEffects())
+        return false;
+      continue;
+    }
+
+    if (!isVectorElementType(EltTy))
+      return false;
+
+    MemAccess MA;
+    MA.Inst = I;
+    MA.Ptr = Ptr;
+    MA.EltTy = EltTy;
+    MA.IsWrite = IsWrite;
+    MA.Rec = 0;
+
+    const SCEV *S = SE->getSCEV(Ptr);
+    if (!SE->isLoopInvariant(S, CurLoop)) {
+      // The address must advance by exactly one element per iteration.
+      const SCEVAddRecExpr *AR = dyn_cast<SCEVAddRecExpr>(S);
+      if (!AR || AR->getLoop() != CurLoop || !AR->isAffine())
+        return false;
+      const SCEVConstant *Step =
+        dyn_cast<SCEVConstant>(AR->getStepRecurrence(*SE));
+      if (!Step ||
+          Step->getValue()->getValue() != TD->getTypeAllocSize(EltTy))
+        return false;
+      MA.Rec = AR;
+    } else if (IsWrite) {
+      // Stores to a loop invariant address are not vectorized.
+      return false;
+    }
+    Accesses.push_back(MA);
+  }
+  return true;
+}
+
+/// isWidenable - Return true if I can be turned into a vector instruction.
+bool LoopVectorize::isWidenable(Instruction *I) const {
+  if (!isVectorElementType(I->getType()))
+    return false;
+  if (isa<BinaryOperator>(I) || isa<LoadInst>(I) || isa<PHINode>(I))
+    return true;
+  if (CastInst *CI = dyn_cast<CastInst>(I))
+    return isVectorElementType(CI->getOperand(0)->getType());
+  return false;
+}
+
+/// analyzeWidenedValues - Compute the set of instructions whose values are
+/// needed as vectors: the values stored, the reductions, and the values used
+/// after the loop.  Everything else (address arithmetic, loop control) stays
+/// scalar, or is recomputed with SCEV.
+bool LoopVectorize::analyzeWidenedValues(BasicBlock *Exit) {
+  SmallVector<Instruction*, 16> Worklist;
+  for (unsigned i = 0, e = Accesses.size(); i != e; ++i)
+    if (Accesses[i].IsWrite) {
+      Value *V = cast<StoreInst>(Accesses[i].Inst)->getValueOperand();
+      if (Instruction *I = dyn_cast<Instruction>(V))
+        Worklist.push_back(I);
+    }
+  for (unsigned i = 0, e = Reductions.size(); i != e; ++i)
+    Worklist.push_back(Reductions[i].LoopVal);
+
+  // Values live out of the loop are either recomputed from their SCEV, or
+  // extracted from the last lane of the vector.
+  for (BasicBlock::iterator I = Exit->begin(); isa<PHINode>(I); ++I) {
+    Instruction *Op =
+      dyn_cast<Instruction>(cast<PHINode>(I)->getIncomingValue(0));
+    if (!Op || !CurLoop->contains(Op))
+      continue;
+    const SCEVAddRecExpr *AR = dyn_cast<SCEVAddRecExpr>(SE->getSCEV(Op));
+    if (AR && AR->getLoop() == CurLoop)
+      continue;
+    if (PHINode *PN = dyn_cast<PHINode>(Op))
+      if (std::find(Inductions.begin(), Inductions.end(), PN) ==
+          Inductions.end())
+        return false;
+    Worklist.push_back(Op);
+  }
+
+  while (!Worklist.empty()) {
+    Instruction *I = Worklist.pop_back_val();
+    if (!CurLoop->contains(I) || !Widen.insert(I))
+      continue;
+    if (!isWidenable(I)) {
+      DEBUG(dbgs() << "LV: Cannot widen: " << *I << "\n");
+      return false;
+    }
+
+    if (PHINode *PN = dyn_cast<PHINode>(I)) {
+      // Inductions are materialized from their SCEV, which needs a constant
+      // step.
+      if (std::find(Inductions.begin(), Inductions.end(), PN) !=
+          Inductions.end()) {
+        const SCEVAddRecExpr *AR = cast<SCEVAddRecExpr>(SE->getSCEV(PN));
+        if (!PN->getType()->isIntegerTy() ||
+            !isa<SCEVConstant>(AR->getStepRecurrence(*SE)))
+          return false;
+      }
+      continue;
+    }
+    if (isa<LoadInst>(I))
+      continue;
+
+    for (unsigned i = 0, e = I->getNumOperands(); i != e; ++i)
+      if (Instruction *Op = dyn_cast<Instruction>(I->getOperand(i)))
+        Worklist.push_back(Op);
+  }
+
+  // Loop without stores or reductions have nothing to vectorize.
+  return !Widen.empty();
+}
+
+/// getVectorizationFactor - Pick the number of lanes so that a vector of the
+/// widest scalar type in the loop fills a vector register.  If that factor
+/// cannot be used, halve it until one can.  Return 1 if no factor works.
+unsigned LoopVectorize::getVectorizationFactor() {
+  unsigned RegWidth = VectorRegisterWidth;
+  if (TLI)
+    RegWidth = TLI->getVectorRegisterBitWidth();
+
+  uint64_t MaxBits = 0;
+  for (SmallPtrSet<Instruction*, 32>::iterator I = Widen.begin(),
+       E = Widen.end(); I != E; ++I)
+    MaxBits = std::max(MaxBits, TD->getTypeSizeInBits((*I)->getType()));
+  for (unsigned i = 0, e = Accesses.size(); i != e; ++i)
+    MaxBits = std::max(MaxBits, TD->getTypeSizeInBits(Accesses[i].EltTy));
+
+  if (MaxBits == 0 || MaxBits > RegWidth)
+    return 1;
+
+  for (VF = RegWidth / MaxBits; VF >= 2; VF /= 2) {
+    if (!isLegalVectorizationFactor(MaxBits))
+      continue;
+
+    // Don't bother with loops that never execute a full vector iteration.
+    if (const SCEVConstant *C = dyn_cast<SCEVConstant>(BECount))
+      if (C->getValue()->getValue().ult(VF - 1))
+        continue;
+
+    // A narrower vector may fit between accesses that depend on each other.
+    RuntimeChecks.clear();
+    if (checkDependences())
+      return VF;
+  }
+  return 1;
+}
+
+/// isLegalVectorizationFactor - Return true if the target can hold a vector of
+/// VF values of the widest type in the loop, MaxBits, in a register.
+bool LoopVectorize::isLegalVectorizationFactor(uint64_t MaxBits) const {
+  if (!TLI)
+    return true;
+  for (SmallPtrSet<Instruction*, 32>::const_iterator I = Widen.begin(),
+       E = Widen.end(); I != E; ++I) {
+    const Type *Ty = (*I)->getType();
+    if (TD->getTypeSizeInBits(Ty) != MaxBits)
+      continue;
+    EVT VT = TLI->getValueType(VectorType::get(Ty, VF), true);
+    if (!TLI->isTypeLegal(VT))
+      return false;
+  }
+  return true;
+}
+
+/// checkDependences - Make sure that executing VF iterations at once cannot
+/// reorder dependent memory accesses.  Pairs of accesses that may depend on
+/// each other but whose address ranges can be computed are recorded in
+/// RuntimeChecks.
+bool LoopVectorize::checkDependences() {
+  for (unsigned i = 0, e = Accesses.size(); i != e; ++i)
+    for (unsigned j = i + 1; j != e; ++j) {
+      const MemAccess &A = Accesses[i], &B = Accesses[j];
+      if (!A.IsWrite && !B.IsWrite)
+        continue;
+
+      // Accesses at a constant distance from each other are independent
+      // within a vector iteration if they are either the same location, or
+      // at least a whole vector apart.
+      const SCEV *Dist =
+        SE->getMinusSCEV(SE->getSCEV(B.Ptr), SE->getSCEV(A.Ptr));
+      if (const SCEVConstant *C = dyn_cast<SCEVConstant>(Dist)) {
+        int64_t D = C->getValue()->getSExtValue();
+        uint64_t Size = std::max(TD->getTypeAllocSize(A.EltTy),
+                                 TD->getTypeAllocSize(B.EltTy));
+        if (D == 0 || (uint64_t)(D < 0 ? -D : D) >= VF * Size)
+          continue;
+        DEBUG(dbgs() << "LV: Dependence at distance " << D << ": "
+                     << *A.Inst << " and " << *B.Inst << "\n");
+        return false;
+      }
+
+      if (!LDA->depends(A.Inst, B.Inst))
+        continue;
+      if (AA->alias(A.Ptr, AliasAnalysis::UnknownSize,
+                    B.Ptr, AliasAnalysis::UnknownSize) ==
+          AliasAnalysis::NoAlias)
+        continue;
+
+      // Fall back to checking at runtime that the accessed ranges do not
+      // overlap.
+      if (A.Ptr->getType() != B.Ptr->getType() &&
+          cast<PointerType>(A.Ptr->getType())->getAddressSpace() !=
+          cast<PointerType>(B.Ptr->getType())->getAddressSpace())
+        return false;
+      if (RuntimeChecks.size() == MaxRuntimeChecks) {
+        DEBUG(dbgs() << "LV: Too many runtime alias checks\n");
+        return false;
+      }
+      RuntimeChecks.push_back(std::make_pair(i, j));
+    }
+  return true;
+}
+
+//===----------------------------------------------------------------------===//
+// Transformation
+//===----------------------------------------------------------------------===//
+
+unsigned LoopVectorize::getAlignment(Instruction *I,
+                                     const Type *EltTy) const {
+  unsigned Align = isa<LoadInst>(I) ? cast<LoadInst>(I)->getAlignment()
+                                    : cast<StoreInst>(I)->getAlignment();
+  return Align ? Align : TD->getABITypeAlignment(EltTy);
+}
+
+/// getSplat - Return a vector with V in every lane, inserting any code needed
+/// with B.
+Value *LoopVectorize::getSplat(Value *V, IRBuilder<> &B) {
+  if (Constant *C = dyn_cast<Constant>(V))
+    return ConstantVector::get(std::vector<Constant*>(VF, C));
+
+  const Type *VecTy = VectorType::get(V->getType(), VF);
+  Value *Ins = B.CreateInsertElement(UndefValue::get(VecTy), V, B.getInt32(0),
+                                     V->getName() + ".splatinsert");
+  Constant *Zeros = Constant::getNullValue(VectorType::get(B.getInt32Ty(),
+                                                           VF));
+  return B.CreateShuffleVector(Ins, UndefValue::get(VecTy), Zeros,
+                               V->getName() + ".splat");
+}
+
+/// getInductionVector - Return the values the induction PN takes in the VF
+/// scalar iterations covered by the current vector iteration.
+Value *LoopVectorize::getInductionVector(PHINode *PN) {
+  const SCEVAddRecExpr *AR = cast<SCEVAddRecExpr>(SE->getSCEV(PN));
+  ConstantInt *Step =
+    cast<SCEVConstant>(AR->getStepRecurrence(*SE))->getValue();
+  Value *Start = PN->getIncomingValueForBlock(Preheader);
+
+  const Type *Ty = PN->getType();
+  Value *Iter = Builder->CreateIntCast(Index, Ty, false);
+  Value *Scalar = Builder->CreateAdd(Start, Builder->CreateMul(Iter, Step),
+                                     PN->getName() + ".vecbase");
+
+  std::vector<Constant*> Offsets;
+  for (unsigned i = 0; i != VF; ++i)
+    Offsets.push_back(ConstantInt::get(Ty, Step->getSExtValue() * i, true));
+  return Builder->CreateAdd(getSplat(Scalar, *Builder), ConstantVector::get(Offsets),
+                            PN->getName() + ".vec");
+}
+
+/// getConsecutivePointer - Return a pointer to the VF consecutive elements
+/// accessed by MA in the current vector iteration.
+Value *LoopVectorize::getConsecutivePointer(const MemAccess &MA,
+                                            const Type *VecTy) {
+  const Type *EltPtrTy = MA.Ptr->getType();
+  SCEVExpander Expander(*SE);
+  Value *Base = Expander.expandCodeFor(MA.Rec->getStart(), EltPtrTy,
+                                       VecPH->getTerminator());
+  Value *Ptr = Builder->CreateGEP(Base, Index, MA.Ptr->getName() + ".vec");
+  unsigned AS = cast<PointerType>(EltPtrTy)->getAddressSpace();
+  return Builder->CreateBitCast(Ptr, PointerType::get(VecTy, AS));
+}
+
+/// getVectorValue - Return the vectorized form of V, widening instructions of
+/// the loop body on demand.
+Value *LoopVectorize::getVectorValue(Value *V) {
+  DenseMap<Value*, Value*>::iterator It = VectorMap.find(V);
+  if (It != VectorMap.end())
+    return It->second;
+
+  Instruction *I = dyn_cast<Instruction>(V);
+  Value *Vec;
+  if (I == 0 || !CurLoop->contains(I)) {
+    // Loop invariants are broadcast in the vector preheader.
+    IRBuilder<> PHBuilder(VecPH->getTerminator());
+    Vec = getSplat(V, PHBuilder);
+  } else if (PHINode *PN = dyn_cast<PHINode>(I)) {
+    Vec = getInductionVector(PN);
+  } else if (BinaryOperator *BO = dyn_cast<BinaryOperator>(I)) {
+    Value *LHS = getVectorValue(BO->getOperand(0));
+    Value *RHS = getVectorValue(BO->getOperand(1));
+    Vec = Builder->CreateBinOp(BO->getOpcode(), LHS, RHS,
+                               BO->getName() + ".vec");
+  } else {
+    CastInst *CI = cast<CastInst>(I);
+    Vec = Builder->CreateCast(CI->getOpcode(),
+                              getVectorValue(CI->getOperand(0)),
+                              VectorType::get(CI->getType(), VF),
+                              CI->getName() + ".vec");
+  }
+  VectorMap[V] = Vec;
+  return Vec;
+}
+
+/// emitRuntimeChecks - Emit code before Loc that computes whether any pair of
+/// accesses in RuntimeChecks may touch overlapping memory.
+Value *LoopVectorize::emitRuntimeChecks(Value *TC, Instruction *Loc) {
+  LLVMContext &Ctx = Loc->getContext();
+  const Type *IntPtrTy = TD->getIntPtrType(Ctx);
+  const SCEV *TCS = SE->getUnknown(TC);
+  SCEVExpander Expander(*SE);
+  IRBuilder<> B(Loc);
+
+  // Compute the [Start, End) byte range touched by each access.
+  DenseMap<unsigned, std::pair<Value*, Value*> > Ranges;
+  Value *Conflict = 0;
+  for (unsigned i = 0, e = RuntimeChecks.size(); i != e; ++i) {
+    unsigned Idx[2] = { RuntimeChecks[i].first, RuntimeChecks[i].second };
+    Value *Start[2], *End[2];
+    for (unsigned k = 0; k != 2; ++k) {
+      std::pair<Value*, Value*> &R = Ranges[Idx[k]];
+      if (R.first == 0) {
+        const MemAccess &MA = Accesses[Idx[k]];
+        unsigned AS = cast<PointerType>(MA.Ptr->getType())->getAddressSpace();
+        const Type *I8PtrTy = Type::getInt8PtrTy(Ctx, AS);
+        const SCEV *Size =
+          SE->getConstant(IntPtrTy, TD->getTypeAllocSize(MA.EltTy));
+        const SCEV *StartS = MA.Rec ? MA.Rec->getStart() : SE->getSCEV(MA.Ptr);
+        const SCEV *EndS = MA.Rec ?
+          SE->getAddExpr(StartS, SE->getMulExpr(TCS, Size)) :
+          SE->getAddExpr(StartS, Size);
+        R.first = Expander.expandCodeFor(StartS, I8PtrTy, Loc);
+        R.second = Expander.expandCodeFor(EndS, I8PtrTy, Loc);
+      }
+      Start[k] = R.first;
+      End[k] = R.second;
+    }
+
+    // The ranges overlap iff each one starts before the other one ends.
+    Value *Cmp0 = B.CreateICmpULT(Start[0], End[1], "bound0");
+    Value *Cmp1 = B.CreateICmpULT(Start[1], End[0], "bound1");
+    Value *Overlap = B.CreateAnd(Cmp0, Cmp1, "found.conflict");
+    Conflict = Conflict ? B.CreateOr(Conflict, Overlap, "conflict.rdx")
+                        : Overlap;
+  }
+  return Conflict;
+}
+
+/// getReductionIdentity - Return the identity value of a reduction operator.
+static Constant *getReductionIdentity(Instruction::BinaryOps Opcode,
+                                      const Type *Ty) {
+  switch (Opcode) {
+  default: llvm_unreachable("Unknown reduction operator!");
+  case Instruction::Add:
+  case Instruction::Or:
+  case Instruction::Xor:
+    return Constant::getNullValue(Ty);
+  case Instruction::Mul:
+    return ConstantInt::get(Ty, 1);
+  case Instruction::And:
+    return Constant::getAllOnesValue(Ty);
+  }
+}
+
+void LoopVectorize::vectorizeLoop(LPPassManager &LPM) {
+  BasicBlock *Exit = CurLoop->getExitBlock();
+  Loop *ParentLoop = CurLoop->getParentLoop();
+  Function *F = Body->getParent();
+  LLVMContext &Ctx = F->getContext();
+  const Type *IntPtrTy = TD->getIntPtrType(Ctx);
+
+  // Create the new blocks.
+  BasicBlock *CheckBB = RuntimeChecks.empty() ? 0 :
+    BasicBlock::Create(Ctx, "vector.memcheck", F, Body);
+  VecPH = BasicBlock::Create(Ctx, "vector.ph", F, Body);
+  VecBody = BasicBlock::Create(Ctx, "vector.body", F, Body);
+  BasicBlock *Middle = BasicBlock::Create(Ctx, "middle.block", F, Body);
+  BasicBlock *ScalarPH = BasicBlock::Create(Ctx, "scalar.ph", F, Body);
+  BranchInst::Create(VecBody, VecPH);
+  BranchInst::Create(Body, ScalarPH);
+
+  // In the old preheader, compute the trip count and the number of iterations
+  // executed by the vector loop.  If the trip count wraps around to zero, no
+  // vector iteration executes and the scalar loop runs on its own.
+  Instruction *PHTerm = Preheader->getTerminator();
+  SCEVExpander Expander(*SE);
+  Value *BETaken = Expander.expandCodeFor(BECount, BECount->getType(), PHTerm);
+  IRBuilder<> B(PHTerm);
+  Value *TC = B.CreateAdd(B.CreateZExtOrBitCast(BETaken, IntPtrTy),
+                          ConstantInt::get(IntPtrTy, 1), "trip.count");
+  Value *VecTC = B.CreateAnd(TC, ConstantInt::get(IntPtrTy, -(int64_t)VF, true),
+                             "n.vec");
+  Value *NoVector = B.CreateICmpEQ(VecTC, ConstantInt::get(IntPtrTy, 0),
+                                   "cmp.zero");
+  BranchInst::Create(ScalarPH, CheckBB ? CheckBB : VecPH, NoVector, PHTerm);
+  PHTerm->eraseFromParent();
+
+  if (CheckBB) {
+    BranchInst *Br = BranchInst::Create(ScalarPH, VecPH,
+                                        ConstantInt::getFalse(Ctx), CheckBB);
+    Br->setCondition(emitRuntimeChecks(TC, Br));
+    ++NumRuntimeChecked;
+  }
+
+  // Generate the vector loop.
+  IRBuilder<> BodyBuilder(VecBody);
+  Builder = &BodyBuilder;
+  Index = BodyBuilder.CreatePHI(IntPtrTy, "index");
+
+  for (unsigned i = 0, e = Reductions.size(); i != e; ++i) {
+    // Lane zero of the vector accumulator starts with the incoming value, the
+    // other lanes with the identity of the operator.
+    const Reduction &R = Reductions[i];
+    const Type *Ty = R.Phi->getType();
+    IRBuilder<> PHBuilder(VecPH->getTerminator());
+    Value *Init = PHBuilder.CreateInsertElement(
+      getSplat(getReductionIdentity(R.Opcode, Ty), PHBuilder),
+      R.Phi->getIncomingValueForBlock(Preheader), PHBuilder.getInt32(0),
+      "rdx.init");
+    PHINode *VecPhi = BodyBuilder.CreatePHI(VectorType::get(Ty, VF),
+                                            R.Phi->getName() + ".vec");
+    VecPhi->addIncoming(Init, VecPH);
+    VectorMap[R.Phi] = VecPhi;
+  }
+
+  // Memory accesses are emitted in their original order; arithmetic is
+  // widened on demand when its value is needed.
+  for (unsigned i = 0, e = Accesses.size(); i != e; ++i) {
+    const MemAccess &MA = Accesses[i];
+    const Type *VecTy = VectorType::get(MA.EltTy, VF);
+    if (!MA.IsWrite) {
+      if (!Widen.count(MA.Inst))
+        continue;
+      Value *Vec;
+      if (MA.Rec) {
+        LoadInst *Load =
+          BodyBuilder.CreateLoad(getConsecutivePointer(MA, VecTy),
+                                 MA.Inst->getName() + ".vec");
+        Load->setAlignment(getAlignment(MA.Inst, MA.EltTy));
+        Vec = Load;
+      } else {
+        LoadInst *Load = BodyBuilder.CreateLoad(MA.Ptr, MA.Inst->getName());
+        Load->setAlignment(getAlignment(MA.Inst, MA.EltTy));
+        Vec = getSplat(Load, BodyBuilder);
+      }
+      VectorMap[MA.Inst] = Vec;
+      continue;
+    }
+
+    StoreInst *SI = cast<StoreInst>(MA.Inst);
+    Value *Val = getVectorValue(SI->getValueOperand());
+    StoreInst *Store =
+      BodyBuilder.CreateStore(Val, getConsecutivePointer(MA, VecTy));
+    Store->setAlignment(getAlignment(SI, MA.EltTy));
+  }
+
+  for (unsigned i = 0, e = Reductions.size(); i != e; ++i) {
+    const Reduction &R = Reductions[i];
+    cast<PHINode>(VectorMap[R.Phi])->addIncoming(getVectorValue(R.LoopVal),
+                                                 VecBody);
+  }
+
+  // Make sure every value used after the loop is available.
+  for (SmallPtrSet<Instruction*, 32>::iterator I = Widen.begin(),
+       E = Widen.end(); I != E; ++I)
+    getVectorValue(*I);
+
+  Value *NextIndex = BodyBuilder.CreateAdd(Index,
+                                           ConstantInt::get(IntPtrTy, VF),
+                                           "index.next");
+  Index->addIncoming(ConstantInt::get(IntPtrTy, 0), VecPH);
+  Index->addIncoming(NextIndex, VecBody);
+  BodyBuilder.CreateCondBr(BodyBuilder.CreateICmpEQ(NextIndex, VecTC),
+                           Middle, VecBody);
+  Builder = 0;
+
+  // In the middle block, reduce the vector accumulators and compute the values
+  // the scalar loop resumes with.
+  BranchInst *MiddleBr =
+    BranchInst::Create(Exit, ScalarPH, ConstantInt::getTrue(Ctx), Middle);
+  IRBuilder<> MB(MiddleBr);
+  MiddleBr->setCondition(MB.CreateICmpEQ(VecTC, TC, "cmp.n"));
+
+  DenseMap<Value*, Value*> ResumeValues;
+  for (unsigned i = 0, e = Reductions.size(); i != e; ++i) {
+    const Reduction &R = Reductions[i];
+    Value *Vec = VectorMap[R.LoopVal];
+    Value *Rdx = MB.CreateExtractElement(Vec, MB.getInt32(0));
+    for (unsigned Lane = 1; Lane != VF; ++Lane)
+      Rdx = MB.CreateBinOp(R.Opcode, Rdx,
+                           MB.CreateExtractElement(Vec, MB.getInt32(Lane)),
+                           "bin.rdx");
+    ResumeValues[R.Phi] = Rdx;
+    ResumeValues[R.LoopVal] = Rdx;
+  }
+
+  SCEVExpander MiddleExpander(*SE);
+  const SCEV *VecTCS = SE->getUnknown(VecTC);
+  for (unsigned i = 0, e = Inductions.size(); i != e; ++i) {
+    PHINode *PN = Inductions[i];
+    const SCEVAddRecExpr *AR = cast<SCEVAddRecExpr>(SE->getSCEV(PN));
+    ResumeValues[PN] =
+      MiddleExpander.expandCodeFor(AR->evaluateAtIteration(VecTCS, *SE),
+                                   PN->getType(), MiddleBr);
+  }
+
+  // Values used after the loop get their value at the last iteration when the
+  // vector loop ran to completion.
+  for (BasicBlock::iterator I = Exit->begin(); isa<PHINode>(I); ++I) {
+    PHINode *PN = cast<PHINode>(I);
+    Value *V = PN->getIncomingValueForBlock(Body);
+    Instruction *Inst = dyn_cast<Instruction>(V);
+    if (Inst && CurLoop->contains(Inst)) {
+      DenseMap<Value*, Value*>::iterator RV = ResumeValues.find(Inst);
+      if (RV != ResumeValues.end() && !isa<PHINode>(Inst)) {
+        V = RV->second;
+      } else if (const SCEVAddRecExpr *AR =
+                   dyn_cast<SCEVAddRecExpr>(SE->getSCEV(Inst))) {
+        V = MiddleExpander.expandCodeFor(AR->evaluateAtIteration(BECount, *SE),
+                                         Inst->getType(), MiddleBr);
+      } else {
+        V = MB.CreateExtractElement(getVectorValue(Inst),
+                                    MB.getInt32(VF - 1));
+      }
+    }
+    PN->addIncoming(V, Middle);
+    SE->forgetValue(PN);
+  }
+
+  // The vector loop exits into the middle block; route its values through
+  // PHIs there to keep it in LCSSA form.
+  for (BasicBlock::iterator I = VecBody->begin(), E = VecBody->end();
+       I != E; ++I) {
+    SmallVector<Use*, 4> OutsideUses;
+    for (Value::use_iterator UI = I->use_begin(), UE = I->use_end();
+         UI != UE; ++UI)
+      if (cast<Instruction>(*UI)->getParent() != VecBody)
+        OutsideUses.push_back(&UI.getUse());
+    if (OutsideUses.empty())
+      continue;
+    PHINode *PN = PHINode::Create(I->getType(), I->getName() + ".lcssa",
+                                  &Middle->front());
+    PN->addIncoming(I, VecBody);
+    for (unsigned i = 0, e = OutsideUses.size(); i != e; ++i)
+      OutsideUses[i]->set(PN);
+  }
+
+  // Give the scalar loop an exit block of its own, so that the exit block
+  // shared with the middle block is not an exit of either loop.
+  BasicBlock *ScalarExit = BasicBlock::Create(Ctx, "scalar.exit", F, Exit);
+  BranchInst::Create(Exit, ScalarExit);
+  Body->getTerminator()->replaceUsesOfWith(Exit, ScalarExit);
+  for (BasicBlock::iterator I = Exit->begin(); isa<PHINode>(I); ++I) {
+    PHINode *PN = cast<PHINode>(I);
+    int Idx = PN->getBasicBlockIndex(Body);
+    Value *V = PN->getIncomingValue(Idx);
+    Instruction *Inst = dyn_cast<Instruction>(V);
+    if (Inst && CurLoop->contains(Inst)) {
+      PHINode *LCSSA = PHINode::Create(Inst->getType(),
+                                       Inst->getName() + ".lcssa",
+                                       ScalarExit->getTerminator());
+      LCSSA->addIncoming(Inst, Body);
+      V = LCSSA;
+    }
+    PN->setIncomingValue(Idx, V);
+    PN->setIncomingBlock(Idx, ScalarExit);
+  }
+
+  // Resume the scalar loop where the vector loop left off, or from the start
+  // if the vector loop was bypassed.
+  for (BasicBlock::iterator I = Body->begin(); isa<PHINode>(I); ++I) {
+    PHINode *PN = cast<PHINode>(I);
+    int Idx = PN->getBasicBlockIndex(Preheader);
+    Value *Start = PN->getIncomingValue(Idx);
+    PHINode *Resume = PHINode::Create(PN->getType(), PN->getName() + ".resume",
+                                      ScalarPH->getTerminator());
+    Resume->addIncoming(Start, Preheader);
+    if (CheckBB)
+      Resume->addIncoming(Start, CheckBB);
+    Resume->addIncoming(ResumeValues[PN], Middle);
+    PN->setIncomingValue(Idx, Resume);
+    PN->setIncomingBlock(Idx, ScalarPH);
+  }
+
+  // Update the dominator tree.
+  if (CheckBB)
+    DT->addNewBlock(CheckBB, Preheader);
+  DT->addNewBlock(VecPH, CheckBB ? CheckBB : Preheader);
+  DT->addNewBlock(VecBody, VecPH);
+  DT->addNewBlock(Middle, VecBody);
+  DT->addNewBlock(ScalarPH, Preheader);
+  DT->changeImmediateDominator(Body, ScalarPH);
+  DT->addNewBlock(ScalarExit, Body);
+  DT->changeImmediateDominator(Exit, Preheader);
+
+  // Update loop info: the vector body is a new loop next to the scalar one.
+  if (ParentLoop) {
+    if (CheckBB)
+      ParentLoop->addBasicBlockToLoop(CheckBB, LI->getBase());
+    ParentLoop->addBasicBlockToLoop(VecPH, LI->getBase());
+    ParentLoop->addBasicBlockToLoop(Middle, LI->getBase());
+    ParentLoop->addBasicBlockToLoop(ScalarPH, LI->getBase());
+    ParentLoop->addBasicBlockToLoop(ScalarExit, LI->getBase());
+  }
+  Loop *VecLoop = new Loop();
+  LPM.insertLoop(VecLoop, ParentLoop);
+  VecLoop->addBasicBlockToLoop(VecBody, LI->getBase());
+
+  SE->forgetLoop(CurLoop);
+}
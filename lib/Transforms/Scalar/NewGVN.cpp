@@ -0,0 +1,859 @@
+//===- NewGVN.cpp - Partition-based global value numbering ----------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This pass is an alternative to GVN whose compile time stays close to linear
+// on large functions.  Rather than interleaving value numbering with a memory
+// dependence query per load, it works on the whole function in three phases:
+//
+//  1. A memory SSA form is built once.  Every instruction that may write
+//     memory is a memory def, every block with several predecessors starts
+//     with a memory phi, and every load records the memory state it reads.
+//  2. Values are partitioned into congruence classes with the optimistic
+//     reverse post-order algorithm of Simpson.  A load is numbered by its
+//     pointer and by the nearest memory def that may clobber it, found by
+//     walking the memory SSA form with a bounded number of alias queries, so
+//     loads across code that does not touch their memory are congruent.
+//  3. Each value is replaced by a dominating member of its class.  Then the
+//     expressions and loads that are still partially redundant at a join are
+//     phi-translated into each predecessor; if only one predecessor lacks the
+//     value, a copy is inserted there and the original is replaced by a phi.
+//
+// The number of iterations of phase 2 is capped by -newgvn-max-iterations
+// (default 20); a function whose classes still change after that many is
+// left unchanged.  Phase 3 never splits critical edges, so the CFG is
+// preserved.
+//
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "newgvn"
+#include "llvm/Transforms/Scalar.h"
+#include "llvm/Constants.h"
+#include "llvm/Instructions.h"
+#include "llvm/IntrinsicInst.h"
+#include "llvm/Pass.h"
+#include "llvm/Analysis/AliasAnalysis.h"
+#include "llvm/Analysis/ConstantFolding.h"
+#include "llvm/Analysis/Dominators.h"
+#include "llvm/Analysis/InstructionSimplify.h"
+#include "llvm/Target/TargetData.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/PostOrderIterator.h"
+#include "llvm/ADT/ScopedHashTable.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Support/CFG.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+using namespace llvm;
+
+STATISTIC(NumGVNInstr,  "Number of instructions deleted");
+STATISTIC(NumGVNLoad,   "Number of loads deleted");
+STATISTIC(NumGVNPRE,    "Number of instructions PRE'd");
+STATISTIC(NumPRELoad,   "Number of loads PRE'd");
+
+static cl::opt<bool>
+EnablePRE("newgvn-pre", cl::init(true), cl::Hidden,
+          cl::desc("Eliminate partial redundancies in NewGVN"));
+
+static cl::opt<unsigned>
+MaxIterations("newgvn-max-iterations", cl::init(20), cl::Hidden,
+              cl::desc("The maximum number of value numbering iterations "
+                       "before NewGVN gives up on a function"));
+
+static cl::opt<unsigned>
+WalkLimit("newgvn-walk-limit", cl::init(100), cl::Hidden,
+          cl::desc("The maximum number of memory defs a load looks past"));
+
+namespace {
+  /// MemoryAccess - A node of the memory SSA form: the state of memory on
+  /// entry to the function, after an instruction that may write memory, or
+  /// at the start of a block where several states merge.
+  struct MemoryAccess {
+    enum AccessKind { LiveOnEntry, Def, Phi };
+    AccessKind Kind;
+    Instruction *Inst;          // The writing instruction of a Def.
+    BasicBlock *BB;             // The block of a Phi.
+    MemoryAccess *Defining;     // The state a Def is applied to.
+
+    // The incoming states of a Phi and the predecessors they come from.
+    SmallVector<MemoryAccess*, 4> Incoming;
+    SmallVector<BasicBlock*, 4> IncomingBlocks;
+
+    explicit MemoryAccess(AccessKind K)
+      : Kind(K), Inst(0), BB(0), Defining(0) {}
+
+    MemoryAccess *getIncomingFor(BasicBlock *Pred) const {
+      for (unsigned i = 0, e = IncomingBlocks.size(); i != e; ++i)
+        if (IncomingBlocks[i] == Pred)
+          return Incoming[i];
+      return 0;
+    }
+  };
+
+  /// Expression - An operator applied to the class leaders of its operands.
+  /// Loads also record the memory state they read, and phis their block.
+  struct Expression {
+    uint32_t Opcode;
+    const Type *Ty;
+    const void *Extra;
+    SmallVector<Value*, 4> Ops;
+
+    Expression(uint32_t o = ~2U) : Opcode(o), Ty(0), Extra(0) {}
+
+    bool operator==(const Expression &Other) const {
+      if (Opcode != Other.Opcode)
+        return false;
+      if (Opcode == ~0U || Opcode == ~1U)
+        return true;
+      return Ty == Other.Ty && Extra == Other.Extra && Ops == Other.Ops;
+    }
+  };
+}
+
+namespace llvm {
+template <> struct DenseMapInfo<Expression> {
+  static inline Expression getEmptyKey() { return ~0U; }
+  static inline Expression getTombstoneKey() { return ~1U; }
+
+  static unsigned getHashValue(const Expression &E) {
+    unsigned Hash = E.Opcode;
+    Hash = Hash * 37 + DenseMapInfo<const Type*>::getHashValue(E.Ty);
+    Hash = Hash * 37 + DenseMapInfo<const void*>::getHashValue(E.Extra);
+    for (unsigned i = 0, e = E.Ops.size(); i != e; ++i)
+      Hash = Hash * 37 + DenseMapInfo<Value*>::getHashValue(E.Ops[i]);
+    return Hash;
+  }
+  static bool isEqual(const Expression &LHS, const Expression &RHS) {
+    return LHS == RHS;
+  }
+};
+}
+
+namespace {
+  class NewGVN : public FunctionPass {
+    DominatorTree *DT;
+    AliasAnalysis *AA;
+    const TargetData *TD;
+
+    // The memory SSA form.  UseAccess maps each load to the state it reads.
+    std::vector<MemoryAccess*> Accesses;
+    DenseMap<BasicBlock*, MemoryAccess*> PhiAccess;
+    DenseMap<Instruction*, MemoryAccess*> UseAccess;
+
+    // Reachable blocks in reverse post-order.
+    std::vector<BasicBlock*> RPO;
+
+    // Leader - The congruence class of each instruction, represented by its
+    // leader: the first member in reverse post-order, or a constant or
+    // argument.  A missing entry means the optimistic "not yet known".
+    DenseMap<Value*, Value*> Leader;
+
+    // MemLeader - The class of each memory phi, represented by the def or
+    // phi it is congruent to.
+    DenseMap<MemoryAccess*, MemoryAccess*> MemLeader;
+
+    // ExpressionTable - The class leader of each expression seen in the last
+    // value numbering iteration.
+    DenseMap<Expression, Value*> ExpressionTable;
+
+    // Members - The instructions of each class that survived elimination.
+    DenseMap<Value*, SmallVector<Instruction*, 2> > Members;
+
+    // Available - The members of each class available in the dominator tree
+    // scope being eliminated.
+    typedef ScopedHashTable<Value*, Instruction*> AvailableTy;
+    AvailableTy *Available;
+
+    SmallVector<Instruction*, 32> Dead;
+    SmallPtrSet<Instruction*, 32> DeadSet;
+
+  public:
+    static char ID; // Pass identification, replacement for typeid
+    NewGVN() : FunctionPass(ID) {
+      initializeNewGVNPass(*PassRegistry::getPassRegistry());
+    }
+
+    bool runOnFunction(Function &F);
+
+    virtual void getAnalysisUsage(AnalysisUsage &AU) const {
+      AU.setPreservesCFG();
+      AU.addRequired<DominatorTree>();
+      AU.addRequired<AliasAnalysis>();
+      AU.addPreserved<DominatorTree>();
+      AU.addPreserved<AliasAnalysis>();
+    }
+
+  private:
+    void buildMemorySSA(Function &F);
+    MemoryAccess *createAccess(MemoryAccess::AccessKind K) {
+      Accesses.push_back(new MemoryAccess(K));
+      return Accesses.back();
+    }
+    MemoryAccess *getMemoryLeader(MemoryAccess *MA) const {
+      if (MA->Kind != MemoryAccess::Phi)
+        return MA;
+      MemoryAccess *L = MemLeader.lookup(MA);
+      return L ? L : MA;
+    }
+    MemoryAccess *findClobber(MemoryAccess *MA,
+                              const AliasAnalysis::Location &Loc);
+    MemoryAccess *findClobber(MemoryAccess *MA,
+                              const AliasAnalysis::Location &Loc,
+                              SmallPtrSet<MemoryAccess*, 8> &Visited,
+                              unsigned &Budget);
+
+    Value *getLeader(Value *V) const {
+      if (!isa<Instruction>(V))
+        return V;
+      return Leader.lookup(V);
+    }
+    bool valueNumber();
+    Value *numberPHI(PHINode *PN);
+    Value *numberInstruction(Instruction *I);
+    Value *numberLoad(LoadInst *LI, MemoryAccess *MA, Value *Ptr,
+                      Expression &E);
+    bool isNumbered(Instruction *I) const;
+    void createExpression(Instruction *I, Expression &E);
+    Value *foldExpression(Instruction *I, const Expression &E);
+    Value *lookupOrAdd(const Expression &E, Instruction *I) {
+      Value *&L = ExpressionTable[E];
+      if (!L) L = I;
+      return L;
+    }
+
+    bool eliminate(DomTreeNode *Node);
+    bool performPRE();
+    bool performPREOn(Instruction *I, bool Anticipated);
+    Value *findAvailableIn(Instruction *I, BasicBlock *Pred,
+                           SmallVectorImpl<Value*> &TransOps);
+    Instruction *findMemberIn(Value *L, BasicBlock *BB) const;
+
+    void cleanup();
+  };
+}
+
+char NewGVN::ID = 0;
+INITIALIZE_PASS_BEGIN(NewGVN, "newgvn", "Partition-based Global Value Numbering",
+                      false, false)
+INITIALIZE_PASS_DEPENDENCY(DominatorTree)
+INITIALIZE_AG_DEPENDENCY(AliasAnalysis)
+INITIALIZE_PASS_END(NewGVN, "newgvn", "Partition-based Global Value Numbering",
+                    false, false)
+
+FunctionPass *llvm::createNewGVNPass() { return new NewGVN(); }
+
+//===----------------------------------------------------------------------===//
+//                              Memory SSA
+//===----------------------------------------------------------------------===//
+
+/// buildMemorySSA - Create the memory accesses of all reachable blocks.  A
+/// block with a single predecessor inherits its state, which is known because
+/// that predecessor dominates it and so comes first in reverse post-order.
+void NewGVN::buildMemorySSA(Function &F) {
+  DenseMap<BasicBlock*, MemoryAccess*> ExitState;
+  MemoryAccess *LiveOnEntry = createAccess(MemoryAccess::LiveOnEntry);
+
+  for (unsigned i = 0, e = RPO.size(); i != e; ++i) {
+    BasicBlock *BB = RPO[i];
+    MemoryAccess *Cur;
+    if (BB == &F.getEntryBlock()) {
+      Cur = LiveOnEntry;
+    } else if (BasicBlock *Pred = BB->getSinglePredecessor()) {
+      Cur = ExitState[Pred];
+    } else {
+      Cur = createAccess(MemoryAccess::Phi);
+      Cur->BB = BB;
+      PhiAccess[BB] = Cur;
+    }
+
+    for (BasicBlock::iterator I = BB->begin(), E = BB->end(); I != E; ++I) {
+      if (I->mayWriteToMemory()) {
+        MemoryAccess *D = createAccess(MemoryAccess::Def);
+        D->Inst = I;
+        D->Defining = Cur;
+        Cur = D;
+      } else if (isa<LoadInst>(I)) {
+        UseAccess[I] = Cur;
+      }
+    }
+    ExitState[BB] = Cur;
+  }
+
+  // Now that every block has an exit state, fill in the phis.  Unreachable
+  // predecessors contribute nothing.
+  for (DenseMap<BasicBlock*, MemoryAccess*>::iterator I = PhiAccess.begin(),
+       E = PhiAccess.end(); I != E; ++I) {
+    MemoryAccess *Phi = I->second;
+    for (pred_iterator PI = pred_begin(I->first), PE = pred_end(I->first);
+         PI != PE; ++PI) {
+      DenseMap<BasicBlock*, MemoryAccess*>::iterator S = ExitState.find(*PI);
+      if (S == ExitState.end())
+        continue;
+      Phi->Incoming.push_back(S->second);
+      Phi->IncomingBlocks.push_back(*PI);
+    }
+  }
+}
+
+/// findClobber - Walk up from MA to the nearest access that may modify Loc.
+/// At a memory phi of its own class, each incoming path is walked in turn;
+/// if they all reach the same clobber, so does the phi.  Paths that come back
+/// to a phi already being walked carry no information and are ignored.  Null
+/// is returned when every path does so.
+MemoryAccess *NewGVN::findClobber(MemoryAccess *MA,
+                                  const AliasAnalysis::Location &Loc,
+                                  SmallPtrSet<MemoryAccess*, 8> &Visited,
+                                  unsigned &Budget) {
+  while (Budget) {
+    --Budget;
+    if (MA->Kind == MemoryAccess::Def) {
+      if (AA->getModRefInfo(MA->Inst, Loc) & AliasAnalysis::Mod)
+        return MA;
+      MA = MA->Defining;
+      continue;
+    }
+    if (MA->Kind != MemoryAccess::Phi)
+      return MA;
+    MemoryAccess *L = getMemoryLeader(MA);
+    if (L != MA) {
+      MA = L;
+      continue;
+    }
+    if (!Visited.insert(MA))
+      return 0;
+
+    MemoryAccess *Same = 0;
+    for (unsigned i = 0, e = MA->Incoming.size(); i != e; ++i) {
+      MemoryAccess *C = findClobber(MA->Incoming[i], Loc, Visited, Budget);
+      if (!C)
+        continue;
+      if (Same && Same != C)
+        return MA;
+      Same = C;
+    }
+    return Same;
+  }
+  return MA;
+}
+
+MemoryAccess *NewGVN::findClobber(MemoryAccess *MA,
+                                  const AliasAnalysis::Location &Loc) {
+  SmallPtrSet<MemoryAccess*, 8> Visited;
+  unsigned Budget = WalkLimit;
+  MemoryAccess *C = findClobber(MA, Loc, Visited, Budget);
+  return C ? C : MA;
+}
+
+//===----------------------------------------------------------------------===//
+//                           Value Numbering
+//===----------------------------------------------------------------------===//
+
+/// isNumbered - Return true if I is numbered by the expression it computes,
+/// rather than being a class of its own.
+bool NewGVN::isNumbered(Instruction *I) const {
+  if (isa<BinaryOperator>(I) || isa<CmpInst>(I) || isa<CastInst>(I) ||
+      isa<GetElementPtrInst>(I) || isa<SelectInst>(I) ||
+      isa<ExtractElementInst>(I) || isa<InsertElementInst>(I) ||
+      isa<ShuffleVectorInst>(I))
+    return true;
+  if (LoadInst *LI = dyn_cast<LoadInst>(I))
+    return !LI->isVolatile();
+  if (CallInst *CI = dyn_cast<CallInst>(I))
+    return !CI->getType()->isVoidTy() && AA->doesNotAccessMemory(CI);
+  return false;
+}
+
+/// createExpression - Fill in the opcode and type of I, and put its commutative
+/// operands and compare predicates in a canonical form.  E.Ops must already
+/// hold the operand leaders.
+void NewGVN::createExpression(Instruction *I, Expression &E) {
+  E.Opcode = I->getOpcode();
+  E.Ty = I->getType();
+  if (I->isCommutative() && E.Ops[0] > E.Ops[1])
+    std::swap(E.Ops[0], E.Ops[1]);
+  if (CmpInst *C = dyn_cast<CmpInst>(I)) {
+    CmpInst::Predicate Pred = C->getPredicate();
+    if (E.Ops[0] > E.Ops[1]) {
+      std::swap(E.Ops[0], E.Ops[1]);
+      Pred = CmpInst::getSwappedPredicate(Pred);
+    }
+    E.Opcode = (C->getOpcode() << 8) | Pred;
+  }
+}
+
+/// foldExpression - If all operands of E are constants, try to fold it.
+Value *NewGVN::foldExpression(Instruction *I, const Expression &E) {
+  SmallVector<Constant*, 4> Ops;
+  for (unsigned i = 0, e = E.Ops.size(); i != e; ++i) {
+    Constant *C = dyn_cast<Constant>(E.Ops[i]);
+    if (!C) return 0;
+    Ops.push_back(C);
+  }
+  if (isa<LoadInst>(I))
+    return ConstantFoldLoadFromConstPtr(Ops[0], TD);
+  if (isa<CmpInst>(I))
+    return ConstantFoldCompareInstOperands(E.Opcode & 0xff, Ops[0], Ops[1], TD);
+  if (isa<CallInst>(I))
+    return 0;
+  return ConstantFoldInstOperands(I->getOpcode(), I->getType(),
+                                  Ops.data(), Ops.size(), TD);
+}
+
+/// numberLoad - Number a load of Ptr that reads memory state MA.  A load of
+/// what a store to the same pointer just wrote is congruent to the stored
+/// value.
+Value *NewGVN::numberLoad(LoadInst *LI, MemoryAccess *MA, Value *Ptr,
+                          Expression &E) {
+  AliasAnalysis::Location Loc = AA->getLocation(LI);
+  Loc.Ptr = Ptr;
+  MemoryAccess *Clobber = findClobber(MA, Loc);
+  Value *PtrLeader = getLeader(Ptr);
+  if (Clobber->Kind == MemoryAccess::Def)
+    if (StoreInst *SI = dyn_cast<StoreInst>(Clobber->Inst))
+      if (SI->getValueOperand()->getType() == LI->getType() &&
+          getLeader(SI->getPointerOperand()) == PtrLeader)
+        return SI->getValueOperand();
+
+  E.Ops.push_back(PtrLeader);
+  createExpression(LI, E);
+  E.Extra = getMemoryLeader(Clobber);
+  return 0;
+}
+
+/// numberPHI - A phi whose known incoming values all are in one class joins
+/// that class.  Values that are not known yet are optimistically ignored, as
+/// are undefined ones.
+Value *NewGVN::numberPHI(PHINode *PN) {
+  Expression E;
+  Value *Same = 0;
+  bool AllSame = true, SawUndef = false;
+  for (unsigned i = 0, e = PN->getNumIncomingValues(); i != e; ++i) {
+    if (!DT->isReachableFromEntry(PN->getIncomingBlock(i)))
+      continue;
+    Value *V = getLeader(PN->getIncomingValue(i));
+    E.Ops.push_back(V);
+    if (!V)
+      continue;
+    if (isa<UndefValue>(V)) {
+      SawUndef = true;
+      continue;
+    }
+    if (!Same)
+      Same = V;
+    else if (Same != V)
+      AllSame = false;
+  }
+  if (AllSame && Same)
+    return Same;
+  if (AllSame && SawUndef)
+    return UndefValue::get(PN->getType());
+  if (AllSame)
+    return PN;
+
+  E.Opcode = PN->getOpcode();
+  E.Ty = PN->getType();
+  E.Extra = PN->getParent();
+  return lookupOrAdd(E, PN);
+}
+
+Value *NewGVN::numberInstruction(Instruction *I) {
+  if (PHINode *PN = dyn_cast<PHINode>(I))
+    return numberPHI(PN);
+  if (!isNumbered(I))
+    return I;
+
+  if (Value *V = SimplifyInstruction(I, TD, DT))
+    if (Value *L = getLeader(V))
+      return L;
+
+  Expression E;
+  if (LoadInst *LI = dyn_cast<LoadInst>(I)) {
+    if (Value *V = numberLoad(LI, UseAccess[LI], LI->getPointerOperand(), E))
+      return getLeader(V) ? getLeader(V) : I;
+  } else {
+    for (User::op_iterator OI = I->op_begin(), OE = I->op_end(); OI != OE;
+         ++OI) {
+      Value *L = getLeader(*OI);
+      if (!L) return I;
+      E.Ops.push_back(L);
+    }
+    createExpression(I, E);
+  }
+
+  if (Value *C = foldExpression(I, E))
+    return C;
+  return lookupOrAdd(E, I);
+}
+
+/// valueNumber - Iterate over the function in reverse post-order until the
+/// classes do not change.  Return false if that takes too many iterations.
+bool NewGVN::valueNumber() {
+  for (unsigned Iteration = 0; Iteration != MaxIterations; ++Iteration) {
+    bool Changed = false;
+    ExpressionTable.clear();
+
+    for (unsigned i = 0, e = RPO.size(); i != e; ++i) {
+      BasicBlock *BB = RPO[i];
+
+      if (MemoryAccess *Phi = PhiAccess.lookup(BB)) {
+        MemoryAccess *Same = 0;
+        bool AllSame = true;
+        for (unsigned j = 0, je = Phi->Incoming.size(); j != je; ++j) {
+          MemoryAccess *In = Phi->Incoming[j];
+          if (In->Kind == MemoryAccess::Phi) {
+            In = MemLeader.lookup(In);
+            if (!In) continue;
+          }
+          if (!Same)
+            Same = In;
+          else if (Same != In)
+            AllSame = false;
+        }
+        MemoryAccess *L = (AllSame && Same) ? Same : Phi;
+        MemoryAccess *&Old = MemLeader[Phi];
+        if (Old != L) {
+          Old = L;
+          Changed = true;
+        }
+      }
+
+      for (BasicBlock::iterator I = BB->begin(), E = BB->end(); I != E; ++I) {
+        if (I->getType()->isVoidTy())
+          continue;
+        Value *V = numberInstruction(I);
+        Value *&Old = Leader[I];
+        if (Old != V) {
+          Old = V;
+          Changed = true;
+        }
+      }
+    }
+
+    if (!Changed) {
+      DEBUG(dbgs() << "NewGVN: converged after " << Iteration + 1
+                   << " iterations\n");
+      return true;
+    }
+  }
+  DEBUG(dbgs() << "NewGVN: no fixed point after " << MaxIterations
+               << " iterations\n");
+  return false;
+}
+
+//===----------------------------------------------------------------------===//
+//                             Elimination
+//===----------------------------------------------------------------------===//
+
+/// eliminate - Walk the dominator tree, replacing each value by a member of its
+/// class that dominates it, or by the constant or argument leading it.
+bool NewGVN::eliminate(DomTreeNode *Node) {
+  AvailableTy::ScopeTy Scope(*Available);
+  bool Changed = false;
+
+  BasicBlock *BB = Node->getBlock();
+  for (BasicBlock::iterator BI = BB->begin(), BE = BB->end(); BI != BE; ) {
+    Instruction *I = BI++;
+    Value *L = Leader.lookup(I);
+    // The result of an invoke is not available on its unwind edge, so it
+    // cannot stand for the rest of its class.
+    if (!L || isa<InvokeInst>(I))
+      continue;
+
+    Value *Repl = 0;
+    if (!isa<Instruction>(L))
+      Repl = L;
+    else if (L != I)
+      Repl = Available->lookup(L);
+
+    if (!Repl || Repl == I) {
+      Available->insert(L, I);
+      Members[L].push_back(I);
+      continue;
+    }
+
+    DEBUG(dbgs() << "NewGVN removed: " << *I << '\n');
+    I->replaceAllUsesWith(Repl);
+    if (isa<LoadInst>(I))
+      ++NumGVNLoad;
+    else
+      ++NumGVNInstr;
+    Dead.push_back(I);
+    DeadSet.insert(I);
+    Changed = true;
+  }
+
+  for (DomTreeNode::iterator I = Node->begin(), E = Node->end(); I != E; ++I)
+    Changed |= eliminate(*I);
+  return Changed;
+}
+
+//===----------------------------------------------------------------------===//
+//                    Partial Redundancy Elimination
+//===----------------------------------------------------------------------===//
+
+/// findMemberIn - Return a member of class L that is available at the end of
+/// BB, if any.
+Instruction *NewGVN::findMemberIn(Value *L, BasicBlock *BB) const {
+  DenseMap<Value*, SmallVector<Instruction*, 2> >::const_iterator It =
+    Members.find(L);
+  if (It == Members.end())
+    return 0;
+  const SmallVector<Instruction*, 2> &M = It->second;
+  for (unsigned i = 0, e = M.size(); i != e; ++i)
+    if (DT->dominates(M[i]->getParent(), BB))
+      return M[i];
+  return 0;
+}
+
+/// findAvailableIn - Translate I, which lives in a block with predecessor
+/// Pred, through the phis of its block and return a value computing it that is
+/// available at the end of Pred.  TransOps is set to the translated operands,
+/// or cleared if I cannot be computed at the end of Pred.
+Value *NewGVN::findAvailableIn(Instruction *I, BasicBlock *Pred,
+                               SmallVectorImpl<Value*> &TransOps) {
+  BasicBlock *BB = I->getParent();
+  TransOps.clear();
+  Expression E;
+  for (User::op_iterator OI = I->op_begin(), OE = I->op_end(); OI != OE;
+       ++OI) {
+    Value *Op = *OI;
+    if (PHINode *PN = dyn_cast<PHINode>(Op)) {
+      if (PN->getParent() == BB)
+        Op = PN->getIncomingValueForBlock(Pred);
+    } else if (Instruction *OpI = dyn_cast<Instruction>(Op)) {
+      if (OpI->getParent() == BB) {
+        TransOps.clear();
+        return 0;
+      }
+    }
+    Value *L = getLeader(Op);
+    if (!L) {
+      TransOps.clear();
+      return 0;
+    }
+    TransOps.push_back(Op);
+    E.Ops.push_back(L);
+  }
+
+  if (LoadInst *LI = dyn_cast<LoadInst>(I)) {
+    // Translate the memory state through the phi of BB, looking past the
+    // writes in BB before the load that do not touch the translated pointer.
+    AliasAnalysis::Location Loc = AA->getLocation(LI);
+    Loc.Ptr = TransOps[0];
+    MemoryAccess *MA = findClobber(UseAccess[LI], Loc);
+    if (MA == PhiAccess.lookup(BB))
+      MA = MA->getIncomingFor(Pred);
+    else if (MA->Kind == MemoryAccess::Def && MA->Inst->getParent() == BB)
+      MA = 0;
+    if (!MA) {
+      TransOps.clear();
+      return 0;
+    }
+
+    E.Ops.clear();
+    if (Value *V = numberLoad(LI, MA, TransOps[0], E))
+      return V;
+  } else {
+    createExpression(I, E);
+  }
+
+  if (Value *C = foldExpression(I, E))
+    return C;
+
+  DenseMap<Expression, Value*>::iterator It = ExpressionTable.find(E);
+  if (It == ExpressionTable.end())
+    return 0;
+  if (!isa<Instruction>(It->second))
+    return It->second;
+  return findMemberIn(It->second, Pred);
+}
+
+/// performPREOn - If I is available in all predecessors of its block but one,
+/// and can be computed at the end of that one, insert it there and replace I
+/// with a phi.  Anticipated is true if I is executed whenever its block is
+/// entered.
+bool NewGVN::performPREOn(Instruction *I, bool Anticipated) {
+  if (!isNumbered(I) || isa<CallInst>(I) || DeadSet.count(I))
+    return false;
+  Value *L = Leader.lookup(I);
+  if (!L || !isa<Instruction>(L))
+    return false;
+
+  BasicBlock *BB = I->getParent();
+  DenseMap<BasicBlock*, Value*> Avail;
+  SmallVector<Value*, 4> TransOps, UnavailOps;
+  BasicBlock *Unavail = 0;
+  unsigned NumPreds = 0;
+  for (pred_iterator PI = pred_begin(BB), PE = pred_end(BB); PI != PE; ++PI) {
+    BasicBlock *Pred = *PI;
+    ++NumPreds;
+    if (Avail.count(Pred) || Pred == Unavail)
+      continue;
+    if (Value *V = findAvailableIn(I, Pred, TransOps)) {
+      Avail[Pred] = V;
+      continue;
+    }
+    // Only one predecessor may need a new computation, and it must not be
+    // on a critical edge.
+    if (Unavail || Pred == BB || Pred->getTerminator()->getNumSuccessors() != 1)
+      return false;
+    Unavail = Pred;
+    UnavailOps = TransOps;
+  }
+  if (NumPreds < 2 || Avail.empty())
+    return false;
+
+  if (Unavail) {
+    // Every operand must be computable at the end of Unavail, and I must be
+    // executed whenever BB is entered, so that the new computation cannot
+    // trap where the program would not.
+    if (UnavailOps.size() != I->getNumOperands() || !Anticipated)
+      return false;
+    Instruction *PREInstr = I->clone();
+    for (unsigned i = 0, e = UnavailOps.size(); i != e; ++i)
+      PREInstr->setOperand(i, UnavailOps[i]);
+    PREInstr->insertBefore(Unavail->getTerminator());
+    PREInstr->setName(I->getName() + ".pre");
+    Leader[PREInstr] = PREInstr;
+    Avail[Unavail] = PREInstr;
+    if (isa<LoadInst>(I))
+      ++NumPRELoad;
+    else
+      ++NumGVNPRE;
+  }
+
+  // If every predecessor provides the same value, apart from I itself along a
+  // back edge, no phi is needed: I was invariant in a loop.
+  {
+    Value *Same = 0;
+    for (DenseMap<BasicBlock*, Value*>::iterator AI = Avail.begin(),
+         AE = Avail.end(); AI != AE; ++AI) {
+      if (AI->second == I)
+        continue;
+      if (Same && Same != AI->second) {
+        Same = 0;
+        break;
+      }
+      Same = AI->second;
+    }
+    Instruction *SameInst = dyn_cast_or_null<Instruction>(Same);
+    if (Same && (!SameInst || DT->dominates(SameInst, I))) {
+      DEBUG(dbgs() << "NewGVN PRE removed: " << *I << '\n');
+      I->replaceAllUsesWith(Same);
+      SmallVector<Instruction*, 2> &M = Members[L];
+      M.erase(std::remove(M.begin(), M.end(), I), M.end());
+      Dead.push_back(I);
+      DeadSet.insert(I);
+      if (!Unavail && isa<LoadInst>(I))
+        ++NumGVNLoad;
+      else if (!Unavail)
+        ++NumGVNInstr;
+      return true;
+    }
+  }
+
+  PHINode *Phi = PHINode::Create(I->getType(), I->getName() + ".pre-phi",
+                                 BB->begin());
+  Phi->reserveOperandSpace(NumPreds);
+  for (pred_iterator PI = pred_begin(BB), PE = pred_end(BB); PI != PE; ++PI) {
+    Value *V = Avail[*PI];
+    Phi->addIncoming(V == I ? Phi : V, *PI);
+  }
+
+  DEBUG(dbgs() << "NewGVN PRE removed: " << *I << '\n');
+  I->replaceAllUsesWith(Phi);
+  Leader[Phi] = L;
+  SmallVector<Instruction*, 2> &M = Members[L];
+  std::replace(M.begin(), M.end(), I, static_cast<Instruction*>(Phi));
+  Dead.push_back(I);
+  DeadSet.insert(I);
+  return true;
+}
+
+/// performPRE - Look for partially redundant values in blocks with several
+/// predecessors, all of them reachable.
+bool NewGVN::performPRE() {
+  bool Changed = false;
+  for (unsigned i = 0, e = RPO.size(); i != e; ++i) {
+    BasicBlock *BB = RPO[i];
+    if (BB->getSinglePredecessor() || pred_begin(BB) == pred_end(BB))
+      continue;
+    bool AllReachable = true;
+    for (pred_iterator PI = pred_begin(BB), PE = pred_end(BB); PI != PE; ++PI)
+      if (!DT->isReachableFromEntry(*PI) ||
+          isa<IndirectBrInst>((*PI)->getTerminator()))
+        AllReachable = false;
+    if (!AllReachable)
+      continue;
+
+    // Once an instruction that may not return has been seen, the rest of the
+    // block is not anticipated on entry.
+    bool Anticipated = true;
+    for (BasicBlock::iterator BI = BB->getFirstNonPHI(), BE = BB->end();
+         BI != BE; ) {
+      Instruction *I = BI++;
+      if (isa<TerminatorInst>(I))
+        break;
+      Changed |= performPREOn(I, Anticipated);
+      if (isa<CallInst>(I) && !isa<DbgInfoIntrinsic>(I))
+        Anticipated = false;
+    }
+  }
+  return Changed;
+}
+
+//===----------------------------------------------------------------------===//
+//                                Driver
+//===----------------------------------------------------------------------===//
+
+void NewGVN::cleanup() {
+  for (unsigned i = 0, e = Accesses.size(); i != e; ++i)
+    delete Accesses[i];
+  Accesses.clear();
+  PhiAccess.clear();
+  UseAccess.clear();
+  RPO.clear();
+  Leader.clear();
+  MemLeader.clear();
+  ExpressionTable.clear();
+  Members.clear();
+  Dead.clear();
+  DeadSet.clear();
+}
+
+bool NewGVN::runOnFunction(Function &F) {
+  DT = &getAnalysis<DominatorTree>();
+  AA = &getAnalysis<AliasAnalysis>();
+  TD = getAnalysisIfAvailable<TargetData>();
+
+  ReversePostOrderTraversal<Function*> RPOT(&F);
+  RPO.assign(RPOT.begin(), RPOT.end());
+
+  buildMemorySSA(F);
+  if (!valueNumber()) {
+    cleanup();
+    return false;
+  }
+
+  AvailableTy AvailableTable;
+  Available = &AvailableTable;
+  bool Changed = eliminate(DT->getRootNode());
+  if (EnablePRE)
+    Changed |= performPRE();
+
+  for (unsigned i = 0, e = Dead.size(); i != e; ++i) {
+    AA->deleteValue(Dead[i]);
+    Dead[i]->eraseFromParent();
+  }
+
+  cleanup();
+  return Changed;
+}
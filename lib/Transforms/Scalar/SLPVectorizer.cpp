@@ -0,0 +1,622 @@
+//===- SLPVectorizer.cpp - Vectorize straight-line code -------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This pass implements a superword-level-parallelism (SLP) vectorizer for basic
+// blocks.  It looks for chains of stores to consecutive addresses, such as:
+//
+//   A[0] = B[0] + C[0];
+//   A[1] = B[1] + C[1];
+//   A[2] = B[2] + C[2];
+//   A[3] = B[3] + C[3];
+//
+// and builds a tree of isomorphic operations bottom-up from the stored values:
+// each node is a bundle of VF scalars with the same opcode (one per lane) whose
+// operands form the child bundles.  Consecutive loads become vector loads, and
+// bundles that cannot be vectorized become the leaves of the tree, which are
+// gathered with insertelement.  The tree is replaced by vector code when the
+// cost model, which consults the target when it is available, says the vector
+// form is cheaper.
+//
+// All the vector code is emitted at the position of the last store of the
+// chain, so the loads and stores of the tree are moved.  AliasAnalysis is used
+// to verify that no memory access they are moved across may interfere.
+//
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "slp-vectorizer"
+#include "llvm/Transforms/Scalar.h"
+#include "llvm/Constants.h"
+#include "llvm/DerivedTypes.h"
+#include "llvm/Instructions.h"
+#include "llvm/Pass.h"
+#include "llvm/Analysis/AliasAnalysis.h"
+#include "llvm/Analysis/ScalarEvolution.h"
+#include "llvm/Analysis/ScalarEvolutionExpressions.h"
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/Target/TargetData.h"
+#include "llvm/Target/TargetLowering.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/IRBuilder.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/Statistic.h"
+#include <algorithm>
+using namespace llvm;
+
+STATISTIC(NumVectorized, "Number of store chains vectorized");
+STATISTIC(NumStores,     "Number of scalar stores vectorized");
+
+static cl::opt<unsigned>
+VectorRegisterWidth("slp-vectorize-width", cl::init(128), cl::Hidden,
+  cl::desc("Vector register width in bits to assume when no target "
+           "information is available"));
+
+static cl::opt<unsigned>
+MaxTreeDepth("slp-max-depth", cl::init(12), cl::Hidden,
+  cl::desc("The maximum depth of the trees built by the SLP vectorizer"));
+
+static cl::opt<unsigned>
+MaxStoreBucket("slp-max-store-bucket", cl::init(64), cl::Hidden,
+  cl::desc("The maximum number of stores to one object compared for "
+           "adjacency"));
+
+namespace {
+  /// Bundle - A node of the SLP tree: the scalars computed by the VF lanes.
+  struct Bundle {
+    SmallVector<Value*, 8> Scalars;
+    /// Operands - Indices of the child bundles, one per instruction operand.
+    SmallVector<unsigned, 2> Operands;
+    /// NeedGather - True if this is a leaf built with insertelement.
+    bool NeedGather;
+    Value *VectorValue;
+
+    Bundle() : NeedGather(false), VectorValue(0) {}
+  };
+
+  class SLPVectorizer : public FunctionPass {
+    /// TLI - Keep a pointer of a TargetLowering to consult for the vector
+    /// register width and the cost of vector operations.  This is null when
+    /// no target information is available.
+    const TargetLowering *TLI;
+    const TargetData *TD;
+    AliasAnalysis *AA;
+    ScalarEvolution *SE;
+
+    /// InstOrder - The position of each instruction in the current block.
+    DenseMap<Instruction*, unsigned> InstOrder;
+
+    // The tree being built.
+    SmallVector<Bundle, 16> Tree;
+    /// ScalarToBundle - Map from the vectorized scalars to their bundle.
+    DenseMap<Value*, unsigned> ScalarToBundle;
+    unsigned VF;
+
+  public:
+    static char ID; // Pass identification, replacement for typeid
+    explicit SLPVectorizer(const TargetLowering *tli = 0)
+      : FunctionPass(ID), TLI(tli) {
+      initializeSLPVectorizerPass(*PassRegistry::getPassRegistry());
+    }
+
+    bool runOnFunction(Function &F);
+
+    virtual void getAnalysisUsage(AnalysisUsage &AU) const {
+      AU.setPreservesCFG();
+      AU.addRequired<AliasAnalysis>();
+      AU.addPreserved<AliasAnalysis>();
+      AU.addRequired<ScalarEvolution>();
+    }
+
+  private:
+    bool vectorizeStoreChains(BasicBlock &BB);
+    bool vectorizeStores(const SmallVectorImpl<StoreInst*> &Stores);
+    void numberInstructions(BasicBlock &BB);
+    bool isConsecutiveAccess(Value *A, Value *B);
+
+    unsigned buildTree(const SmallVectorImpl<Value*> &VL, unsigned Depth);
+    unsigned newGather(const SmallVectorImpl<Value*> &VL);
+    int getTreeCost(const SmallVectorImpl<StoreInst*> &Stores);
+    int getOperationCost(unsigned Opcode, const Type *Ty) const;
+    bool canMoveMemoryAccesses(const SmallVectorImpl<StoreInst*> &Stores,
+                               Instruction *InsertPt);
+    Value *vectorizeBundle(unsigned Idx, IRBuilder<> &Builder);
+  };
+}
+
+char SLPVectorizer::ID = 0;
+INITIALIZE_PASS_BEGIN(SLPVectorizer, "slp-vectorizer",
+                      "Vectorize straight-line code", false, false)
+INITIALIZE_PASS_DEPENDENCY(ScalarEvolution)
+INITIALIZE_AG_DEPENDENCY(AliasAnalysis)
+INITIALIZE_PASS_END(SLPVectorizer, "slp-vectorizer",
+                    "Vectorize straight-line code", false, false)
+
+FunctionPass *llvm::createSLPVectorizerPass(const TargetLowering *TLI) {
+  return new SLPVectorizer(TLI);
+}
+
+/// isVectorElementType - Return true if values of type Ty can be packed into
+/// vectors whose memory layout matches an array of Ty.
+static bool isVectorElementType(const Type *Ty) {
+  if (Ty->isFloatTy() || Ty->isDoubleTy())
+    return true;
+  if (const IntegerType *ITy = dyn_cast<IntegerType>(Ty)) {
+    unsigned Bits = ITy->getBitWidth();
+    return Bits == 8 || Bits == 16 || Bits == 32 || Bits == 64;
+  }
+  return false;
+}
+
+bool SLPVectorizer::runOnFunction(Function &F) {
+  TD = getAnalysisIfAvailable<TargetData>();
+  if (TD == 0) return false;
+  AA = &getAnalysis<AliasAnalysis>();
+  SE = &getAnalysis<ScalarEvolution>();
+
+  bool Changed = false;
+  for (Function::iterator BB = F.begin(), E = F.end(); BB != E; ++BB)
+    Changed |= vectorizeStoreChains(*BB);
+  return Changed;
+}
+
+void SLPVectorizer::numberInstructions(BasicBlock &BB) {
+  InstOrder.clear();
+  unsigned N = 0;
+  for (BasicBlock::iterator I = BB.begin(), E = BB.end(); I != E; ++I)
+    InstOrder[I] = N++;
+}
+
+/// isConsecutiveAccess - Return true if the memory accessed by load or store B
+/// immediately follows the memory accessed by A.
+bool SLPVectorizer::isConsecutiveAccess(Value *A, Value *B) {
+  Value *PtrA, *PtrB;
+  if (LoadInst *L = dyn_cast<LoadInst>(A)) {
+    PtrA = L->getPointerOperand();
+    PtrB = cast<LoadInst>(B)->getPointerOperand();
+  } else {
+    PtrA = cast<StoreInst>(A)->getPointerOperand();
+    PtrB = cast<StoreInst>(B)->getPointerOperand();
+  }
+  if (PtrA->getType() != PtrB->getType())
+    return false;
+
+  const Type *Ty = cast<PointerType>(PtrA->getType())->getElementType();
+  const SCEV *Dist = SE->getMinusSCEV(SE->getSCEV(PtrB), SE->getSCEV(PtrA));
+  const SCEVConstant *C = dyn_cast<SCEVConstant>(Dist);
+  return C && C->getValue()->getValue() == TD->getTypeAllocSize(Ty);
+}
+
+/// vectorizeStoreChains - Find chains of stores to consecutive addresses in BB
+/// and try to vectorize them.
+bool SLPVectorizer::vectorizeStoreChains(BasicBlock &BB) {
+  // Bucket the candidate stores by stored type and underlying object; only
+  // stores in the same bucket can be adjacent.  Buckets are kept in the order
+  // of their first store so that the output does not depend on pointer values.
+  typedef std::pair<const Type*, Value*> BucketKey;
+  DenseMap<BucketKey, unsigned> BucketIdx;
+  SmallVector<SmallVector<StoreInst*, 8>, 4> Buckets;
+  for (BasicBlock::iterator I = BB.begin(), E = BB.end(); I != E; ++I) {
+    StoreInst *SI = dyn_cast<StoreInst>(I);
+    if (!SI || SI->isVolatile())
+      continue;
+    const Type *Ty = SI->getValueOperand()->getType();
+    if (!isVectorElementType(Ty))
+      continue;
+    Value *Obj = GetUnderlyingObject(SI->getPointerOperand(), TD);
+    std::pair<DenseMap<BucketKey, unsigned>::iterator, bool> Ins =
+      BucketIdx.insert(std::make_pair(BucketKey(Ty, Obj), Buckets.size()));
+    if (Ins.second)
+      Buckets.push_back(SmallVector<StoreInst*, 8>());
+    SmallVector<StoreInst*, 8> &Bucket = Buckets[Ins.first->second];
+    if (Bucket.size() < MaxStoreBucket)
+      Bucket.push_back(SI);
+  }
+
+  bool Changed = false;
+  SmallPtrSet<StoreInst*, 16> Vectorized;
+  for (unsigned b = 0, be = Buckets.size(); b != be; ++b) {
+    SmallVector<StoreInst*, 8> &Stores = Buckets[b];
+    if (Stores.size() < 2)
+      continue;
+
+    // Link each store to the store writing the memory right after it.
+    DenseMap<StoreInst*, StoreInst*> Next;
+    SmallPtrSet<StoreInst*, 16> HasPrev;
+    for (unsigned i = 0, e = Stores.size(); i != e; ++i)
+      for (unsigned j = 0; j != e; ++j) {
+        if (i == j || HasPrev.count(Stores[j]))
+          continue;
+        if (isConsecutiveAccess(Stores[i], Stores[j])) {
+          Next[Stores[i]] = Stores[j];
+          HasPrev.insert(Stores[j]);
+          break;
+        }
+      }
+
+    const Type *Ty = Stores[0]->getValueOperand()->getType();
+    unsigned RegWidth = TLI ? TLI->getVectorRegisterBitWidth()
+                            : (unsigned)VectorRegisterWidth;
+    unsigned MaxVF = RegWidth / TD->getTypeSizeInBits(Ty);
+
+    for (unsigned i = 0, e = Stores.size(); i != e; ++i) {
+      if (HasPrev.count(Stores[i]) || !Next.count(Stores[i]))
+        continue;
+      SmallVector<StoreInst*, 16> Chain;
+      for (StoreInst *SI = Stores[i]; SI; SI = Next.lookup(SI)) {
+        // Guard against cycles of stores to the same addresses.
+        if (std::find(Chain.begin(), Chain.end(), SI) != Chain.end())
+          break;
+        Chain.push_back(SI);
+      }
+
+      // Try the widest vectors first, sliding over the chain.
+      for (unsigned Factor = MaxVF; Factor >= 2; Factor /= 2) {
+        for (unsigned k = 0; k + Factor <= Chain.size(); ) {
+          SmallVector<StoreInst*, 16> Slice(Chain.begin() + k,
+                                            Chain.begin() + k + Factor);
+          bool Skip = false;
+          for (unsigned s = 0; s != Factor; ++s)
+            Skip |= Vectorized.count(Slice[s]);
+          if (!Skip && vectorizeStores(Slice)) {
+            for (unsigned s = 0; s != Factor; ++s)
+              Vectorized.insert(Slice[s]);
+            Changed = true;
+            k += Factor;
+          } else {
+            ++k;
+          }
+        }
+      }
+    }
+  }
+  return Changed;
+}
+
+/// newGather - Add a leaf bundle whose vector is built lane by lane.
+unsigned SLPVectorizer::newGather(const SmallVectorImpl<Value*> &VL) {
+  Tree.push_back(Bundle());
+  Tree.back().Scalars.append(VL.begin(), VL.end());
+  Tree.back().NeedGather = true;
+  return Tree.size() - 1;
+}
+
+/// buildTree - Build the bundle for the scalars VL and its children, and
+/// return its index in Tree.
+unsigned SLPVectorizer::buildTree(const SmallVectorImpl<Value*> &VL, unsigned Depth) {
+  if (Depth > MaxTreeDepth)
+    return newGather(VL);
+
+  // All lanes must be distinct instructions of the stores' block with the
+  // same opcode, not yet part of the tree.  Values from other blocks are
+  // gathered.
+  Instruction *I0 = dyn_cast<Instruction>(VL[0]);
+  if (!I0 || !isVectorElementType(I0->getType()))
+    return newGather(VL);
+  for (unsigned i = 0; i != VL.size(); ++i) {
+    Instruction *I = dyn_cast<Instruction>(VL[i]);
+    if (!I || !InstOrder.count(I) || I->getOpcode() != I0->getOpcode() ||
+        I->getType() != I0->getType() || ScalarToBundle.count(I))
+      return newGather(VL);
+    for (unsigned j = 0; j != i; ++j)
+      if (VL[j] == I)
+        return newGather(VL);
+  }
+
+  switch (I0->getOpcode()) {
+  case Instruction::Load:
+    // Loads must read consecutive memory in lane order.
+    for (unsigned i = 0; i != VL.size(); ++i) {
+      if (cast<LoadInst>(VL[i])->isVolatile())
+        return newGather(VL);
+      if (i && !isConsecutiveAccess(VL[i-1], VL[i]))
+        return newGather(VL);
+    }
+    break;
+  case Instruction::Trunc:
+  case Instruction::ZExt:
+  case Instruction::SExt:
+  case Instruction::FPToUI:
+  case Instruction::FPToSI:
+  case Instruction::UIToFP:
+  case Instruction::SIToFP:
+  case Instruction::FPTrunc:
+  case Instruction::FPExt:
+  case Instruction::BitCast: {
+    const Type *SrcTy = I0->getOperand(0)->getType();
+    if (!isVectorElementType(SrcTy))
+      return newGather(VL);
+    for (unsigned i = 0; i != VL.size(); ++i)
+      if (cast<Instruction>(VL[i])->getOperand(0)->getType() != SrcTy)
+        return newGather(VL);
+    break;
+  }
+  default:
+    if (!isa<BinaryOperator>(I0))
+      return newGather(VL);
+    break;
+  }
+
+  unsigned Idx = Tree.size();
+  Tree.push_back(Bundle());
+  Tree.back().Scalars.append(VL.begin(), VL.end());
+  for (unsigned i = 0; i != VL.size(); ++i)
+    ScalarToBundle[VL[i]] = Idx;
+
+  if (isa<LoadInst>(I0))
+    return Idx;
+
+  for (unsigned Op = 0, e = I0->getNumOperands(); Op != e; ++Op) {
+    SmallVector<Value*, 8> Operands;
+    for (unsigned i = 0; i != VL.size(); ++i)
+      Operands.push_back(cast<Instruction>(VL[i])->getOperand(Op));
+    unsigned Child = buildTree(Operands, Depth + 1);
+    Tree[Idx].Operands.push_back(Child);
+  }
+  return Idx;
+}
+
+/// getISDOpcode - Return the SelectionDAG node an IR opcode is lowered to.
+static unsigned getISDOpcode(unsigned Opcode) {
+  switch (Opcode) {
+  default: return 0;
+  case Instruction::Add:     return ISD::ADD;
+  case Instruction::FAdd:    return ISD::FADD;
+  case Instruction::Sub:     return ISD::SUB;
+  case Instruction::FSub:    return ISD::FSUB;
+  case Instruction::Mul:     return ISD::MUL;
+  case Instruction::FMul:    return ISD::FMUL;
+  case Instruction::UDiv:    return ISD::UDIV;
+  case Instruction::SDiv:    return ISD::SDIV;
+  case Instruction::FDiv:    return ISD::FDIV;
+  case Instruction::URem:    return ISD::UREM;
+  case Instruction::SRem:    return ISD::SREM;
+  case Instruction::FRem:    return ISD::FREM;
+  case Instruction::Shl:     return ISD::SHL;
+  case Instruction::LShr:    return ISD::SRL;
+  case Instruction::AShr:    return ISD::SRA;
+  case Instruction::And:     return ISD::AND;
+  case Instruction::Or:      return ISD::OR;
+  case Instruction::Xor:     return ISD::XOR;
+  case Instruction::Trunc:   return ISD::TRUNCATE;
+  case Instruction::ZExt:    return ISD::ZERO_EXTEND;
+  case Instruction::SExt:    return ISD::SIGN_EXTEND;
+  case Instruction::FPToUI:  return ISD::FP_TO_UINT;
+  case Instruction::FPToSI:  return ISD::FP_TO_SINT;
+  case Instruction::UIToFP:  return ISD::UINT_TO_FP;
+  case Instruction::SIToFP:  return ISD::SINT_TO_FP;
+  case Instruction::FPTrunc: return ISD::FP_ROUND;
+  case Instruction::FPExt:   return ISD::FP_EXTEND;
+  case Instruction::BitCast: return ISD::BITCAST;
+  case Instruction::Load:    return ISD::LOAD;
+  case Instruction::Store:   return ISD::STORE;
+  }
+}
+
+/// getOperationCost - Return the cost of performing Opcode on a vector of type
+/// Ty, relative to the cost of one scalar instruction.  Operations the target
+/// cannot perform natively are assumed to be scalarized.
+int SLPVectorizer::getOperationCost(unsigned Opcode, const Type *Ty) const {
+  if (!TLI)
+    return 1;
+  EVT VT = TLI->getValueType(Ty, true);
+  if (!VT.isSimple() || !TLI->isTypeLegal(VT))
+    return 2 * VF;
+  unsigned ISDOpc = getISDOpcode(Opcode);
+  if (ISDOpc == ISD::LOAD || ISDOpc == ISD::STORE)
+    return 1;
+  if (ISDOpc && TLI->isOperationLegalOrCustom(ISDOpc, VT))
+    return 1;
+  return 2 * VF;
+}
+
+/// getTreeCost - Return the difference between the cost of the vectorized tree
+/// rooted at Stores and the cost of the scalar code it replaces.  A negative
+/// result means vectorization is profitable.
+int SLPVectorizer::getTreeCost(const SmallVectorImpl<StoreInst*> &Stores) {
+  const Type *StoreTy =
+    VectorType::get(Stores[0]->getValueOperand()->getType(), VF);
+  int Cost = getOperationCost(Instruction::Store, StoreTy) - (int)VF;
+
+  for (unsigned i = 0, e = Tree.size(); i != e; ++i) {
+    const Bundle &B = Tree[i];
+    if (B.NeedGather) {
+      // Constants are materialized as a constant vector, everything else is
+      // inserted lane by lane.
+      for (unsigned j = 0; j != VF; ++j)
+        if (!isa<Constant>(B.Scalars[j]))
+          ++Cost;
+      continue;
+    }
+
+    Instruction *I0 = cast<Instruction>(B.Scalars[0]);
+    const Type *VecTy = VectorType::get(I0->getType(), VF);
+    if (I0->getNumOperands() && !isa<LoadInst>(I0) &&
+        I0->getOperand(0)->getType() != I0->getType() && isa<CastInst>(I0))
+      VecTy = VectorType::get(I0->getOperand(0)->getType(), VF);
+    Cost += getOperationCost(I0->getOpcode(), VecTy);
+
+    // Scalars that are also used outside of the tree stay alive.
+    for (unsigned j = 0; j != VF; ++j) {
+      Value *V = B.Scalars[j];
+      bool Dead = true;
+      for (Value::use_iterator UI = V->use_begin(), UE = V->use_end();
+           UI != UE && Dead; ++UI)
+        if (!ScalarToBundle.count(*UI) &&
+            std::find(Stores.begin(), Stores.end(), *UI) == Stores.end())
+          Dead = false;
+      if (Dead)
+        --Cost;
+    }
+  }
+  return Cost;
+}
+
+/// canMoveMemoryAccesses - Return true if the stores of the chain and the
+/// loads of the tree can all be moved to InsertPt without reordering them
+/// with an interfering memory access.
+bool SLPVectorizer::canMoveMemoryAccesses(const SmallVectorImpl<StoreInst*> &Stores,
+                                          Instruction *InsertPt) {
+  SmallPtrSet<Instruction*, 16> TreeMem;
+  SmallVector<LoadInst*, 16> Loads;
+  for (unsigned i = 0; i != Stores.size(); ++i)
+    TreeMem.insert(Stores[i]);
+  for (unsigned i = 0, e = Tree.size(); i != e; ++i)
+    if (!Tree[i].NeedGather && isa<LoadInst>(Tree[i].Scalars[0]))
+      for (unsigned j = 0; j != VF; ++j) {
+        LoadInst *LI = cast<LoadInst>(Tree[i].Scalars[j]);
+        TreeMem.insert(LI);
+        Loads.push_back(LI);
+      }
+
+  unsigned End = InstOrder[InsertPt];
+  BasicBlock::iterator BBEnd = InsertPt;
+  for (unsigned i = 0; i != Stores.size(); ++i) {
+    // A store moves down past everything up to InsertPt.  The vector loads
+    // are emitted before the vector store, so a tree load that used to
+    // follow the store must not read the stored memory either.
+    StoreInst *SI = Stores[i];
+    AliasAnalysis::Location Loc = AA->getLocation(SI);
+    for (BasicBlock::iterator I = SI; I != BBEnd; ++I) {
+      if (TreeMem.count(I) && !isa<LoadInst>(I))
+        continue;
+      if (AA->getModRefInfo(I, Loc) != AliasAnalysis::NoModRef)
+        return false;
+    }
+  }
+
+  for (unsigned i = 0, e = Loads.size(); i != e; ++i) {
+    // A load moves down past everything up to InsertPt; the tree stores it
+    // passes have been checked above.
+    LoadInst *LI = Loads[i];
+    if (InstOrder[LI] > End)
+      return false;
+    AliasAnalysis::Location Loc = AA->getLocation(LI);
+    for (BasicBlock::iterator I = LI; I != BBEnd; ++I) {
+      if (TreeMem.count(I))
+        continue;
+      if (AA->getModRefInfo(I, Loc) & AliasAnalysis::Mod)
+        return false;
+    }
+  }
+  return true;
+}
+
+/// vectorizeBundle - Emit the vector code for bundle Idx and its children.
+Value *SLPVectorizer::vectorizeBundle(unsigned Idx, IRBuilder<> &Builder) {
+  if (Tree[Idx].VectorValue)
+    return Tree[Idx].VectorValue;
+
+  const SmallVectorImpl<Value*> &VL = Tree[Idx].Scalars;
+  const Type *VecTy = VectorType::get(VL[0]->getType(), VF);
+  Value *V;
+  if (Tree[Idx].NeedGather) {
+    bool AllConst = true;
+    for (unsigned i = 0; i != VF; ++i)
+      AllConst &= isa<Constant>(VL[i]);
+    if (AllConst) {
+      std::vector<Constant*> Elts;
+      for (unsigned i = 0; i != VF; ++i)
+        Elts.push_back(cast<Constant>(VL[i]));
+      V = ConstantVector::get(Elts);
+    } else {
+      V = UndefValue::get(VecTy);
+      for (unsigned i = 0; i != VF; ++i)
+        V = Builder.CreateInsertElement(V, VL[i], Builder.getInt32(i),
+                                        "gather");
+    }
+  } else if (LoadInst *L0 = dyn_cast<LoadInst>(VL[0])) {
+    unsigned AS = L0->getPointerAddressSpace();
+    Value *Ptr = Builder.CreateBitCast(L0->getPointerOperand(),
+                                       PointerType::get(VecTy, AS));
+    LoadInst *LI = Builder.CreateLoad(Ptr, L0->getName() + ".vec");
+    unsigned Align = L0->getAlignment();
+    LI->setAlignment(Align ? Align : TD->getABITypeAlignment(L0->getType()));
+    V = LI;
+  } else if (CastInst *CI = dyn_cast<CastInst>(VL[0])) {
+    V = Builder.CreateCast(CI->getOpcode(),
+                           vectorizeBundle(Tree[Idx].Operands[0], Builder),
+                           VecTy, CI->getName() + ".vec");
+  } else {
+    BinaryOperator *BO = cast<BinaryOperator>(VL[0]);
+    Value *LHS = vectorizeBundle(Tree[Idx].Operands[0], Builder);
+    Value *RHS = vectorizeBundle(Tree[Idx].Operands[1], Builder);
+    V = Builder.CreateBinOp(BO->getOpcode(), LHS, RHS, BO->getName() + ".vec");
+  }
+  Tree[Idx].VectorValue = V;
+  return V;
+}
+
+/// vectorizeStores - Try to replace the consecutive stores in Stores, and the
+/// tree of computations feeding them, by vector code.
+bool SLPVectorizer::vectorizeStores(const SmallVectorImpl<StoreInst*> &Stores) {
+  VF = Stores.size();
+  Tree.clear();
+  ScalarToBundle.clear();
+
+  BasicBlock &BB = *Stores[0]->getParent();
+  numberInstructions(BB);
+
+  SmallVector<Value*, 8> Values;
+  for (unsigned i = 0; i != VF; ++i)
+    Values.push_back(Stores[i]->getValueOperand());
+  unsigned Root = buildTree(Values, 0);
+  if (Tree[Root].NeedGather)
+    return false;
+
+  int Cost = getTreeCost(Stores);
+  DEBUG(dbgs() << "SLP: Tree of " << Tree.size() << " bundles for "
+               << *Stores[0] << " has cost " << Cost << "\n");
+  if (Cost >= 0)
+    return false;
+
+  // Emit the vector code at the last store of the chain.
+  StoreInst *Last = Stores[0];
+  for (unsigned i = 1; i != VF; ++i)
+    if (InstOrder[Stores[i]] > InstOrder[Last])
+      Last = Stores[i];
+  if (!canMoveMemoryAccesses(Stores, Last))
+    return false;
+
+  IRBuilder<> Builder(Last);
+  Value *Vec = vectorizeBundle(Root, Builder);
+  unsigned AS = Stores[0]->getPointerAddressSpace();
+  Value *Ptr = Builder.CreateBitCast(Stores[0]->getPointerOperand(),
+                                     PointerType::get(Vec->getType(), AS));
+  StoreInst *Store = Builder.CreateStore(Vec, Ptr);
+  unsigned Align = Stores[0]->getAlignment();
+  Store->setAlignment(Align ? Align :
+                      TD->getABITypeAlignment(Values[0]->getType()));
+
+  DEBUG(dbgs() << "SLP: Vectorized " << VF << " stores into " << *Store
+               << "\n");
+
+  // Remove the scalar stores, and the scalars that became dead.
+  SmallVector<Instruction*, 32> DeadInsts;
+  for (unsigned i = 0; i != VF; ++i) {
+    Stores[i]->eraseFromParent();
+    ++NumStores;
+  }
+  // Bundles are numbered before their operands, so users are visited first.
+  for (unsigned i = 0, e = Tree.size(); i != e; ++i)
+    if (!Tree[i].NeedGather)
+      for (unsigned j = 0; j != VF; ++j)
+        DeadInsts.push_back(cast<Instruction>(Tree[i].Scalars[j]));
+  for (unsigned i = 0, e = DeadInsts.size(); i != e; ++i)
+    if (DeadInsts[i]->use_empty()) {
+      SE->forgetValue(DeadInsts[i]);
+      DeadInsts[i]->eraseFromParent();
+    }
+
+  Tree.clear();
+  ScalarToBundle.clear();
+  ++NumVectorized;
+  return true;
+}
@@ -13,6 +13,10 @@
 // each member (if possible).  Then, if possible, it transforms the individual
 // alloca instructions into nice clean scalar SSA form.
 //
+// Allocas that are too big to be broken up field by field, or that are
+// accessed in ways the field-wise algorithm can't handle (such as partial
+// memcpys), are instead split into the byte ranges that are actually accessed.
+//
 // This combines a simple SRoA algorithm with the Mem2Reg algorithm because
 // often interact, especially for C++ programs.  As such, iterating between
 // SRoA, then Mem2Reg until we run out of things to promote works well.
@@ -38,6 +42,7 @@
 #include "llvm/Transforms/Utils/Local.h"
 #include "llvm/Transforms/Utils/SSAUpdater.h"
 #include "llvm/Support/CallSite.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/GetElementPtrTypeIterator.h"
@@ -47,6 +52,7 @@
 #include "llvm/ADT/SetVector.h"
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/ADT/Statistic.h"
+#include <algorithm>
 using namespace llvm;
 
 STATISTIC(NumReplaced,  "Number of allocas broken up");
@@ -54,6 +60,11 @@ STATISTIC(NumPromoted,  "Number of allocas promoted");
 STATISTIC(NumAdjusted,  "Number of scalar allocas adjusted to allow promotion");
 STATISTIC(NumConverted, "Number of aggregates converted to scalar");
 STATISTIC(NumGlobals,   "Number of allocas copied from constant global");
+STATISTIC(NumSliced,    "Number of allocas split into accessed slices");
+
+static cl::opt<unsigned>
+SliceLimit("scalarrepl-max-slices", cl::init(1024), cl::Hidden,
+           cl::desc("Maximum number of slices an alloca is split into"));
 
 namespace {
   struct SROA : public FunctionPass {
@@ -815,6 +826,462 @@ ConvertScalar_InsertValue(Value *SV, Value *Old,
 }
 
 
+//===----------------------------------------------------------------------===//
+// Slice-Based Scalar Replacement
+//===----------------------------------------------------------------------===//
+
+namespace {
+/// AllocaSlicer - This class implements the slice-based form of SRoA, which is
+/// used for allocas that are too large or too irregular to be broken up field
+/// by field.  The alloca is partitioned by the byte ranges that are actually
+/// accessed: every load and store must fall into a single slice, while memcpy,
+/// memmove and memset are split at the slice boundaries.  Each slice becomes a
+/// new alloca, which is then promoted or broken up further by the driver.
+/// Slices that are written but never read are dropped entirely.
+///
+/// Apart from sorting the accesses, the work done is linear in the number of
+/// uses of the alloca.
+class AllocaSlicer {
+  const TargetData &TD;
+
+  /// Access - A load, store or mem intrinsic that accesses the bytes
+  /// [Begin, End) of the alloca through the pointer Ptr.
+  struct Access {
+    uint64_t Begin, End;
+    Instruction *Inst;
+    Value *Ptr;
+
+    Access(uint64_t B, uint64_t E, Instruction *I, Value *P)
+      : Begin(B), End(E), Inst(I), Ptr(P) {}
+    bool operator<(const Access &RHS) const { return Begin < RHS.Begin; }
+  };
+
+  /// Slice - A range of the alloca that is replaced by its own alloca.  Ty is
+  /// the type of the new alloca if all loads and stores of the slice agree on
+  /// it, or null if the slice is just a blob of bytes.
+  struct Slice {
+    uint64_t Begin, End;
+    const Type *Ty;
+    bool IsRead;
+    AllocaInst *NewAI;
+    /// Align - The alignment NewAI is known to have.
+    unsigned Align;
+
+    Slice(uint64_t B, uint64_t E, const Type *T)
+      : Begin(B), End(E), Ty(T), IsRead(false), NewAI(0), Align(0) {}
+    bool operator<(const Slice &RHS) const { return Begin < RHS.Begin; }
+  };
+
+  /// LoadsAndStores - The accesses that must not be split.
+  SmallVector<Access, 16> LoadsAndStores;
+
+  /// MemIntrinsics - The memcpy, memmove and memset calls that use the alloca.
+  SmallVector<Access, 8> MemIntrinsics;
+
+  /// PtrInsts - The bitcasts and GEPs derived from the alloca, in the order in
+  /// which they were visited.  Every instruction comes after its operand.
+  SmallVector<Instruction*, 16> PtrInsts;
+
+  /// DeadUsers - Users that are simply deleted: lifetime markers and empty
+  /// mem intrinsics.
+  SmallVector<Instruction*, 4> DeadUsers;
+
+  SmallVector<Slice, 16> Slices;
+
+public:
+  explicit AllocaSlicer(const TargetData &td) : TD(td) {}
+
+  bool TrySlice(AllocaInst *AI, uint64_t AllocaSize,
+                std::vector<AllocaInst*> &WorkList);
+
+private:
+  bool CollectAccesses(AllocaInst *AI, uint64_t AllocaSize);
+  bool AddAccess(SmallVectorImpl<Access> &List, Instruction *I, Value *Ptr,
+                 uint64_t Offset, uint64_t Size, uint64_t AllocaSize);
+  void BuildSlices();
+  Slice *FindSlice(uint64_t Offset);
+  Value *GetSlicePtr(Slice &S, uint64_t Offset, const Type *PtrTy,
+                     IRBuilder<> &Builder);
+  void RewriteMemIntrinsic(const Access &A);
+  Value *GetMemSetValue(Value *ByteVal, const Type *Ty, IRBuilder<> &Builder);
+};
+} // end anonymous namespace.
+
+/// TrySlice - Analyze the uses of AI and, if all of them can be described by
+/// byte ranges, replace it with one alloca per accessed slice.  The new allocas
+/// are added to WorkList.  Returns true if AI was replaced (and deleted).
+bool AllocaSlicer::TrySlice(AllocaInst *AI, uint64_t AllocaSize,
+                            std::vector<AllocaInst*> &WorkList) {
+  if (!CollectAccesses(AI, AllocaSize))
+    return false;
+
+  BuildSlices();
+  if (Slices.size() > SliceLimit)
+    return false;
+
+  // If the whole alloca is one slice there is nothing to gain.  The slice may
+  // be shorter than the alloca if its type has tail padding (x86_fp80).
+  if (Slices.size() == 1 && Slices[0].Begin == 0 && Slices[0].IsRead &&
+      (Slices[0].End == AllocaSize ||
+       Slices[0].Ty == AI->getAllocatedType()))
+    return false;
+
+  DEBUG(dbgs() << "SLICING: " << *AI << " into " << Slices.size()
+               << " slices\n");
+
+  unsigned AIAlign = AI->getAlignment();
+  if (AIAlign == 0)
+    AIAlign = TD.getPrefTypeAlignment(AI->getAllocatedType());
+
+  // Create the new allocas.  A slice that is never read needs no storage:
+  // the writes to it are simply dropped below.
+  for (unsigned i = 0, e = Slices.size(); i != e; ++i) {
+    Slice &S = Slices[i];
+    if (!S.IsRead) continue;
+
+    const Type *SliceTy = S.Ty;
+    if (!SliceTy)
+      SliceTy = ArrayType::get(Type::getInt8Ty(AI->getContext()),
+                               S.End - S.Begin);
+    unsigned Align = (unsigned)MinAlign(AIAlign, S.Begin);
+    S.Align = std::max(Align, TD.getABITypeAlignment(SliceTy));
+    if (Align <= TD.getABITypeAlignment(SliceTy))
+      Align = 0;
+    S.NewAI = new AllocaInst(SliceTy, 0, Align,
+                             AI->getName() + ".off" + Twine(S.Begin), AI);
+    WorkList.push_back(S.NewAI);
+  }
+
+  // Point the loads and stores at the slices.  Their alignment can't be more
+  // than the slice guarantees at their offset into it.
+  for (unsigned i = 0, e = LoadsAndStores.size(); i != e; ++i) {
+    const Access &A = LoadsAndStores[i];
+    Slice *S = FindSlice(A.Begin);
+    if (!S->NewAI) {
+      assert(isa<StoreInst>(A.Inst) && "Unread slice was loaded from!");
+      A.Inst->eraseFromParent();
+      continue;
+    }
+    IRBuilder<> Builder(A.Inst);
+    unsigned MaxAlign = (unsigned)MinAlign(S->Align, A.Begin - S->Begin);
+    if (LoadInst *LI = dyn_cast<LoadInst>(A.Inst)) {
+      LI->setOperand(0, GetSlicePtr(*S, A.Begin, A.Ptr->getType(), Builder));
+      unsigned Align = LI->getAlignment();
+      if (Align == 0) Align = TD.getABITypeAlignment(LI->getType());
+      if (Align > MaxAlign)
+        LI->setAlignment(MaxAlign);
+    } else {
+      StoreInst *SI = cast<StoreInst>(A.Inst);
+      SI->setOperand(1, GetSlicePtr(*S, A.Begin, A.Ptr->getType(), Builder));
+      unsigned Align = SI->getAlignment();
+      if (Align == 0)
+        Align = TD.getABITypeAlignment(SI->getOperand(0)->getType());
+      if (Align > MaxAlign)
+        SI->setAlignment(MaxAlign);
+    }
+  }
+
+  for (unsigned i = 0, e = MemIntrinsics.size(); i != e; ++i)
+    RewriteMemIntrinsic(MemIntrinsics[i]);
+
+  for (unsigned i = 0, e = DeadUsers.size(); i != e; ++i)
+    DeadUsers[i]->eraseFromParent();
+
+  // The casts and GEPs are dead now; delete users before their operands.
+  while (!PtrInsts.empty()) {
+    Instruction *I = PtrInsts.pop_back_val();
+    assert(I->use_empty() && "Alloca still has a use that wasn't rewritten!");
+    I->eraseFromParent();
+  }
+
+  AI->eraseFromParent();
+  return true;
+}
+
+/// CollectAccesses - Walk the uses of the alloca through bitcasts and constant
+/// GEPs, recording the byte range accessed by every load, store and mem
+/// intrinsic.  Returns false if some use can't be handled.
+bool AllocaSlicer::CollectAccesses(AllocaInst *AI, uint64_t AllocaSize) {
+  SmallVector<std::pair<Value*, uint64_t>, 16> Worklist;
+  SmallPtrSet<Instruction*, 8> SeenMemIntrinsics;
+  Worklist.push_back(std::make_pair(AI, 0));
+
+  while (!Worklist.empty()) {
+    Value *Ptr = Worklist.back().first;
+    uint64_t Offset = Worklist.back().second;
+    Worklist.pop_back();
+
+    for (Value::use_iterator UI = Ptr->use_begin(), E = Ptr->use_end();
+         UI != E; ++UI) {
+      Instruction *User = cast<Instruction>(*UI);
+
+      if (BitCastInst *BC = dyn_cast<BitCastInst>(User)) {
+        PtrInsts.push_back(BC);
+        Worklist.push_back(std::make_pair(BC, Offset));
+        continue;
+      }
+
+      if (GetElementPtrInst *GEPI = dyn_cast<GetElementPtrInst>(User)) {
+        if (!GEPI->hasAllConstantIndices())
+          return false;
+        SmallVector<Value*, 8> Indices(GEPI->op_begin() + 1, GEPI->op_end());
+        int64_t GEPOffset =
+          (int64_t)TD.getIndexedOffset(GEPI->getPointerOperandType(),
+                                       &Indices[0], Indices.size());
+        int64_t NewOffset = (int64_t)Offset + GEPOffset;
+        if (NewOffset < 0 || (uint64_t)NewOffset > AllocaSize)
+          return false;
+        PtrInsts.push_back(GEPI);
+        Worklist.push_back(std::make_pair(GEPI, (uint64_t)NewOffset));
+        continue;
+      }
+
+      if (LoadInst *LI = dyn_cast<LoadInst>(User)) {
+        if (LI->isVolatile() ||
+            !AddAccess(LoadsAndStores, LI, Ptr, Offset,
+                       TD.getTypeStoreSize(LI->getType()), AllocaSize))
+          return false;
+        continue;
+      }
+
+      if (StoreInst *SI = dyn_cast<StoreInst>(User)) {
+        // Storing the address of the alloca lets it escape.
+        if (SI->isVolatile() || SI->getOperand(0) == Ptr ||
+            !AddAccess(LoadsAndStores, SI, Ptr, Offset,
+                       TD.getTypeStoreSize(SI->getOperand(0)->getType()),
+                       AllocaSize))
+          return false;
+        continue;
+      }
+
+      if (MemIntrinsic *MI = dyn_cast<MemIntrinsic>(User)) {
+        // Copies from one part of the alloca to another are not split.
+        ConstantInt *Length = dyn_cast<ConstantInt>(MI->getLength());
+        if (!Length || MI->isVolatile() || !SeenMemIntrinsics.insert(MI))
+          return false;
+        if (Length->isZero()) {
+          DeadUsers.push_back(MI);
+          continue;
+        }
+        if (!AddAccess(MemIntrinsics, MI, Ptr, Offset, Length->getZExtValue(),
+                       AllocaSize))
+          return false;
+        continue;
+      }
+
+      if (IntrinsicInst *II = dyn_cast<IntrinsicInst>(User))
+        if (II->getIntrinsicID() == Intrinsic::lifetime_start ||
+            II->getIntrinsicID() == Intrinsic::lifetime_end) {
+          DeadUsers.push_back(II);
+          continue;
+        }
+
+      DEBUG(dbgs() << "  Slicing preventing inst: " << *User << '\n');
+      return false;
+    }
+  }
+  return true;
+}
+
+/// AddAccess - Record that I accesses Size bytes at Offset through Ptr.
+/// Returns false if the access runs off the end of the alloca.
+bool AllocaSlicer::AddAccess(SmallVectorImpl<Access> &List, Instruction *I,
+                             Value *Ptr, uint64_t Offset, uint64_t Size,
+                             uint64_t AllocaSize) {
+  if (Size > AllocaSize - Offset)
+    return false;
+  List.push_back(Access(Offset, Offset + Size, I, Ptr));
+  return true;
+}
+
+/// BuildSlices - Partition the alloca.  Overlapping loads and stores are
+/// merged into one slice, and the bytes that are only touched by mem
+/// intrinsics are covered by untyped slices in between.
+void AllocaSlicer::BuildSlices() {
+  std::sort(LoadsAndStores.begin(), LoadsAndStores.end());
+  for (unsigned i = 0, e = LoadsAndStores.size(); i != e; ++i) {
+    const Access &A = LoadsAndStores[i];
+    const Type *Ty = isa<LoadInst>(A.Inst) ? A.Inst->getType() :
+      A.Inst->getOperand(0)->getType();
+
+    if (Slices.empty() || A.Begin >= Slices.back().End) {
+      Slices.push_back(Slice(A.Begin, A.End, Ty));
+      continue;
+    }
+    Slice &S = Slices.back();
+    if (A.Begin != S.Begin || A.End != S.End || Ty != S.Ty)
+      S.Ty = 0;
+    S.End = std::max(S.End, A.End);
+  }
+
+  // Fill the holes between the load/store slices that mem intrinsics write or
+  // read.  Both lists are sorted, so a single walk over them suffices.
+  std::sort(MemIntrinsics.begin(), MemIntrinsics.end());
+  unsigned NumTyped = Slices.size(), Next = 0;
+  uint64_t Covered = 0;
+  for (unsigned i = 0, e = MemIntrinsics.size(); i != e; ++i) {
+    uint64_t Cur = std::max(MemIntrinsics[i].Begin, Covered);
+    uint64_t End = MemIntrinsics[i].End;
+    if (Cur >= End) continue;
+    Covered = End;
+
+    while (Next != NumTyped && Slices[Next].End <= Cur)
+      ++Next;
+    for (unsigned j = Next; Cur < End; ++j) {
+      if (j == NumTyped || Slices[j].Begin >= End) {
+        Slices.push_back(Slice(Cur, End, 0));
+        break;
+      }
+      if (Slices[j].Begin > Cur)
+        Slices.push_back(Slice(Cur, Slices[j].Begin, 0));
+      Cur = Slices[j].End;
+    }
+  }
+  std::sort(Slices.begin(), Slices.end());
+
+  // Work out which slices are ever read.
+  for (unsigned i = 0, e = LoadsAndStores.size(); i != e; ++i)
+    if (isa<LoadInst>(LoadsAndStores[i].Inst))
+      FindSlice(LoadsAndStores[i].Begin)->IsRead = true;
+  for (unsigned i = 0, e = MemIntrinsics.size(); i != e; ++i) {
+    const Access &A = MemIntrinsics[i];
+    MemTransferInst *MTI = dyn_cast<MemTransferInst>(A.Inst);
+    if (!MTI || MTI->getRawSource() != A.Ptr) continue;
+    for (Slice *S = FindSlice(A.Begin), *E = Slices.end();
+         S != E && S->Begin < A.End; ++S)
+      S->IsRead = true;
+  }
+}
+
+/// FindSlice - Return the slice that contains the byte at Offset.
+AllocaSlicer::Slice *AllocaSlicer::FindSlice(uint64_t Offset) {
+  Slice *S = std::upper_bound(Slices.begin(), Slices.end(),
+                              Slice(Offset, Offset, 0));
+  assert(S != Slices.begin() && "Offset is not covered by a slice!");
+  --S;
+  assert(Offset < S->End && "Offset is not covered by a slice!");
+  return S;
+}
+
+/// GetSlicePtr - Return a pointer of type PtrTy to the byte at Offset of the
+/// alloca, which must lie in slice S.
+Value *AllocaSlicer::GetSlicePtr(Slice &S, uint64_t Offset, const Type *PtrTy,
+                                 IRBuilder<> &Builder) {
+  Value *Ptr = S.NewAI;
+  if (Offset != S.Begin) {
+    Ptr = Builder.CreateBitCast(Ptr, Builder.getInt8PtrTy(), "tmp");
+    Ptr = Builder.CreateConstInBoundsGEP1_64(Ptr, Offset - S.Begin, "tmp");
+  }
+  return Builder.CreateBitCast(Ptr, PtrTy, "tmp");
+}
+
+/// RewriteMemIntrinsic - Split the mem intrinsic of A at the slice boundaries.
+/// A piece that covers a whole typed slice becomes a plain load or store so
+/// that the slice can be promoted; other pieces remain mem intrinsics.
+void AllocaSlicer::RewriteMemIntrinsic(const Access &A) {
+  MemIntrinsic *MI = cast<MemIntrinsic>(A.Inst);
+  LLVMContext &Context = MI->getContext();
+  bool IsDest = MI->getRawDest() == A.Ptr;
+
+  // For memcpy and memmove, the pointer that does not point into the alloca.
+  Value *Other = 0;
+  unsigned OtherAS = 0;
+  if (MemTransferInst *MTI = dyn_cast<MemTransferInst>(MI)) {
+    Other = IsDest ? MTI->getRawSource() : MTI->getRawDest();
+    OtherAS = cast<PointerType>(Other->getType())->getAddressSpace();
+  }
+
+  unsigned MemAlign = MI->getAlignment();
+  if (MemAlign == 0) MemAlign = 1;
+
+  for (Slice *S = FindSlice(A.Begin), *E = Slices.end();
+       S != E && S->Begin < A.End; ++S) {
+    // Writes to a slice that is never read are dropped.
+    if (!S->NewAI) continue;
+
+    uint64_t Begin = std::max(A.Begin, S->Begin);
+    uint64_t Size = std::min(A.End, S->End) - Begin;
+    unsigned Align = (unsigned)MinAlign(MemAlign, Begin - A.Begin);
+
+    IRBuilder<> Builder(MI);
+    Value *OtherPtr = 0;
+    if (Other) {
+      OtherPtr = Builder.CreateBitCast(Other, Type::getInt8PtrTy(Context,
+                                                                 OtherAS));
+      if (Begin != A.Begin)
+        OtherPtr = Builder.CreateConstInBoundsGEP1_64(OtherPtr,
+                                                      Begin - A.Begin, "tmp");
+    }
+
+    if (S->Ty && S->Ty->isSingleValueType() &&
+        Begin == S->Begin && Size == S->End - S->Begin) {
+      if (!Other) {
+        if (Value *V = GetMemSetValue(MI->getArgOperand(1), S->Ty, Builder)) {
+          Builder.CreateStore(V, S->NewAI);
+          continue;
+        }
+      } else {
+        OtherPtr = Builder.CreateBitCast(OtherPtr,
+                                         PointerType::get(S->Ty, OtherAS));
+        if (IsDest) {
+          LoadInst *L = Builder.CreateLoad(OtherPtr, "tmp");
+          L->setAlignment(Align);
+          Builder.CreateStore(L, S->NewAI);
+        } else {
+          Value *V = Builder.CreateLoad(S->NewAI, "tmp");
+          Builder.CreateStore(V, OtherPtr)->setAlignment(Align);
+        }
+        continue;
+      }
+    }
+
+    // The alignment of the new mem intrinsic holds for the slice too.
+    Align = std::min(Align, (unsigned)MinAlign(S->Align, Begin - S->Begin));
+    Value *SlicePtr = GetSlicePtr(*S, Begin, Builder.getInt8PtrTy(), Builder);
+    if (!Other)
+      Builder.CreateMemSet(SlicePtr, MI->getArgOperand(1), Size, Align);
+    else if (isa<MemCpyInst>(MI))
+      Builder.CreateMemCpy(IsDest ? SlicePtr : OtherPtr,
+                           IsDest ? OtherPtr : SlicePtr, Size, Align);
+    else
+      Builder.CreateMemMove(IsDest ? SlicePtr : OtherPtr,
+                            IsDest ? OtherPtr : SlicePtr, Size, Align);
+  }
+  MI->eraseFromParent();
+}
+
+/// GetMemSetValue - Return the value of type Ty whose bytes are all ByteVal, or
+/// null if it can't be formed.
+Value *AllocaSlicer::GetMemSetValue(Value *ByteVal, const Type *Ty,
+                                    IRBuilder<> &Builder) {
+  unsigned Bits = (unsigned)TD.getTypeSizeInBits(Ty);
+  if (Bits % 8 != 0)
+    return 0;
+
+  APInt Splat(Bits, 0);
+  for (unsigned i = 0; i != Bits; i += 8)
+    Splat |= APInt(Bits, 1).shl(i);
+
+  ConstantInt *CI = dyn_cast<ConstantInt>(ByteVal);
+  if (Ty->isIntegerTy()) {
+    if (CI)
+      return ConstantInt::get(Ty->getContext(),
+                              Splat * APInt(Bits, CI->getZExtValue()));
+    Value *V = Builder.CreateZExt(ByteVal, Ty, "tmp");
+    return Builder.CreateMul(V, ConstantInt::get(Ty->getContext(), Splat),
+                             "tmp");
+  }
+  if (!CI || !(Ty->isFloatingPointTy() || Ty->isPointerTy()))
+    return 0;
+
+  Constant *C = ConstantInt::get(Ty->getContext(),
+                                 Splat * APInt(Bits, CI->getZExtValue()));
+  if (Ty->isPointerTy())
+    return ConstantExpr::getIntToPtr(C, Ty);
+  return ConstantExpr::getBitCast(C, Ty);
+}
+
+
 //===----------------------------------------------------------------------===//
 // SRoA Driver
 //===----------------------------------------------------------------------===//
@@ -1242,8 +1709,15 @@ bool SROA::performScalarRepl(Function &F) {
     // Do not promote [0 x %struct].
     if (AllocaSize == 0) continue;
 
-    // Do not promote any struct whose size is too big.
-    if (AllocaSize > SRThreshold) continue;
+    // Do not break up any struct whose size is too big field by field.  It may
+    // still be split into the byte ranges that are actually used.
+    if (AllocaSize > SRThreshold) {
+      if (AllocaSlicer(*TD).TrySlice(AI, AllocaSize, WorkList)) {
+        ++NumSliced;
+        Changed = true;
+      }
+      continue;
+    }
 
     // If the alloca looks like a good candidate for scalar replacement, and if
     // all its users can be transformed, then split up the aggregate into its
@@ -1269,6 +1743,14 @@ bool SROA::performScalarRepl(Function &F) {
       continue;
     }
 
+    // Otherwise, try to split the alloca into the slices that are accessed,
+    // which handles partial memcpys and memsets.
+    if (AllocaSlicer(*TD).TrySlice(AI, AllocaSize, WorkList)) {
+      ++NumSliced;
+      Changed = true;
+      continue;
+    }
+
     // Otherwise, couldn't process this alloca.
   }
 
@@ -105,7 +105,14 @@ static BasicBlock *FoldBlockIntoPredecessor(BasicBlock *BB, LoopInfo* LI) {
 ///
 /// If a LoopPassManager is passed in, and the loop is fully removed, it will be
 /// removed from the LoopPassManager as well. LPM can also be NULL.
-bool llvm::UnrollLoop(Loop *L, unsigned Count, LoopInfo* LI, LPPassManager* LPM) {
+///
+/// If AllowRuntime is true and the trip count is only known at run time, the
+/// left over iterations are peeled into a prolog loop first, so that the
+/// unrolled loop only needs to check the exit condition once every Count
+/// iterations.  The loop is left unmodified if the prolog loop can't be built.
+/// See UnrollRuntimeLoopProlog.
+bool llvm::UnrollLoop(Loop *L, unsigned Count, LoopInfo* LI, LPPassManager* LPM,
+                      bool AllowRuntime) {
   BasicBlock *Preheader = L->getLoopPreheader();
   if (!Preheader) {
     DEBUG(dbgs() << "  Can't unroll; loop preheader-insertion failed.\n");
@@ -140,6 +147,17 @@ bool llvm::UnrollLoop(Loop *L, unsigned Count, LoopInfo* LI, LPPassManager* LPM)
   if (TripCount == 0)
     TripMultiple = L->getSmallConstantTripMultiple();
 
+  // If the trip count is not a known multiple of Count, make it one by
+  // running the left over iterations in a prolog loop.
+  if (AllowRuntime && TripCount == 0 && TripMultiple % Count != 0) {
+    if (!UnrollRuntimeLoopProlog(L, Count, LI, LPM)) {
+      DEBUG(dbgs() << "  Can't unroll; no prolog loop for the run-time trip "
+                      "count.\n");
+      return false;
+    }
+    TripMultiple = Count;
+  }
+
   if (TripCount != 0)
     DEBUG(dbgs() << "  Trip Count = " << TripCount << "\n");
   if (TripMultiple != 1)
@@ -0,0 +1,256 @@
+//===-- LoopUnrollRuntime.cpp - Runtime loop unrolling utilities ---------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements some loop unrolling utilities for loops with run-time
+// trip counts.  See LoopUnroll.cpp for unrolling loops with compile-time
+// trip counts.
+//
+// The functions in this file are used to generate extra code when the
+// run-time trip count modulo the unroll factor is not 0.  When this is the
+// case, we need to generate code to execute these 'left over' iterations.
+//
+// The current strategy generates a prolog loop that executes the left over
+// iterations before the unrolled loop:
+//
+//          PH:   xtraiter = tripcount & (Count - 1)
+//                br (xtraiter != 0), prol.ph, prol.end
+//     prol.ph:   br prol.header
+//   prol loop:   runs xtraiter iterations of the original loop body
+//   prol.exit:   br prol.end
+//    prol.end:   br (tripcount < Count), unr.exit, unr.ph
+//      unr.ph:   br header
+//  unrolled loop runs a multiple of Count iterations and exits to the
+//  original exit block, which falls through to unr.exit.
+//
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "loop-unroll"
+#include "llvm/Transforms/Utils/UnrollLoop.h"
+#include "llvm/BasicBlock.h"
+#include "llvm/Constants.h"
+#include "llvm/Instructions.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Analysis/LoopPass.h"
+#include "llvm/Analysis/ScalarEvolution.h"
+#include "llvm/Analysis/ScalarEvolutionExpander.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+#include "llvm/Transforms/Utils/Local.h"
+
+using namespace llvm;
+
+STATISTIC(NumRuntimeUnrolled,
+          "Number of loops unrolled with run-time trip counts");
+
+/// getPrologValue - Return the value V has on the last iteration of the prolog
+/// loop, seen from its exit block ProlExit.  Values defined in the prolog loop
+/// get an LCSSA PHI node in ProlExit, which is cached in LCSSAMap.
+static Value *getPrologValue(Value *V, Loop *L, ValueToValueMapTy &VMap,
+                             BasicBlock *ProlLatch, BasicBlock *ProlExit,
+                             DenseMap<Value*, PHINode*> &LCSSAMap) {
+  Instruction *I = dyn_cast<Instruction>(V);
+  if (!I || !L->contains(I))
+    return V;
+
+  PHINode *&PN = LCSSAMap[V];
+  if (PN == 0) {
+    PN = PHINode::Create(V->getType(), V->getName() + ".prol.lcssa",
+                         ProlExit->begin());
+    PN->addIncoming(VMap[V], ProlLatch);
+  }
+  return PN;
+}
+
+/// UnrollRuntimeLoopProlog - Insert code in the preheader of L so that it runs
+/// the first (TripCount % Count) iterations in a separate prolog loop.  The
+/// loop L itself is then known to execute a multiple of Count iterations, so
+/// it can be unrolled by Count without a check between the copies.
+///
+/// This only handles innermost loops in simplified form whose latch is the
+/// only exiting block, with a power of two unroll count.  ScalarEvolution must
+/// be able to compute the backedge-taken count of L.  Returns true if the
+/// prolog was inserted, in which case the LoopInfo passed is kept consistent
+/// and the caller is responsible for updating the DominatorTree.
+bool llvm::UnrollRuntimeLoopProlog(Loop *L, unsigned Count, LoopInfo *LI,
+                                   LPPassManager *LPM) {
+  if (LPM == 0 || Count < 2 || !isPowerOf2_32(Count))
+    return false;
+
+  // The prolog loop is built by cloning the blocks of L, which doesn't know
+  // how to clone the LoopInfo of subloops.
+  if (!L->empty() || !L->isLoopSimplifyForm())
+    return false;
+
+  BasicBlock *PH = L->getLoopPreheader();
+  BasicBlock *Header = L->getHeader();
+  BasicBlock *Latch = L->getLoopLatch();
+  BasicBlock *Exit = L->getUniqueExitBlock();
+  if (L->getExitingBlock() != Latch || Exit == 0 ||
+      Exit->getSinglePredecessor() != Latch)
+    return false;
+  // The exit must stay inside the enclosing loop, the prolog loop branches
+  // around L to it.
+  Loop *ParentLoop = L->getParentLoop();
+  if (LI->getLoopFor(Exit) != ParentLoop)
+    return false;
+  BranchInst *LatchBR = dyn_cast<BranchInst>(Latch->getTerminator());
+  if (!LatchBR || LatchBR->isUnconditional())
+    return false;
+
+  ScalarEvolution *SE = LPM->getAnalysisIfAvailable<ScalarEvolution>();
+  if (!SE)
+    return false;
+  const SCEV *BECountSC = SE->getBackedgeTakenCount(L);
+  if (isa<SCEVCouldNotCompute>(BECountSC) ||
+      !BECountSC->getType()->isIntegerTy())
+    return false;
+  const IntegerType *Ty = cast<IntegerType>(BECountSC->getType());
+  if (Log2_32(Count) > Ty->getBitWidth())
+    return false;
+
+  DEBUG(dbgs() << "  Adding a prolog loop for the " << *BECountSC
+               << " backedges of %" << Header->getName() << "\n");
+
+  // The code around the loop changes, so whatever ScalarEvolution knows about
+  // the enclosing loop is stale.
+  if (ParentLoop)
+    SE->forgetLoop(ParentLoop);
+  SE->forgetLoop(L);
+
+  // Compute the number of left over iterations in the preheader.  A trip
+  // count that overflows to 0 is a multiple of Count, so it doesn't need a
+  // special case.
+  Function *F = Header->getParent();
+  LLVMContext &Context = F->getContext();
+  BranchInst *PreHeaderBR = cast<BranchInst>(PH->getTerminator());
+  SCEVExpander Expander(*SE);
+  Value *BECount = Expander.expandCodeFor(BECountSC, Ty, PreHeaderBR);
+  Value *TripCount = BinaryOperator::CreateAdd(BECount,
+                                               ConstantInt::get(Ty, 1),
+                                               "tripcount", PreHeaderBR);
+  Value *ModVal = BinaryOperator::CreateAnd(TripCount,
+                                            ConstantInt::get(Ty, Count - 1),
+                                            "xtraiter", PreHeaderBR);
+  Value *HasExtra = new ICmpInst(PreHeaderBR, ICmpInst::ICMP_NE, ModVal,
+                                 ConstantInt::get(Ty, 0), "lcmp.mod");
+
+  // Create the blocks around the prolog loop.
+  BasicBlock *ProlPH = BasicBlock::Create(Context, "prol.ph", F, Header);
+  BasicBlock *ProlExit = BasicBlock::Create(Context, "prol.exit", F, Header);
+  BasicBlock *ProlEnd = BasicBlock::Create(Context, "prol.end", F, Header);
+  BasicBlock *UnrPH = BasicBlock::Create(Context, "unr.ph", F, Header);
+  BranchInst::Create(ProlEnd, ProlExit);
+  BranchInst::Create(Header, UnrPH);
+  BranchInst::Create(ProlPH, ProlEnd, HasExtra, PreHeaderBR);
+  PreHeaderBR->eraseFromParent();
+
+  // The original exit block keeps only its LCSSA PHI nodes, the rest of it is
+  // also reached when the prolog loop runs all the iterations.
+  BasicBlock *UnrExit = Exit->splitBasicBlock(Exit->getFirstNonPHI(),
+                                              "unr.exit");
+
+  // The prolog loop is not added to the pass manager's queue: it runs fewer
+  // than Count iterations, so the loop passes have nothing to gain from it.
+  Loop *PrologLoop = new Loop();
+  if (ParentLoop) {
+    ParentLoop->addChildLoop(PrologLoop);
+    ParentLoop->addBasicBlockToLoop(UnrExit, LI->getBase());
+    ParentLoop->addBasicBlockToLoop(ProlPH, LI->getBase());
+    ParentLoop->addBasicBlockToLoop(ProlExit, LI->getBase());
+    ParentLoop->addBasicBlockToLoop(ProlEnd, LI->getBase());
+    ParentLoop->addBasicBlockToLoop(UnrPH, LI->getBase());
+  } else {
+    LI->addTopLevelLoop(PrologLoop);
+  }
+
+  // Clone the loop body into the prolog loop.
+  ValueToValueMapTy VMap;
+  std::vector<BasicBlock*> LoopBlocks = L->getBlocks();
+  std::vector<BasicBlock*> NewBlocks;
+  for (unsigned i = 0, e = LoopBlocks.size(); i != e; ++i) {
+    BasicBlock *New = CloneBasicBlock(LoopBlocks[i], VMap, ".prol");
+    F->getBasicBlockList().insert(ProlExit, New);
+    VMap[LoopBlocks[i]] = New;
+    PrologLoop->addBasicBlockToLoop(New, LI->getBase());
+    NewBlocks.push_back(New);
+  }
+  for (unsigned i = 0, e = NewBlocks.size(); i != e; ++i)
+    for (BasicBlock::iterator I = NewBlocks[i]->begin(),
+         E = NewBlocks[i]->end(); I != E; ++I)
+      RemapInstruction(I, VMap, RF_IgnoreMissingEntries);
+
+  BasicBlock *ProlHeader = cast<BasicBlock>(VMap[Header]);
+  BasicBlock *ProlLatch = cast<BasicBlock>(VMap[Latch]);
+  BranchInst::Create(ProlHeader, ProlPH);
+  for (BasicBlock::iterator I = ProlHeader->begin(); isa<PHINode>(I); ++I) {
+    PHINode *PN = cast<PHINode>(I);
+    PN->setIncomingBlock(PN->getBasicBlockIndex(PH), ProlPH);
+  }
+
+  // The prolog loop counts down the left over iterations; it runs no more
+  // iterations than the original loop, so its exit test can be dropped.
+  PHINode *Iter = PHINode::Create(Ty, "prol.iter", ProlHeader->begin());
+  TerminatorInst *ProlTerm = ProlLatch->getTerminator();
+  Value *IterSub = BinaryOperator::CreateSub(Iter, ConstantInt::get(Ty, 1),
+                                             "prol.iter.sub", ProlTerm);
+  Value *IterCmp = new ICmpInst(ProlTerm, ICmpInst::ICMP_NE, IterSub,
+                                ConstantInt::get(Ty, 0), "prol.iter.cmp");
+  Iter->addIncoming(ModVal, ProlPH);
+  Iter->addIncoming(IterSub, ProlLatch);
+  Value *OldCond = cast<BranchInst>(ProlTerm)->getCondition();
+  BranchInst::Create(ProlHeader, ProlExit, IterCmp, ProlTerm);
+  ProlTerm->eraseFromParent();
+  RecursivelyDeleteTriviallyDeadInstructions(OldCond);
+
+  DenseMap<Value*, PHINode*> LCSSAMap;
+
+  // Start the unrolled loop where the prolog loop left off.
+  for (BasicBlock::iterator I = Header->begin(); isa<PHINode>(I); ++I) {
+    PHINode *PN = cast<PHINode>(I);
+    unsigned PHIdx = PN->getBasicBlockIndex(PH);
+    Value *Start = PN->getIncomingValue(PHIdx);
+    Value *Next = PN->getIncomingValueForBlock(Latch);
+    PHINode *Resume = PHINode::Create(PN->getType(), PN->getName() + ".unr",
+                                      ProlEnd);
+    Resume->addIncoming(Start, PH);
+    Resume->addIncoming(getPrologValue(Next, L, VMap, ProlLatch, ProlExit,
+                                       LCSSAMap), ProlExit);
+    PN->setIncomingValue(PHIdx, Resume);
+    PN->setIncomingBlock(PHIdx, UnrPH);
+  }
+
+  // If the prolog loop ran all of the iterations, skip the unrolled loop and
+  // merge the live-out values into unr.exit.  The preheader edge is never
+  // taken in that case, since the trip count is then not a multiple of Count.
+  for (BasicBlock::iterator I = Exit->begin(); isa<PHINode>(I); ++I) {
+    PHINode *PN = cast<PHINode>(I);
+    Value *V = PN->getIncomingValueForBlock(Latch);
+    PHINode *LiveOut = PHINode::Create(PN->getType(), PN->getName() + ".unr",
+                                       ProlEnd);
+    LiveOut->addIncoming(UndefValue::get(PN->getType()), PH);
+    LiveOut->addIncoming(getPrologValue(V, L, VMap, ProlLatch, ProlExit,
+                                        LCSSAMap), ProlExit);
+
+    PHINode *Merge = PHINode::Create(PN->getType(), PN->getName() + ".merge",
+                                     UnrExit->begin());
+    PN->replaceAllUsesWith(Merge);
+    Merge->addIncoming(PN, Exit);
+    Merge->addIncoming(LiveOut, ProlEnd);
+  }
+
+  Value *Done = new ICmpInst(*ProlEnd, ICmpInst::ICMP_ULT, BECount,
+                             ConstantInt::get(Ty, Count - 1), "lcmp.done");
+  BranchInst::Create(UnrExit, UnrPH, Done, ProlEnd);
+
+  ++NumRuntimeUnrolled;
+  return true;
+}
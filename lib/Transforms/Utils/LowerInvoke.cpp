@@ -43,6 +43,7 @@
 #include "llvm/LLVMContext.h"
 #include "llvm/Module.h"
 #include "llvm/Pass.h"
+#include "llvm/Analysis/ProfileInfo.h"
 #include "llvm/Transforms/Utils/BasicBlockUtils.h"
 #include "llvm/Transforms/Utils/Local.h"
 #include "llvm/ADT/SmallVector.h"
@@ -89,6 +90,7 @@ namespace {
       // This is a cluster of orthogonal Transforms
       AU.addPreserved("mem2reg");
       AU.addPreservedID(LowerSwitchID);
+      AU.addPreserved<ProfileInfo>();
     }
 
   private:
@@ -0,0 +1,85 @@
+; RUN: opt < %s -basicaa -anders-aa -aa-eval -print-all-alias-modref-info \
+; RUN:   -disable-output |& FileCheck %s
+
+declare noalias i8* @malloc(i64)
+declare void @external(i32*)
+
+@g1 = internal global i32* null
+@g2 = internal global i32* null
+@fp = internal global i32* (i32*)* null
+
+; Each global holds its own heap object, so pointers loaded from them don't
+; alias, even though basicaa knows nothing about either load.
+define void @init() {
+  %m1 = call i8* @malloc(i64 4)
+  %p1 = bitcast i8* %m1 to i32*
+  store i32* %p1, i32** @g1
+  %m2 = call i8* @malloc(i64 4)
+  %p2 = bitcast i8* %m2 to i32*
+  store i32* %p2, i32** @g2
+  store i32* (i32*)* @identity, i32* (i32*)** @fp
+  ret void
+}
+
+define void @loads() {
+  %a = load i32** @g1
+  %b = load i32** @g2
+  store i32 0, i32* %a
+  store i32 1, i32* %b
+  ret void
+}
+; CHECK: Function: loads
+; CHECK: NoAlias: i32* %a, i32* %b
+
+; The result of an indirect call through @fp is its argument.
+define internal i32* @identity(i32* %x) {
+  ret i32* %x
+}
+
+define void @indirect() {
+  %f = load i32* (i32*)** @fp
+  %a = load i32** @g1
+  %b = load i32** @g2
+  %r = call i32* %f(i32* %a)
+  store i32 0, i32* %r
+  store i32 1, i32* %b
+  ret void
+}
+; CHECK: Function: indirect
+; CHECK-DAG: NoAlias: i32* %b, i32* %r
+; CHECK-DAG: MayAlias: i32* %a, i32* %r
+
+; Pointers that round-trip through integers are still tracked.
+define void @inttoptr() {
+  %a = load i32** @g1
+  %b = load i32** @g2
+  %i = ptrtoint i32* %a to i64
+  %j = add i64 %i, 4
+  %c = inttoptr i64 %j to i32*
+  store i32 0, i32* %b
+  store i32 1, i32* %c
+  ret void
+}
+; CHECK: Function: inttoptr
+; CHECK-DAG: NoAlias: i32* %b, i32* %c
+; CHECK-DAG: MayAlias: i32* %a, i32* %c
+
+; Once a pointer escapes to external code, anything that comes back from
+; external code may alias it.
+@g3 = internal global i32* null
+
+define void @escape(i32** %q) {
+  %m = call i8* @malloc(i64 4)
+  %a = bitcast i8* %m to i32*
+  store i32* %a, i32** @g3
+  call void @external(i32* %a)
+  %b = load i32** %q
+  %c = load i32** @g1
+  store i32 0, i32* %a
+  store i32 1, i32* %b
+  store i32 2, i32* %c
+  ret void
+}
+; CHECK: Function: escape
+; CHECK-DAG: MayAlias: i32* %a, i32* %b
+; CHECK-DAG: NoAlias: i32* %a, i32* %c
@@ -0,0 +1,29 @@
+; RUN: opt < %s -basicaa -anders-aa -gvn -S | FileCheck %s
+
+; @copy moves the pointer in @slot to @slot2 as a double, so %p may point to
+; @x and the load of @x can't be folded to 0.
+
+@x = internal global i32 0
+@y = internal global i32 0
+@slot = internal global i32* null
+@slot2 = internal global i32* @y
+
+define internal void @copy() noinline {
+  %s = bitcast i32** @slot to double*
+  %d = load double* %s
+  %t = bitcast i32** @slot2 to double*
+  store double %d, double* %t
+  ret void
+}
+
+define i32 @test() {
+  store i32* @x, i32** @slot
+  call void @copy()
+  %p = load i32** @slot2
+  store i32 0, i32* @x
+  store i32 7, i32* %p
+  %v = load i32* @x
+  ret i32 %v
+; CHECK: @test
+; CHECK: ret i32 %v
+}
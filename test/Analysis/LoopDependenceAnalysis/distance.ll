@@ -0,0 +1,112 @@
+; RUN: opt < %s -analyze -basicaa -lda | FileCheck %s
+
+@x = common global [64 x [64 x i32]] zeroinitializer, align 4
+@y = common global [64 x i32] zeroinitializer, align 4
+
+;; for (i = 1; i < 64; i++)
+;;   for (j = 0; j < 63; j++)
+;;     x[i][j] = x[i-1][j+1] + y[j]
+
+define void @f1(...) nounwind {
+entry:
+  br label %outer
+
+outer:
+  %i = phi i64 [ 1, %entry ], [ %i.next, %outer.latch ]
+  %i.1 = add i64 %i, -1
+  br label %inner
+
+inner:
+  %j = phi i64 [ 0, %outer ], [ %j.next, %inner ]
+  %j.next = add i64 %j, 1
+  %x.ld.addr = getelementptr [64 x [64 x i32]]* @x, i64 0, i64 %i.1, i64 %j.next
+  %y.ld.addr = getelementptr [64 x i32]* @y, i64 0, i64 %j
+  %x.st.addr = getelementptr [64 x [64 x i32]]* @x, i64 0, i64 %i, i64 %j
+  %x = load i32* %x.ld.addr     ; 0
+  %y = load i32* %y.ld.addr     ; 1
+  %r = add i32 %y, %x
+  store i32 %r, i32* %x.st.addr ; 2
+; CHECK: 0,2: dependent, distance (-1, 1)
+; CHECK: 1,2: ind
+  %inner.cond = icmp eq i64 %j.next, 63
+  br i1 %inner.cond, label %outer.latch, label %inner
+
+outer.latch:
+  %i.next = add i64 %i, 1
+  %outer.cond = icmp eq i64 %i.next, 64
+  br i1 %outer.cond, label %exit, label %outer
+
+exit:
+  ret void
+}
+
+;; for (i = 0; i < 64; i++)
+;;   for (j = 0; j < 64; j++)
+;;     x[i][0] = x[i][0] + y[j]
+
+define void @f2(...) nounwind {
+entry:
+  br label %outer
+
+outer:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %outer.latch ]
+  br label %inner
+
+inner:
+  %j = phi i64 [ 0, %outer ], [ %j.next, %inner ]
+  %x.addr = getelementptr [64 x [64 x i32]]* @x, i64 0, i64 %i, i64 0
+  %y.ld.addr = getelementptr [64 x i32]* @y, i64 0, i64 %j
+  %x = load i32* %x.addr        ; 0
+  %y = load i32* %y.ld.addr     ; 1
+  %r = add i32 %y, %x
+  store i32 %r, i32* %x.addr    ; 2
+; CHECK: 0,2: dependent, distance (0, *)
+; CHECK: 1,2: ind
+  %j.next = add i64 %j, 1
+  %inner.cond = icmp eq i64 %j.next, 64
+  br i1 %inner.cond, label %outer.latch, label %inner
+
+outer.latch:
+  %i.next = add i64 %i, 1
+  %outer.cond = icmp eq i64 %i.next, 64
+  br i1 %outer.cond, label %exit, label %outer
+
+exit:
+  ret void
+}
+
+;; for (i = 0; i < 64; i++)
+;;   for (j = 0; j < 32; j++)
+;;     x[0][64*i+2*j] = x[0][64*i+2*j+1]
+
+define void @f3(...) nounwind {
+entry:
+  br label %outer
+
+outer:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %outer.latch ]
+  %i.64 = mul i64 %i, 64
+  br label %inner
+
+inner:
+  %j = phi i64 [ 0, %outer ], [ %j.next, %inner ]
+  %j.2 = shl i64 %j, 1
+  %idx = add i64 %i.64, %j.2
+  %idx.1 = add i64 %idx, 1
+  %x.ld.addr = getelementptr [64 x [64 x i32]]* @x, i64 0, i64 0, i64 %idx.1
+  %x.st.addr = getelementptr [64 x [64 x i32]]* @x, i64 0, i64 0, i64 %idx
+  %x = load i32* %x.ld.addr     ; 0
+  store i32 %x, i32* %x.st.addr ; 1
+; CHECK: 0,1: ind
+  %j.next = add i64 %j, 1
+  %inner.cond = icmp eq i64 %j.next, 32
+  br i1 %inner.cond, label %outer.latch, label %inner
+
+outer.latch:
+  %i.next = add i64 %i, 1
+  %outer.cond = icmp eq i64 %i.next, 64
+  br i1 %outer.cond, label %exit, label %outer
+
+exit:
+  ret void
+}
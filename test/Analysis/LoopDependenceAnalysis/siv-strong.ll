@@ -18,7 +18,7 @@ for.body:
   %y = load i32* %y.addr      ; 1
   %r = add i32 %y, %x
   store i32 %r, i32* %x.addr  ; 2
-; CHECK: 0,2: dep
+; CHECK: 0,2: dependent, distance (0)
 ; CHECK: 1,2: ind
   %i.next = add i64 %i, 1
   %exitcond = icmp eq i64 %i.next, 256
@@ -45,7 +45,7 @@ for.body:
   %y = load i32* %y.ld.addr     ; 1
   %r = add i32 %y, %x
   store i32 %r, i32* %x.st.addr ; 2
-; CHECK: 0,2: dep
+; CHECK: 0,2: dependent, distance (-1)
 ; CHECK: 1,2: ind
   %exitcond = icmp eq i64 %i.next, 256
   br i1 %exitcond, label %for.end, label %for.body
@@ -56,6 +56,7 @@ for.end:
 
 ;; for (i = 0; i < 10; i++)
 ;;   x[i+20] = x[i] + y[i]
+;; // the distance of 20 iterations is more than the loop runs.
 
 define void @f3(...) nounwind {
 entry:
@@ -71,7 +72,7 @@ for.body:
   %y = load i32* %y.ld.addr     ; 1
   %r = add i32 %y, %x
   store i32 %r, i32* %x.st.addr ; 2
-; CHECK: 0,2: dep
+; CHECK: 0,2: ind
 ; CHECK: 1,2: ind
   %i.next = add i64 %i, 1
   %exitcond = icmp eq i64 %i.next, 10
@@ -83,6 +84,7 @@ for.end:
 
 ;; for (i = 0; i < 10; i++)
 ;;   x[10*i+1] = x[10*i] + y[i]
+;; // the distance of 1/10 iterations is not a whole number.
 
 define void @f4(...) nounwind {
 entry:
@@ -99,7 +101,7 @@ for.body:
   %y = load i32* %y.ld.addr     ; 1
   %r = add i32 %y, %x
   store i32 %r, i32* %x.st.addr ; 2
-; CHECK: 0,2: dep
+; CHECK: 0,2: ind
 ; CHECK: 1,2: ind
   %i.next = add i64 %i, 1
   %exitcond = icmp eq i64 %i.next, 10
@@ -0,0 +1,17 @@
+; RUN: llc < %s -mtriple=i686-linux -mcpu=atom | FileCheck %s
+
+; Atom issues in order, so the scheduler should start the independent
+; multiply while the adds it will be combined with are still in flight.
+
+; CHECK: f:
+; CHECK: addsd
+; CHECK-NEXT: mulsd
+; CHECK-NEXT: addsd
+; CHECK-NEXT: addsd
+define double @f(double %a, double %b, double %c, double %d) nounwind {
+  %m = fmul double %a, %b
+  %n = fadd double %c, %d
+  %o = fadd double %n, %c
+  %r = fadd double %m, %o
+  ret double %r
+}
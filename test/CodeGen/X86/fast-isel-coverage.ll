@@ -0,0 +1,133 @@
+; RUN: llc < %s -O0 -fast-isel-abort -verify-machineinstrs -mtriple=x86_64-unknown-linux-gnu | FileCheck %s
+
+; Instructions fast isel selects itself rather than falling back to
+; SelectionDAG for the rest of the block.
+
+; A compare in the same block is folded into the cmov.
+; CHECK: test1:
+; CHECK: cmpl %esi, %edi
+; CHECK-NEXT: cmovl
+define i32 @test1(i32 %a, i32 %b, i32 %c) nounwind {
+  %cmp = icmp slt i32 %a, %b
+  %r = select i1 %cmp, i32 %b, i32 %c
+  ret i32 %r
+}
+
+; FP selects have no cmov and become a branch.
+; CHECK: test2:
+; CHECK: ucomisd
+; CHECK: ja
+define double @test2(double %a, double %b) nounwind {
+  %cmp = fcmp olt double %a, %b
+  %r = select i1 %cmp, double %a, double %b
+  ret double %r
+}
+
+; CHECK: test3:
+; CHECK: testb
+; CHECK: jne
+define i8 @test3(i1 %c, i8 %a, i8 %b) nounwind {
+  %r = select i1 %c, i8 %a, i8 %b
+  ret i8 %r
+}
+
+; Small switches become a chain of compares.
+; CHECK: test4:
+; CHECK: cmpl $1, %edi
+; CHECK: je
+; CHECK: cmpl $7,
+; CHECK-NEXT: je
+define i32 @test4(i32 %a) nounwind {
+entry:
+  switch i32 %a, label %default [ i32 1, label %one
+                                  i32 7, label %seven ]
+one:
+  ret i32 10
+seven:
+  ret i32 70
+default:
+  ret i32 0
+}
+
+; Each compare gets its own block, so values live into a case block are
+; spilled before the branch that leaves for it.
+; CHECK: test4b:
+; CHECK: cmpl $1, %edi
+; CHECK: movl %esi, [[SLOT:-[0-9]+\(%rsp\)]]
+; CHECK: je [[JOIN:.LBB[0-9_]+]]
+; CHECK: cmpl $2,
+; CHECK-NEXT: je
+; CHECK: [[JOIN]]:
+; CHECK-NEXT: movl [[SLOT]], %eax
+define i32 @test4b(i32 %x, i32 %y) nounwind {
+entry:
+  %a = add i32 %y, 5
+  switch i32 %x, label %default [ i32 1, label %join
+                                  i32 2, label %two ]
+two:
+  br label %join
+default:
+  ret i32 -1
+join:
+  %p = phi i32 [ %a, %entry ], [ 9, %two ]
+  ret i32 %p
+}
+
+declare void @llvm.memcpy.p0i8.p0i8.i64(i8*, i8*, i64, i32, i1) nounwind
+declare void @llvm.memset.p0i8.i64(i8*, i8, i64, i32, i1) nounwind
+
+; Small constant-length memcpys are expanded inline; the rest are calls.
+; CHECK: test5:
+; CHECK: movq (%rsi), [[R1:%r[a-z0-9]+]]
+; CHECK-NEXT: movq [[R1]], (%rdi)
+; CHECK-NEXT: movl 8(%rsi), [[R2:%[a-z0-9]+]]
+; CHECK-NEXT: movl [[R2]], 8(%rdi)
+; CHECK: call{{.*}}memcpy
+; CHECK: call{{.*}}memset
+define void @test5(i8* %a, i8* %b, i64 %n) nounwind {
+  call void @llvm.memcpy.p0i8.p0i8.i64(i8* %a, i8* %b, i64 12, i32 1, i1 false)
+  call void @llvm.memcpy.p0i8.p0i8.i64(i8* %a, i8* %b, i64 %n, i32 1, i1 false)
+  call void @llvm.memset.p0i8.i64(i8* %a, i8 0, i64 %n, i32 1, i1 false)
+  ret void
+}
+
+; Vector loads and stores pick the aligned form only when they can.
+; CHECK: test6:
+; CHECK: movaps (%rdi)
+; CHECK: movups {{.*}}, (%rsi)
+define void @test6(<4 x float>* %a, <4 x float>* %b) nounwind {
+  %v = load <4 x float>* %a, align 16
+  store <4 x float> %v, <4 x float>* %b, align 4
+  ret void
+}
+
+; CHECK: test7:
+; CHECK: movzbl
+; CHECK: cvtsi2sd
+define double @test7(i8 %a) nounwind {
+  %r = uitofp i8 %a to double
+  ret double %r
+}
+
+; CHECK: test8:
+; CHECK: movl %edi, %e
+; CHECK: cvtsi2sdq
+define double @test8(i32 %a) nounwind {
+  %r = uitofp i32 %a to double
+  ret double %r
+}
+
+; CHECK: test9:
+; CHECK: cvttsd2siq %xmm0, %r
+define i32 @test9(double %a) nounwind {
+  %r = fptoui double %a to i32
+  ret i32 %r
+}
+
+; Extended return values.
+; CHECK: test10:
+; CHECK: movswl
+; CHECK: ret
+define signext i16 @test10(i16 %a) nounwind {
+  ret i16 %a
+}
@@ -0,0 +1,43 @@
+; RUN: llc < %s -mtriple=x86_64-linux -regalloc=greedy -verify-regalloc | FileCheck %s
+
+; The zero passed to asin is rematerialized before each use in the loop.  Its
+; original def in the preheader is dead after that and must be deleted.
+
+; CHECK: trace_line:
+; CHECK: subq $24, %rsp
+; CHECK-NEXT: .align
+; CHECK: pxor %xmm0, %xmm0
+; CHECK-NEXT: callq asin
+
+@object_distance = external global double, align 8
+@axis_slope_angle = external global double, align 8
+@current_surfaces.b = external global i1
+
+declare double @sin(double) nounwind readonly
+
+declare double @asin(double) nounwind readonly
+
+declare double @tan(double) nounwind readonly
+
+define fastcc void @trace_line(i32 %line) nounwind {
+entry:
+  %.b3 = load i1* @current_surfaces.b
+  br i1 %.b3, label %bb, label %return
+
+bb:
+  %0 = tail call double @asin(double 0.000000e+00) nounwind readonly
+  %1 = fadd double 0.000000e+00, %0
+  %2 = tail call double @asin(double 0.000000e+00) nounwind readonly
+  %3 = fsub double %1, %2
+  store double %3, double* @axis_slope_angle, align 8
+  %4 = fdiv double %1, 2.000000e+00
+  %5 = tail call double @sin(double %4) nounwind readonly
+  %6 = fmul double 0.000000e+00, %5
+  %7 = tail call double @tan(double %3) nounwind readonly
+  %8 = fadd double 0.000000e+00, %6
+  store double %8, double* @object_distance, align 8
+  br label %bb
+
+return:
+  ret void
+}
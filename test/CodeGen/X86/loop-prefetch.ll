@@ -0,0 +1,31 @@
+; RUN: llc < %s -mtriple=x86_64-linux | FileCheck %s
+; RUN: llc < %s -mtriple=x86_64-linux -enable-loop-prefetch | FileCheck %s -check-prefix=PF
+
+; Loop prefetching is opt-in: a loop with an unknown trip count is only
+; prefetched when asked for.
+
+; CHECK: sum:
+; CHECK-NOT: prefetch
+; CHECK: ret
+
+; PF: sum:
+; PF: prefetcht0
+; PF: ret
+
+define i64 @sum(i64* %p, i64 %n) nounwind {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i64 [0, %entry], [%i.next, %loop]
+  %acc = phi i64 [0, %entry], [%acc.next, %loop]
+  %a = getelementptr i64* %p, i64 %i
+  %v = load i64* %a
+  %acc.next = add i64 %acc, %v
+  %i.next = add i64 %i, 1
+  %done = icmp eq i64 %i.next, %n
+  br i1 %done, label %exit, label %loop
+
+exit:
+  ret i64 %acc.next
+}
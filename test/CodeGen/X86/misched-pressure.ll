@@ -0,0 +1,92 @@
+; RUN: llc < %s -mtriple=i686-linux -mcpu=generic -enable-misched | FileCheck %s
+
+; A dot product with more terms than there are registers.  Once the register
+; pressure limit is reached, the machine scheduler should finish each product
+; before starting the next one instead of spilling the partial sums.
+
+; CHECK: dot:
+; CHECK-NOT: {{Spill|Reload}}
+; CHECK: imull 4(
+; CHECK-NEXT: movl (
+; CHECK-NEXT: imull (
+; CHECK-NEXT: addl
+; CHECK-NEXT: movl 8(
+; CHECK-NEXT: imull 8(
+; CHECK-NEXT: addl
+; CHECK-NOT: {{Spill|Reload}}
+; CHECK: ret
+define i32 @dot(i32* %p, i32* %q) nounwind {
+entry:
+  %pa0 = getelementptr i32* %p, i32 0
+  %a0 = load i32* %pa0
+  %pa1 = getelementptr i32* %p, i32 1
+  %a1 = load i32* %pa1
+  %pa2 = getelementptr i32* %p, i32 2
+  %a2 = load i32* %pa2
+  %pa3 = getelementptr i32* %p, i32 3
+  %a3 = load i32* %pa3
+  %pa4 = getelementptr i32* %p, i32 4
+  %a4 = load i32* %pa4
+  %pa5 = getelementptr i32* %p, i32 5
+  %a5 = load i32* %pa5
+  %pa6 = getelementptr i32* %p, i32 6
+  %a6 = load i32* %pa6
+  %pa7 = getelementptr i32* %p, i32 7
+  %a7 = load i32* %pa7
+  %pa8 = getelementptr i32* %p, i32 8
+  %a8 = load i32* %pa8
+  %pa9 = getelementptr i32* %p, i32 9
+  %a9 = load i32* %pa9
+  %pa10 = getelementptr i32* %p, i32 10
+  %a10 = load i32* %pa10
+  %pa11 = getelementptr i32* %p, i32 11
+  %a11 = load i32* %pa11
+  %pb0 = getelementptr i32* %q, i32 0
+  %b0 = load i32* %pb0
+  %pb1 = getelementptr i32* %q, i32 1
+  %b1 = load i32* %pb1
+  %pb2 = getelementptr i32* %q, i32 2
+  %b2 = load i32* %pb2
+  %pb3 = getelementptr i32* %q, i32 3
+  %b3 = load i32* %pb3
+  %pb4 = getelementptr i32* %q, i32 4
+  %b4 = load i32* %pb4
+  %pb5 = getelementptr i32* %q, i32 5
+  %b5 = load i32* %pb5
+  %pb6 = getelementptr i32* %q, i32 6
+  %b6 = load i32* %pb6
+  %pb7 = getelementptr i32* %q, i32 7
+  %b7 = load i32* %pb7
+  %pb8 = getelementptr i32* %q, i32 8
+  %b8 = load i32* %pb8
+  %pb9 = getelementptr i32* %q, i32 9
+  %b9 = load i32* %pb9
+  %pb10 = getelementptr i32* %q, i32 10
+  %b10 = load i32* %pb10
+  %pb11 = getelementptr i32* %q, i32 11
+  %b11 = load i32* %pb11
+  %m0 = mul i32 %a0, %b0
+  %m1 = mul i32 %a1, %b1
+  %m2 = mul i32 %a2, %b2
+  %m3 = mul i32 %a3, %b3
+  %m4 = mul i32 %a4, %b4
+  %m5 = mul i32 %a5, %b5
+  %m6 = mul i32 %a6, %b6
+  %m7 = mul i32 %a7, %b7
+  %m8 = mul i32 %a8, %b8
+  %m9 = mul i32 %a9, %b9
+  %m10 = mul i32 %a10, %b10
+  %m11 = mul i32 %a11, %b11
+  %s1 = add i32 %m0, %m1
+  %s2 = add i32 %s1, %m2
+  %s3 = add i32 %s2, %m3
+  %s4 = add i32 %s3, %m4
+  %s5 = add i32 %s4, %m5
+  %s6 = add i32 %s5, %m6
+  %s7 = add i32 %s6, %m7
+  %s8 = add i32 %s7, %m8
+  %s9 = add i32 %s8, %m9
+  %s10 = add i32 %s9, %m10
+  %s11 = add i32 %s10, %m11
+  ret i32 %s11
+}
@@ -0,0 +1,43 @@
+; RUN: llc < %s -mtriple=i686-pc-linux-gnu -relocation-model=pic -j 2 \
+; RUN:   -filetype=obj -o %t.j.o
+; RUN: llc < %s -mtriple=i686-pc-linux-gnu -relocation-model=pic \
+; RUN:   -filetype=obj -o %t.o
+; RUN: llvm-nm %t.j.o > %t.j.nm
+; RUN: llvm-nm %t.o | diff - %t.j.nm
+; RUN: FileCheck %s < %t.j.nm
+
+; The integrated assembler rejects the '$' names and the Mach-O style section
+; name in the joined output of the partitions, so llc compiles the module
+; serially instead.
+
+; CHECK: B $bar
+; CHECK: T $foo
+; CHECK: U $hen
+; CHECK: T baz
+; CHECK: D g
+; CHECK: T qux
+
+@"$bar" = global i32 0
+@g = global i32 1, section "__DATA,__mydata"
+
+define i32 @"$foo"() nounwind {
+  %m = load i32* @"$bar"
+  %u = call i32 @"$hen"(i32 %m)
+  ret i32 %u
+}
+
+define i32 @baz(i32 %x) nounwind {
+  %m = load i32* @"$bar"
+  %n = load i32* @g
+  %r = add i32 %m, %x
+  %s = add i32 %r, %n
+  ret i32 %s
+}
+
+define i32 @qux(i32 %x) nounwind {
+  %r = call i32 @"$foo"()
+  %s = mul i32 %r, %x
+  ret i32 %s
+}
+
+declare i32 @"$hen"(i32 %a)
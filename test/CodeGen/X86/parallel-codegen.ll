@@ -0,0 +1,73 @@
+; RUN: llc < %s -mtriple=x86_64-unknown-linux-gnu -j 3 | FileCheck %s
+; RUN: llc < %s -mtriple=x86_64-unknown-linux-gnu -j 3 -filetype=obj -o %t.j.o
+; RUN: llc < %s -mtriple=x86_64-unknown-linux-gnu -filetype=obj -o %t.o
+; RUN: llvm-nm %t.o | grep { \[A-Z\] } > %t.nm
+; RUN: llvm-nm %t.j.o | grep { \[A-Z\] } | diff - %t.nm
+; RUN: llc < %s -mtriple=x86_64-unknown-linux-gnu -j 3 | \
+; RUN:   llvm-mc -triple=x86_64-unknown-linux-gnu -filetype=obj -o %t.mc.o
+; RUN: llvm-nm %t.mc.o | grep { \[A-Z\] } | diff - %t.nm
+
+; The functions are split into three partitions, whose output appears in
+; module order.  Local symbols stay local: the partitions that use them only
+; declare them hidden, and private ones used across partitions become
+; internal.  The assembler temporaries of each partition are kept apart.
+
+@.str = private constant [6 x i8] c"hello\00"
+@counter = internal global i32 0
+
+; CHECK-NOT: .globl f1
+; CHECK: f1:
+; CHECK: .Ltmp0:
+define internal i32 @f1(i32 %x) nounwind {
+  %v = load i32* @counter
+  %r = add i32 %x, %v
+  store i32 %r, i32* @counter
+  %s = mul i32 %r, %x
+  %t = xor i32 %s, %v
+  %u = sub i32 %t, %x
+  %w = shl i32 %u, 3
+  ret i32 %w
+}
+
+; Globals go with the first partition.  @counter is only used there.
+; CHECK-NOT: .globl .str
+; CHECK: .str:
+; CHECK: .local counter
+
+; CHECK: .globl f2
+; CHECK: f2:
+; CHECK: callq f1
+; CHECK: .Lp1_tmp0:
+define i32 @f2(i32 %x) nounwind {
+  %a = call i32 @f1(i32 %x)
+  %b = add i32 %a, 7
+  ret i32 %b
+}
+
+; CHECK: f3:
+; CHECK: movl $.str, %eax
+; CHECK: .Lp1_tmp1:
+; CHECK: .hidden f1
+define i8* @f3() nounwind {
+  ret i8* getelementptr ([6 x i8]* @.str, i32 0, i32 0)
+}
+
+; CHECK: f4:
+; CHECK: .Lp2_BB[[LOOP:[0-9]+_1]]:
+; CHECK: callq f1
+; CHECK: jne .Lp2_BB[[LOOP]]
+; CHECK: .Lp2_tmp0:
+; CHECK: .hidden f1
+define i32 @f4(i32 %x) nounwind {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i32 [ %x, %entry ], [ %a, %loop ]
+  %a = call i32 @f1(i32 %i)
+  %c = icmp eq i32 %a, 0
+  br i1 %c, label %exit, label %loop
+
+exit:
+  ret i32 %a
+}
@@ -0,0 +1,31 @@
+; RUN: llc < %s -mtriple=x86_64-linux -mcpu=generic -post-RA-scheduler -sched-mem-window=2 | FileCheck %s
+; RUN: llc < %s -mtriple=x86_64-linux -mcpu=generic -enable-misched -sched-mem-window=2 | FileCheck %s
+; RUN: llc < %s -mtriple=x86_64-linux -mcpu=generic -post-RA-scheduler -sched-mem-window=100000 | FileCheck %s -check-prefix=NOWIN
+; RUN: llc < %s -mtriple=x86_64-linux -mcpu=generic -enable-misched -sched-mem-window=100000 | FileCheck %s -check-prefix=NOWIN
+
+; The references to @a, @b and @c don't alias, so the load from @c is free to
+; start first. The dependencies are built bottom-up: with a window of two,
+; the load and the store to @b fill it, and the store to @a becomes an alias
+; chain node that everything below it must follow.
+
+@a = global i32 0
+@b = global i32 0
+@c = global i32 0
+
+; CHECK: %entry
+; CHECK-NEXT: movl %edi, a(%rip)
+; CHECK: movl c(%rip)
+
+; NOWIN: %entry
+; NOWIN-NEXT: movl c(%rip)
+; NOWIN: movl %edi, a(%rip)
+define i32 @f(i32 %x, i32 %y) nounwind {
+entry:
+  store i32 %x, i32* @a
+  store i32 %y, i32* @b
+  %v = load i32* @c
+  %m = mul i32 %v, %x
+  %n = mul i32 %m, %y
+  %o = mul i32 %n, %v
+  ret i32 %o
+}
@@ -0,0 +1,104 @@
+; RUN: llc < %s -mtriple=x86_64-linux | FileCheck %s
+; RUN: llc < %s -mtriple=x86_64-linux -shrink-wrap=false | FileCheck %s -check-prefix=NOSW
+
+; The null check returns without touching callee-saved registers, so the
+; saves move into the slow path.
+
+; CHECK: early:
+; CHECK-NOT: push
+; CHECK: testq %rdi, %rdi
+; CHECK-NEXT: jne
+; CHECK-NOT: push
+; CHECK: ret
+; CHECK: pushq %r14
+; CHECK: callq compute
+; CHECK: popq %r14
+; CHECK-NEXT: ret
+
+; NOSW: early:
+; NOSW-NEXT: # BB#0:
+; NOSW-NEXT: push
+
+define i32 @early(i32* %p) nounwind {
+entry:
+  %null = icmp eq i32* %p, null
+  br i1 %null, label %fast, label %slow
+
+fast:
+  ret i32 0
+
+slow:
+  %v = load i32* %p
+  %a = call i32 @compute(i32 %v)
+  %b = call i32 @compute(i32 %a)
+  %s = add i32 %a, %b
+  store i32 %s, i32* %p
+  ret i32 %s
+}
+
+; The stack frame for %buf is only set up when the call is made.
+
+; CHECK: withbuf:
+; CHECK-NOT: subq
+; CHECK: jle
+; CHECK: subq $264, %rsp
+; CHECK: callq fill
+; CHECK: addq $264, %rsp
+; CHECK-NEXT: ret
+; CHECK: movl $7, %eax
+; CHECK-NEXT: ret
+
+define i32 @withbuf(i32 %n) nounwind {
+entry:
+  %buf = alloca [64 x i32], align 16
+  %z = icmp slt i32 %n, 1
+  br i1 %z, label %out, label %work
+
+work:
+  %b0 = getelementptr [64 x i32]* %buf, i32 0, i32 0
+  call void @fill(i32* %b0, i32 %n)
+  %e = getelementptr [64 x i32]* %buf, i32 0, i32 5
+  %v = load i32* %e
+  ret i32 %v
+
+out:
+  ret i32 7
+}
+
+; Saves are hoisted out of the loop rather than repeated on each iteration.
+
+; CHECK: loopy:
+; CHECK-NOT: push
+; CHECK: jle
+; CHECK: pushq %r15
+; CHECK: %loop
+; CHECK-NOT: push
+; CHECK: callq compute
+; CHECK: popq %r15
+; CHECK-NEXT: ret
+; CHECK: movl $-1, %eax
+; CHECK-NEXT: ret
+
+define i32 @loopy(i32 %n) nounwind {
+entry:
+  %z = icmp sle i32 %n, 0
+  br i1 %z, label %out, label %loop
+
+loop:
+  %i = phi i32 [0, %entry], [%i.next, %loop]
+  %acc = phi i32 [0, %entry], [%acc.next, %loop]
+  %c = call i32 @compute(i32 %i)
+  %acc.next = add i32 %acc, %c
+  %i.next = add i32 %i, 1
+  %done = icmp eq i32 %i.next, %n
+  br i1 %done, label %exit, label %loop
+
+exit:
+  ret i32 %acc.next
+
+out:
+  ret i32 -1
+}
+
+declare i32 @compute(i32)
+declare void @fill(i32*, i32)
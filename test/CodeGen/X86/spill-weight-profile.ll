@@ -0,0 +1,65 @@
+; RUN: llc < %s -mtriple=i686-linux -regalloc=linearscan -profile-loader -profile-info-file=%p/Inputs/spill-weight-profile.prof | FileCheck %s
+; RUN: llc < %s -mtriple=i686-linux -regalloc=greedy -profile-loader -profile-info-file=%p/Inputs/spill-weight-profile.prof | FileCheck %s
+; RUN: llc < %s -mtriple=i686-pc-win32 -regalloc=greedy -profile-loader -profile-info-file=%p/Inputs/spill-weight-profile.prof | FileCheck %s
+
+; The edge profile in Inputs/spill-weight-profile.prof says the entry block
+; ran 1000 times and branched to %hot 999 times and to %cold once. There are
+; not enough registers for all loaded values, and %cold uses its values more
+; often than %hot, so only the measured frequencies keep the values used by
+; %hot in registers. On win32, invokes are lowered by a pass that must keep
+; the profile too.
+
+; CHECK: %hot
+; CHECK-NOT: Reload
+; CHECK: ret
+; CHECK: %cold
+
+define i32 @f(i32 %k, i32* %p) nounwind {
+entry:
+  %q1 = getelementptr i32* %p, i32 1
+  %q2 = getelementptr i32* %p, i32 2
+  %q3 = getelementptr i32* %p, i32 3
+  %q4 = getelementptr i32* %p, i32 4
+  %q5 = getelementptr i32* %p, i32 5
+  %q6 = getelementptr i32* %p, i32 6
+  %q7 = getelementptr i32* %p, i32 7
+  %q8 = getelementptr i32* %p, i32 8
+  %x1 = volatile load i32* %q1
+  %x2 = volatile load i32* %q2
+  %x3 = volatile load i32* %q3
+  %x4 = volatile load i32* %q4
+  %x5 = volatile load i32* %q5
+  %x6 = volatile load i32* %q6
+  %x7 = volatile load i32* %q7
+  %x8 = volatile load i32* %q8
+  %c = icmp eq i32 %k, 0
+  br i1 %c, label %hot, label %cold
+
+hot:
+  %h1 = mul i32 %x1, %x2
+  %h2 = mul i32 %h1, %x3
+  %h3 = mul i32 %h2, %x4
+  volatile store i32 %h3, i32* %p
+  %h4 = mul i32 %x4, %x3
+  %h5 = mul i32 %h4, %x2
+  %h6 = mul i32 %h5, %x1
+  ret i32 %h6
+
+cold:
+  %c1 = xor i32 %x5, %x6
+  %c2 = xor i32 %c1, %x7
+  %c3 = xor i32 %c2, %x8
+  volatile store i32 %c3, i32* %p
+  %c4 = xor i32 %x8, %x7
+  %c5 = xor i32 %c4, %x6
+  %c6 = xor i32 %c5, %x5
+  volatile store i32 %c6, i32* %p
+  %c7 = sub i32 %x5, %x6
+  %c8 = sub i32 %c7, %x7
+  %c9 = sub i32 %c8, %x8
+  volatile store i32 %c9, i32* %p
+  %d1 = add i32 %x1, %x2
+  %d2 = add i32 %d1, %x3
+  %d3 = add i32 %d2, %x4
+  ret i32 %d3
+}
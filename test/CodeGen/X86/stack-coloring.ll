@@ -0,0 +1,110 @@
+; RUN: llc < %s -mtriple=i686-linux | FileCheck %s
+; RUN: llc < %s -mtriple=i686-linux -no-stack-coloring | FileCheck %s -check-prefix=NOCOLOR
+; RUN: llc < %s -mtriple=i686-linux -O0 | FileCheck %s -check-prefix=NOCOLOR
+; RUN: llc < %s -mtriple=i686-linux -print-machineinstrs -o /dev/null |& \
+; RUN:   FileCheck %s -check-prefix=MMO
+
+; The two buffers are never live at the same time, so they share one slot.
+
+; CHECK: disjoint:
+; CHECK: subl $524, %esp
+; CHECK-NOT: subl
+; CHECK: ret
+
+; NOCOLOR: disjoint:
+; NOCOLOR: subl $1036, %esp
+
+define void @disjoint(i1 %c) nounwind {
+entry:
+  %a = alloca [512 x i8], align 1
+  %b = alloca [512 x i8], align 1
+  %a.0 = getelementptr [512 x i8]* %a, i32 0, i32 0
+  %b.0 = getelementptr [512 x i8]* %b, i32 0, i32 0
+  br i1 %c, label %left, label %right
+
+left:
+  call void @llvm.lifetime.start(i64 512, i8* %a.0)
+  call void @use(i8* %a.0)
+  call void @llvm.lifetime.end(i64 512, i8* %a.0)
+  br label %exit
+
+right:
+  call void @llvm.lifetime.start(i64 512, i8* %b.0)
+  call void @use(i8* %b.0)
+  call void @llvm.lifetime.end(i64 512, i8* %b.0)
+  br label %exit
+
+exit:
+  ret void
+}
+
+; The buffers overlap, so both keep their own slot.
+
+; CHECK: overlapping:
+; CHECK: subl $1036, %esp
+
+define void @overlapping() nounwind {
+entry:
+  %a = alloca [512 x i8], align 1
+  %b = alloca [512 x i8], align 1
+  %a.0 = getelementptr [512 x i8]* %a, i32 0, i32 0
+  %b.0 = getelementptr [512 x i8]* %b, i32 0, i32 0
+  call void @llvm.lifetime.start(i64 512, i8* %a.0)
+  call void @llvm.lifetime.start(i64 512, i8* %b.0)
+  call void @use(i8* %a.0)
+  call void @use(i8* %b.0)
+  call void @llvm.lifetime.end(i64 512, i8* %a.0)
+  call void @llvm.lifetime.end(i64 512, i8* %b.0)
+  ret void
+}
+
+; %b is stored to before its lifetime starts, so its markers can't be trusted.
+
+; CHECK: escaping:
+; CHECK: subl $1036, %esp
+
+define void @escaping() nounwind {
+entry:
+  %a = alloca [512 x i8], align 1
+  %b = alloca [512 x i8], align 1
+  %a.0 = getelementptr [512 x i8]* %a, i32 0, i32 0
+  %b.0 = getelementptr [512 x i8]* %b, i32 0, i32 0
+  store i8 0, i8* %b.0
+  call void @llvm.lifetime.start(i64 512, i8* %a.0)
+  call void @use(i8* %a.0)
+  call void @llvm.lifetime.end(i64 512, i8* %a.0)
+  call void @llvm.lifetime.start(i64 512, i8* %b.0)
+  call void @use(i8* %b.0)
+  call void @llvm.lifetime.end(i64 512, i8* %b.0)
+  ret void
+}
+
+; Once %a and %b share a slot, %p may point into either, so the load through
+; it no longer has a value that alias analysis could tell apart from them.
+
+; MMO: # Machine code for function through_pointer:
+; MMO: LD1[%p]
+; MMO: # After codegen DCE pass:
+; MMO-NEXT: # Machine code for function through_pointer:
+; MMO: LD1[<unknown>]
+
+define i8 @through_pointer(i8** %pp) nounwind {
+entry:
+  %a = alloca [512 x i8], align 1
+  %b = alloca [512 x i8], align 1
+  %a.0 = getelementptr [512 x i8]* %a, i32 0, i32 0
+  %b.0 = getelementptr [512 x i8]* %b, i32 0, i32 0
+  call void @llvm.lifetime.start(i64 512, i8* %a.0)
+  call void @use(i8* %a.0)
+  call void @llvm.lifetime.end(i64 512, i8* %a.0)
+  call void @llvm.lifetime.start(i64 512, i8* %b.0)
+  call void @use(i8* %b.0)
+  %p = load i8** %pp
+  %v = load i8* %p
+  call void @llvm.lifetime.end(i64 512, i8* %b.0)
+  ret i8 %v
+}
+
+declare void @use(i8*)
+declare void @llvm.lifetime.start(i64, i8* nocapture) nounwind
+declare void @llvm.lifetime.end(i64, i8* nocapture) nounwind
@@ -0,0 +1,156 @@
+; RUN: opt < %s -basicaa -dse -S | FileCheck %s
+; RUN: opt < %s -basicaa -dse -enable-global-dse=false -S | FileCheck %s -check-prefix=LOCAL
+target datalayout = "e-p:64:64:64-i1:8:8-i8:8:8-i16:16:16-i32:32:32-i64:64:64-f32:32:32-f64:64:64-v64:64:64-v128:128:128-a0:0:64-s0:64:64-f80:128:128-n8:16:32:64"
+
+declare void @use(i32)
+declare void @capture(i32*)
+
+; The store in the entry block is overwritten on both paths to %join.
+define void @diamond(i32* %p, i1 %c, i32 %x) {
+entry:
+  store i32 1, i32* %p
+  br i1 %c, label %then, label %join
+
+then:
+  call void @use(i32 %x) readnone
+  br label %join
+
+join:
+  store i32 2, i32* %p
+  ret void
+; CHECK: @diamond
+; CHECK-NOT: store i32 1
+; CHECK: store i32 2
+; LOCAL: @diamond
+; LOCAL: store i32 1
+}
+
+; The value may be loaded on one path, so the first store is live.
+define i32 @read_on_path(i32* %p, i1 %c) {
+entry:
+  store i32 1, i32* %p
+  br i1 %c, label %then, label %join
+
+then:
+  %v = load i32* %p
+  br label %join
+
+join:
+  %r = phi i32 [ %v, %then ], [ 0, %entry ]
+  store i32 2, i32* %p
+  ret i32 %r
+; CHECK: @read_on_path
+; CHECK: store i32 1
+; CHECK: store i32 2
+}
+
+; The overwriting store doesn't post-dominate the first one.
+define void @no_postdom(i32* %p, i1 %c) {
+entry:
+  store i32 1, i32* %p
+  br i1 %c, label %then, label %exit
+
+then:
+  store i32 2, i32* %p
+  br label %exit
+
+exit:
+  ret void
+; CHECK: @no_postdom
+; CHECK: store i32 1
+; CHECK: store i32 2
+}
+
+; Stores to a local struct that is not read again before the function returns
+; are dead, even if the returning block is not the one that stores.
+define i32 @dead_local(i1 %c, i32 %x) {
+entry:
+  %s = alloca [4 x i32], align 4
+  %a = getelementptr inbounds [4 x i32]* %s, i64 0, i64 0
+  %b = getelementptr inbounds [4 x i32]* %s, i64 0, i64 1
+  store i32 %x, i32* %a
+  %v = load i32* %a
+  store i32 %v, i32* %b
+  br i1 %c, label %then, label %exit
+
+then:
+  store i32 0, i32* %a
+  br label %exit
+
+exit:
+  ret i32 %v
+; CHECK: @dead_local
+; CHECK: store i32 %x, i32* %a
+; CHECK-NOT: store
+; CHECK: ret i32 %v
+}
+
+; The local escapes into a call on the way to the return, so the store stays.
+define void @escaping_local(i1 %c) {
+entry:
+  %s = alloca i32, align 4
+  store i32 7, i32* %s
+  br i1 %c, label %then, label %exit
+
+then:
+  call void @capture(i32* %s)
+  br label %exit
+
+exit:
+  ret void
+; CHECK: @escaping_local
+; CHECK: store i32 7
+}
+
+; A store in a loop is read in the next iteration.
+define void @loop(i32* noalias %p, i32 %n) {
+entry:
+  %t = alloca i32, align 4
+  store i32 0, i32* %t
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  %old = load i32* %t
+  %new = add i32 %old, %i
+  store i32 %new, i32* %t
+  %i.next = add i32 %i, 1
+  %done = icmp eq i32 %i.next, %n
+  br i1 %done, label %exit, label %loop
+
+exit:
+  %r = load i32* %t
+  store i32 %r, i32* %p
+  ret void
+; CHECK: @loop
+; CHECK: store i32 0, i32* %t
+; CHECK: store i32 %new, i32* %t
+}
+
+; for (i = 0;; i += s) { a[i] = 1; if (i == n) break; a[i] = 2; }
+; The store in the header writes a different element than the latch store
+; it is reached from, so the latch store is live.
+define void @loop_latch(i32* %base, i64 %n, i64 %s) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %latch ]
+  %p = getelementptr i32* %base, i64 %i
+  store i32 1, i32* %p
+  %done = icmp eq i64 %i, %n
+  br i1 %done, label %exit, label %latch
+
+latch:
+  store i32 2, i32* %p
+  %i.next = add i64 %i, %s
+  %p.next = getelementptr i32* %base, i64 %i.next
+  call void @capture(i32* %p.next) readnone
+  br label %loop
+
+exit:
+  ret void
+; CHECK: @loop_latch
+; CHECK: store i32 1, i32* %p
+; CHECK: store i32 2, i32* %p
+}
@@ -0,0 +1,123 @@
+; RUN: opt < %s -function-specialization -S | FileCheck %s
+; RUN: opt < %s -function-specialization -ipsccp -instcombine -inline -S | FileCheck %s -check-prefix=OPT
+
+; A generic routine taking a comparison callback is cloned for each callback
+; it is called with, and the callback is then a direct, inlineable call.
+
+define internal i32 @cmp_lt(i32 %a, i32 %b) nounwind readnone {
+  %c = icmp slt i32 %a, %b
+  %r = zext i1 %c to i32
+  ret i32 %r
+}
+
+define internal i32 @cmp_gt(i32 %a, i32 %b) nounwind readnone {
+  %c = icmp sgt i32 %a, %b
+  %r = zext i1 %c to i32
+  ret i32 %r
+}
+
+define i32 @count(i32* %p, i32 %n, i32 %k, i32 (i32, i32)* %cmp) nounwind {
+entry:
+  %e = icmp sgt i32 %n, 0
+  br i1 %e, label %loop, label %exit
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  %s = phi i32 [ 0, %entry ], [ %s.next, %loop ]
+  %a = getelementptr i32* %p, i32 %i
+  %v = load i32* %a
+  %c = call i32 %cmp(i32 %v, i32 %k)
+  %s.next = add i32 %s, %c
+  %i.next = add i32 %i, 1
+  %d = icmp eq i32 %i.next, %n
+  br i1 %d, label %exit, label %loop
+
+exit:
+  %r = phi i32 [ 0, %entry ], [ %s.next, %loop ]
+  ret i32 %r
+}
+
+define i32 @use_count(i32* %p, i32 %n) nounwind {
+  %a = call i32 @count(i32* %p, i32 %n, i32 10, i32 (i32, i32)* @cmp_lt)
+  %b = call i32 @count(i32* %p, i32 %n, i32 20, i32 (i32, i32)* @cmp_gt)
+  %c = call i32 @count(i32* %p, i32 %n, i32 30, i32 (i32, i32)* @cmp_lt)
+  %s = add i32 %a, %b
+  %t = add i32 %s, %c
+  ret i32 %t
+}
+
+; CHECK: define internal i32 @count.spec(i32* %p, i32 %n, i32 %k)
+; CHECK: call i32 @cmp_lt(i32 %v, i32 %k)
+; CHECK: define internal i32 @count.spec1(i32* %p, i32 %n, i32 %k)
+; CHECK: call i32 @cmp_gt(i32 %v, i32 %k)
+; CHECK: define i32 @count(
+; CHECK: call i32 %cmp(
+; CHECK: define i32 @use_count
+; CHECK: call i32 @count.spec(i32* %p, i32 %n, i32 10)
+; CHECK: call i32 @count.spec1(i32* %p, i32 %n, i32 20)
+; CHECK: call i32 @count.spec(i32* %p, i32 %n, i32 30)
+
+; OPT: define i32 @use_count
+; OPT-NOT: call
+; OPT: icmp slt i32 %{{.*}}, 10
+; OPT-NOT: call
+; OPT: icmp sgt i32 %{{.*}}, 20
+; OPT-NOT: call
+; OPT: icmp slt i32 %{{.*}}, 30
+; OPT-NOT: call
+; OPT: ret i32
+
+; A flag that selects between two paths is specialized too, but an argument
+; that is only used as data is not.
+
+define i32 @mode(i32 %x, i1 %fast) nounwind readnone {
+  br i1 %fast, label %f, label %s
+
+f:
+  %a = shl i32 %x, 1
+  ret i32 %a
+
+s:
+  %b = mul i32 %x, 3
+  ret i32 %b
+}
+
+define i32 @data(i32 %x, i32 %y) nounwind readnone {
+  %a = add i32 %x, %y
+  ret i32 %a
+}
+
+define i32 @use_mode(i32 %x) nounwind {
+  %a = call i32 @mode(i32 %x, i1 true)
+  %b = call i32 @mode(i32 %x, i1 false)
+  %c = call i32 @data(i32 %x, i32 7)
+  %s = add i32 %a, %b
+  %t = add i32 %s, %c
+  ret i32 %t
+}
+
+; CHECK: define i32 @use_mode
+; CHECK: call i32 @mode.spec{{[0-9]*}}(i32 %x)
+; CHECK: call i32 @mode.spec{{[0-9]*}}(i32 %x)
+; CHECK: call i32 @data(i32 %x, i32 7)
+; CHECK-NOT: @data.spec
+
+; The clone keeps the calling convention of the original, which the
+; redirected calls use.
+
+define internal fastcc i32 @apply(i32 %x, i32 (i32, i32)* %f) nounwind {
+  %r = call i32 %f(i32 %x, i32 1)
+  ret i32 %r
+}
+
+define i32 @use_apply(i32 %x) nounwind {
+  %a = call fastcc i32 @apply(i32 %x, i32 (i32, i32)* @cmp_lt)
+  %b = call fastcc i32 @apply(i32 %a, i32 (i32, i32)* @cmp_gt)
+  %s = add i32 %a, %b
+  ret i32 %s
+}
+
+; CHECK: define internal fastcc i32 @apply.spec{{[0-9]*}}(i32 %x)
+; CHECK: define i32 @use_apply
+; CHECK: call fastcc i32 @apply.spec{{[0-9]*}}(i32 %x)
+; CHECK: call fastcc i32 @apply.spec{{[0-9]*}}(i32 %a)
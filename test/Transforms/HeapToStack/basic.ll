@@ -0,0 +1,177 @@
+; RUN: opt < %s -heap-to-stack -S | FileCheck %s
+
+declare noalias i8* @malloc(i64) nounwind
+declare void @free(i8*) nounwind
+declare i64 @strlen(i8* nocapture) nounwind readonly
+declare i8* @realloc(i8* nocapture, i64) nounwind
+declare void @capture(i8*)
+declare void @fill(i8* nocapture) nounwind
+
+; A temporary buffer that is freed before returning.
+define i64 @temporary(i8* %src) nounwind {
+  %buf = call i8* @malloc(i64 64)
+  call void @llvm.memcpy.p0i8.p0i8.i64(i8* %buf, i8* %src, i64 64, i32 1, i1 false)
+  %n = call i64 @strlen(i8* %buf)
+  call void @free(i8* %buf)
+  ret i64 %n
+; CHECK: @temporary
+; CHECK: %buf.stack = alloca [64 x i8], align 16
+; CHECK-NOT: @malloc
+; CHECK: call i64 @strlen(i8* %buf)
+; CHECK-NOT: @free
+; CHECK: ret i64 %n
+}
+
+; The buffer is only accessed through typed pointers, and it is never freed.
+define i32 @typed() nounwind {
+  %mem = call i8* @malloc(i64 4)
+  %p = bitcast i8* %mem to i32*
+  store i32 7, i32* %p
+  call void @fill(i8* %mem)
+  %v = load i32* %p
+  %f = bitcast i32* %p to i8*
+  call void @free(i8* %f)
+  ret i32 %v
+; CHECK: @typed
+; CHECK: alloca [4 x i8], align 4
+; CHECK-NOT: @malloc
+; CHECK-NOT: @free
+; CHECK: ret i32 %v
+}
+
+; Once the buffer is on the stack, a call that reads it can't be a tail call.
+define i64 @tail(i8* %src) nounwind {
+  %buf = call i8* @malloc(i64 32)
+  call void @llvm.memcpy.p0i8.p0i8.i64(i8* %buf, i8* %src, i64 32, i32 1, i1 false)
+  %n = tail call i64 @strlen(i8* %buf)
+  ret i64 %n
+; CHECK: @tail
+; CHECK: %buf.stack = alloca [32 x i8], align 16
+; CHECK-NOT: tail call
+; CHECK: %n = call i64 @strlen(i8* %buf)
+; CHECK: ret i64 %n
+}
+
+; A new buffer in each iteration can reuse the same stack slot.
+define void @loop(i64 %n) nounwind {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %buf = call i8* @malloc(i64 32)
+  call void @fill(i8* %buf)
+  call void @free(i8* %buf)
+  %i.next = add i64 %i, 1
+  %done = icmp eq i64 %i.next, %n
+  br i1 %done, label %exit, label %loop
+
+exit:
+  ret void
+; CHECK: @loop
+; CHECK: entry:
+; CHECK-NEXT: alloca [32 x i8]
+; CHECK-NOT: @malloc
+; CHECK-NOT: @free
+; CHECK: ret void
+}
+
+; The buffer of one iteration is still used in the next one.
+define void @loop_carried(i64 %n) nounwind {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %prev = phi i8* [ null, %entry ], [ %buf, %loop ]
+  %buf = call i8* @malloc(i64 32)
+  %v = load i8* %prev
+  store i8 %v, i8* %buf
+  call void @free(i8* %prev)
+  %i.next = add i64 %i, 1
+  %done = icmp eq i64 %i.next, %n
+  br i1 %done, label %exit, label %loop
+
+exit:
+  call void @free(i8* %buf)
+  ret void
+; CHECK: @loop_carried
+; CHECK: call i8* @malloc(i64 32)
+}
+
+; Escaping, too large, variable sized and reallocated buffers stay on the heap.
+define i8* @escapes() nounwind {
+  %buf = call i8* @malloc(i64 16)
+  ret i8* %buf
+; CHECK: @escapes
+; CHECK: call i8* @malloc(i64 16)
+}
+
+define void @captured() nounwind {
+  %buf = call i8* @malloc(i64 16)
+  call void @capture(i8* %buf)
+  ret void
+; CHECK: @captured
+; CHECK: call i8* @malloc(i64 16)
+}
+
+define void @too_large() nounwind {
+  %buf = call i8* @malloc(i64 4096)
+  call void @fill(i8* %buf)
+  call void @free(i8* %buf)
+  ret void
+; CHECK: @too_large
+; CHECK: call i8* @malloc(i64 4096)
+}
+
+define void @variable(i64 %n) nounwind {
+  %buf = call i8* @malloc(i64 %n)
+  call void @fill(i8* %buf)
+  call void @free(i8* %buf)
+  ret void
+; CHECK: @variable
+; CHECK: call i8* @malloc(i64 %n)
+}
+
+define void @reallocated() nounwind {
+  %buf = call i8* @malloc(i64 16)
+  %new = call i8* @realloc(i8* %buf, i64 32)
+  call void @free(i8* %new)
+  ret void
+; CHECK: @reallocated
+; CHECK: call i8* @malloc(i64 16)
+}
+
+; A free of a pointer that may be something else must not be deleted.
+define void @merged(i1 %c, i8* %other) nounwind {
+entry:
+  %buf = call i8* @malloc(i64 16)
+  br i1 %c, label %then, label %join
+
+then:
+  br label %join
+
+join:
+  %p = phi i8* [ %buf, %entry ], [ %other, %then ]
+  call void @free(i8* %p)
+  ret void
+; CHECK: @merged
+; CHECK: call i8* @malloc(i64 16)
+}
+
+; The limit covers all promoted buffers of a function.
+define void @budget() nounwind {
+  %a = call i8* @malloc(i64 1000)
+  call void @fill(i8* %a)
+  %b = call i8* @malloc(i64 100)
+  call void @fill(i8* %b)
+  call void @free(i8* %a)
+  call void @free(i8* %b)
+  ret void
+; CHECK: @budget
+; CHECK: alloca [1000 x i8]
+; CHECK-NOT: alloca
+; CHECK: %b = call i8* @malloc(i64 100)
+}
+
+declare void @llvm.memcpy.p0i8.p0i8.i64(i8* nocapture, i8* nocapture, i64, i32, i1) nounwind
@@ -0,0 +1,72 @@
+; RUN: opt < %s -basicaa -licm -S | FileCheck %s
+; RUN: opt < %s -basicaa -licm -alias-set-saturation-threshold=1 -S \
+; RUN:   | FileCheck %s -check-prefix=SATURATED
+; RUN: opt < %s -basicaa -licm -alias-set-max-sets=1 -S \
+; RUN:   | FileCheck %s -check-prefix=SATURATED
+
+@G = global i32 0
+
+; The stores through %a may alias each other but not @G, so the load of @G is
+; invariant.  Once the tracker saturates, either because of the size of its
+; may-alias sets or because of the number of sets, every pointer is assumed to
+; alias every other and the load stays in the loop.
+define void @test1(i32* noalias %a, i64 %j, i64 %n) {
+entry:
+  br label %loop
+; CHECK: @test1
+; CHECK: entry:
+; CHECK-NEXT: load i32* @G
+; CHECK: br label %loop
+
+; SATURATED: @test1
+; SATURATED: loop:
+; SATURATED: load i32* @G
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %g = load i32* @G
+  %p1 = getelementptr i32* %a, i64 %i
+  store i32 %g, i32* %p1
+  %p2 = getelementptr i32* %a, i64 %j
+  store i32 0, i32* %p2
+  %i.next = add i64 %i, 1
+  %cond = icmp eq i64 %i.next, %n
+  br i1 %cond, label %exit, label %loop
+
+exit:
+  ret void
+}
+
+; The inner loop's tracker is adopted by the outer loop, and @G is still known
+; not to be modified by either.
+define void @test2(i32* noalias %a, i64 %j, i64 %n) {
+entry:
+  br label %outer
+; CHECK: @test2
+; CHECK: entry:
+; CHECK-NEXT: load i32* @G
+; CHECK: br label %outer
+
+outer:
+  %k = phi i64 [ 0, %entry ], [ %k.next, %latch ]
+  br label %inner
+
+inner:
+  %i = phi i64 [ 0, %outer ], [ %i.next, %inner ]
+  %g = load i32* @G
+  %p1 = getelementptr i32* %a, i64 %i
+  store i32 %g, i32* %p1
+  %p2 = getelementptr i32* %a, i64 %j
+  store i32 0, i32* %p2
+  %i.next = add i64 %i, 1
+  %cond = icmp eq i64 %i.next, %n
+  br i1 %cond, label %latch, label %inner
+
+latch:
+  %k.next = add i64 %k, 1
+  %outer.cond = icmp eq i64 %k.next, %n
+  br i1 %outer.cond, label %exit, label %outer
+
+exit:
+  ret void
+}
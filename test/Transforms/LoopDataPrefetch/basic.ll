@@ -0,0 +1,88 @@
+; RUN: opt < %s -loop-data-prefetch -prefetch-distance=90 -prefetch-cache-line-size=64 -prefetch-cache-size=4096 -S | FileCheck %s
+; RUN: opt < %s -loop-data-prefetch -S | FileCheck %s -check-prefix=NOTARGET
+
+target datalayout = "e-p:64:64:64-i1:8:8-i8:8:8-i16:16:16-i32:32:32-i64:64:64-f32:32:32-f64:64:64-v64:64:64-v128:128:128-a0:0:64-s0:64:64-f80:128:128-n8:16:32:64"
+
+; A loop with an unknown trip count streams through memory.  Both loads are
+; prefetched 10 iterations ahead: the body costs 9 cycles.
+; CHECK: @stream
+; CHECK: for.body:
+; CHECK: %prefetch.addr = getelementptr i8* %{{.*}}, i64 80
+; CHECK-NEXT: call void @llvm.prefetch(i8* %prefetch.addr, i32 0, i32 3)
+; CHECK-NEXT: load i64* %pa
+; CHECK: %prefetch.addr{{[0-9]+}} = getelementptr i8* %{{.*}}, i64 80
+; CHECK-NEXT: call void @llvm.prefetch(i8* %prefetch.addr{{[0-9]+}}, i32 0, i32 3)
+; CHECK-NEXT: load i64* %pb
+; CHECK: ret
+; NOTARGET: @stream
+; NOTARGET-NOT: llvm.prefetch
+; NOTARGET: ret
+define void @stream(i64* %a, i64* %b, i64 %n) nounwind {
+entry:
+  br label %for.body
+
+for.body:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %for.body ]
+  %pa = getelementptr i64* %a, i64 %i
+  %x = load i64* %pa, align 8
+  %pb = getelementptr i64* %b, i64 %i
+  %y = load i64* %pb, align 8
+  %sum = add i64 %x, %y
+  store i64 %sum, i64* %pa, align 8
+  %i.next = add i64 %i, 1
+  %cmp = icmp slt i64 %i.next, %n
+  br i1 %cmp, label %for.body, label %for.end
+
+for.end:
+  ret void
+}
+
+; Loads within one cache line of each other share a prefetch.
+; CHECK: @sameline
+; CHECK: call void @llvm.prefetch
+; CHECK-NOT: call void @llvm.prefetch
+; CHECK: ret
+define i32 @sameline(i32* %a, i64 %n) nounwind {
+entry:
+  br label %for.body
+
+for.body:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %for.body ]
+  %s = phi i32 [ 0, %entry ], [ %s.next, %for.body ]
+  %j = shl i64 %i, 1
+  %p0 = getelementptr i32* %a, i64 %j
+  %x = load i32* %p0, align 4
+  %j1 = or i64 %j, 1
+  %p1 = getelementptr i32* %a, i64 %j1
+  %y = load i32* %p1, align 4
+  %t = add i32 %x, %y
+  %s.next = add i32 %s, %t
+  %i.next = add i64 %i, 1
+  %cmp = icmp slt i64 %i.next, %n
+  br i1 %cmp, label %for.body, label %for.end
+
+for.end:
+  ret i32 %s.next
+}
+
+; A loop whose data fits in the cache isn't prefetched.
+; CHECK: @small
+; CHECK-NOT: llvm.prefetch
+; CHECK: ret
+define i64 @small(i64* %a) nounwind {
+entry:
+  br label %for.body
+
+for.body:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %for.body ]
+  %s = phi i64 [ 0, %entry ], [ %s.next, %for.body ]
+  %p = getelementptr i64* %a, i64 %i
+  %x = load i64* %p, align 8
+  %s.next = add i64 %s, %x
+  %i.next = add i64 %i, 1
+  %cmp = icmp ult i64 %i.next, 100
+  br i1 %cmp, label %for.body, label %for.end
+
+for.end:
+  ret i64 %s.next
+}
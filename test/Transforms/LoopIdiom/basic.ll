@@ -273,3 +273,51 @@ for.end13:                                        ; preds = %for.inc10
 ; CHECK-NOT: store
 ; CHECK: ret void
 }
+
+; Two stores that together fill each element of an array of complex floats:
+;   for (i) { __real__(P[i]) = 0;  __imag__(P[i]) = 0; }
+define void @test11({ float, float }* %P, i64 %Size) nounwind ssp {
+entry:
+  br label %for.body
+
+for.body:                                         ; preds = %entry, %for.body
+  %indvar = phi i64 [ 0, %entry ], [ %indvar.next, %for.body ]
+  %re = getelementptr { float, float }* %P, i64 %indvar, i32 0
+  %im = getelementptr { float, float }* %P, i64 %indvar, i32 1
+  store float 0.000000e+00, float* %re, align 4
+  store float 0.000000e+00, float* %im, align 4
+  %indvar.next = add i64 %indvar, 1
+  %exitcond = icmp eq i64 %indvar.next, %Size
+  br i1 %exitcond, label %for.end, label %for.body
+
+for.end:                                          ; preds = %for.body
+  ret void
+; CHECK: @test11
+; CHECK: call void @llvm.memset.p0i8.i64(i8* %{{.*}}, i8 0, i64 %{{.*}}, i32 4, i1 false)
+; CHECK-NOT: store
+; CHECK: ret void
+}
+
+; The stores leave a gap in each element, so this isn't a memset.
+define void @test12({ i32, i32, i32 }* %P, i64 %Size) nounwind ssp {
+entry:
+  br label %for.body
+
+for.body:                                         ; preds = %entry, %for.body
+  %indvar = phi i64 [ 0, %entry ], [ %indvar.next, %for.body ]
+  %a = getelementptr { i32, i32, i32 }* %P, i64 %indvar, i32 0
+  %c = getelementptr { i32, i32, i32 }* %P, i64 %indvar, i32 2
+  store i32 0, i32* %a, align 4
+  store i32 0, i32* %c, align 4
+  %indvar.next = add i64 %indvar, 1
+  %exitcond = icmp eq i64 %indvar.next, %Size
+  br i1 %exitcond, label %for.end, label %for.body
+
+for.end:                                          ; preds = %for.body
+  ret void
+; CHECK: @test12
+; CHECK-NOT: memset
+; CHECK: store i32 0
+; CHECK: store i32 0
+; CHECK: ret void
+}
@@ -0,0 +1,68 @@
+; RUN: opt -loop-idiom -loop-idiom-bitcount < %s -S | FileCheck %s
+; RUN: opt -loop-idiom < %s -S | FileCheck %s -check-prefix=NOTARGET
+target datalayout = "e-p:64:64:64-i1:8:8-i8:8:8-i16:16:16-i32:32:32-i64:64:64-f32:32:32-f64:64:64-v64:64:64-v128:128:128-a0:0:64-s0:64:64-f80:128:128-n8:16:32:64"
+
+; for (n = 0; x; ++n)
+;   x &= x - 1;
+define i32 @popcount(i32 %x) nounwind readnone {
+entry:
+  %z = icmp eq i32 %x, 0
+  br i1 %z, label %done, label %loop
+
+loop:
+  %v = phi i32 [ %x, %entry ], [ %v.next, %loop ]
+  %n = phi i32 [ 0, %entry ], [ %n.next, %loop ]
+  %v.1 = add i32 %v, -1
+  %v.next = and i32 %v, %v.1
+  %n.next = add i32 %n, 1
+  %z.next = icmp eq i32 %v.next, 0
+  br i1 %z.next, label %done.loopexit, label %loop
+
+done.loopexit:
+  %n.lcssa = phi i32 [ %n.next, %loop ]
+  br label %done
+
+done:
+  %r = phi i32 [ 0, %entry ], [ %n.lcssa, %done.loopexit ]
+  ret i32 %r
+; CHECK: @popcount
+; CHECK: call i32 @llvm.ctpop.i32(i32 %x)
+; CHECK-NOT: and i32
+; CHECK: ret i32
+; NOTARGET: @popcount
+; NOTARGET-NOT: ctpop
+; NOTARGET: ret i32
+}
+
+; for (n = 0; x; ++n)
+;   x >>= 1;
+define i64 @bits(i64 %x) nounwind readnone {
+entry:
+  %z = icmp eq i64 %x, 0
+  br i1 %z, label %done, label %loop
+
+loop:
+  %v = phi i64 [ %x, %entry ], [ %v.next, %loop ]
+  %n = phi i64 [ 0, %entry ], [ %n.next, %loop ]
+  %v.next = lshr i64 %v, 1
+  %n.next = add i64 %n, 1
+  %nz = icmp ne i64 %v.next, 0
+  br i1 %nz, label %loop, label %done.loopexit
+
+done.loopexit:
+  %n.lcssa = phi i64 [ %n.next, %loop ]
+  %v.lcssa = phi i64 [ %v.next, %loop ]
+  br label %done
+
+done:
+  %r = phi i64 [ 0, %entry ], [ %n.lcssa, %done.loopexit ]
+  %rv = phi i64 [ %x, %entry ], [ %v.lcssa, %done.loopexit ]
+  %s = add i64 %r, %rv
+  ret i64 %s
+; CHECK: @bits
+; CHECK: %[[CTLZ:.*]] = call i64 @llvm.ctlz.i64(i64 %x)
+; CHECK: sub i64 64, %[[CTLZ]]
+; CHECK: phi i64 [ 0, %{{.*}} ]
+; CHECK-NOT: lshr
+; CHECK: ret i64
+}
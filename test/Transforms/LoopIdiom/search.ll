@@ -0,0 +1,277 @@
+; RUN: opt -basicaa -loop-idiom -loop-idiom-string-libcalls < %s -S | FileCheck %s
+; RUN: opt -basicaa -loop-idiom < %s -S | FileCheck %s -check-prefix=NOLIB
+target datalayout = "e-p:64:64:64-i1:8:8-i8:8:8-i16:16:16-i32:32:32-i64:64:64-f32:32:32-f64:64:64-v64:64:64-v128:128:128-a0:0:64-s0:64:64-f80:128:128-n8:16:32:64"
+target triple = "x86_64-apple-darwin10.0.0"
+
+; for (n = 0; s[n]; ++n) ;
+define i64 @length(i8* %s) nounwind ssp {
+entry:
+  %c0 = load i8* %s, align 1
+  %z0 = icmp eq i8 %c0, 0
+  br i1 %z0, label %done, label %loop
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %i.next = add i64 %i, 1
+  %p = getelementptr i8* %s, i64 %i.next
+  %c = load i8* %p, align 1
+  %z = icmp eq i8 %c, 0
+  br i1 %z, label %done.loopexit, label %loop
+
+done.loopexit:
+  %n.lcssa = phi i64 [ %i.next, %loop ]
+  br label %done
+
+done:
+  %n = phi i64 [ 0, %entry ], [ %n.lcssa, %done.loopexit ]
+  ret i64 %n
+; CHECK: @length
+; CHECK: %strlen = call i64 @strlen(i8* %{{.*}})
+; CHECK-NEXT: %{{.*}} = add i64 %strlen, 1
+; CHECK-NEXT: br label %done.loopexit
+; CHECK-NOT: load
+; CHECK: ret i64
+; NOLIB: @length
+; NOLIB-NOT: strlen
+; NOLIB: ret i64
+}
+
+; for (i = 0; i < n; ++i)
+;   if (p[i] == c)
+;     break;
+define i64 @find(i8* %p, i8 %c, i64 %n) nounwind ssp {
+entry:
+  %empty = icmp eq i64 %n, 0
+  br i1 %empty, label %done, label %loop
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %latch ]
+  %a = getelementptr i8* %p, i64 %i
+  %b = load i8* %a, align 1
+  %f = icmp eq i8 %b, %c
+  br i1 %f, label %done.loopexit, label %latch
+
+latch:
+  %i.next = add i64 %i, 1
+  %more = icmp ult i64 %i.next, %n
+  br i1 %more, label %loop, label %done.loopexit
+
+done.loopexit:
+  %r.lcssa = phi i64 [ %i, %loop ], [ %i.next, %latch ]
+  br label %done
+
+done:
+  %r = phi i64 [ 0, %entry ], [ %r.lcssa, %done.loopexit ]
+  ret i64 %r
+; CHECK: @find
+; CHECK: %memchr = call i8* @memchr(i8* %p, i32 %{{.*}}, i64 %{{.*}})
+; CHECK-NEXT: %memchr.found = icmp ne i8* %memchr, null
+; CHECK: %memchr.index = sub i64
+; CHECK: select i1 %memchr.found
+; CHECK-NEXT: br label %done.loopexit
+; CHECK-NOT: load
+; CHECK: ret i64
+; NOLIB: @find
+; NOLIB-NOT: memchr
+; NOLIB: ret i64
+}
+
+@ga = global [16 x i8] zeroinitializer
+@gb = global [16 x i8] zeroinitializer
+@weak = weak global [16 x i8] zeroinitializer
+
+; for (i = 0; i != 16; ++i)
+;   if (ga[i] != gb[i])
+;     return false;
+; return true;
+define zeroext i1 @equal() nounwind ssp {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %latch ]
+  %pa = getelementptr [16 x i8]* @ga, i64 0, i64 %i
+  %pb = getelementptr [16 x i8]* @gb, i64 0, i64 %i
+  %ca = load i8* %pa, align 1
+  %cb = load i8* %pb, align 1
+  %ne = icmp ne i8 %ca, %cb
+  br i1 %ne, label %differ, label %latch
+
+latch:
+  %i.next = add i64 %i, 1
+  %end = icmp eq i64 %i.next, 16
+  br i1 %end, label %same, label %loop
+
+differ:
+  ret i1 false
+
+same:
+  ret i1 true
+; CHECK: @equal
+; CHECK: %memcmp = call i32 @memcmp(i8* getelementptr inbounds ([16 x i8]* @ga, i32 0, i32 0), i8* getelementptr inbounds ([16 x i8]* @gb, i32 0, i32 0), i64 16)
+; CHECK-NEXT: %memcmp.ne = icmp ne i32 %memcmp, 0
+; CHECK-NEXT: br i1 %memcmp.ne, label %differ, label %same
+; NOLIB: @equal
+; NOLIB-NOT: memcmp
+; NOLIB: ret i1
+}
+
+; The loop stops at the first difference, but memcmp may read all n bytes,
+; which need not exist.
+define zeroext i1 @equal_unknown(i8* %a, i8* %b, i64 %n) nounwind ssp {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %latch ]
+  %pa = getelementptr i8* %a, i64 %i
+  %pb = getelementptr i8* %b, i64 %i
+  %ca = load i8* %pa, align 1
+  %cb = load i8* %pb, align 1
+  %ne = icmp ne i8 %ca, %cb
+  br i1 %ne, label %differ, label %latch
+
+latch:
+  %i.next = add i64 %i, 1
+  %end = icmp eq i64 %i.next, %n
+  br i1 %end, label %same, label %loop
+
+differ:
+  ret i1 false
+
+same:
+  ret i1 true
+; CHECK: @equal_unknown
+; CHECK-NOT: memcmp
+; CHECK: ret i1 true
+}
+
+; Without a bound there is no length to give memcmp.
+define zeroext i1 @equal_unbounded(i8* %a, i8* %b) nounwind ssp {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %pa = getelementptr i8* %a, i64 %i
+  %pb = getelementptr i8* %b, i64 %i
+  %ca = load i8* %pa, align 1
+  %cb = load i8* %pb, align 1
+  %i.next = add i64 %i, 1
+  %eq = icmp eq i8 %ca, %cb
+  br i1 %eq, label %loop, label %differ
+
+differ:
+  ret i1 false
+; CHECK: @equal_unbounded
+; CHECK-NOT: memcmp
+; CHECK: ret i1 false
+}
+
+; Comparing 16 bytes starting at offset 4 would run past the end of @ga, and
+; a weak definition may be replaced by a smaller one.
+define zeroext i1 @equal_past_end() nounwind ssp {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %latch ]
+  %j = add i64 %i, 4
+  %pa = getelementptr [16 x i8]* @ga, i64 0, i64 %j
+  %pb = getelementptr [16 x i8]* @weak, i64 0, i64 %i
+  %ca = load i8* %pa, align 1
+  %cb = load i8* %pb, align 1
+  %ne = icmp ne i8 %ca, %cb
+  br i1 %ne, label %differ, label %latch
+
+latch:
+  %i.next = add i64 %i, 1
+  %end = icmp eq i64 %i.next, 16
+  br i1 %end, label %same, label %loop
+
+differ:
+  ret i1 false
+
+same:
+  ret i1 true
+; CHECK: @equal_past_end
+; CHECK-NOT: memcmp
+; CHECK: ret i1 true
+}
+
+; A local buffer can be compared as a whole.
+define zeroext i1 @equal_local() nounwind ssp {
+entry:
+  %buf = alloca [8 x i8], align 1
+  %b0 = getelementptr [8 x i8]* %buf, i64 0, i64 0
+  call void @fill(i8* %b0)
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %latch ]
+  %j = add i64 %i, 8
+  %pa = getelementptr [16 x i8]* @ga, i64 0, i64 %j
+  %pb = getelementptr [8 x i8]* %buf, i64 0, i64 %i
+  %ca = load i8* %pa, align 1
+  %cb = load i8* %pb, align 1
+  %ne = icmp ne i8 %ca, %cb
+  br i1 %ne, label %differ, label %latch
+
+latch:
+  %i.next = add i64 %i, 1
+  %end = icmp eq i64 %i.next, 8
+  br i1 %end, label %same, label %loop
+
+differ:
+  ret i1 false
+
+same:
+  ret i1 true
+; CHECK: @equal_local
+; CHECK: %memcmp = call i32 @memcmp(i8* getelementptr inbounds ([16 x i8]* @ga, i64 0, i64 8), i8* %{{.*}}, i64 8)
+}
+
+declare void @fill(i8*)
+
+; The loop stores the bytes it looks at, so it is not a search.
+define i64 @clear(i8* %s) nounwind ssp {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %p = getelementptr i8* %s, i64 %i
+  %c = load i8* %p, align 1
+  store i8 1, i8* %p, align 1
+  %i.next = add i64 %i, 1
+  %z = icmp eq i8 %c, 0
+  br i1 %z, label %done, label %loop
+
+done:
+  %n = phi i64 [ %i, %loop ]
+  ret i64 %n
+; CHECK: @clear
+; CHECK-NOT: strlen
+; CHECK: ret i64
+}
+
+; Library functions are not turned into calls to themselves.
+define i64 @strlen(i8* %s) nounwind ssp {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %p = getelementptr i8* %s, i64 %i
+  %c = load i8* %p, align 1
+  %i.next = add i64 %i, 1
+  %z = icmp eq i8 %c, 0
+  br i1 %z, label %done, label %loop
+
+done:
+  %n = phi i64 [ %i, %loop ]
+  ret i64 %n
+; CHECK: define i64 @strlen
+; CHECK: loop:
+; CHECK: ret i64
+}
@@ -0,0 +1,178 @@
+; RUN: opt < %s -basicaa -loop-interchange -S | FileCheck %s
+
+target datalayout = "e-p:64:64:64-i1:8:8-i8:8:8-i16:16:16-i32:32:32-i64:64:64-f32:32:32-f64:64:64-v64:64:64-v128:128:128-a0:0:64-s0:64:64-f80:128:128-n8:16:32:64"
+
+@x = common global [64 x [64 x i32]] zeroinitializer, align 4
+@y = common global [64 x [64 x i32]] zeroinitializer, align 4
+
+;; for (i = 0; i < 64; i++)
+;;   for (j = 0; j < 64; j++)
+;;     x[j][i] += y[j][i]
+;; // the inner loop walks down the columns, so the loops are interchanged.
+
+; CHECK: @f1
+; CHECK: outer:
+; CHECK-NEXT: %j = phi i64 [ 0, %entry ], [ %j.next, %outer.latch ]
+; CHECK: inner:
+; CHECK-NEXT: %i = phi i64 [ 0, %outer ], [ %i.next, %inner ]
+; CHECK: %i.next = add i64 %i, 1
+; CHECK-NEXT: %outer.cond = icmp eq i64 %i.next, 64
+; CHECK-NEXT: br i1 %outer.cond, label %outer.latch, label %inner
+; CHECK: outer.latch:
+; CHECK-NEXT: %j.next = add i64 %j, 1
+; CHECK-NEXT: %inner.cond = icmp eq i64 %j.next, 64
+; CHECK-NEXT: br i1 %inner.cond, label %exit, label %outer
+define void @f1() nounwind {
+entry:
+  br label %outer
+
+outer:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %outer.latch ]
+  br label %inner
+
+inner:
+  %j = phi i64 [ 0, %outer ], [ %j.next, %inner ]
+  %x.addr = getelementptr [64 x [64 x i32]]* @x, i64 0, i64 %j, i64 %i
+  %y.addr = getelementptr [64 x [64 x i32]]* @y, i64 0, i64 %j, i64 %i
+  %x = load i32* %x.addr
+  %y = load i32* %y.addr
+  %r = add i32 %x, %y
+  store i32 %r, i32* %x.addr
+  %j.next = add i64 %j, 1
+  %inner.cond = icmp eq i64 %j.next, 64
+  br i1 %inner.cond, label %outer.latch, label %inner
+
+outer.latch:
+  %i.next = add i64 %i, 1
+  %outer.cond = icmp eq i64 %i.next, 64
+  br i1 %outer.cond, label %exit, label %outer
+
+exit:
+  ret void
+}
+
+;; for (i = 0; i < 64; i++)
+;;   for (j = 0; j < 64; j++)
+;;     x[i][j] += y[i][j]
+;; // the inner loop already walks along the rows.
+
+; CHECK: @f2
+; CHECK: outer:
+; CHECK-NEXT: %i = phi
+; CHECK: inner:
+; CHECK-NEXT: %j = phi
+; CHECK: ret
+define void @f2() nounwind {
+entry:
+  br label %outer
+
+outer:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %outer.latch ]
+  br label %inner
+
+inner:
+  %j = phi i64 [ 0, %outer ], [ %j.next, %inner ]
+  %x.addr = getelementptr [64 x [64 x i32]]* @x, i64 0, i64 %i, i64 %j
+  %y.addr = getelementptr [64 x [64 x i32]]* @y, i64 0, i64 %i, i64 %j
+  %x = load i32* %x.addr
+  %y = load i32* %y.addr
+  %r = add i32 %x, %y
+  store i32 %r, i32* %x.addr
+  %j.next = add i64 %j, 1
+  %inner.cond = icmp eq i64 %j.next, 64
+  br i1 %inner.cond, label %outer.latch, label %inner
+
+outer.latch:
+  %i.next = add i64 %i, 1
+  %outer.cond = icmp eq i64 %i.next, 64
+  br i1 %outer.cond, label %exit, label %outer
+
+exit:
+  ret void
+}
+
+;; for (i = 1; i < 64; i++)
+;;   for (j = 0; j < 63; j++)
+;;     x[j][i] = x[j+1][i-1]
+;; // the dependence has distance (1, -1): iteration (i, j) reads what
+;; // iteration (i-1, j+1) wrote, which would run later after interchange.
+
+; CHECK: @f3
+; CHECK: outer:
+; CHECK-NEXT: %i = phi
+; CHECK: inner:
+; CHECK-NEXT: %j = phi
+; CHECK: ret
+define void @f3() nounwind {
+entry:
+  br label %outer
+
+outer:
+  %i = phi i64 [ 1, %entry ], [ %i.next, %outer.latch ]
+  %i.1 = add i64 %i, -1
+  br label %inner
+
+inner:
+  %j = phi i64 [ 0, %outer ], [ %j.next, %inner ]
+  %j.next = add i64 %j, 1
+  %ld.addr = getelementptr [64 x [64 x i32]]* @x, i64 0, i64 %j.next, i64 %i.1
+  %st.addr = getelementptr [64 x [64 x i32]]* @x, i64 0, i64 %j, i64 %i
+  %x = load i32* %ld.addr
+  store i32 %x, i32* %st.addr
+  %inner.cond = icmp eq i64 %j.next, 63
+  br i1 %inner.cond, label %outer.latch, label %inner
+
+outer.latch:
+  %i.next = add i64 %i, 1
+  %outer.cond = icmp eq i64 %i.next, 64
+  br i1 %outer.cond, label %exit, label %outer
+
+exit:
+  ret void
+}
+
+;; for (i = 1; i < 64; i++)
+;;   for (j = 1; j < 64; j++)
+;;     x[j][i] = x[j-1][i-1]
+;; // the dependence has distance (1, 1), which interchange preserves.  The
+;; // outer header computes i-1, which moves into the new inner loop.
+
+; CHECK: @f4
+; CHECK: outer:
+; CHECK-NEXT: %j = phi i64 [ 1, %entry ], [ %j.next, %outer.latch ]
+; CHECK: inner:
+; CHECK-NEXT: %i = phi i64 [ 1, %outer ], [ %i.next, %inner ]
+; CHECK-NEXT: %i.1 = add i64 %i, -1
+; CHECK: %j.next.body = add i64 %j, 1
+; CHECK: outer.latch:
+; CHECK-NEXT: %j.next = add i64 %j, 1
+define void @f4() nounwind {
+entry:
+  br label %outer
+
+outer:
+  %i = phi i64 [ 1, %entry ], [ %i.next, %outer.latch ]
+  %i.1 = add i64 %i, -1
+  br label %inner
+
+inner:
+  %j = phi i64 [ 1, %outer ], [ %j.next, %inner ]
+  %j.next = add i64 %j, 1
+  %j.1 = add i64 %j, -1
+  %ld.addr = getelementptr [64 x [64 x i32]]* @x, i64 0, i64 %j.1, i64 %i.1
+  %st.addr = getelementptr [64 x [64 x i32]]* @x, i64 0, i64 %j, i64 %i
+  %x = load i32* %ld.addr
+  %x.j = trunc i64 %j.next to i32
+  %r = add i32 %x, %x.j
+  store i32 %r, i32* %st.addr
+  %inner.cond = icmp eq i64 %j.next, 64
+  br i1 %inner.cond, label %outer.latch, label %inner
+
+outer.latch:
+  %i.next = add i64 %i, 1
+  %outer.cond = icmp eq i64 %i.next, 64
+  br i1 %outer.cond, label %exit, label %outer
+
+exit:
+  ret void
+}
@@ -0,0 +1,97 @@
+; RUN: opt < %s -basicaa -loop-interchange -S | FileCheck %s
+; RUN: opt < %s -basicaa -loop-interchange -loop-interchange-cache-size=0 -S | FileCheck %s -check-prefix=NOTILE
+
+target datalayout = "e-p:64:64:64-i1:8:8-i8:8:8-i16:16:16-i32:32:32-i64:64:64-f32:32:32-f64:64:64-v64:64:64-v128:128:128-a0:0:64-s0:64:64-f80:128:128-n8:16:32:64"
+
+@x = common global [1024 x [1024 x i32]] zeroinitializer, align 4
+@y = common global [1024 x [1024 x i32]] zeroinitializer, align 4
+
+;; for (i = 0; i < 1024; i++)
+;;   for (j = 0; j < 1024; j++)
+;;     x[i][j] = y[j][i]
+;; // Each iteration of the inner loop touches a new line of y, which is
+;; // reused by the next iteration of the outer loop.  The inner loop costs
+;; // 68 bytes per iteration, so tiles of 128 iterations fit in half of the
+;; // 32k cache.
+
+; CHECK: @transpose
+; CHECK: tile.header:
+; CHECK-NEXT: %tile = phi i64 [ 0, %entry ], [ %tile.next, %tile.latch ]
+; CHECK-NEXT: %tile.left = sub i64 1023, %tile
+; CHECK: %tile.last = select i1 %{{.*}}, i64 %tile.left, i64 127
+; CHECK: %tile.start = add i64 0,
+; CHECK: %tile.end = add i64 %tile.start,
+; CHECK: %tile.more = icmp ugt i64 %tile.left, 127
+; CHECK-NEXT: br label %outer
+; CHECK: outer:
+; CHECK-NEXT: %i = phi i64 [ 0, %tile.header ], [ %i.next, %outer.latch ]
+; CHECK: inner:
+; CHECK-NEXT: %j = phi i64 [ %tile.start, %outer ], [ %j.next, %inner ]
+; CHECK: %tile.cond = icmp ne i64 %j.next, %tile.end
+; CHECK-NEXT: br i1 %tile.cond, label %inner, label %outer.latch
+; CHECK: outer.latch:
+; CHECK: br i1 %outer.cond, label %tile.latch, label %outer
+; CHECK: tile.latch:
+; CHECK-NEXT: %tile.next = add i64 %tile, 128
+; CHECK-NEXT: br i1 %tile.more, label %tile.header, label %exit
+; NOTILE: @transpose
+; NOTILE-NOT: tile
+; NOTILE: ret
+define void @transpose() nounwind {
+entry:
+  br label %outer
+
+outer:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %outer.latch ]
+  br label %inner
+
+inner:
+  %j = phi i64 [ 0, %outer ], [ %j.next, %inner ]
+  %y.addr = getelementptr [1024 x [1024 x i32]]* @y, i64 0, i64 %j, i64 %i
+  %x.addr = getelementptr [1024 x [1024 x i32]]* @x, i64 0, i64 %i, i64 %j
+  %y = load i32* %y.addr
+  store i32 %y, i32* %x.addr
+  %j.next = add i64 %j, 1
+  %inner.cond = icmp eq i64 %j.next, 1024
+  br i1 %inner.cond, label %outer.latch, label %inner
+
+outer.latch:
+  %i.next = add i64 %i, 1
+  %outer.cond = icmp eq i64 %i.next, 1024
+  br i1 %outer.cond, label %exit, label %outer
+
+exit:
+  ret void
+}
+
+;; Transposing a 64x64 block fits in the cache as it is.
+
+; CHECK: @small
+; CHECK-NOT: tile
+; CHECK: ret
+define void @small() nounwind {
+entry:
+  br label %outer
+
+outer:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %outer.latch ]
+  br label %inner
+
+inner:
+  %j = phi i64 [ 0, %outer ], [ %j.next, %inner ]
+  %y.addr = getelementptr [1024 x [1024 x i32]]* @y, i64 0, i64 %j, i64 %i
+  %x.addr = getelementptr [1024 x [1024 x i32]]* @x, i64 0, i64 %i, i64 %j
+  %y = load i32* %y.addr
+  store i32 %y, i32* %x.addr
+  %j.next = add i64 %j, 1
+  %inner.cond = icmp eq i64 %j.next, 64
+  br i1 %inner.cond, label %outer.latch, label %inner
+
+outer.latch:
+  %i.next = add i64 %i, 1
+  %outer.cond = icmp eq i64 %i.next, 64
+  br i1 %outer.cond, label %exit, label %outer
+
+exit:
+  ret void
+}
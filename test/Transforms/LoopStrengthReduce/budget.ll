@@ -0,0 +1,77 @@
+; RUN: opt < %s -loop-reduce -S | FileCheck %s
+; RUN: opt < %s -loop-reduce -lsr-formula-budget=2 -S | FileCheck %s
+; RUN: opt < %s -loop-reduce -lsr-solver-budget=0 -S | FileCheck %s
+; RUN: opt < %s -loop-reduce -lsr-max-uses=2 -S | FileCheck %s -check-prefix=FALLBACK
+; RUN: opt < %s -loop-reduce -lsr-formula-budget=2 -disable-output -stats \
+; RUN:   -info-output-file - | FileCheck %s -check-prefix=BUDGET
+; RUN: opt < %s -loop-reduce -lsr-max-uses=2 -disable-output -stats \
+; RUN:   -info-output-file - | FileCheck %s -check-prefix=KEPT
+
+; With a small complexity budget LSR still finds a solution, but a loop with
+; more uses than -lsr-max-uses keeps its original induction variable.
+
+; CHECK: @many_uses
+; CHECK: %lsr.iv = phi i64
+
+; FALLBACK: @many_uses
+; FALLBACK-NOT: %lsr.iv
+; FALLBACK: %i = phi i64
+
+; BUDGET: 1 loop-reduce - Number of loops that hit the LSR complexity budget
+; BUDGET-NOT: IVs were kept
+
+; KEPT: 1 loop-reduce - Number of loops that hit the LSR complexity budget
+; KEPT: 1 loop-reduce - Number of loops whose IVs were kept because of the budget
+
+target datalayout = "e-p:64:64:64-i1:8:8-i8:8:8-i16:16:16-i32:32:32-i64:64:64-f32:32:32-f64:64:64-v64:64:64-v128:128:128-a0:0:64-s0:64:64-f80:128:128-n8:16:32:64"
+target triple = "x86_64-unknown-linux-gnu"
+
+define i64 @many_uses(i8* %a0, i8* %a1, i64 %o0, i64 %o1, i64 %n) nounwind {
+entry:
+  %cmp = icmp sgt i64 %n, 0
+  br i1 %cmp, label %loop, label %exit
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %sum = phi i64 [ 0, %entry ], [ %sum.next, %loop ]
+  %j0.0 = add i64 %i, %o0
+  %idx0 = mul i64 %j0.0, 1
+  %off0 = add i64 %idx0, 0
+  %p0 = getelementptr i8* %a0, i64 %off0
+  %v0 = load i8* %p0
+  %x0 = zext i8 %v0 to i64
+  %s0 = add i64 %sum, %x0
+  %j1.0 = add i64 %i, %o1
+  %idx1 = mul i64 %j1.0, 2
+  %off1 = add i64 %idx1, 7
+  %p1 = getelementptr i8* %a1, i64 %off1
+  %q1 = bitcast i8* %p1 to i16*
+  %v1 = load i16* %q1
+  %x1 = zext i16 %v1 to i64
+  %s1 = add i64 %s0, %x1
+  %j2.0 = add i64 %i, %o0
+  %idx2 = mul i64 %j2.0, 1
+  %off2 = add i64 %idx2, 14
+  %p2 = getelementptr i8* %a0, i64 %off2
+  %q2 = bitcast i8* %p2 to i32*
+  %v2 = load i32* %q2
+  %x2 = zext i32 %v2 to i64
+  %s2 = add i64 %s1, %x2
+  %j3.0 = add i64 %i, %o1
+  %idx3 = mul i64 %j3.0, 2
+  %off3 = add i64 %idx3, 21
+  %p3 = getelementptr i8* %a1, i64 %off3
+  %q3 = bitcast i8* %p3 to i64*
+  %v3 = load i64* %q3
+  %x3 = add i64 %v3, 0
+  %s3 = add i64 %s2, %x3
+  %sum.next = add i64 %s3, 0
+  %i.next = add i64 %i, 1
+  %done = icmp eq i64 %i.next, %n
+  br i1 %done, label %exit, label %loop
+
+exit:
+  %r = phi i64 [ 0, %entry ], [ %sum.next, %loop ]
+  ret i64 %r
+}
+
@@ -0,0 +1,79 @@
+; RUN: opt < %s -loop-unroll -S | FileCheck %s
+; RUN: opt < %s -loop-unroll -unroll-runtime=false -S | FileCheck %s -check-prefix=NORUNTIME
+
+target datalayout = "e-p:64:64:64-i1:8:8-i8:8:8-i16:16:16-i32:32:32-i64:64:64-f32:32:32-f64:64:64-v64:64:64-v128:128:128-a0:0:64-s0:64:64-f80:128:128-n8:16:32:64"
+
+; The left over iterations run in a prolog loop, and the loop body is then
+; unrolled with a single exit test.
+
+; CHECK: @sum
+; CHECK: %xtraiter = and i32 %tripcount, 7
+; CHECK: %lcmp.mod = icmp ne i32 %xtraiter, 0
+; CHECK: br i1 %lcmp.mod, label %prol.ph, label %prol.end
+; CHECK: for.body.prol:
+; CHECK: %prol.iter.cmp = icmp ne i32 %prol.iter.sub, 0
+; CHECK: br i1 %prol.iter.cmp, label %for.body.prol, label %prol.exit
+; CHECK: prol.end:
+; CHECK: %lcmp.done = icmp ult i32 %{{.*}}, 7
+; CHECK: br i1 %lcmp.done, label %unr.exit, label %unr.ph
+; CHECK: for.body:
+; CHECK: %add.7 = add nsw i32
+; CHECK-NOT: br i1 %exitcond.{{[0-6]}}
+; CHECK: br i1 %exitcond.7, label %for.end.loopexit, label %for.body
+; CHECK: unr.exit:
+; CHECK: %add.lcssa.merge = phi i32 [ %add.lcssa, %for.end.loopexit ], [ %add.lcssa.unr, %prol.end ]
+
+; NORUNTIME: @sum
+; NORUNTIME-NOT: prol.ph
+; NORUNTIME-NOT: %add.1
+
+define i32 @sum(i32* nocapture %a, i32 %n) nounwind readonly {
+entry:
+  %cmp1 = icmp sgt i32 %n, 0
+  br i1 %cmp1, label %for.body, label %for.end
+
+for.body:
+  %i.03 = phi i32 [ %inc, %for.body ], [ 0, %entry ]
+  %sum.02 = phi i32 [ %add, %for.body ], [ 0, %entry ]
+  %arrayidx = getelementptr inbounds i32* %a, i32 %i.03
+  %0 = load i32* %arrayidx, align 4
+  %add = add nsw i32 %0, %sum.02
+  %inc = add nsw i32 %i.03, 1
+  %exitcond = icmp eq i32 %inc, %n
+  br i1 %exitcond, label %for.end.loopexit, label %for.body
+
+for.end.loopexit:
+  %add.lcssa = phi i32 [ %add, %for.body ]
+  br label %for.end
+
+for.end:
+  %sum.0.lcssa = phi i32 [ 0, %entry ], [ %add.lcssa, %for.end.loopexit ]
+  ret i32 %sum.0.lcssa
+}
+
+; Loops with more than one exit are not unrolled at run time.
+
+; CHECK: @find
+; CHECK-NOT: prol.ph
+; CHECK: ret
+
+define i32 @find(i32* nocapture %a, i32 %n) nounwind readonly {
+entry:
+  br label %for.cond
+
+for.cond:
+  %i = phi i32 [ 0, %entry ], [ %inc, %for.body ]
+  %cmp = icmp slt i32 %i, %n
+  br i1 %cmp, label %for.body, label %for.end
+
+for.body:
+  %arrayidx = getelementptr inbounds i32* %a, i32 %i
+  %0 = load i32* %arrayidx, align 4
+  %found = icmp eq i32 %0, 42
+  %inc = add nsw i32 %i, 1
+  br i1 %found, label %for.end, label %for.cond
+
+for.end:
+  %r = phi i32 [ -1, %for.cond ], [ %i, %for.body ]
+  ret i32 %r
+}
@@ -0,0 +1,110 @@
+; RUN: opt -basicaa -loop-vectorize -S < %s | FileCheck %s
+target datalayout = "e-p:64:64:64-i1:8:8-i8:8:8-i16:16:16-i32:32:32-i64:64:64-f32:32:32-f64:64:64-v64:64:64-v128:128:128-a0:0:64-s0:64:64-f80:128:128-n8:16:32:64"
+target triple = "x86_64-unknown-linux-gnu"
+
+; for (i = 0; i < n; ++i) A[i] = B[i] + C[i];
+define void @add(i32* noalias %A, i32* noalias %B, i32* noalias %C, i64 %n) nounwind {
+entry:
+  %cmp = icmp sgt i64 %n, 0
+  br i1 %cmp, label %for.body, label %for.end
+
+for.body:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %for.body ]
+  %b.addr = getelementptr inbounds i32* %B, i64 %i
+  %b = load i32* %b.addr, align 4
+  %c.addr = getelementptr inbounds i32* %C, i64 %i
+  %c = load i32* %c.addr, align 4
+  %sum = add nsw i32 %b, %c
+  %a.addr = getelementptr inbounds i32* %A, i64 %i
+  store i32 %sum, i32* %a.addr, align 4
+  %i.next = add i64 %i, 1
+  %exitcond = icmp eq i64 %i.next, %n
+  br i1 %exitcond, label %for.end, label %for.body
+
+for.end:
+  ret void
+; CHECK: @add
+; CHECK-NOT: vector.memcheck
+; CHECK: vector.body:
+; CHECK: load <4 x i32>* {{.*}}, align 4
+; CHECK: load <4 x i32>* {{.*}}, align 4
+; CHECK: add <4 x i32>
+; CHECK: store <4 x i32> {{.*}}, align 4
+; CHECK: %index.next = add i64 %index, 4
+; CHECK: middle.block:
+; CHECK: scalar.ph:
+}
+
+; The pointers may alias, so the vector loop is guarded by a runtime check.
+define void @may_alias(float* %A, float* %B, i64 %n) nounwind {
+entry:
+  br label %for.body
+
+for.body:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %for.body ]
+  %b.addr = getelementptr inbounds float* %B, i64 %i
+  %b = load float* %b.addr, align 4
+  %mul = fmul float %b, 3.000000e+00
+  %a.addr = getelementptr inbounds float* %A, i64 %i
+  store float %mul, float* %a.addr, align 4
+  %i.next = add i64 %i, 1
+  %exitcond = icmp eq i64 %i.next, %n
+  br i1 %exitcond, label %for.end, label %for.body
+
+for.end:
+  ret void
+; CHECK: @may_alias
+; CHECK: vector.memcheck:
+; CHECK: %found.conflict = and i1
+; CHECK: br i1 %found.conflict, label %scalar.ph, label %vector.ph
+; CHECK: fmul <4 x float> {{.*}}, <float 3.000000e+00, float 3.000000e+00, float 3.000000e+00, float 3.000000e+00>
+}
+
+; A[i+1] = A[i] + 1 carries a dependence of distance one and is left alone.
+define void @dependence(i32* %A, i64 %n) nounwind {
+entry:
+  br label %for.body
+
+for.body:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %for.body ]
+  %a.addr = getelementptr inbounds i32* %A, i64 %i
+  %a = load i32* %a.addr, align 4
+  %inc = add nsw i32 %a, 1
+  %i.next = add i64 %i, 1
+  %a.next.addr = getelementptr inbounds i32* %A, i64 %i.next
+  store i32 %inc, i32* %a.next.addr, align 4
+  %exitcond = icmp eq i64 %i.next, %n
+  br i1 %exitcond, label %for.end, label %for.body
+
+for.end:
+  ret void
+; CHECK: @dependence
+; CHECK-NOT: <4 x i32>
+; CHECK: ret void
+}
+
+; A[i] = A[i+8] * 2 only reads ahead by more than a vector and is vectorized
+; without checks.
+define void @far_dependence(i16* %A, i32 %n) nounwind {
+entry:
+  br label %for.body
+
+for.body:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %for.body ]
+  %i.ext = sext i32 %i to i64
+  %j.ext = add i64 %i.ext, 8
+  %src = getelementptr inbounds i16* %A, i64 %j.ext
+  %v = load i16* %src, align 2
+  %mul = shl i16 %v, 1
+  %dst = getelementptr inbounds i16* %A, i64 %i.ext
+  store i16 %mul, i16* %dst, align 2
+  %i.next = add nsw i32 %i, 1
+  %exitcond = icmp slt i32 %i.next, %n
+  br i1 %exitcond, label %for.body, label %for.end
+
+for.end:
+  ret void
+; CHECK: @far_dependence
+; CHECK-NOT: vector.memcheck
+; CHECK: shl <8 x i16>
+}
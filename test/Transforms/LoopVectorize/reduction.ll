@@ -0,0 +1,67 @@
+; RUN: opt -basicaa -loop-vectorize -S < %s | FileCheck %s
+target datalayout = "e-p:64:64:64-i1:8:8-i8:8:8-i16:16:16-i32:32:32-i64:64:64-f32:32:32-f64:64:64-v64:64:64-v128:128:128-a0:0:64-s0:64:64-f80:128:128-n8:16:32:64"
+target triple = "x86_64-unknown-linux-gnu"
+
+; sum += A[i] * B[i]
+define i32 @dot(i32* %A, i32* %B, i32 %n) nounwind readonly {
+entry:
+  br label %for.body
+
+for.body:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %for.body ]
+  %sum = phi i32 [ 7, %entry ], [ %sum.next, %for.body ]
+  %idx = zext i32 %i to i64
+  %a.addr = getelementptr inbounds i32* %A, i64 %idx
+  %a = load i32* %a.addr, align 4
+  %b.addr = getelementptr inbounds i32* %B, i64 %idx
+  %b = load i32* %b.addr, align 4
+  %mul = mul nsw i32 %a, %b
+  %sum.next = add nsw i32 %mul, %sum
+  %i.next = add i32 %i, 1
+  %exitcond = icmp eq i32 %i.next, %n
+  br i1 %exitcond, label %for.end, label %for.body
+
+for.end:
+  %sum.lcssa = phi i32 [ %sum.next, %for.body ]
+  ret i32 %sum.lcssa
+; CHECK: @dot
+; CHECK-NOT: vector.memcheck
+; CHECK: vector.ph:
+; CHECK: vector.body:
+; CHECK: %sum.vec = phi <4 x i32> [ <i32 7, i32 0, i32 0, i32 0>, %vector.ph ]
+; CHECK: mul <4 x i32>
+; CHECK: add <4 x i32>
+; CHECK: middle.block:
+; CHECK: %bin.rdx
+; CHECK: scalar.ph:
+; CHECK: %sum.resume = phi i32 [ 7, %entry ], [ %bin.rdx{{[0-9]*}}, %middle.block ]
+; CHECK: scalar.exit:
+; CHECK: %sum.next.lcssa = phi i32 [ %sum.next, %for.body ]
+; CHECK: for.end:
+; CHECK: %sum.lcssa = phi i32 [ %sum.next.lcssa, %scalar.exit ], [ %bin.rdx{{[0-9]*}}, %middle.block ]
+}
+
+; The running sum is stored, so it cannot be kept per lane.
+define void @prefix_sum(i32* noalias %A, i32* noalias %B, i32 %n) nounwind {
+entry:
+  br label %for.body
+
+for.body:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %for.body ]
+  %sum = phi i32 [ 0, %entry ], [ %sum.next, %for.body ]
+  %idx = zext i32 %i to i64
+  %a.addr = getelementptr inbounds i32* %A, i64 %idx
+  %a = load i32* %a.addr, align 4
+  %sum.next = add nsw i32 %a, %sum
+  %b.addr = getelementptr inbounds i32* %B, i64 %idx
+  store i32 %sum.next, i32* %b.addr, align 4
+  %i.next = add i32 %i, 1
+  %exitcond = icmp eq i32 %i.next, %n
+  br i1 %exitcond, label %for.end, label %for.body
+
+for.end:
+  ret void
+; CHECK: @prefix_sum
+; CHECK-NOT: <4 x i32>
+; CHECK: ret void
+}
@@ -0,0 +1,79 @@
+; RUN: opt -basicaa -loop-vectorize -loop-vectorize-width=256 -S < %s | FileCheck %s
+; RUN: opt -basicaa -loop-vectorize -loop-vectorize-width=32 -S < %s | FileCheck %s -check-prefix=NARROW
+target datalayout = "e-p:64:64:64-i1:8:8-i8:8:8-i16:16:16-i32:32:32-i64:64:64-f32:32:32-f64:64:64-v64:64:64-v128:128:128-a0:0:64-s0:64:64-f80:128:128-n8:16:32:64"
+target triple = "x86_64-unknown-linux-gnu"
+
+; The induction variable is stored, so it is materialized as a vector.
+define void @iota(float* noalias %A, i64 %n) nounwind {
+entry:
+  br label %for.body
+
+for.body:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %for.body ]
+  %i.trunc = trunc i64 %i to i32
+  %conv = sitofp i32 %i.trunc to float
+  %a.addr = getelementptr inbounds float* %A, i64 %i
+  store float %conv, float* %a.addr, align 4
+  %i.next = add i64 %i, 1
+  %exitcond = icmp eq i64 %i.next, %n
+  br i1 %exitcond, label %for.end, label %for.body
+
+for.end:
+  ret void
+; CHECK: @iota
+; CHECK: %i.vec = add <4 x i64> %i.vecbase.splat, <i64 0, i64 1, i64 2, i64 3>
+; CHECK: sitofp <4 x i32> {{.*}} to <4 x float>
+; NARROW: @iota
+; NARROW-NOT: vector.body
+; NARROW: ret void
+}
+
+; A[i + 2] depends on A[i] two iterations earlier, which rules out four lanes
+; but not two.
+define void @dist2(i32* %A, i64 %n) nounwind {
+entry:
+  br label %for.body
+
+for.body:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %for.body ]
+  %a.addr = getelementptr inbounds i32* %A, i64 %i
+  %a = load i32* %a.addr, align 4
+  %inc = add nsw i32 %a, 1
+  %i.2 = add i64 %i, 2
+  %b.addr = getelementptr inbounds i32* %A, i64 %i.2
+  store i32 %inc, i32* %b.addr, align 4
+  %i.next = add i64 %i, 1
+  %exitcond = icmp eq i64 %i.next, %n
+  br i1 %exitcond, label %for.end, label %for.body
+
+for.end:
+  ret void
+; CHECK: @dist2
+; CHECK: vector.body:
+; CHECK: load <2 x i32>*
+; CHECK: store <2 x i32>
+; CHECK: %index.next = add i64 %index, 2
+}
+
+; Three iterations are too few for four lanes, but enough for two.
+define i32 @three(i32* noalias %A) nounwind {
+entry:
+  br label %for.body
+
+for.body:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %for.body ]
+  %s = phi i32 [ 0, %entry ], [ %s.next, %for.body ]
+  %a.addr = getelementptr inbounds i32* %A, i64 %i
+  %a = load i32* %a.addr, align 4
+  %s.next = add i32 %s, %a
+  %i.next = add i64 %i, 1
+  %exitcond = icmp eq i64 %i.next, 3
+  br i1 %exitcond, label %for.end, label %for.body
+
+for.end:
+  ret i32 %s.next
+; CHECK: @three
+; CHECK: vector.body:
+; CHECK: %s.vec = phi <2 x i32>
+; CHECK: %index.next = add i64 %index, 2
+}
@@ -0,0 +1,97 @@
+; RUN: opt < %s -mergefunc -S | FileCheck %s
+target datalayout = "e-p:64:64:64-i1:8:8-i8:8:8-i16:16:16-i32:32:32-i64:64:64-f32:32:32-f64:64:64-v64:64:64-v128:128:128-a0:0:64-s0:64:64-f80:128:128-n8:16:32:64"
+
+; Functions with the same signature and block count but different bodies must
+; be kept apart, while identical bodies are still merged, including ones that
+; only differ in the pointer types they use.
+
+define internal i32 @add(i32 %a, i32 %b) {
+  %r = add i32 %a, %b
+  ret i32 %r
+}
+
+define internal i32 @sub(i32 %a, i32 %b) {
+  %r = sub i32 %a, %b
+  ret i32 %r
+}
+
+define internal i32 @add2(i32 %a, i32 %b) {
+  %r = add i32 %a, %b
+  ret i32 %r
+}
+
+define internal i32 @load_i32(i32* %p, i1 %c) {
+entry:
+  br i1 %c, label %then, label %exit
+then:
+  %v = load i32* %p
+  br label %exit
+exit:
+  %r = phi i32 [ %v, %then ], [ 0, %entry ]
+  ret i32 %r
+}
+
+define internal i32 @load_i32b(i32* %p, i1 %c) {
+entry:
+  br i1 %c, label %then, label %exit
+then:
+  %v = load i32* %p
+  br label %exit
+exit:
+  %r = phi i32 [ %v, %then ], [ 0, %entry ]
+  ret i32 %r
+}
+
+define internal i32 @load_else(i32* %p, i1 %c) {
+entry:
+  br i1 %c, label %exit, label %else
+else:
+  %v = load i32* %p
+  br label %exit
+exit:
+  %r = phi i32 [ %v, %else ], [ 0, %entry ]
+  ret i32 %r
+}
+
+define internal i32* @id_i32(i32* %p) {
+  ret i32* %p
+}
+
+define internal i8* @id_i8(i8* %p) {
+  ret i8* %p
+}
+
+define i32 @user(i32* %p, i8* %q, i1 %c) {
+  %a = call i32 @add(i32 1, i32 2)
+  %b = call i32 @sub(i32 1, i32 2)
+  %d = call i32 @add2(i32 1, i32 2)
+  %e = call i32 @load_i32(i32* %p, i1 %c)
+  %f = call i32 @load_i32b(i32* %p, i1 %c)
+  %g = call i32 @load_else(i32* %p, i1 %c)
+  %h = call i32* @id_i32(i32* %p)
+  %i = call i8* @id_i8(i8* %q)
+  %s1 = add i32 %a, %b
+  %s2 = add i32 %s1, %d
+  %s3 = add i32 %s2, %e
+  %s4 = add i32 %s3, %f
+  %s5 = add i32 %s4, %g
+  ret i32 %s5
+}
+
+; CHECK: define internal i32 @add(
+; CHECK: define internal i32 @sub(
+; CHECK-NOT: define internal i32 @add2(
+; CHECK: define internal i32 @load_i32(
+; CHECK-NOT: define internal i32 @load_i32b(
+; CHECK: define internal i32 @load_else(
+; CHECK: define internal i32* @id_i32(
+; CHECK-NOT: define internal i8* @id_i8(
+; CHECK: define i32 @user
+; CHECK: call i32 @add(i32 1, i32 2)
+; CHECK: call i32 @sub(i32 1, i32 2)
+; CHECK: call i32 @add(i32 1, i32 2)
+; CHECK: call i32 @load_i32(
+; CHECK: call i32 @load_i32(
+; CHECK: call i32 @load_else(
+; CHECK: call i32* @id_i32(
+; CHECK: call i8* bitcast (i32* (i32*)* @id_i32 to i8* (i8*)*)
@@ -0,0 +1,92 @@
+; RUN: opt < %s -basicaa -newgvn -S | FileCheck %s
+
+target datalayout = "e-p:64:64:64-i1:8:8-i8:8:8-i16:16:16-i32:32:32-i64:64:64-f32:32:32-f64:64:64-v64:64:64-v128:128:128-a0:0:64-s0:64:64-f80:128:128-n8:16:32:64"
+
+@G = global i32 0
+@H = global i32 0
+
+; Commuted operands are in the same class.
+define i32 @commute(i32 %x, i32 %y) {
+; CHECK: @commute
+; CHECK: %a = add i32 %x, %y
+; CHECK-NOT: add
+; CHECK: ret i32 %r
+  %a = add i32 %x, %y
+  %b = add i32 %y, %x
+  %r = mul i32 %a, %b
+  ret i32 %r
+}
+
+; The two induction variables are only found equal optimistically.
+define i64 @ivs(i64 %n) {
+; CHECK: @ivs
+entry:
+  br label %loop
+
+loop:
+; CHECK: loop:
+; CHECK-NEXT: %i = phi
+; CHECK-NOT: phi
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %j = phi i64 [ 0, %entry ], [ %j.next, %loop ]
+  %i.next = add i64 %i, 1
+  %j.next = add i64 %j, 1
+  %c = icmp eq i64 %i.next, %n
+  br i1 %c, label %exit, label %loop
+
+exit:
+; CHECK: ret i64 %i.next
+  %r = sub i64 %j.next, 0
+  ret i64 %r
+}
+
+; A store forwards its value to a load of the same pointer, across a store
+; that does not alias it.
+define i32 @forward(i32 %x) {
+; CHECK: @forward
+; CHECK-NOT: load
+; CHECK: ret i32 %x
+  store i32 %x, i32* @G
+  store i32 1, i32* @H
+  %v = load i32* @G
+  ret i32 %v
+}
+
+; The loop only writes @H, so its memory phi is congruent to the state before
+; the loop and the load in the loop is the load before it.
+define i32 @across_loop(i64 %n) {
+; CHECK: @across_loop
+entry:
+  %a = load i32* @G
+  br label %loop
+
+loop:
+; CHECK: loop:
+; CHECK-NOT: load
+; CHECK: br i1
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %s = phi i32 [ 0, %entry ], [ %s.next, %loop ]
+  %b = load i32* @G
+  %s.next = add i32 %s, %b
+  store i32 %s.next, i32* @H
+  %i.next = add i64 %i, 1
+  %c = icmp eq i64 %i.next, %n
+  br i1 %c, label %exit, label %loop
+
+exit:
+  %r = add i32 %s.next, %a
+  ret i32 %r
+}
+
+; Loads on the two sides of a store to the same location differ.
+define i32 @clobber(i32* %p) {
+; CHECK: @clobber
+; CHECK: load
+; CHECK: load
+  %a = load i32* %p
+  store i32 0, i32* @G
+  %b = load i32* %p
+  %r = sub i32 %a, %b
+  ret i32 %r
+}
+
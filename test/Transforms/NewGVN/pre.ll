@@ -0,0 +1,125 @@
+; RUN: opt < %s -basicaa -newgvn -S | FileCheck %s
+
+target datalayout = "e-p:64:64:64-i1:8:8-i8:8:8-i16:16:16-i32:32:32-i64:64:64-f32:32:32-f64:64:64-v64:64:64-v128:128:128-a0:0:64-s0:64:64-f80:128:128-n8:16:32:64"
+
+@G = global i32 0
+
+define i32 @diamond(i1 %c, i32 %x, i32 %y) {
+; CHECK: @diamond
+entry:
+  br i1 %c, label %then, label %else
+
+then:
+  %a = add i32 %x, %y
+  br label %join
+
+else:
+; CHECK: else:
+; CHECK-NEXT: %b.pre = add i32 %x, %y
+  br label %join
+
+join:
+; CHECK: join:
+; CHECK-NEXT: %b.pre-phi = phi i32 [ %b.pre, %else ], [ %a, %then ]
+; CHECK-NEXT: ret i32 %b.pre-phi
+  %b = add i32 %x, %y
+  ret i32 %b
+}
+
+; The expression is translated through the phi into each predecessor.
+define i32 @translate(i1 %c, i32 %x, i32 %y) {
+; CHECK: @translate
+entry:
+  br i1 %c, label %then, label %else
+
+then:
+  %a = mul i32 %x, 3
+  br label %join
+
+else:
+; CHECK: else:
+; CHECK-NEXT: %b.pre = mul i32 %y, 3
+  br label %join
+
+join:
+; CHECK: join:
+; CHECK-NEXT: %b.pre-phi = phi i32 [ %b.pre, %else ], [ %a, %then ]
+; CHECK-NOT: mul
+  %p = phi i32 [ %x, %then ], [ %y, %else ]
+  %b = mul i32 %p, 3
+  ret i32 %b
+}
+
+define i32 @load(i1 %c, i32* %p) {
+; CHECK: @load
+entry:
+  br i1 %c, label %then, label %else
+
+then:
+  %a = load i32* %p
+  br label %join
+
+else:
+; CHECK: else:
+; CHECK: store i32 0, i32* @G
+; CHECK-NEXT: %b.pre = load i32* %p
+  store i32 0, i32* @G
+  br label %join
+
+join:
+; CHECK: join:
+; CHECK-NEXT: %b.pre-phi = phi i32 [ %b.pre, %else ], [ %a, %then ]
+  %b = load i32* %p
+  ret i32 %b
+}
+
+; The load is invariant in the loop, so it is computed in the preheader.
+define i32 @invariant(i32* noalias %p, i32* noalias %q, i64 %n) {
+; CHECK: @invariant
+entry:
+; CHECK: entry:
+; CHECK-NEXT: %v.pre = load i32* %p
+  br label %loop
+
+loop:
+; CHECK: loop:
+; CHECK-NOT: load
+; CHECK: store i32 %v.pre
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %v = load i32* %p
+  %q.i = getelementptr i32* %q, i64 %i
+  store i32 %v, i32* %q.i
+  %i.next = add i64 %i, 1
+  %c = icmp eq i64 %i.next, %n
+  br i1 %c, label %exit, label %loop
+
+exit:
+; CHECK: ret i32 %v.pre
+  ret i32 %v
+}
+
+; A call that may not return precedes the load, so it is not anticipated.
+declare void @f()
+
+define i32 @not_anticipated(i1 %c, i32* %p) {
+; CHECK: @not_anticipated
+entry:
+  br i1 %c, label %then, label %else
+
+then:
+  %a = load i32* %p
+  br label %join
+
+else:
+; CHECK: else:
+; CHECK-NEXT: br label %join
+  br label %join
+
+join:
+; CHECK: join:
+; CHECK-NEXT: call void @f()
+; CHECK-NEXT: %b = load i32* %p
+  call void @f()
+  %b = load i32* %p
+  ret i32 %b
+}
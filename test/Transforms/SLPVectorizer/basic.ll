@@ -0,0 +1,140 @@
+; RUN: opt -basicaa -slp-vectorizer -S < %s | FileCheck %s
+target datalayout = "e-p:64:64:64-i1:8:8-i8:8:8-i16:16:16-i32:32:32-i64:64:64-f32:32:32-f64:64:64-v64:64:64-v128:128:128-a0:0:64-s0:64:64-f80:128:128-n8:16:32:64"
+target triple = "x86_64-unknown-linux-gnu"
+
+; A[i] = B[i] + C[i] for i = 0..3
+define void @add4(float* noalias %A, float* noalias %B, float* noalias %C) nounwind {
+entry:
+  %b0 = load float* %B, align 4
+  %c0 = load float* %C, align 4
+  %s0 = fadd float %b0, %c0
+  store float %s0, float* %A, align 4
+  %B1 = getelementptr inbounds float* %B, i64 1
+  %C1 = getelementptr inbounds float* %C, i64 1
+  %A1 = getelementptr inbounds float* %A, i64 1
+  %b1 = load float* %B1, align 4
+  %c1 = load float* %C1, align 4
+  %s1 = fadd float %b1, %c1
+  store float %s1, float* %A1, align 4
+  %B2 = getelementptr inbounds float* %B, i64 2
+  %C2 = getelementptr inbounds float* %C, i64 2
+  %A2 = getelementptr inbounds float* %A, i64 2
+  %b2 = load float* %B2, align 4
+  %c2 = load float* %C2, align 4
+  %s2 = fadd float %b2, %c2
+  store float %s2, float* %A2, align 4
+  %B3 = getelementptr inbounds float* %B, i64 3
+  %C3 = getelementptr inbounds float* %C, i64 3
+  %A3 = getelementptr inbounds float* %A, i64 3
+  %b3 = load float* %B3, align 4
+  %c3 = load float* %C3, align 4
+  %s3 = fadd float %b3, %c3
+  store float %s3, float* %A3, align 4
+  ret void
+; CHECK: @add4
+; CHECK-NOT: load float
+; CHECK: %b0.vec = load <4 x float>* {{.*}}, align 4
+; CHECK: %c0.vec = load <4 x float>* {{.*}}, align 4
+; CHECK: %s0.vec = fadd <4 x float> %b0.vec, %c0.vec
+; CHECK: store <4 x float> %s0.vec
+; CHECK-NOT: store float
+; CHECK: ret void
+}
+
+; The stores are written in reverse order and a scalar is multiplied in.
+define void @scale2(double* noalias %A, double* noalias %B, double %k) nounwind {
+entry:
+  %B1 = getelementptr inbounds double* %B, i64 1
+  %A1 = getelementptr inbounds double* %A, i64 1
+  %b1 = load double* %B1, align 8
+  %m1 = fmul double %b1, %k
+  store double %m1, double* %A1, align 8
+  %b0 = load double* %B, align 8
+  %m0 = fmul double %b0, %k
+  store double %m0, double* %A, align 8
+  ret void
+; CHECK: @scale2
+; CHECK: insertelement <2 x double> undef, double %k, i32 0
+; CHECK: fmul <2 x double>
+; CHECK: store <2 x double>
+; CHECK-NOT: store double
+; CHECK: ret void
+}
+
+; The loads may read what the first store wrote, so nothing can be moved.
+define void @alias(i32* %A, i32* %B) nounwind {
+entry:
+  %b0 = load i32* %B, align 4
+  %x0 = xor i32 %b0, 5
+  store i32 %x0, i32* %A, align 4
+  %B1 = getelementptr inbounds i32* %B, i64 1
+  %A1 = getelementptr inbounds i32* %A, i64 1
+  %b1 = load i32* %B1, align 4
+  %x1 = xor i32 %b1, 5
+  store i32 %x1, i32* %A1, align 4
+  ret void
+; CHECK: @alias
+; CHECK-NOT: <2 x i32>
+; CHECK: ret void
+}
+
+; The stored values are unrelated, so gathering them costs more than the
+; single vector store saves.
+define void @unprofitable(i32* %A, i32 %x, i32 %y) nounwind {
+entry:
+  %a = mul i32 %x, %y
+  %b = sdiv i32 %x, %y
+  store i32 %a, i32* %A, align 4
+  %A1 = getelementptr inbounds i32* %A, i64 1
+  store i32 %b, i32* %A1, align 4
+  ret void
+; CHECK: @unprofitable
+; CHECK-NOT: <2 x i32>
+; CHECK: ret void
+}
+
+; Independent chains are vectorized in the order their first stores appear.
+define void @two_chains(double* noalias %X, double* noalias %Y, double* noalias %B, double* noalias %C) nounwind {
+entry:
+  %B1 = getelementptr inbounds double* %B, i64 1
+  %C1 = getelementptr inbounds double* %C, i64 1
+  %X1 = getelementptr inbounds double* %X, i64 1
+  %Y1 = getelementptr inbounds double* %Y, i64 1
+  %b0 = load double* %B, align 8
+  %b1 = load double* %B1, align 8
+  %c0 = load double* %C, align 8
+  %c1 = load double* %C1, align 8
+  store double %b0, double* %Y, align 8
+  store double %c0, double* %X, align 8
+  store double %b1, double* %Y1, align 8
+  store double %c1, double* %X1, align 8
+  ret void
+; CHECK: @two_chains
+; CHECK: %0 = bitcast double* %B to <2 x double>*
+; CHECK: %1 = bitcast double* %Y to <2 x double>*
+; CHECK: %2 = bitcast double* %C to <2 x double>*
+; CHECK: %3 = bitcast double* %X to <2 x double>*
+; CHECK: ret void
+}
+
+; The operands come from another block, so they are gathered rather than
+; vectorized with the stores.
+define void @other_block(double* noalias %A, double* noalias %B) nounwind {
+entry:
+  %A1 = getelementptr inbounds double* %A, i64 1
+  %B1 = getelementptr inbounds double* %B, i64 1
+  %a0 = load double* %A, align 8
+  %a1 = load double* %A1, align 8
+  %x0 = fadd double %a0, 1.0
+  %x1 = fadd double %a1, 1.0
+  br label %next
+
+next:
+  store double %x0, double* %B, align 8
+  store double %x1, double* %B1, align 8
+  ret void
+; CHECK: @other_block
+; CHECK: next:
+; CHECK-NOT: load <2 x double>
+; CHECK: ret void
+}
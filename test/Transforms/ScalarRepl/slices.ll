@@ -0,0 +1,124 @@
+; RUN: opt < %s -scalarrepl -S | FileCheck %s
+target datalayout = "e-p:64:64:64-i1:8:8-i8:8:8-i16:16:16-i32:32:32-i64:64:64-f32:32:32-f64:64:64-v64:64:64-v128:128:128-a0:0:64-s0:64:64-f80:128:128-n8:16:32:64"
+
+%big = type { i32, double, [1020 x i32] }
+%quad = type { i32, i32, i32, i32 }
+
+declare void @llvm.memcpy.p0i8.p0i8.i64(i8* nocapture, i8* nocapture, i64, i32, i1) nounwind
+declare void @llvm.memset.p0i8.i64(i8* nocapture, i8, i64, i32, i1) nounwind
+declare void @escape(%big*)
+
+; A large struct that is copied in and then read field by field.  The fields
+; are loaded straight from the source.
+; CHECK: @copy_in
+; CHECK-NOT: alloca
+; CHECK-NOT: memcpy
+; CHECK: getelementptr inbounds i8* %a, i64 416
+; CHECK: ret i32
+define i32 @copy_in(%big* %arg) {
+entry:
+  %s = alloca %big, align 8
+  %d = bitcast %big* %s to i8*
+  %a = bitcast %big* %arg to i8*
+  call void @llvm.memcpy.p0i8.p0i8.i64(i8* %d, i8* %a, i64 4096, i32 8, i1 false)
+  %f0 = getelementptr inbounds %big* %s, i64 0, i32 0
+  %v0 = load i32* %f0, align 8
+  %f2 = getelementptr inbounds %big* %s, i64 0, i32 2, i64 100
+  %v2 = load i32* %f2, align 4
+  %r = add i32 %v0, %v2
+  ret i32 %r
+}
+
+; CHECK: @set_and_store
+; CHECK-NEXT: entry:
+; CHECK-NEXT: %r = add i32 16843009, %x
+; CHECK-NEXT: ret i32 %r
+define i32 @set_and_store(i32 %x) {
+entry:
+  %s = alloca %big, align 8
+  %d = bitcast %big* %s to i8*
+  call void @llvm.memset.p0i8.i64(i8* %d, i8 1, i64 4096, i32 8, i1 false)
+  %f2 = getelementptr inbounds %big* %s, i64 0, i32 2, i64 7
+  store i32 %x, i32* %f2, align 4
+  %f0 = getelementptr inbounds %big* %s, i64 0, i32 0
+  %v0 = load i32* %f0, align 8
+  %v2 = load i32* %f2, align 4
+  %r = add i32 %v0, %v2
+  ret i32 %r
+}
+
+; A memcpy that only covers part of the struct.
+; CHECK: @partial_copy
+; CHECK-NOT: alloca
+; CHECK: load i32* %{{.*}}, align 4
+; CHECK-NOT: memcpy
+; CHECK: ret i32
+define i32 @partial_copy(%quad* %src) {
+entry:
+  %q = alloca %quad, align 4
+  %f0 = getelementptr inbounds %quad* %q, i64 0, i32 0
+  store i32 0, i32* %f0
+  %f1 = getelementptr inbounds %quad* %q, i64 0, i32 1
+  %d = bitcast i32* %f1 to i8*
+  %sp = getelementptr inbounds %quad* %src, i64 0, i32 1
+  %s = bitcast i32* %sp to i8*
+  call void @llvm.memcpy.p0i8.p0i8.i64(i8* %d, i8* %s, i64 8, i32 4, i1 false)
+  %v0 = load i32* %f0
+  %f2 = getelementptr inbounds %quad* %q, i64 0, i32 2
+  %v2 = load i32* %f2
+  %r = add i32 %v0, %v2
+  ret i32 %r
+}
+
+; The bytes that are never loaded stay in memory, but the field that is
+; stored to is split off and the memcpys are split around it.
+; CHECK: @copy_through
+; CHECK: %s.off4 = alloca [4092 x i8], align 4
+; CHECK: memcpy{{.*}}i64 4092, i32 4
+; CHECK: store i32 %x
+; CHECK: memcpy{{.*}}i64 4092, i32 4
+define void @copy_through(%big* %dst, %big* %src, i32 %x) {
+entry:
+  %s = alloca %big, align 8
+  %d = bitcast %big* %s to i8*
+  %a = bitcast %big* %src to i8*
+  %b = bitcast %big* %dst to i8*
+  call void @llvm.memcpy.p0i8.p0i8.i64(i8* %d, i8* %a, i64 4096, i32 8, i1 false)
+  %f0 = getelementptr inbounds %big* %s, i64 0, i32 0
+  store i32 %x, i32* %f0, align 8
+  call void @llvm.memcpy.p0i8.p0i8.i64(i8* %b, i8* %d, i64 4096, i32 8, i1 false)
+  ret void
+}
+
+; CHECK: @escapes
+; CHECK: alloca %big
+define i32 @escapes() {
+entry:
+  %s = alloca %big, align 8
+  call void @escape(%big* %s)
+  %f0 = getelementptr inbounds %big* %s, i64 0, i32 0
+  %v0 = load i32* %f0, align 8
+  ret i32 %v0
+}
+
+; The slice at offset 20 of an alloca aligned to 4 is only aligned to 4, so
+; the loads from it can't keep the alignment they claim.
+; CHECK: @overaligned
+; CHECK: %s.off20 = alloca [16 x i8], align 4
+; CHECK: %x = load <4 x float>* %tmp, align 4
+; CHECK: %y = load i32* %tmp1, align 4
+define <4 x float> @overaligned(i8* %src, i8* %dst, i32* %out) {
+entry:
+  %s = alloca [4096 x i8], align 4
+  %d = getelementptr inbounds [4096 x i8]* %s, i64 0, i64 0
+  call void @llvm.memcpy.p0i8.p0i8.i64(i8* %d, i8* %src, i64 4096, i32 4, i1 false)
+  %p = getelementptr inbounds [4096 x i8]* %s, i64 0, i64 20
+  %v = bitcast i8* %p to <4 x float>*
+  %x = load <4 x float>* %v, align 16
+  %w = bitcast i8* %p to i32*
+  %y = load i32* %w, align 16
+  store i32 %y, i32* %out
+  %q = getelementptr inbounds [4096 x i8]* %s, i64 0, i64 16
+  call void @llvm.memcpy.p0i8.p0i8.i64(i8* %dst, i8* %q, i64 14, i32 4, i1 false)
+  ret <4 x float> %x
+}
@@ -13,30 +13,52 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include "llvm/Constants.h"
+#include "llvm/DerivedTypes.h"
 #include "llvm/LLVMContext.h"
 #include "llvm/Module.h"
 #include "llvm/PassManager.h"
 #include "llvm/Pass.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringExtras.h"
 #include "llvm/ADT/Triple.h"
+#include "llvm/Analysis/Passes.h"
+#include "llvm/Bitcode/ReaderWriter.h"
 #include "llvm/Support/IRReader.h"
 #include "llvm/CodeGen/LinkAllAsmWriterComponents.h"
 #include "llvm/CodeGen/LinkAllCodegenComponents.h"
 #include "llvm/Config/config.h"
+#include "llvm/MC/MCContext.h"
+#include "llvm/MC/MCStreamer.h"
+#include "llvm/MC/MCParser/MCAsmParser.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/FormattedStream.h"
 #include "llvm/Support/ManagedStatic.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
 #include "llvm/Support/PluginLoader.h"
 #include "llvm/Support/PrettyStackTrace.h"
+#include "llvm/Support/Program.h"
 #include "llvm/Support/ToolOutputFile.h"
 #include "llvm/Support/Host.h"
 #include "llvm/Support/Signals.h"
+#include "llvm/Support/SourceMgr.h"
 #include "llvm/Target/SubtargetFeature.h"
+#include "llvm/Target/TargetAsmBackend.h"
+#include "llvm/Target/TargetAsmInfo.h"
+#include "llvm/Target/TargetAsmParser.h"
 #include "llvm/Target/TargetData.h"
+#include "llvm/Target/TargetLowering.h"
+#include "llvm/Target/TargetLoweringObjectFile.h"
 #include "llvm/Target/TargetMachine.h"
 #include "llvm/Target/TargetRegistry.h"
 #include "llvm/Target/TargetSelect.h"
+#include <algorithm>
 #include <memory>
+#include <vector>
 using namespace llvm;
 
 // General options for llc.  Other pass-specific options are specified
@@ -109,6 +131,29 @@ NoImplicitFloats("no-implicit-float",
   cl::desc("Don't generate implicit floating point instructions (x86-only)"),
   cl::init(false));
 
+static cl::opt<bool>
+LoadProfile("profile-loader",
+  cl::desc("Use the edge profile in -profile-info-file to weigh spill code"),
+  cl::init(false));
+
+static cl::opt<unsigned>
+NumJobs("j", cl::desc("Generate code for the functions of the module in this "
+                      "many processes (assembly and object output only)"),
+        cl::value_desc("N"), cl::init(1));
+
+// Options used by llc to hand one partition of a -j build to a child process.
+static cl::opt<int>
+CodeGenPartition("codegen-partition", cl::Hidden, cl::init(-1),
+  cl::desc("Only generate code for this partition of the module"));
+
+static cl::opt<std::string>
+PartitionInput("codegen-partition-input", cl::Hidden,
+  cl::desc("Bitcode to read in place of the input file"));
+
+static cl::opt<std::string>
+PartitionOutput("codegen-partition-output", cl::Hidden,
+  cl::desc("File to write in place of the output file"));
+
 // GetFileNameRoot - Helper function to get the basename of a filename.
 static inline std::string
 GetFileNameRoot(const std::string &InputFilename) {
@@ -189,6 +234,334 @@ static tool_output_file *GetOutputStream(const char *TargetName,
   return FDOut;
 }
 
+//===----------------------------------------------------------------------===//
+// Module partitioning for -j
+//
+// Every process of a -j build reads the same module and splits it the same
+// way.  The defined functions are cut, in module order, into NumJobs runs of
+// roughly equal size; global variables, aliases of variables and module asm
+// go with the first run.  Each process turns what the other partitions define
+// into declarations and writes assembly for the rest.  The parent joins their
+// output, in order, into one assembly file, or assembles it into one object
+// file.  Nothing is linked, so local symbols stay local to the output just as
+// in a serial build; only the assembler temporaries of each partition carry
+// a tag to keep them apart.
+//===----------------------------------------------------------------------===//
+
+typedef DenseMap<const GlobalValue*, unsigned> PartitionMap;
+
+/// getFunctionSize - Estimate the cost of generating code for F.
+static uint64_t getFunctionSize(const Function &F) {
+  uint64_t Size = 1;
+  for (Function::const_iterator BB = F.begin(), E = F.end(); BB != E; ++BB)
+    Size += BB->size();
+  return Size;
+}
+
+/// assignPartitions - Decide which of NumParts partitions each definition of M
+/// belongs to.
+static void assignPartitions(Module &M, unsigned NumParts, PartitionMap &Part) {
+  uint64_t Total = 0;
+  for (Module::iterator F = M.begin(), E = M.end(); F != E; ++F)
+    if (!F->isDeclaration())
+      Total += getFunctionSize(*F);
+
+  uint64_t Seen = 0;
+  for (Module::iterator F = M.begin(), E = M.end(); F != E; ++F) {
+    if (F->isDeclaration())
+      continue;
+    Part[F] = std::min<uint64_t>(NumParts - 1, Seen * NumParts / Total);
+    Seen += getFunctionSize(*F);
+  }
+
+  for (Module::global_iterator G = M.global_begin(), E = M.global_end();
+       G != E; ++G)
+    Part[G] = 0;
+
+  for (Module::alias_iterator A = M.alias_begin(), E = M.alias_end();
+       A != E; ++A) {
+    const GlobalValue *Aliasee = A->resolveAliasedGlobal(false);
+    PartitionMap::iterator I = Part.find(Aliasee);
+    Part[A] = (Aliasee && isa<Function>(Aliasee) && I != Part.end()) ?
+      I->second : 0;
+  }
+}
+
+/// isUsedOutside - Return true if V is used by a definition that is not in
+/// partition P.
+static bool isUsedOutside(const Value *V, unsigned P,
+                          const PartitionMap &Part) {
+  for (Value::const_use_iterator UI = V->use_begin(), E = V->use_end();
+       UI != E; ++UI) {
+    const User *U = *UI;
+    const GlobalValue *Owner = 0;
+    if (const Instruction *I = dyn_cast<Instruction>(U))
+      Owner = I->getParent()->getParent();
+    else if (const GlobalValue *GV = dyn_cast<GlobalValue>(U))
+      Owner = GV;
+    else if (isa<Constant>(U)) {
+      if (isUsedOutside(U, P, Part))
+        return true;
+      continue;
+    }
+    PartitionMap::const_iterator I = Part.find(Owner);
+    if (I == Part.end() || I->second != P)
+      return true;
+  }
+  return false;
+}
+
+/// canPartition - Return true if the output for M can be generated in parts
+/// and joined.  Block addresses cannot refer to a function in another
+/// partition, every part would describe the whole module in its debug info,
+/// and on Darwin every part would emit its own stubs for the symbols it
+/// references.
+static bool canPartition(Module &M, const Triple &TheTriple) {
+  if (TheTriple.getOS() == Triple::Darwin)
+    return false;
+  for (Module::named_metadata_iterator I = M.named_metadata_begin(),
+       E = M.named_metadata_end(); I != E; ++I)
+    if (I->getName().startswith("llvm.dbg."))
+      return false;
+  for (Module::iterator F = M.begin(), E = M.end(); F != E; ++F)
+    for (Function::iterator BB = F->begin(), BE = F->end(); BB != BE; ++BB)
+      if (BB->hasAddressTaken())
+        return false;
+  return true;
+}
+
+/// selectPartition - Reduce M to partition K of NumParts.
+static void selectPartition(Module &M, unsigned K, unsigned NumParts) {
+  PartitionMap Part;
+  assignPartitions(M, NumParts, Part);
+
+  // The mangler numbers unnamed symbols in the order it meets them, which
+  // differs between partitions, so name them all up front.
+  std::vector<GlobalValue*> GVs, Locals;
+  for (Module::iterator F = M.begin(), E = M.end(); F != E; ++F)
+    GVs.push_back(F);
+  for (Module::global_iterator G = M.global_begin(), E = M.global_end();
+       G != E; ++G)
+    GVs.push_back(G);
+  for (Module::alias_iterator A = M.alias_begin(), E = M.alias_end();
+       A != E; ++A)
+    GVs.push_back(A);
+  for (unsigned i = 0, e = GVs.size(); i != e; ++i) {
+    GlobalValue *GV = GVs[i];
+    if (!GV->hasName())
+      GV->setName("__unnamed");
+    if (GV->hasLocalLinkage() && !GV->isDeclaration())
+      Locals.push_back(GV);
+  }
+
+  // Private symbols are assembler temporaries, which are tagged differently
+  // in each partition.  Those used across partitions become internal, which
+  // keeps them local to the output but gives them one name in every part.
+  for (unsigned i = 0, e = Locals.size(); i != e; ++i) {
+    GlobalValue *GV = Locals[i];
+    GV->removeDeadConstantUsers();
+    if (!GV->hasInternalLinkage() && isUsedOutside(GV, Part[GV], Part))
+      GV->setLinkage(GlobalValue::InternalLinkage);
+  }
+
+  // Module asm and the special appending arrays, such as llvm.global_ctors,
+  // are emitted by the first partition only.  Arrays that code refers to
+  // become declarations like any other global.
+  if (K != 0) {
+    M.setModuleInlineAsm("");
+    for (Module::global_iterator G = M.global_begin(), E = M.global_end();
+         G != E; ) {
+      GlobalVariable *GV = G++;
+      GV->removeDeadConstantUsers();
+      if (GV->hasAppendingLinkage() && GV->use_empty())
+        GV->eraseFromParent();
+    }
+  }
+
+  // Drop the bodies of everything defined elsewhere.  Declarations of local
+  // symbols are hidden, so that references to them are generated as they
+  // would be for the local definition that the joined output has.
+  for (Module::iterator F = M.begin(), E = M.end(); F != E; ++F)
+    if (!F->isDeclaration() && Part[F] != K) {
+      bool Local = F->hasLocalLinkage();
+      F->deleteBody();
+      if (Local)
+        F->setVisibility(GlobalValue::HiddenVisibility);
+    }
+  if (K != 0)
+    for (Module::global_iterator G = M.global_begin(), E = M.global_end();
+         G != E; ++G)
+      if (!G->isDeclaration()) {
+        if (G->hasLocalLinkage())
+          G->setVisibility(GlobalValue::HiddenVisibility);
+        G->setInitializer(0);
+        G->setLinkage(GlobalValue::ExternalLinkage);
+      }
+  for (Module::alias_iterator A = M.alias_begin(), E = M.alias_end();
+       A != E; ) {
+    GlobalAlias *GA = A++;
+    if (Part[GA] == K)
+      continue;
+    const PointerType *PTy = cast<PointerType>(GA->getType());
+    GlobalValue *Decl;
+    if (const FunctionType *FTy =
+          dyn_cast<FunctionType>(PTy->getElementType()))
+      Decl = Function::Create(FTy, GlobalValue::ExternalLinkage, "", &M);
+    else
+      Decl = new GlobalVariable(M, PTy->getElementType(), false,
+                                GlobalValue::ExternalLinkage, 0, "", 0, false,
+                                PTy->getAddressSpace());
+    Decl->takeName(GA);
+    Decl->setVisibility(GA->hasLocalLinkage() ? GlobalValue::HiddenVisibility :
+                                                GA->getVisibility());
+    GA->replaceAllUsesWith(ConstantExpr::getBitCast(Decl, GA->getType()));
+    GA->eraseFromParent();
+  }
+
+  // Symbols only used by dropped code are no longer needed at all.
+  for (Module::iterator F = M.begin(), E = M.end(); F != E; ) {
+    Function *Fn = F++;
+    Fn->removeDeadConstantUsers();
+    if (Fn->isDeclaration() && Fn->use_empty() && Part.count(Fn))
+      Fn->eraseFromParent();
+  }
+  for (Module::global_iterator G = M.global_begin(), E = M.global_end();
+       G != E; ) {
+    GlobalVariable *GV = G++;
+    GV->removeDeadConstantUsers();
+    if (GV->isDeclaration() && GV->use_empty() && Part.count(GV))
+      GV->eraseFromParent();
+  }
+}
+
+/// runPartitions - Generate assembly for each partition of M in a child llc,
+/// all running at once, and append their output in order to Asm.  Return true
+/// on failure.
+static bool runPartitions(Module &M, int argc, char **argv, std::string &Asm) {
+  std::string ErrMsg;
+  sys::Path TempDir = sys::Path::GetTemporaryDirectory(&ErrMsg);
+  if (TempDir.isEmpty()) {
+    errs() << argv[0] << ": " << ErrMsg << '\n';
+    return true;
+  }
+
+  // The children read the module back from bitcode, as it may have come from
+  // standard input.
+  sys::Path Input(TempDir);
+  Input.appendComponent("input.bc");
+  {
+    tool_output_file BC(Input.c_str(), ErrMsg, raw_fd_ostream::F_Binary);
+    if (ErrMsg.empty()) {
+      WriteBitcodeToFile(&M, BC.os());
+      BC.os().close();
+      if (!BC.os().has_error())
+        BC.keep();
+      else {
+        BC.os().clear_error();
+        ErrMsg = "error writing " + Input.str();
+      }
+    }
+  }
+
+  sys::Path Exe = sys::Path::GetMainExecutable(argv[0],
+                                               (void*)(intptr_t)runPartitions);
+  std::vector<sys::Path> Outputs;
+  std::vector<sys::Program*> Children;
+  bool Failed = !ErrMsg.empty();
+  for (unsigned K = 0; K != NumJobs && !Failed; ++K) {
+    Outputs.push_back(TempDir);
+    Outputs.back().appendComponent("part" + utostr(K));
+
+    std::string PartArg = "-codegen-partition=" + utostr(K);
+    std::string InputArg = "-codegen-partition-input=" + Input.str();
+    std::string OutputArg = "-codegen-partition-output=" + Outputs.back().str();
+    std::vector<const char*> Args;
+    Args.push_back(Exe.c_str());
+    for (int i = 1; i != argc; ++i)
+      Args.push_back(argv[i]);
+    Args.push_back(PartArg.c_str());
+    Args.push_back(InputArg.c_str());
+    Args.push_back(OutputArg.c_str());
+    Args.push_back(0);
+
+    Children.push_back(new sys::Program());
+    Failed = !Children.back()->Execute(Exe, &Args[0], 0, 0, 0, &ErrMsg);
+  }
+
+  for (unsigned K = 0, e = Children.size(); K != e; ++K) {
+    std::string WaitErr;
+    if (Children[K]->Wait(Exe, 0, &WaitErr) != 0 && !Failed) {
+      Failed = true;
+      ErrMsg = "code generation of partition " + utostr(K) + " failed";
+      if (!WaitErr.empty())
+        ErrMsg += ": " + WaitErr;
+    }
+    delete Children[K];
+  }
+
+  for (unsigned K = 0, e = Outputs.size(); K != e && !Failed; ++K) {
+    OwningPtr<MemoryBuffer> Buf;
+    if (error_code EC = MemoryBuffer::getFile(Outputs[K].str(), Buf)) {
+      Failed = true;
+      ErrMsg = Outputs[K].str() + ": " + EC.message();
+    } else
+      Asm.append(Buf->getBufferStart(), Buf->getBufferEnd());
+  }
+
+  if (Failed)
+    errs() << argv[0] << ": " << ErrMsg << '\n';
+  TempDir.eraseFromDisk(true);
+  return Failed;
+}
+
+/// ignoreDiagnostic - Drop the assembler's diagnostics.  The caller falls back
+/// to a serial compile when the joined output doesn't assemble.
+static void ignoreDiagnostic(const SMDiagnostic &, void *) {}
+
+/// assembleOutput - Assemble Asm, the joined output of the partitions, into
+/// an object file on Out.  Nothing is written and true is returned if the
+/// integrated assembler rejects Asm.
+static bool assembleOutput(const std::string &Asm, const Target *TheTarget,
+                           TargetMachine &TM, const std::string &TripleName,
+                           raw_ostream &Out) {
+  SourceMgr SrcMgr;
+  SrcMgr.setDiagHandler(ignoreDiagnostic);
+  SrcMgr.AddNewSourceBuffer(MemoryBuffer::getMemBuffer(Asm, "<partitions>"),
+                            SMLoc());
+
+  const MCAsmInfo &MAI = *TM.getMCAsmInfo();
+  MCContext Ctx(MAI, new TargetAsmInfo(TM));
+  const TargetLoweringObjectFile &TLOF =
+    TM.getTargetLowering()->getObjFileLowering();
+  const_cast<TargetLoweringObjectFile&>(TLOF).Initialize(Ctx, TM);
+
+  MCCodeEmitter *CE = TheTarget->createCodeEmitter(TM, Ctx);
+  TargetAsmBackend *TAB = TheTarget->createAsmBackend(TripleName);
+  if (CE == 0 || TAB == 0) {
+    delete CE;
+    delete TAB;
+    return true;
+  }
+
+  SmallString<4096> Obj;
+  {
+    raw_svector_ostream OS(Obj);
+    formatted_raw_ostream FOS(OS);
+    OwningPtr<MCStreamer> Str(TheTarget->createObjectStreamer(TripleName, Ctx,
+                                                              *TAB, FOS, CE,
+                                                           TM.hasMCRelaxAll(),
+                                                       TM.hasMCNoExecStack()));
+    OwningPtr<MCAsmParser> Parser(createMCAsmParser(*TheTarget, SrcMgr, Ctx,
+                                                     *Str, MAI));
+    OwningPtr<TargetAsmParser> TAP(TheTarget->createAsmParser(*Parser, TM));
+    Parser->setTargetParser(*TAP);
+    if (Parser->Run(/*NoInitialTextSection=*/false))
+      return true;
+  }
+  Out << Obj.str();
+  return false;
+}
+
 // main - Entry point for the llc compiler.
 //
 int main(int argc, char **argv) {
@@ -207,6 +580,19 @@ int main(int argc, char **argv) {
   InitializeAllAsmParsers();
 
   cl::ParseCommandLineOptions(argc, argv, "llvm system compiler\n");
+
+  // A child of a -j build reads the module the parent wrote and produces
+  // output for the parent to collect.
+  bool IsPartition = CodeGenPartition >= 0;
+  std::string ModuleID =
+    InputFilename == "-" ? "<stdin>" : InputFilename.getValue();
+  if (IsPartition) {
+    InputFilename = PartitionInput;
+    OutputFilename = PartitionOutput;
+    // The parent assembles the output of its children itself.
+    FileType = TargetMachine::CGFT_AssemblyFile;
+    RelaxAll = false;
+  }
   
   // Load the module to be compiled...
   SMDiagnostic Err;
@@ -218,6 +604,8 @@ int main(int argc, char **argv) {
     return 1;
   }
   Module &mod = *M.get();
+  if (IsPartition)
+    mod.setModuleIdentifier(ModuleID);
 
   // If we are supposed to override the target triple, do so now.
   if (!TargetTriple.empty())
@@ -308,6 +696,47 @@ int main(int argc, char **argv) {
   case '3': OLvl = CodeGenOpt::Aggressive; break;
   }
 
+  if (RelaxAll) {
+    if (FileType != TargetMachine::CGFT_ObjectFile)
+      errs() << argv[0]
+             << ": warning: ignoring -mc-relax-all because filetype != obj";
+    else
+      Target.setMCRelaxAll(true);
+  }
+
+  if (NumJobs > 1 && !IsPartition) {
+    bool CanJoin = TheTarget->hasAsmPrinter() &&
+      (FileType == TargetMachine::CGFT_AssemblyFile ||
+       (FileType == TargetMachine::CGFT_ObjectFile &&
+        TheTarget->hasAsmParser()));
+    if (!CanJoin)
+      errs() << argv[0] << ": warning: ignoring -j because output is not "
+             << "target assembly or object code\n";
+    else if (canPartition(mod, TheTriple)) {
+      std::string Asm;
+      if (runPartitions(mod, argc, argv, Asm))
+        return 1;
+      // The integrated assembler doesn't accept everything the asm printers
+      // emit, such as '$' in i386 symbol names.  If it rejects the joined
+      // output, compile the module serially instead.
+      bool Done = true;
+      if (FileType == TargetMachine::CGFT_AssemblyFile)
+        Out->os() << Asm;
+      else
+        Done = !assembleOutput(Asm, TheTarget, Target, TheTriple.getTriple(),
+                               Out->os());
+      if (Done) {
+        Out->keep();
+        return 0;
+      }
+    }
+  }
+  if (IsPartition) {
+    selectPartition(mod, CodeGenPartition, NumJobs);
+    if (CodeGenPartition != 0)
+      Target.setMCTempSymbolTag("p" + utostr(CodeGenPartition) + "_");
+  }
+
   // Build up all of the passes that we want to do to the module.
   PassManager PM;
 
@@ -317,17 +746,12 @@ int main(int argc, char **argv) {
   else
     PM.add(new TargetData(&mod));
 
+  if (LoadProfile)
+    PM.add(createProfileLoaderPass());
+
   // Override default to generate verbose assembly.
   Target.setAsmVerbosityDefault(true);
 
-  if (RelaxAll) {
-    if (FileType != TargetMachine::CGFT_ObjectFile)
-      errs() << argv[0]
-             << ": warning: ignoring -mc-relax-all because filetype != obj";
-    else
-      Target.setMCRelaxAll(true);
-  }
-
   {
     formatted_raw_ostream FOS(Out->os());
 
@@ -536,8 +536,14 @@ void SubtargetEmitter::EmitProcessorLookup(raw_ostream &OS) {
     
     // Emit as { "cpu", procinit },
     OS << "  { "
-       << "\"" << Name << "\", "
-       << "(void *)&" << ProcItin;
+       << "\"" << Name << "\", ";
+
+    // Processors without a schedule share the empty itinerary data, which is
+    // not emitted.
+    if (ProcItin == "NoItineraries")
+      OS << "0";
+    else
+      OS << "(void *)&" << ProcItin;
         
     OS << " }";
     
@@ -0,0 +1,147 @@
+#!/usr/bin/env python
+
+"""
+Generate synthetic loops with many induction variable uses, and optionally
+time how long 'opt -loop-reduce' takes on them.
+
+These loops are a worst case for the formula search in LoopStrengthReduce:
+every use has its own stride and offset, so the number of candidate formulae
+and the number of solutions grow quickly with the number of uses.
+
+Examples:
+
+  lsr-stress.py --uses 64 > stress.ll
+  lsr-stress.py --time --opt=./bin/opt --uses 16,32,64,128,256
+"""
+
+import optparse
+import subprocess
+import sys
+import time
+
+DATALAYOUT = ("e-p:64:64:64-i1:8:8-i8:8:8-i16:16:16-i32:32:32-i64:64:64-"
+              "f32:32:32-f64:64:64-v64:64:64-v128:128:128-a0:0:64-s0:64:64-"
+              "f80:128:128-n8:16:32:64")
+TRIPLE = "x86_64-unknown-linux-gnu"
+
+TYPES = ["i8", "i16", "i32", "i64"]
+
+def gen_loop(out, name, uses, strides, arrays, invariants, addends):
+    """Emit a function with a single loop containing 'uses' loads, which are
+    spread over 'strides' different strides and 'arrays' base pointers.  The
+    index of each load adds 'addends' of the 'invariants' loop-invariant
+    offsets to the induction variable."""
+    args = ["i8* %%a%d" % k for k in range(arrays)]
+    args += ["i64 %%o%d" % k for k in range(invariants)]
+    out.write("define i64 @%s(%s, i64 %%n) nounwind {\n" % (name,
+                                                             ", ".join(args)))
+    out.write("entry:\n")
+    out.write("  %cmp = icmp sgt i64 %n, 0\n")
+    out.write("  br i1 %cmp, label %loop, label %exit\n\n")
+    out.write("loop:\n")
+    out.write("  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]\n")
+    out.write("  %sum = phi i64 [ 0, %entry ], [ %sum.next, %loop ]\n")
+    acc = "%sum"
+    for u in range(uses):
+        ty = TYPES[u % len(TYPES)]
+        stride = 1 + (u % strides)
+        offset = (u * 7) % 61
+        base = "%%a%d" % (u % arrays)
+        iv = "%i"
+        for k in range(min(addends, invariants)):
+            out.write("  %%j%d.%d = add i64 %s, %%o%d\n" %
+                      (u, k, iv, (u + k) % invariants))
+            iv = "%%j%d.%d" % (u, k)
+        out.write("  %%idx%d = mul i64 %s, %d\n" % (u, iv, stride))
+        out.write("  %%off%d = add i64 %%idx%d, %d\n" % (u, u, offset))
+        out.write("  %%p%d = getelementptr i8* %s, i64 %%off%d\n" % (u, base, u))
+        out.write("  %%q%d = bitcast i8* %%p%d to %s*\n" % (u, u, ty))
+        out.write("  %%v%d = load %s* %%q%d\n" % (u, ty, u))
+        if ty != "i64":
+            out.write("  %%x%d = zext %s %%v%d to i64\n" % (u, ty, u))
+        else:
+            out.write("  %%x%d = add i64 %%v%d, 0\n" % (u, u))
+        out.write("  %%s%d = add i64 %s, %%x%d\n" % (u, acc, u))
+        acc = "%%s%d" % u
+    out.write("  %%sum.next = add i64 %s, 0\n" % acc)
+    out.write("  %i.next = add i64 %i, 1\n")
+    out.write("  %done = icmp eq i64 %i.next, %n\n")
+    out.write("  br i1 %done, label %exit, label %loop\n\n")
+    out.write("exit:\n")
+    out.write("  %r = phi i64 [ 0, %entry ], [ %sum.next, %loop ]\n")
+    out.write("  ret i64 %r\n")
+    out.write("}\n\n")
+
+def gen_module(out, uses, strides, arrays, invariants, addends, loops):
+    out.write('target datalayout = "%s"\n' % DATALAYOUT)
+    out.write('target triple = "%s"\n\n' % TRIPLE)
+    for l in range(loops):
+        gen_loop(out, "stress%d" % l, uses, strides, arrays, invariants,
+                 addends)
+
+class StringOut:
+    def __init__(self):
+        self.parts = []
+    def write(self, s):
+        self.parts.append(s)
+    def getvalue(self):
+        return "".join(self.parts)
+
+def time_opt(opt, extra, ir):
+    cmd = [opt, "-loop-reduce", "-disable-output", "-stats"] + extra
+    start = time.time()
+    p = subprocess.Popen(cmd, stdin=subprocess.PIPE, stdout=subprocess.PIPE,
+                         stderr=subprocess.PIPE)
+    _, err = p.communicate(ir.encode())
+    elapsed = time.time() - start
+    budget = 0
+    for line in err.decode().splitlines():
+        if "hit the LSR complexity budget" in line:
+            budget += int(line.split()[0])
+    return p.returncode, elapsed, budget
+
+def main():
+    parser = optparse.OptionParser(usage="%prog [options]")
+    parser.add_option("--uses", default="64",
+                      help="number of IV uses per loop; a comma separated "
+                           "list with --time")
+    parser.add_option("--strides", type="int", default=8,
+                      help="number of distinct strides")
+    parser.add_option("--arrays", type="int", default=4,
+                      help="number of distinct base pointers")
+    parser.add_option("--invariants", type="int", default=4,
+                      help="number of distinct loop-invariant index offsets")
+    parser.add_option("--addends", type="int", default=3,
+                      help="number of invariant offsets added to each index")
+    parser.add_option("--loops", type="int", default=1,
+                      help="number of loops (functions) to generate")
+    parser.add_option("--time", action="store_true", default=False,
+                      help="time 'opt -loop-reduce' instead of printing IR")
+    parser.add_option("--opt", default="opt", help="opt binary to run")
+    parser.add_option("--opt-arg", action="append", default=[],
+                      dest="opt_args", help="extra argument for opt")
+    opts, args = parser.parse_args()
+
+    sizes = [int(s) for s in opts.uses.split(",")]
+    if not opts.time:
+        if len(sizes) != 1:
+            parser.error("--uses takes a single value without --time")
+        gen_module(sys.stdout, sizes[0], opts.strides, opts.arrays,
+                   opts.invariants, opts.addends, opts.loops)
+        return 0
+
+    print("%8s %10s %8s" % ("uses", "seconds", "budget"))
+    status = 0
+    for uses in sizes:
+        ir = StringOut()
+        gen_module(ir, uses, opts.strides, opts.arrays, opts.invariants,
+                   opts.addends, opts.loops)
+        rc, elapsed, budget = time_opt(opts.opt, opts.opt_args, ir.getvalue())
+        print("%8d %10.3f %8d%s" % (uses, elapsed, budget,
+                                     "" if rc == 0 else "  (opt failed)"))
+        if rc != 0:
+            status = 1
+    return status
+
+if __name__ == "__main__":
+    sys.exit(main())